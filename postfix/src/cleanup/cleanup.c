@@ -349,6 +349,14 @@
 /*	Available in Postfix version 3.0 and later:
 /* .IP "\fBvirtual_alias_address_length_limit (1000)\fR"
 /*	The maximal length of an email address after virtual alias expansion.
+/* .PP
+/*	Available in Postfix version 3.6 and later:
+/* .IP "\fBvirtual_alias_expansion_cache_size (0)\fR"
+/*	The maximal number of virtual alias expansion results that a
+/*	cleanup(8) process will remember.
+/* .IP "\fBvirtual_alias_expansion_cache_ttl (60s)\fR"
+/*	The maximal time that a cleanup(8) process will use a remembered
+/*	virtual alias expansion result.
 /* SMTPUTF8 CONTROLS
 /* .ad
 /* .fi
@@ -231,7 +231,11 @@ extern const CONFIG_TIME_TABLE cleanup_time_table[];
 extern void cleanup_out(CLEANUP_STATE *, int, const char *, ssize_t);
 extern void cleanup_out_string(CLEANUP_STATE *, int, const char *);
 extern void PRINTFLIKE(3, 4) cleanup_out_format(CLEANUP_STATE *, int, const char *,...);
-extern void cleanup_out_header(CLEANUP_STATE *, VSTRING *);
+extern void cleanup_out_header_info(CLEANUP_STATE *, VSTRING *,
+				            const MIME_HEADER_INFO *);
+
+#define cleanup_out_header(s, b) \
+	cleanup_out_header_info((s), (b), (MIME_HEADER_INFO *) 0)
 
 #define CLEANUP_OUT_BUF(s, t, b) \
 	cleanup_out((s), (t), vstring_str((b)), VSTRING_LEN((b)))
@@ -342,6 +346,7 @@ extern void cleanup_region_init(CLEANUP_STATE *);
 extern CLEANUP_REGION *cleanup_region_open(CLEANUP_STATE *, ssize_t);
 extern void cleanup_region_close(CLEANUP_STATE *, CLEANUP_REGION *);
 extern CLEANUP_REGION *cleanup_region_return(CLEANUP_STATE *, CLEANUP_REGION *);
+extern void cleanup_region_trim(CLEANUP_STATE *);
 extern void cleanup_region_done(CLEANUP_STATE *);
 
 extern int cleanup_body_edit_start(CLEANUP_STATE *);
@@ -29,14 +29,17 @@
 /*
 /*	cleanup_body_edit_start() performs initialization and sets
 /*	the queue file write pointer to the start of the first body
-/*	region.
+/*	region. The queue file stream buffer is enlarged, so that
+/*	replacement content is written in large blocks.
 /*
 /*	cleanup_body_edit_write() adds a queue file record to the
 /*	queue file. When the current body region fills up, some
 /*	unused region is reused, or a new region is created.
 /*
 /*	cleanup_body_edit_finish() makes some final adjustments
-/*	after the last body content record is written.
+/*	after the last body content record is written, and gives
+/*	unused space at the end of the queue file back to the file
+/*	system.
 /*
 /*	cleanup_body_edit_free() frees up memory that was allocated
 /*	by cleanup_body_edit_start() and cleanup_body_edit_write().
@@ -87,6 +90,11 @@
 
 #define LEN(s) VSTRING_LEN(s)
 
+ /*
+  * Queue file buffer size while writing replacement body content.
+  */
+#define CLEANUP_BODY_EDIT_BUFSIZE	(64 * 1024)
+
 static int cleanup_body_edit_ptr_rec_len;
 
 /* cleanup_body_edit_start - rewrite body region pool */
@@ -107,6 +115,9 @@ int     cleanup_body_edit_start(CLEANUP_STATE *state)
     if (state->body_regions == 0) {
 	REC_SPACE_NEED(REC_TYPE_PTR_PAYL_SIZE, cleanup_body_edit_ptr_rec_len);
 	cleanup_region_init(state);
+	vstream_control(state->dst,
+			CA_VSTREAM_CTL_BUFSIZE(CLEANUP_BODY_EDIT_BUFSIZE),
+			CA_VSTREAM_CTL_END);
     }
 
     /*
@@ -232,5 +243,12 @@ int     cleanup_body_edit_finish(CLEANUP_STATE *state)
     curr_rp->write_offs = vstream_ftell(state->dst);
     cleanup_region_close(state, curr_rp);
 
+    /*
+     * Don't let an earlier, larger, replacement body inflate the queue
+     * file.
+     */
+    if (CLEANUP_OUT_OK(state))
+	cleanup_region_trim(state);
+
     return (CLEANUP_OUT_OK(state) ? 0 : -1);
 }
@@ -144,6 +144,8 @@ char   *var_masq_classes;		/* what to masquerade */
 int     var_qattr_count_limit;		/* named attribute limit */
 int     var_virt_recur_limit;		/* maximum virtual alias recursion */
 int     var_virt_expan_limit;		/* maximum virtual alias expansion */
+int     var_virt_cache_size;		/* virtual alias expansion cache */
+int     var_virt_cache_ttl;		/* virtual alias expansion cache */
 int     var_body_check_len;		/* when to stop body scan */
 char   *var_send_bcc_maps;		/* sender auto-bcc maps */
 char   *var_rcpt_bcc_maps;		/* recipient auto-bcc maps */
@@ -181,6 +183,7 @@ const CONFIG_INT_TABLE cleanup_int_table[] = {
     VAR_VIRT_RECUR_LIMIT, DEF_VIRT_RECUR_LIMIT, &var_virt_recur_limit, 1, 0,
     VAR_VIRT_EXPAN_LIMIT, DEF_VIRT_EXPAN_LIMIT, &var_virt_expan_limit, 1, 0,
     VAR_VIRT_ADDRLEN_LIMIT, DEF_VIRT_ADDRLEN_LIMIT, &var_virt_addrlen_limit, 1, 0,
+    VAR_VIRT_CACHE_SIZE, DEF_VIRT_CACHE_SIZE, &var_virt_cache_size, 0, 0,
     VAR_BODY_CHECK_LEN, DEF_BODY_CHECK_LEN, &var_body_check_len, 0, 0,
     0,
 };
@@ -197,6 +200,7 @@ const CONFIG_TIME_TABLE cleanup_time_table[] = {
     VAR_MILT_CONN_TIME, DEF_MILT_CONN_TIME, &var_milt_conn_time, 1, 0,
     VAR_MILT_CMD_TIME, DEF_MILT_CMD_TIME, &var_milt_cmd_time, 1, 0,
     VAR_MILT_MSG_TIME, DEF_MILT_MSG_TIME, &var_milt_msg_time, 1, 0,
+    VAR_VIRT_CACHE_TTL, DEF_VIRT_CACHE_TTL, &var_virt_cache_ttl, 1, 0,
     0,
 };
 
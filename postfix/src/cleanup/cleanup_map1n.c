@@ -19,6 +19,26 @@
 /*
 /*	cleanup_map1n_internal() is the interface for addresses in
 /*	internal (unquoted) form.
+/*
+/*	Optionally, successful expansion results are saved in a
+/*	process-private cache, so that repeated mail for the same
+/*	(list) address is expanded only once. Cache entries are keyed
+/*	by the table name, the extension propagation flag, and the
+/*	input address, and expire after virtual_alias_expansion_cache_ttl
+/*	seconds. Expansions that fail are never cached. Changes to
+/*	file-based tables are handled by the cleanup(8) daemon, which
+/*	terminates (and thereby discards the cache) when a table file
+/*	has changed. The DSN and ORCPT properties of the original
+/*	recipient are applied by the caller, and are therefore not
+/*	part of the cached result.
+/* CONFIGURATION PARAMETERS
+/* .ad
+/* .fi
+/* .IP "\fBvirtual_alias_expansion_cache_size (0)\fR"
+/*	The maximal number of cached expansion results; specify 0
+/*	to disable the cache.
+/* .IP "\fBvirtual_alias_expansion_cache_ttl (60s)\fR"
+/*	The maximal time that an expansion result stays in the cache.
 /* DIAGNOSTICS
 /*	When the maximal expansion or recursion limit is reached,
 /*	the alias is not expanded and the CLEANUP_STAT_DEFER error
@@ -50,6 +70,7 @@
 
 #include <sys_defs.h>
 #include <string.h>
+#include <time.h>
 
 /* Utility library. */
 
@@ -59,6 +80,7 @@
 #include <vstring.h>
 #include <dict.h>
 #include <stringops.h>
+#include <ctable.h>
 
 /* Global library. */
 
@@ -72,10 +94,61 @@
 
 #include "cleanup.h"
 
-/* cleanup_map1n_internal - one-to-many table lookups */
+ /*
+  * Expansion cache. Each entry is created empty, and is filled in after a
+  * successful expansion. An entry without result, or with an expired result,
+  * is (re)computed on the next lookup.
+  */
+typedef struct {
+    ARGV   *argv;			/* expansion, or null */
+    time_t  expires;			/* expiration time */
+} CLEANUP_MAP1N_RESULT;
 
-ARGV   *cleanup_map1n_internal(CLEANUP_STATE *state, const char *addr,
-			               MAPS *maps, int propagate)
+static CTABLE *cleanup_map1n_cache;
+
+/* cleanup_map1n_cache_create - create empty cache entry */
+
+static void *cleanup_map1n_cache_create(const char *unused_key,
+					        void *unused_context)
+{
+    CLEANUP_MAP1N_RESULT *result;
+
+    result = (CLEANUP_MAP1N_RESULT *) mymalloc(sizeof(*result));
+    result->argv = 0;
+    result->expires = 0;
+    return ((void *) result);
+}
+
+/* cleanup_map1n_cache_delete - destroy cache entry */
+
+static void cleanup_map1n_cache_delete(void *value, void *unused_context)
+{
+    CLEANUP_MAP1N_RESULT *result = (CLEANUP_MAP1N_RESULT *) value;
+
+    if (result->argv)
+	argv_free(result->argv);
+    myfree((void *) result);
+}
+
+/* cleanup_map1n_copy - copy address vector */
+
+static ARGV *cleanup_map1n_copy(ARGV *argv)
+{
+    ARGV   *copy;
+    char  **cpp;
+
+    copy = argv_alloc(argv->argc);
+    for (cpp = argv->argv; *cpp; cpp++)
+	argv_add(copy, *cpp, ARGV_END);
+    argv_terminate(copy);
+    return (copy);
+}
+
+/* cleanup_map1n_expand - one-to-many table lookups */
+
+static ARGV *cleanup_map1n_expand(CLEANUP_STATE *state, const char *addr,
+				          MAPS *maps, int propagate,
+				          int *cacheable)
 {
     ARGV   *argv;
     ARGV   *lookup;
@@ -109,8 +182,11 @@ ARGV   *cleanup_map1n_internal(CLEANUP_STATE *state, const char *addr,
     } while (0)
 #define UNEXPAND(argv, addr) do { \
 	argv_truncate((argv), 0); argv_add((argv), (addr), (char *) 0); \
+	*cacheable = 0; \
     } while (0)
 
+    *cacheable = 1;
+
     for (arg = 0; arg < argv->argc; arg++) {
 	if (argv->argc > var_virt_expan_limit) {
 	    msg_warn("%s: unreasonable %s map expansion size for %s -- "
@@ -180,3 +256,62 @@ ARGV   *cleanup_map1n_internal(CLEANUP_STATE *state, const char *addr,
     }
     RETURN(argv);
 }
+
+/* cleanup_map1n_internal - one-to-many table lookups, with optional cache */
+
+ARGV   *cleanup_map1n_internal(CLEANUP_STATE *state, const char *addr,
+			               MAPS *maps, int propagate)
+{
+    static VSTRING *key;
+    CLEANUP_MAP1N_RESULT *result;
+    ARGV   *argv;
+    int     cacheable;
+    time_t  now;
+
+    /*
+     * Bypass the cache if it is disabled.
+     */
+    if (var_virt_cache_size <= 0)
+	return (cleanup_map1n_expand(state, addr, maps, propagate, &cacheable));
+
+    /*
+     * Initialize on the fly.
+     */
+    if (cleanup_map1n_cache == 0) {
+	cleanup_map1n_cache = ctable_create(var_virt_cache_size,
+					    cleanup_map1n_cache_create,
+					    cleanup_map1n_cache_delete,
+					    (void *) 0);
+	key = vstring_alloc(100);
+    }
+
+    /*
+     * Use a cached result if we have one that has not expired. Note: the
+     * result must be copied, because the caller owns the returned vector.
+     */
+    vstring_sprintf(key, "%s\n%d\n%s", maps->title, propagate, addr);
+    result = (CLEANUP_MAP1N_RESULT *)
+	ctable_locate(cleanup_map1n_cache, STR(key));
+    now = time((time_t *) 0);
+    if (result->argv != 0 && result->expires > now) {
+	if (msg_verbose)
+	    msg_info("%s: %s map cache hit for %s",
+		     state->queue_id, maps->title, addr);
+	return (cleanup_map1n_copy(result->argv));
+    }
+
+    /*
+     * Expand the address, and save the result only if the expansion
+     * completed without error.
+     */
+    if (result->argv != 0) {
+	argv_free(result->argv);
+	result->argv = 0;
+    }
+    argv = cleanup_map1n_expand(state, addr, maps, propagate, &cacheable);
+    if (cacheable) {
+	result->argv = cleanup_map1n_copy(argv);
+	result->expires = now + var_virt_cache_ttl;
+    }
+    return (argv);
+}
@@ -495,6 +495,7 @@ static void cleanup_header_callback(void *context, int header_class,
 {
     CLEANUP_STATE *state = (CLEANUP_STATE *) context;
     const char *myname = "cleanup_header_callback";
+    const MIME_HEADER_INFO *info = mime_state_header_info(state->mime_state);
     char   *hdrval;
     struct code_map {
 	const char *name;
@@ -547,6 +548,7 @@ static void cleanup_header_callback(void *context, int header_class,
 		vstring_strcpy(header_buf, result);
 		hdr_opts = header_opts_find(result);
 		myfree((void *) result);
+		info = 0;			/* stale MIME header info */
 	    }
 	} else if (checks->error) {
 	    msg_warn("%s: %s map lookup problem -- "
@@ -562,15 +564,17 @@ static void cleanup_header_callback(void *context, int header_class,
      * headers that do not fit a REC_TYPE_NORM record.
      */
     if (hdr_opts == 0) {
-	cleanup_out_header(state, header_buf);
+	cleanup_out_header_info(state, header_buf, info);
 	return;
     }
 
     /*
-     * Allow 8-bit type info to override 7-bit type info. XXX Should reuse
-     * the effort that went into MIME header parsing.
+     * Allow 8-bit type info to override 7-bit type info. Reuse the effort
+     * that went into MIME header parsing, unless header_checks replaced the
+     * header.
      */
-    hdrval = vstring_str(header_buf) + strlen(hdr_opts->name) + 1;
+    hdrval = vstring_str(header_buf) + (info ? info->value_offset :
+					strlen(hdr_opts->name) + 1);
     while (ISSPACE(*hdrval))
 	hdrval++;
     /* trimblanks(hdrval, 0)[0] = 0; */
@@ -590,7 +594,7 @@ static void cleanup_header_callback(void *context, int header_class,
      * Copy attachment etc. header blocks without further inspection.
      */
     if (header_class != MIME_HDR_PRIMARY) {
-	cleanup_out_header(state, header_buf);
+	cleanup_out_header_info(state, header_buf, info);
 	return;
     }
 
@@ -649,7 +653,7 @@ static void cleanup_header_callback(void *context, int header_class,
 		       && state->hdr_rewrite_context) {
 		cleanup_rewrite_recip(state, hdr_opts, header_buf);
 	    } else if ((hdr_opts->flags & HDR_OPT_DROP) == 0) {
-		cleanup_out_header(state, header_buf);
+		cleanup_out_header_info(state, header_buf, info);
 	    }
 	}
     }
@@ -33,6 +33,11 @@
 /*	void	cleanup_out_header(state, buf)
 /*	CLEANUP_STATE *state;
 /*	VSTRING	*buf;
+/*
+/*	void	cleanup_out_header_info(state, buf, info)
+/*	CLEANUP_STATE *state;
+/*	VSTRING	*buf;
+/*	const MIME_HEADER_INFO *info;
 /* DESCRIPTION
 /*	This module writes records to the output stream.
 /*
@@ -52,6 +57,11 @@
 /*	cleanup_out_format() formats its arguments and writes
 /*	the result as a record.
 /*
+/*	cleanup_out_header_info() is like cleanup_out_header(), but
+/*	uses MIME parser information about the unmodified header
+/*	(8-bit content, number of lines) instead of scanning the
+/*	header again.
+/*
 /*	cleanup_out_header() outputs a multi-line header as records
 /*	of the specified type. The input is expected to be newline
 /*	separated (not newline terminated), and is modified.
@@ -175,7 +185,8 @@ void    cleanup_out_format(CLEANUP_STATE *state, int type, const char *fmt,...)
 
 /* cleanup_out_header - output one multi-line header as a bunch of records */
 
-void    cleanup_out_header(CLEANUP_STATE *state, VSTRING *header_buf)
+void    cleanup_out_header_info(CLEANUP_STATE *state, VSTRING *header_buf,
+				        const MIME_HEADER_INFO *info)
 {
     char   *start = vstring_str(header_buf);
     char   *line;
@@ -185,7 +196,9 @@ void    cleanup_out_header(CLEANUP_STATE *state, VSTRING *header_buf)
     /*
      * Fix 20140711: Auto-detect the presence of a non-ASCII header.
      */
-    if (var_smtputf8_enable && *STR(header_buf) && !allascii(STR(header_buf))) {
+    if (var_smtputf8_enable && *STR(header_buf)
+	&& (info ? (info->flags & MIME_HEADER_FLAG_8BIT) != 0 :
+	    !allascii(STR(header_buf)))) {
 	state->smtputf8 |= SMTPUTF8_FLAG_HEADER;
 	/* Fix 20140713: request SMTPUTF8 support selectively. */
 	if (state->flags & CLEANUP_FLAG_AUTOUTF8)
@@ -208,7 +221,18 @@ void    cleanup_out_header(CLEANUP_STATE *state, VSTRING *header_buf)
      * If Milter is enabled, pad a short header record with a dummy record so
      * that a header record can safely be overwritten by a pointer record.
      * This simplifies header modification enormously.
+     * 
+     * A single-line header that fits the header size limit needs no splitting.
      */
+    if (info != 0 && info->line_count == 1
+	&& (line_len = strlen(start)) <= var_header_limit) {
+	cleanup_out_string(state, REC_TYPE_NORM, start);
+	if ((state->milters || cleanup_milters)
+	    && line_len < REC_TYPE_PTR_PAYL_SIZE)
+	    rec_pad(state->dst, REC_TYPE_DTXT,
+		    REC_TYPE_PTR_PAYL_SIZE - line_len);
+	return;
+    }
     for (line = start; line; line = next_line) {
 	next_line = split_at(line, '\n');
 	line_len = next_line ? next_line - 1 - line : strlen(line);
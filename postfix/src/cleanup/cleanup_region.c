@@ -21,6 +21,9 @@
 /*	CLEANUP_STATE *state;
 /*	CLEANUP_REGION *rp;
 /*
+/*	void	cleanup_region_trim(state)
+/*	CLEANUP_STATE *state;
+/*
 /*	void	cleanup_region_done(state)
 /*	CLEANUP_STATE *state;
 /* DESCRIPTION
@@ -41,18 +44,26 @@
 /*	a new region that can accommodate at least the specified
 /*	amount of space. A new region is an open-ended region at
 /*	the end of the file; it must be closed (see next) before
-/*	unrelated data can be appended to the same file.
+/*	unrelated data can be appended to the same file. When no
+/*	free region is large enough, but the free pool contains a
+/*	region at the end of the file, that region is reopened as
+/*	an open-ended region, instead of leaving it unused.
 /*
 /*	cleanup_region_close() indicates that a region will not be
 /*	updated further. With an open-ended region, the region's
 /*	end is frozen just before the caller-maintained write offset.
 /*	With a close-ended region, unused space (beginning at the
-/*	caller-maintained write offset) may be returned to the free
+/*	caller-maintained write offset) is returned to the free
 /*	pool.
 /*
 /*	cleanup_region_return() returns a list of regions to the
 /*	free pool, and returns a null pointer. To avoid fragmentation,
-/*	adjacent free regions may be coalesced together.
+/*	the free pool is kept in file offset order, and adjacent
+/*	free regions are coalesced together.
+/*
+/*	cleanup_region_trim() truncates the queue file when the
+/*	free pool contains a region at the end of the file. This
+/*	function must not be called while a region is open.
 /*
 /*	cleanup_region_done() destroys all in-memory information
 /*	that was allocated for administering queue file regions.
@@ -78,6 +89,7 @@
 
 #include <sys_defs.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 /* Utility library. */
 
@@ -146,6 +158,7 @@ CLEANUP_REGION *cleanup_region_open(CLEANUP_STATE *state, ssize_t len)
 {
     const char *myname = "cleanup_region_open";
     CLEANUP_REGION **rpp;
+    CLEANUP_REGION **last_rpp = 0;
     CLEANUP_REGION *rp;
     struct stat st;
 
@@ -156,15 +169,30 @@ CLEANUP_REGION *cleanup_region_open(CLEANUP_STATE *state, ssize_t len)
 
 	/*
 	 * Create an open-ended region at the end of the queue file. We
-	 * freeze the region size after we stop writing to it. XXX Assume
-	 * that fstat() returns a file size that is never less than the file
-	 * append offset. It is not a problem if fstat() returns a larger
-	 * result; we would just waste some space.
+	 * freeze the region size after we stop writing to it. Flush pending
+	 * output, so that fstat() returns a file size that is never less
+	 * than the file append offset. It is not a problem if fstat()
+	 * returns a larger result; we would just waste some space.
+	 * 
+	 * If the last free region ends at the end of the file, reopen that
+	 * region as an open-ended region, instead of leaving a hole.
 	 */
 	if ((rp = *rpp) == 0) {
+	    if (vstream_fflush(state->dst) != 0)
+		msg_fatal("%s: flush file %s: %m", myname, cleanup_path);
 	    if (fstat(vstream_fileno(state->dst), &st) < 0)
 		msg_fatal("%s: fstat file %s: %m", myname, cleanup_path);
-	    rp = cleanup_region_alloc(st.st_size, 0);
+	    if (last_rpp != 0
+		&& (*last_rpp)->start + (*last_rpp)->len == st.st_size) {
+		rp = *last_rpp;
+		*last_rpp = 0;
+		rp->len = 0;
+		rp->write_offs = rp->start;
+		if (msg_verbose)
+		    msg_info("%s: extend start %ld", myname, (long) rp->start);
+	    } else {
+		rp = cleanup_region_alloc(st.st_size, 0);
+	    }
 	    break;
 	}
 
@@ -184,6 +212,7 @@ CLEANUP_REGION *cleanup_region_open(CLEANUP_STATE *state, ssize_t len)
 	if (msg_verbose)
 	    msg_info("%s: skip start %ld len %ld < %ld",
 		     myname, (long) rp->start, (long) rp->len, (long) len);
+	last_rpp = rpp;
     }
     if (msg_verbose)
 	msg_info("%s: done start %ld len %ld",
@@ -193,17 +222,24 @@ CLEANUP_REGION *cleanup_region_open(CLEANUP_STATE *state, ssize_t len)
 
 /* cleanup_region_close - freeze queue file region size */
 
-void    cleanup_region_close(CLEANUP_STATE *unused_state, CLEANUP_REGION *rp)
+void    cleanup_region_close(CLEANUP_STATE *state, CLEANUP_REGION *rp)
 {
     const char *myname = "cleanup_region_close";
+    off_t   unused;
 
     /*
      * If this region is still open ended, freeze the size. If this region is
-     * closed, some future version of this routine may shrink the size and
-     * return the unused portion to the free pool.
+     * closed, shrink the size and return the unused portion to the free
+     * pool, so that a later body replacement can reuse that space.
      */
-    if (rp->len == 0)
+    if (rp->len == 0) {
 	rp->len = rp->write_offs - rp->start;
+    } else if ((unused = rp->start + rp->len - rp->write_offs) > 0) {
+	rp->len -= unused;
+	(void) cleanup_region_return(state,
+				     cleanup_region_alloc(rp->write_offs,
+							  unused));
+    }
     if (msg_verbose)
 	msg_info("%s: freeze start %ld len %ld",
 		 myname, (long) rp->start, (long) rp->len);
@@ -213,14 +249,85 @@ void    cleanup_region_close(CLEANUP_STATE *unused_state, CLEANUP_REGION *rp)
 
 CLEANUP_REGION *cleanup_region_return(CLEANUP_STATE *state, CLEANUP_REGION *rp)
 {
+    const char *myname = "cleanup_region_return";
     CLEANUP_REGION **rpp;
+    CLEANUP_REGION *next;
+    CLEANUP_REGION *fp;
 
-    for (rpp = &state->free_regions; (*rpp) != 0; rpp = &(*rpp)->next)
-	 /* void */ ;
-    *rpp = rp;
+    /*
+     * Insert each region into the free pool, in file offset order. A region
+     * that is still open ended (for example, after an error) is frozen at
+     * the caller-maintained write offset.
+     */
+    for ( /* void */ ; rp != 0; rp = next) {
+	next = rp->next;
+	if (rp->len == 0)
+	    rp->len = rp->write_offs - rp->start;
+	if (rp->len <= 0) {
+	    myfree((void *) rp);
+	    continue;
+	}
+	for (rpp = &state->free_regions; (*rpp) != 0
+	     && (*rpp)->start < rp->start; rpp = &(*rpp)->next)
+	     /* void */ ;
+	rp->next = *rpp;
+	*rpp = rp;
+    }
+
+    /*
+     * Coalesce adjacent free regions.
+     */
+    for (fp = state->free_regions; fp != 0 && (next = fp->next) != 0; /* */ ) {
+	if (fp->start + fp->len == next->start) {
+	    if (msg_verbose)
+		msg_info("%s: merge start %ld len %ld + start %ld len %ld",
+			 myname, (long) fp->start, (long) fp->len,
+			 (long) next->start, (long) next->len);
+	    fp->len += next->len;
+	    fp->next = next->next;
+	    myfree((void *) next);
+	} else {
+	    fp = next;
+	}
+    }
     return (0);
 }
 
+/* cleanup_region_trim - truncate unused space at end of queue file */
+
+void    cleanup_region_trim(CLEANUP_STATE *state)
+{
+    const char *myname = "cleanup_region_trim";
+    CLEANUP_REGION **rpp;
+    CLEANUP_REGION *rp;
+    struct stat st;
+
+    /*
+     * Find the last free region. If it ends at the end of the file, it is
+     * not followed by other content, and we can give the space back.
+     */
+    if (state->free_regions == 0)
+	return;
+    for (rpp = &state->free_regions; (*rpp)->next != 0; rpp = &(*rpp)->next)
+	 /* void */ ;
+    rp = *rpp;
+    if (vstream_fflush(state->dst) != 0)
+	msg_fatal("%s: flush file %s: %m", myname, cleanup_path);
+    if (fstat(vstream_fileno(state->dst), &st) < 0)
+	msg_fatal("%s: fstat file %s: %m", myname, cleanup_path);
+    if (rp->start + rp->len != st.st_size)
+	return;
+    if (ftruncate(vstream_fileno(state->dst), rp->start) < 0) {
+	msg_warn("%s: truncate file %s: %m", myname, cleanup_path);
+	return;
+    }
+    if (msg_verbose)
+	msg_info("%s: truncate start %ld len %ld",
+		 myname, (long) rp->start, (long) rp->len);
+    *rpp = 0;
+    myfree((void *) rp);
+}
+
 /* cleanup_region_done - destroy region metadata */
 
 void    cleanup_region_done(CLEANUP_STATE *state)
@@ -230,3 +337,128 @@ void    cleanup_region_done(CLEANUP_STATE *state)
     if (state->body_regions != 0)
 	state->body_regions = cleanup_region_free(state->body_regions);
 }
+
+#ifdef TEST
+
+ /*
+  * Region manager driver for regression tests. Read commands from stdin
+  * that open, fill, close, and return numbered regions in a scratch file,
+  * and report the free pool and the file size after each command.
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <msg_vstream.h>
+#include <vstring_vstream.h>
+#include <stringops.h>
+
+char   *cleanup_path;
+
+#define REGION_TEST_SLOTS	10
+
+static void region_test_report(CLEANUP_STATE *state)
+{
+    CLEANUP_REGION *rp;
+    struct stat st;
+
+    if (vstream_fflush(state->dst) != 0
+	|| fstat(vstream_fileno(state->dst), &st) < 0)
+	msg_fatal("flush or fstat %s: %m", cleanup_path);
+    vstream_printf("free:");
+    for (rp = state->free_regions; rp != 0; rp = rp->next)
+	vstream_printf(" start %ld len %ld;", (long) rp->start, (long) rp->len);
+    vstream_printf(" size %ld\n", (long) st.st_size);
+    vstream_fflush(VSTREAM_OUT);
+}
+
+int     main(int argc, char **argv)
+{
+    CLEANUP_REGION *slots[REGION_TEST_SLOTS];
+    CLEANUP_REGION *rp;
+    CLEANUP_STATE state;
+    VSTRING *buf = vstring_alloc(100);
+    char   *cp;
+    char   *cmd;
+    char   *arg1;
+    char   *arg2;
+    int     slot;
+    long    count;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 2)
+	msg_fatal("usage: %s scratch-file", argv[0]);
+    cleanup_path = argv[1];
+    memset((void *) &state, 0, sizeof(state));
+    memset((void *) slots, 0, sizeof(slots));
+    if ((state.dst = vstream_fopen(cleanup_path, O_RDWR | O_CREAT | O_TRUNC,
+				   0600)) == 0)
+	msg_fatal("open %s: %m", cleanup_path);
+    (void) unlink(cleanup_path);
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	cp = vstring_str(buf);
+	if (*cp == 0 || *cp == '#')
+	    continue;
+	vstream_printf("> %s\n", cp);
+	if ((cmd = mystrtok(&cp, " \t")) == 0)
+	    continue;
+	arg1 = mystrtok(&cp, " \t");
+	arg2 = mystrtok(&cp, " \t");
+	slot = arg1 ? atoi(arg1) : -1;
+	count = arg2 ? atol(arg2) : -1;
+
+	/*
+	 * Commands without a region argument.
+	 */
+	if (strcmp(cmd, "trim") == 0 && arg1 == 0) {
+	    cleanup_region_trim(&state);
+	} else if (strcmp(cmd, "append") == 0 && arg1 != 0 && arg2 == 0
+		   && (count = atol(arg1)) >= 0) {
+	    if (vstream_fseek(state.dst, (off_t) 0, SEEK_END) < 0)
+		msg_fatal("seek %s: %m", cleanup_path);
+	    while (count-- > 0)
+		VSTREAM_PUTC('a', state.dst);
+	}
+
+	/*
+	 * Commands with a region argument.
+	 */
+	else if (slot < 0 || slot >= REGION_TEST_SLOTS) {
+	    msg_warn("bad or missing region number");
+	    continue;
+	} else if (strcmp(cmd, "open") == 0 && slots[slot] == 0 && count >= 0) {
+	    rp = slots[slot] = cleanup_region_open(&state, count);
+	    vstream_printf("region %d: start %ld len %ld\n",
+			   slot, (long) rp->start, (long) rp->len);
+	} else if ((rp = slots[slot]) == 0) {
+	    msg_warn("region %d is not open", slot);
+	    continue;
+	} else if (strcmp(cmd, "write") == 0 && count >= 0) {
+	    if (vstream_fseek(state.dst, rp->write_offs, SEEK_SET) < 0)
+		msg_fatal("seek %s: %m", cleanup_path);
+	    for (rp->write_offs += count; count > 0; count--)
+		VSTREAM_PUTC('0' + slot, state.dst);
+	} else if (strcmp(cmd, "close") == 0 && arg2 == 0) {
+	    cleanup_region_close(&state, rp);
+	    vstream_printf("region %d: start %ld len %ld\n",
+			   slot, (long) rp->start, (long) rp->len);
+	} else if (strcmp(cmd, "return") == 0 && arg2 == 0) {
+	    slots[slot] = cleanup_region_return(&state, rp);
+	} else {
+	    msg_warn("usage: append count | trim | open slot len "
+		     "| write slot count | close slot | return slot");
+	    continue;
+	}
+	region_test_report(&state);
+    }
+    for (slot = 0; slot < REGION_TEST_SLOTS; slot++)
+	if (slots[slot] != 0)
+	    slots[slot] = cleanup_region_return(&state, slots[slot]);
+    cleanup_region_done(&state);
+    if (vstream_fclose(state.dst))
+	msg_fatal("close %s: %m", cleanup_path);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
@@ -199,4 +199,5 @@ void    cleanup_state_free(CLEANUP_STATE *state)
 	vstring_free(state->milter_dsn_buf);
     cleanup_region_done(state);
     myfree((void *) state);
+    vstring_pool_reset();
 }
@@ -66,6 +66,14 @@
 /*
 /*	been_here_free() releases storage for a duplicate filter.
 /*
+/*	The implementation is optimized for large numbers of strings,
+/*	such as the recipients of a message for a large mailing list.
+/*	Each remembered string costs one hash fingerprint and one
+/*	string offset in an open-addressed table, plus the string
+/*	itself in a shared, contiguous, string pool. The full strings
+/*	are compared only when fingerprints match. Memory for deleted
+/*	strings is reclaimed when the table is resized.
+/*
 /*	Arguments:
 /* .IP size
 /*	Upper bound on the table size; at most \fIsize\fR strings will
@@ -106,20 +114,119 @@
 #include "sys_defs.h"
 #include <stdlib.h>			/* 44BSD stdarg.h uses abort() */
 #include <stdarg.h>
+#include <string.h>
 
 /* Utility library. */
 
 #include <msg.h>
 #include <mymalloc.h>
-#include <htable.h>
 #include <vstring.h>
 #include <stringops.h>
+#include <hash_fnv.h>
 
 /* Global library. */
 
 #include "been_here.h"
 
 #define STR(x)	vstring_str(x)
+#define LEN(x)	VSTRING_LEN(x)
+
+ /*
+  * One table slot: a string fingerprint, and the offset of the string in
+  * the string pool. We use the offset, not a pointer, because the string
+  * pool may be relocated as it grows.
+  */
+typedef struct BH_SLOT {
+    size_t  hash;			/* string fingerprint */
+    ssize_t offset;			/* string pool offset, or below */
+} BH_SLOT;
+
+#define BH_SLOT_EMPTY	(-1)		/* never used */
+#define BH_SLOT_DELETED	(-2)		/* was used */
+
+#define BH_MIN_SIZE	16		/* initial table size */
+
+/* been_here_slots - allocate empty slot array */
+
+static BH_SLOT *been_here_slots(ssize_t size)
+{
+    BH_SLOT *slots;
+    BH_SLOT *sp;
+
+    slots = (BH_SLOT *) mymalloc(sizeof(*slots) * size);
+    for (sp = slots; sp < slots + size; sp++)
+	sp->offset = BH_SLOT_EMPTY;
+    return (slots);
+}
+
+/* been_here_find - find matching slot or insertion point */
+
+static BH_SLOT *been_here_find(BH_TABLE *dup_filter, const char *string,
+			               size_t hash, BH_SLOT **insert)
+{
+    BH_SLOT *sp;
+    size_t  mask = dup_filter->size - 1;
+    size_t  n;
+
+    /*
+     * Linear probing. Remember the first deleted slot, so that insertion
+     * can reuse it.
+     */
+    if (insert)
+	*insert = 0;
+    for (n = hash & mask; /* see below */ ; n = (n + 1) & mask) {
+	sp = dup_filter->slots + n;
+	if (sp->offset == BH_SLOT_EMPTY) {
+	    if (insert && *insert == 0)
+		*insert = sp;
+	    return (0);
+	}
+	if (sp->offset == BH_SLOT_DELETED) {
+	    if (insert && *insert == 0)
+		*insert = sp;
+	    continue;
+	}
+	if (sp->hash == hash
+	    && strcmp(STR(dup_filter->strings) + sp->offset, string) == 0)
+	    return (sp);
+    }
+}
+
+/* been_here_resize - rebuild table and string pool */
+
+static void been_here_resize(BH_TABLE *dup_filter, ssize_t new_size)
+{
+    BH_SLOT *old_slots = dup_filter->slots;
+    ssize_t old_size = dup_filter->size;
+    VSTRING *old_strings = dup_filter->strings;
+    BH_SLOT *sp;
+    BH_SLOT *insert;
+    size_t  mask = new_size - 1;
+    size_t  n;
+
+    /*
+     * Re-insert the live entries only. This also squeezes out the strings
+     * of deleted entries. The entries are known to be unique, so we need
+     * no string comparisons.
+     */
+    dup_filter->slots = been_here_slots(new_size);
+    dup_filter->size = new_size;
+    dup_filter->deleted = 0;
+    dup_filter->strings = vstring_alloc(LEN(old_strings) + 1);
+    for (sp = old_slots; sp < old_slots + old_size; sp++) {
+	if (sp->offset < 0)
+	    continue;
+	for (n = sp->hash & mask; (insert = dup_filter->slots + n)->offset
+	     != BH_SLOT_EMPTY; n = (n + 1) & mask)
+	     /* void */ ;
+	insert->hash = sp->hash;
+	insert->offset = LEN(dup_filter->strings);
+	vstring_strcat(dup_filter->strings, STR(old_strings) + sp->offset);
+	VSTRING_ADDCH(dup_filter->strings, 0);
+    }
+    myfree((void *) old_slots);
+    vstring_free(old_strings);
+}
 
 /* been_here_init - initialize duplicate filter */
 
@@ -130,7 +237,13 @@ BH_TABLE *been_here_init(int limit, int flags)
     dup_filter = (BH_TABLE *) mymalloc(sizeof(*dup_filter));
     dup_filter->limit = limit;
     dup_filter->flags = flags;
-    dup_filter->table = htable_create(0);
+    dup_filter->size = BH_MIN_SIZE;
+    dup_filter->slots = been_here_slots(dup_filter->size);
+    dup_filter->used = 0;
+    dup_filter->deleted = 0;
+    dup_filter->strings = vstring_alloc(100);
+    dup_filter->fmt_buf = 0;
+    dup_filter->fold_buf = 0;
     return (dup_filter);
 }
 
@@ -138,76 +251,106 @@ BH_TABLE *been_here_init(int limit, int flags)
 
 void    been_here_free(BH_TABLE *dup_filter)
 {
-    htable_free(dup_filter->table, (void (*) (void *)) 0);
+    myfree((void *) dup_filter->slots);
+    vstring_free(dup_filter->strings);
+    if (dup_filter->fmt_buf)
+	vstring_free(dup_filter->fmt_buf);
+    if (dup_filter->fold_buf)
+	vstring_free(dup_filter->fold_buf);
     myfree((void *) dup_filter);
 }
 
+/* been_here_key - optionally case-fold the search string */
+
+static const char *been_here_key(BH_TABLE *dup_filter, const char *string)
+{
+
+    /*
+     * Special processing: case insensitive lookup.
+     */
+    if (dup_filter->flags & BH_FLAG_FOLD) {
+	if (dup_filter->fold_buf == 0)
+	    dup_filter->fold_buf = vstring_alloc(100);
+	return (casefold(dup_filter->fold_buf, string));
+    } else {
+	return (string);
+    }
+}
+
+/* been_here_format - format the search string */
+
+static const char *been_here_format(BH_TABLE *dup_filter, const char *fmt,
+				            va_list ap)
+{
+    if (dup_filter->fmt_buf == 0)
+	dup_filter->fmt_buf = vstring_alloc(100);
+    vstring_vsprintf(dup_filter->fmt_buf, fmt, ap);
+    return (STR(dup_filter->fmt_buf));
+}
+
 /* been_here - duplicate detector with finer control */
 
 int     been_here(BH_TABLE *dup_filter, const char *fmt,...)
 {
-    VSTRING *buf = vstring_alloc(100);
-    int     status;
+    const char *string;
     va_list ap;
 
     /*
      * Construct the string to be checked.
      */
     va_start(ap, fmt);
-    vstring_vsprintf(buf, fmt, ap);
+    string = been_here_format(dup_filter, fmt, ap);
     va_end(ap);
 
     /*
      * Do the duplicate check.
      */
-    status = been_here_fixed(dup_filter, vstring_str(buf));
-
-    /*
-     * Cleanup.
-     */
-    vstring_free(buf);
-    return (status);
+    return (been_here_fixed(dup_filter, string));
 }
 
 /* been_here_fixed - duplicate detector */
 
 int     been_here_fixed(BH_TABLE *dup_filter, const char *string)
 {
-    VSTRING *folded_string;
     const char *lookup_key;
+    size_t  hash;
+    BH_SLOT *insert;
     int     status;
 
-    /*
-     * Special processing: case insensitive lookup.
-     */
-    if (dup_filter->flags & BH_FLAG_FOLD) {
-	folded_string = vstring_alloc(100);
-	lookup_key = casefold(folded_string, string);
-    } else {
-	folded_string = 0;
-	lookup_key = string;
-    }
-
     /*
      * Do the duplicate check.
      */
-    if (htable_locate(dup_filter->table, lookup_key) != 0) {
+    lookup_key = been_here_key(dup_filter, string);
+    hash = hash_fnvz(lookup_key);
+    if (been_here_find(dup_filter, lookup_key, hash, &insert) != 0) {
 	status = 1;
     } else {
 	if (dup_filter->limit <= 0
-	    || dup_filter->limit > dup_filter->table->used)
-	    htable_enter(dup_filter->table, lookup_key, (void *) 0);
+	    || dup_filter->limit > dup_filter->used) {
+
+	    /*
+	     * Keep the table at most half full, counting deleted slots.
+	     */
+	    if (2 * (dup_filter->used + dup_filter->deleted + 1)
+		> dup_filter->size) {
+		been_here_resize(dup_filter,
+				 2 * (dup_filter->used + 1) > dup_filter->size / 2 ?
+				 2 * dup_filter->size : dup_filter->size);
+		(void) been_here_find(dup_filter, lookup_key, hash, &insert);
+	    }
+	    if (insert->offset == BH_SLOT_DELETED)
+		dup_filter->deleted--;
+	    insert->hash = hash;
+	    insert->offset = LEN(dup_filter->strings);
+	    vstring_strcat(dup_filter->strings, lookup_key);
+	    VSTRING_ADDCH(dup_filter->strings, 0);
+	    dup_filter->used++;
+	}
 	status = 0;
     }
     if (msg_verbose)
 	msg_info("been_here: %s: %d", string, status);
 
-    /*
-     * Cleanup.
-     */
-    if (folded_string)
-	vstring_free(folded_string);
-
     return (status);
 }
 
@@ -215,61 +358,38 @@ int     been_here_fixed(BH_TABLE *dup_filter, const char *string)
 
 int     been_here_check(BH_TABLE *dup_filter, const char *fmt,...)
 {
-    VSTRING *buf = vstring_alloc(100);
-    int     status;
+    const char *string;
     va_list ap;
 
     /*
      * Construct the string to be checked.
      */
     va_start(ap, fmt);
-    vstring_vsprintf(buf, fmt, ap);
+    string = been_here_format(dup_filter, fmt, ap);
     va_end(ap);
 
     /*
      * Do the duplicate check.
      */
-    status = been_here_check_fixed(dup_filter, vstring_str(buf));
-
-    /*
-     * Cleanup.
-     */
-    vstring_free(buf);
-    return (status);
+    return (been_here_check_fixed(dup_filter, string));
 }
 
 /* been_here_check_fixed - query duplicate detector */
 
 int     been_here_check_fixed(BH_TABLE *dup_filter, const char *string)
 {
-    VSTRING *folded_string;
     const char *lookup_key;
     int     status;
 
-    /*
-     * Special processing: case insensitive lookup.
-     */
-    if (dup_filter->flags & BH_FLAG_FOLD) {
-	folded_string = vstring_alloc(100);
-	lookup_key = casefold(folded_string, string);
-    } else {
-	folded_string = 0;
-	lookup_key = string;
-    }
-
     /*
      * Do the duplicate check.
      */
-    status = (htable_locate(dup_filter->table, lookup_key) != 0);
+    lookup_key = been_here_key(dup_filter, string);
+    status = (been_here_find(dup_filter, lookup_key,
+			     hash_fnvz(lookup_key), (BH_SLOT **) 0) != 0);
     if (msg_verbose)
 	msg_info("been_here_check: %s: %d", string, status);
 
-    /*
-     * Cleanup.
-     */
-    if (folded_string)
-	vstring_free(folded_string);
-
     return (status);
 }
 
@@ -277,59 +397,108 @@ int     been_here_check_fixed(BH_TABLE *dup_filter, const char *string)
 
 int     been_here_drop(BH_TABLE *dup_filter, const char *fmt,...)
 {
-    VSTRING *buf = vstring_alloc(100);
-    int     status;
+    const char *string;
     va_list ap;
 
     /*
      * Construct the string to be dropped.
      */
     va_start(ap, fmt);
-    vstring_vsprintf(buf, fmt, ap);
+    string = been_here_format(dup_filter, fmt, ap);
     va_end(ap);
 
     /*
      * Drop the filter entry.
      */
-    status = been_here_drop_fixed(dup_filter, vstring_str(buf));
-
-    /*
-     * Cleanup.
-     */
-    vstring_free(buf);
-    return (status);
+    return (been_here_drop_fixed(dup_filter, string));
 }
 
 /* been_here_drop_fixed - remove filter entry */
 
 int     been_here_drop_fixed(BH_TABLE *dup_filter, const char *string)
 {
-    VSTRING *folded_string;
     const char *lookup_key;
+    BH_SLOT *sp;
     int     status;
 
     /*
-     * Special processing: case insensitive lookup.
+     * Drop the filter entry. The string storage is reclaimed when the table
+     * is resized.
      */
-    if (dup_filter->flags & BH_FLAG_FOLD) {
-	folded_string = vstring_alloc(100);
-	lookup_key = casefold(folded_string, string);
+    lookup_key = been_here_key(dup_filter, string);
+    if ((sp = been_here_find(dup_filter, lookup_key,
+			     hash_fnvz(lookup_key), (BH_SLOT **) 0)) != 0) {
+	sp->offset = BH_SLOT_DELETED;
+	dup_filter->used--;
+	dup_filter->deleted++;
+	status = 1;
     } else {
-	folded_string = 0;
-	lookup_key = string;
+	status = 0;
     }
+    if (msg_verbose)
+	msg_info("been_here_drop: %s: %d", string, status);
 
-    /*
-     * Drop the filter entry.
-     */
-    if ((status = been_here_check_fixed(dup_filter, lookup_key)) != 0)
-	htable_delete(dup_filter->table, lookup_key, (void (*) (void *)) 0);
+    return (status);
+}
 
-    /*
-     * Cleanup.
-     */
-    if (folded_string)
-	vstring_free(folded_string);
+#ifdef TEST
 
-    return (status);
+ /*
+  * Proof-of-concept test program. Read commands from stdin, and report the
+  * result of each command.
+  */
+#include <stdlib.h>
+#include <vstream.h>
+#include <vstring_vstream.h>
+#include <msg_vstream.h>
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    BH_TABLE *dup_filter;
+    char   *cp;
+    char   *cmd;
+    char   *arg;
+    int     limit;
+    int     count;
+    int     n;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 2)
+	msg_fatal("usage: %s limit", argv[0]);
+    limit = atoi(argv[1]);
+    dup_filter = been_here_init(limit, BH_FLAG_FOLD);
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	cp = STR(buf);
+	if ((cmd = mystrtok(&cp, " \t")) == 0 || *cmd == '#')
+	    continue;
+	arg = mystrtok(&cp, " \t");
+	if (strcmp(cmd, "add") == 0 && arg != 0) {
+	    vstream_printf("add %s: %d\n", arg, been_here_fixed(dup_filter, arg));
+	} else if (strcmp(cmd, "check") == 0 && arg != 0) {
+	    vstream_printf("check %s: %d\n", arg,
+			   been_here_check_fixed(dup_filter, arg));
+	} else if (strcmp(cmd, "drop") == 0 && arg != 0) {
+	    vstream_printf("drop %s: %d\n", arg,
+			   been_here_drop_fixed(dup_filter, arg));
+	} else if (strcmp(cmd, "fill") == 0 && arg != 0) {
+	    count = atoi(arg);
+	    for (n = 0; n < count; n++)
+		(void) been_here(dup_filter, "user%d@example.com", n);
+	    vstream_printf("fill %d: used %ld\n", count, (long) dup_filter->used);
+	} else if (strcmp(cmd, "empty") == 0 && arg != 0) {
+	    count = atoi(arg);
+	    for (n = 0; n < count; n++)
+		(void) been_here_drop(dup_filter, "user%d@example.com", n);
+	    vstream_printf("empty %d: used %ld\n", count, (long) dup_filter->used);
+	} else {
+	    msg_warn("bad command: %s", cmd);
+	}
+	vstream_fflush(VSTREAM_OUT);
+    }
+    been_here_free(dup_filter);
+    vstring_free(buf);
+    return (0);
 }
+
+#endif
@@ -22,7 +22,13 @@
 typedef struct {
     int     limit;			/* ceiling, zero for none */
     int     flags;			/* see below */
-    struct HTABLE *table;
+    struct BH_SLOT *slots;		/* open-addressed fingerprint table */
+    ssize_t size;			/* number of slots, power of 2 */
+    ssize_t used;			/* number of remembered strings */
+    ssize_t deleted;			/* number of deleted slots */
+    struct VSTRING *strings;		/* remembered strings, null-terminated */
+    struct VSTRING *fmt_buf;		/* formatted search string */
+    struct VSTRING *fold_buf;		/* case-folded search string */
 } BH_TABLE;
 
 #define BH_BOUND_NONE	0		/* no upper bound */
@@ -17,6 +17,15 @@
 /*
 /*	Configuration parameters are described in memcache_table(5).
 /*
+/*	When multiple memcache servers are specified, each key is
+/*	assigned to one server with consistent hashing, so that adding
+/*	or removing a server reassigns only a fraction of the keys.
+/*
+/*	Bulk lookups (see dict_get_bulk() in dict(3)) send one "get"
+/*	request with multiple keys to each server, and send the
+/*	backup database results to memcache as pipelined "set"
+/*	requests.
+/*
 /*	Arguments:
 /* .IP name
 /*	The path to the Postfix memcache configuration file.
@@ -48,6 +57,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>			/* XXX sscanf() */
+#include <stdlib.h>			/* qsort() */
 
 /* Utility library. */
 
@@ -58,6 +68,8 @@
 #include <stringops.h>
 #include <auto_clnt.h>
 #include <vstream.h>
+#include <argv.h>
+#include <hash_fnv.h>
 
 /* Global library. */
 
@@ -69,6 +81,14 @@
 
 #include <dict_memcache.h>
 
+ /*
+  * One point on the consistent hashing ring.
+  */
+typedef struct {
+    unsigned long hash;			/* ring position */
+    AUTO_CLNT *clnt;			/* memcache server */
+} DICT_MC_POINT;
+
  /*
   * Structure of one memcache dictionary handle.
   */
@@ -84,8 +104,13 @@ typedef struct {
     int     max_tries;			/* number of tries */
     int     max_line;			/* reply line limit */
     int     max_data;			/* reply data limit */
-    char   *memcache;			/* memcache server spec */
-    AUTO_CLNT *clnt;			/* memcache client stream */
+    char   *memcache;			/* memcache server specs */
+    AUTO_CLNT *clnt;			/* memcache client for key_buf */
+    AUTO_CLNT **clnts;			/* memcache clients */
+    int     clnt_count;			/* number of memcache clients */
+    DICT_MC_POINT *ring;		/* consistent hashing ring */
+    int     ring_size;			/* number of ring points */
+    ARGV   *bulk_res;			/* bulk lookup results */
     VSTRING *clnt_buf;			/* memcache client buffer */
     VSTRING *key_buf;			/* lookup key */
     VSTRING *res_buf;			/* lookup result */
@@ -119,6 +144,13 @@ typedef struct {
 #define DICT_MC_NAME_MAX_DATA	"data_size_limit"
 #define DICT_MC_NAME_ERR_PAUSE	"retry_pause"
 
+ /*
+  * The number of ring points per memcache server, and the number of keys
+  * per "get" request.
+  */
+#define DICT_MC_RING_POINTS	160
+#define DICT_MC_BULK_MAX	100
+
  /*
   * SLMs.
   */
@@ -127,6 +159,50 @@ typedef struct {
 
 /*#define msg_verbose 1*/
 
+ /*
+  * A ring position is a string hash, with a final mix so that similar
+  * strings (such as the names of ring points) are spread evenly over the
+  * ring.
+  */
+#define DICT_MC_HASH(str)	hash_fnv_fmix(hash_fnvz(str))
+
+/* dict_memcache_point_cmp - sort ring points */
+
+static int dict_memcache_point_cmp(const void *a, const void *b)
+{
+    unsigned long ha = ((const DICT_MC_POINT *) a)->hash;
+    unsigned long hb = ((const DICT_MC_POINT *) b)->hash;
+
+    return (ha < hb ? -1 : ha > hb ? 1 : 0);
+}
+
+/* dict_memcache_server - find the memcache server for a key */
+
+static AUTO_CLNT *dict_memcache_server(DICT_MC *dict_mc, const char *key)
+{
+    unsigned long hash;
+    int     lo;
+    int     hi;
+    int     mid;
+
+    if (dict_mc->ring_size == 0)
+	return (dict_mc->clnts[0]);
+
+    /*
+     * Find the first ring point at or after the key's position, wrapping
+     * around at the end of the ring.
+     */
+    hash = DICT_MC_HASH(key);
+    for (lo = 0, hi = dict_mc->ring_size; lo < hi; /* void */ ) {
+	mid = lo + (hi - lo) / 2;
+	if (dict_mc->ring[mid].hash < hash)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return (dict_mc->ring[lo < dict_mc->ring_size ? lo : 0].clnt);
+}
+
 /* dict_memcache_set - set memcache key/value */
 
 static int dict_memcache_set(DICT_MC *dict_mc, const char *value, int ttl)
@@ -290,6 +366,8 @@ static ssize_t dict_memcache_prepare_key(DICT_MC *dict_mc, const char *name)
     /*
      * The length indicates whether the expansion is empty or not.
      */
+    if (LEN(dict_mc->key_buf) > 0)
+	dict_mc->clnt = dict_memcache_server(dict_mc, STR(dict_mc->key_buf));
     return (LEN(dict_mc->key_buf));
 }
 
@@ -409,6 +487,252 @@ static const char *dict_memcache_lookup(DICT *dict, const char *name)
     return (retval);
 }
 
+/* dict_memcache_mget_once - send multi-key requests, receive replies */
+
+static int dict_memcache_mget_once(DICT_MC *dict_mc, VSTREAM *fp,
+				           ARGV *mc_keys, int *todo,
+				           int count, int *found)
+{
+    char   *key;
+    char   *cp;
+    long    data_len;
+    int     n;
+    int     k;
+    int     end;
+    int     first;
+
+    /*
+     * Send all requests before receiving the first reply.
+     */
+    for (n = 0; n < count; n += DICT_MC_BULK_MAX) {
+	vstring_strcpy(dict_mc->clnt_buf, "get");
+	for (k = n; k < count && k < n + DICT_MC_BULK_MAX; k++)
+	    vstring_sprintf_append(dict_mc->clnt_buf, " %s",
+				   mc_keys->argv[todo[k]]);
+	if (memcache_printf(fp, "%s", STR(dict_mc->clnt_buf)) < 0)
+	    return (-1);
+    }
+
+    /*
+     * Each request produces zero or more VALUE replies, followed by END. A
+     * key may be requested more than once, when different lookup keys have
+     * the same expansion.
+     */
+    for (n = 0; n < count; n += DICT_MC_BULK_MAX) {
+	end = (n + DICT_MC_BULK_MAX < count ? n + DICT_MC_BULK_MAX : count);
+	for (;;) {
+	    if (memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0)
+		return (-1);
+	    if (strcmp(STR(dict_mc->clnt_buf), "END") == 0)
+		break;
+	    if (strncmp(STR(dict_mc->clnt_buf), "VALUE ", 6) != 0
+		|| (cp = strchr(key = STR(dict_mc->clnt_buf) + 6, ' ')) == 0
+		|| sscanf(cp, " %*s %ld", &data_len) != 1
+		|| data_len < 0 || data_len > dict_mc->max_data) {
+		msg_warn("%s: unexpected memcache server reply: %.30s",
+			 dict_mc->dict.name, STR(dict_mc->clnt_buf));
+		return (-1);
+	    }
+	    *cp = 0;
+	    if (memcache_fread(fp, dict_mc->res_buf, data_len) < 0)
+		return (-1);
+	    for (first = -1, k = n; k < end; k++) {
+		if (found[todo[k]] >= 0
+		    || strcmp(mc_keys->argv[todo[k]], key) != 0)
+		    continue;
+		if (first < 0) {
+		    first = dict_mc->bulk_res->argc;
+		    argv_add(dict_mc->bulk_res, STR(dict_mc->res_buf), ARGV_END);
+		}
+		found[todo[k]] = first;
+	    }
+	}
+    }
+    return (0);
+}
+
+/* dict_memcache_mget - get memcache key/values from one server */
+
+static int dict_memcache_mget(DICT_MC *dict_mc, AUTO_CLNT *clnt,
+			              ARGV *mc_keys, int *todo, int count,
+			              int *found)
+{
+    VSTREAM *fp;
+    int     tries;
+
+    for (tries = 0; tries < dict_mc->max_tries; tries++) {
+	if (tries > 0)
+	    sleep(dict_mc->err_pause);
+	if ((fp = auto_clnt_access(clnt)) == 0) {
+	    break;
+	} else if (dict_memcache_mget_once(dict_mc, fp, mc_keys, todo,
+					   count, found) < 0) {
+	    if (tries > 0)
+		msg_warn(errno ? "database %s:%s: I/O error: %m" :
+			 "database %s:%s: I/O error",
+			 DICT_TYPE_MEMCACHE, dict_mc->dict.name);
+	} else {
+	    /* Victory! */
+	    return (0);
+	}
+	auto_clnt_recover(clnt);
+    }
+    return (-1);
+}
+
+/* dict_memcache_mset - pipeline memcache updates to one server */
+
+static void dict_memcache_mset(DICT_MC *dict_mc, AUTO_CLNT *clnt,
+			               ARGV *mc_keys, int *todo, int count,
+			               int *found)
+{
+    VSTREAM *fp;
+    const char *value;
+    ssize_t data_len;
+    int     sent = 0;
+    int     error = 0;
+    int     n;
+
+    /*
+     * Like the single-key update after a backup database lookup, this is
+     * done once, and failure is not an error.
+     */
+    if ((fp = auto_clnt_access(clnt)) == 0)
+	return;
+    for (n = 0; n < count; n++) {
+	value = dict_mc->bulk_res->argv[found[todo[n]]];
+	if ((data_len = strlen(value)) > dict_mc->max_data) {
+	    msg_warn("database %s:%s: data for key %s is too long (%s=%d) "
+		     "-- not stored", DICT_TYPE_MEMCACHE, dict_mc->dict.name,
+		     mc_keys->argv[todo[n]], DICT_MC_NAME_MAX_DATA,
+		     dict_mc->max_data);
+	    continue;
+	}
+	if (memcache_printf(fp, "set %s %d %d %ld", mc_keys->argv[todo[n]],
+			    dict_mc->mc_flags, dict_mc->mc_ttl,
+			    (long) data_len) < 0
+	    || memcache_fwrite(fp, value, data_len) < 0) {
+	    error = 1;
+	    break;
+	}
+	sent++;
+    }
+    for (n = 0; error == 0 && n < sent; n++) {
+	if (memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0) {
+	    error = 1;
+	    break;
+	}
+	if (strcmp(STR(dict_mc->clnt_buf), "STORED") != 0)
+	    msg_warn("database %s:%s: update failed: %.30s",
+		     DICT_TYPE_MEMCACHE, dict_mc->dict.name,
+		     STR(dict_mc->clnt_buf));
+    }
+    if (error) {
+	msg_warn(errno ? "database %s:%s: I/O error: %m" :
+		 "database %s:%s: I/O error",
+		 DICT_TYPE_MEMCACHE, dict_mc->dict.name);
+	auto_clnt_recover(clnt);
+    }
+}
+
+/* dict_memcache_bulk_lookup - lookup multiple keys */
+
+static int dict_memcache_bulk_lookup(DICT *dict, int count,
+				             const char **names,
+				             const char **values)
+{
+    const char *myname = "dict_memcache_bulk_lookup";
+    DICT_MC *dict_mc = (DICT_MC *) dict;
+    DICT   *backup = dict_mc->backup;
+    ARGV   *mc_keys = argv_alloc(count);
+    AUTO_CLNT **clnts = (AUTO_CLNT **) mymalloc(sizeof(*clnts) * (count + 1));
+    int    *found = (int *) mymalloc(sizeof(*found) * (count + 1));
+    int    *todo = (int *) mymalloc(sizeof(*todo) * (count + 1));
+    int    *filled = (int *) mymalloc(sizeof(*filled) * (count + 1));
+    const char *value;
+    int     ntodo;
+    int     nfilled;
+    int     i;
+    int     n;
+
+#define DICT_MC_BULK_RETURN(err) do { \
+	argv_free(mc_keys); \
+	myfree((void *) clnts); \
+	myfree((void *) found); \
+	myfree((void *) todo); \
+	myfree((void *) filled); \
+	return (dict->error = (err)); \
+    } while (0)
+
+    /*
+     * Expand the keys, and find out which server has each key. Skip keys
+     * that are inapplicable, silently.
+     */
+    argv_truncate(dict_mc->bulk_res, 0);
+    for (n = 0; n < count; n++) {
+	found[n] = -1;
+	if (dict_memcache_valid_key(dict_mc, names[n], "lookup", msg_info)) {
+	    argv_add(mc_keys, STR(dict_mc->key_buf), ARGV_END);
+	    clnts[n] = dict_mc->clnt;
+	} else if (dict_mc->error) {
+	    DICT_MC_BULK_RETURN(dict_mc->error);
+	} else {
+	    argv_add(mc_keys, "", ARGV_END);
+	    clnts[n] = 0;
+	}
+    }
+
+    /*
+     * Search the memcache first, with one request per server. As with
+     * single-key lookups, a backup database hides a memcache error.
+     */
+    for (i = 0; i < dict_mc->clnt_count; i++) {
+	for (ntodo = n = 0; n < count; n++)
+	    if (clnts[n] == dict_mc->clnts[i])
+		todo[ntodo++] = n;
+	if (ntodo > 0
+	    && dict_memcache_mget(dict_mc, dict_mc->clnts[i], mc_keys,
+				  todo, ntodo, found) < 0
+	    && backup == 0)
+	    DICT_MC_BULK_RETURN(DICT_ERR_RETRY);
+    }
+
+    /*
+     * Search the backup database last. Update the memcache with the data
+     * that is found, with one pipeline per server.
+     */
+    if (backup) {
+	for (nfilled = n = 0; n < count; n++) {
+	    if (found[n] >= 0 || clnts[n] == 0)
+		continue;
+	    backup->error = 0;
+	    if ((value = backup->lookup(backup, names[n])) != 0) {
+		found[n] = dict_mc->bulk_res->argc;
+		argv_add(dict_mc->bulk_res, value, ARGV_END);
+		filled[nfilled++] = n;
+	    } else if (backup->error) {
+		DICT_MC_BULK_RETURN(backup->error);
+	    }
+	}
+	for (i = 0; nfilled > 0 && i < dict_mc->clnt_count; i++) {
+	    for (ntodo = n = 0; n < nfilled; n++)
+		if (clnts[filled[n]] == dict_mc->clnts[i])
+		    todo[ntodo++] = filled[n];
+	    if (ntodo > 0)
+		dict_memcache_mset(dict_mc, dict_mc->clnts[i], mc_keys,
+				   todo, ntodo, found);
+	}
+    }
+    for (n = 0; n < count; n++) {
+	values[n] = (found[n] >= 0 ? dict_mc->bulk_res->argv[found[n]] : 0);
+	if (msg_verbose)
+	    msg_info("%s: %s: key \"%s\"(%s) => %s",
+		     myname, dict_mc->dict.name, names[n], mc_keys->argv[n],
+		     values[n] ? values[n] : "(not found)");
+    }
+    DICT_MC_BULK_RETURN(DICT_ERR_NONE);
+}
+
 /* dict_memcache_delete - delete memcache entry */
 
 static int dict_memcache_delete(DICT *dict, const char *name)
@@ -484,7 +808,12 @@ static void dict_memcache_close(DICT *dict)
     if (dict_mc->key_format)
 	myfree(dict_mc->key_format);
     myfree(dict_mc->memcache);
-    auto_clnt_free(dict_mc->clnt);
+    while (dict_mc->clnt_count > 0)
+	auto_clnt_free(dict_mc->clnts[--dict_mc->clnt_count]);
+    myfree((void *) dict_mc->clnts);
+    if (dict_mc->ring)
+	myfree((void *) dict_mc->ring);
+    argv_free(dict_mc->bulk_res);
     vstring_free(dict_mc->clnt_buf);
     vstring_free(dict_mc->key_buf);
     vstring_free(dict_mc->res_buf);
@@ -502,6 +831,10 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
     DICT_MC *dict_mc;
     char   *backup;
     CFG_PARSER *parser;
+    ARGV   *servers;
+    VSTRING *point;
+    int     i;
+    int     j;
 
     /*
      * Sanity checks.
@@ -529,6 +862,7 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
     dict_mc = (DICT_MC *) dict_alloc(DICT_TYPE_MEMCACHE, name,
 				     sizeof(*dict_mc));
     dict_mc->dict.lookup = dict_memcache_lookup;
+    dict_mc->dict.bulk_lookup = dict_memcache_bulk_lookup;
     if (open_flags == O_RDWR) {
 	dict_mc->dict.update = dict_memcache_update;
 	dict_mc->dict.delete = dict_memcache_delete;
@@ -563,10 +897,43 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
 				    DICT_MC_DEF_MEMCACHE, 0, 0);
 
     /*
-     * Initialize the memcache client.
+     * Initialize the memcache clients, and place each server on the
+     * consistent hashing ring.
      */
-    dict_mc->clnt = auto_clnt_create(dict_mc->memcache, dict_mc->timeout, 0, 0);
+    servers = argv_split(dict_mc->memcache, CHARS_COMMA_SP);
+    if (servers->argc == 0)
+	argv_add(servers, DICT_MC_DEF_MEMCACHE, ARGV_END);
+    dict_mc->clnt_count = servers->argc;
+    dict_mc->clnts = (AUTO_CLNT **)
+	mymalloc(sizeof(*dict_mc->clnts) * servers->argc);
+    for (i = 0; i < servers->argc; i++)
+	dict_mc->clnts[i] = auto_clnt_create(servers->argv[i],
+					     dict_mc->timeout, 0, 0);
+    dict_mc->clnt = dict_mc->clnts[0];
+    if (servers->argc > 1) {
+	dict_mc->ring_size = servers->argc * DICT_MC_RING_POINTS;
+	dict_mc->ring = (DICT_MC_POINT *)
+	    mymalloc(sizeof(*dict_mc->ring) * dict_mc->ring_size);
+	point = vstring_alloc(100);
+	for (i = 0; i < servers->argc; i++) {
+	    for (j = 0; j < DICT_MC_RING_POINTS; j++) {
+		vstring_sprintf(point, "%s-%d", servers->argv[i], j);
+		dict_mc->ring[i * DICT_MC_RING_POINTS + j].hash =
+		    DICT_MC_HASH(STR(point));
+		dict_mc->ring[i * DICT_MC_RING_POINTS + j].clnt =
+		    dict_mc->clnts[i];
+	    }
+	}
+	vstring_free(point);
+	qsort((void *) dict_mc->ring, dict_mc->ring_size,
+	      sizeof(*dict_mc->ring), dict_memcache_point_cmp);
+    } else {
+	dict_mc->ring_size = 0;
+	dict_mc->ring = 0;
+    }
+    argv_free(servers);
     dict_mc->clnt_buf = vstring_alloc(100);
+    dict_mc->bulk_res = argv_alloc(10);
 
     /*
      * Open the optional backup database.
@@ -597,3 +964,139 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
 
     return (&dict_mc->dict);
 }
+
+#ifdef TEST
+
+ /*
+  * Proof-of-concept test program. Start a memcache protocol stand-in for
+  * each -s option, then run dict_test(3) commands against a memcache
+  * table. Each stand-in logs the commands that it receives, so that the
+  * output shows which server has which key.
+  */
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <htable.h>
+#include <iostuff.h>
+#include <listen.h>
+#include <msg_vstream.h>
+#include <sane_accept.h>
+
+#define MAX_STUB	10
+
+/* stub_reply - respond to one memcache command */
+
+static void stub_reply(VSTREAM *fp, HTABLE *table, char *cmd, VSTRING *data)
+{
+    char   *bp = cmd;
+    char   *verb;
+    char   *key;
+    char   *value;
+    long    len;
+
+    if ((verb = mystrtok(&bp, " ")) == 0) {
+	memcache_printf(fp, "ERROR");
+    } else if (strcmp(verb, "get") == 0) {
+	while ((key = mystrtok(&bp, " ")) != 0) {
+	    if ((value = htable_find(table, key)) != 0) {
+		memcache_printf(fp, "VALUE %s 0 %ld", key, (long) strlen(value));
+		memcache_fwrite(fp, value, strlen(value));
+	    }
+	}
+	memcache_printf(fp, "END");
+    } else if (strcmp(verb, "set") == 0
+	       && (key = mystrtok(&bp, " ")) != 0
+	       && mystrtok(&bp, " ") != 0 && mystrtok(&bp, " ") != 0
+	       && (value = mystrtok(&bp, " ")) != 0
+	       && (len = atol(value)) >= 0
+	       && memcache_fread(fp, data, len) == 0) {
+	if ((value = htable_find(table, key)) != 0)
+	    htable_delete(table, key, myfree);
+	htable_enter(table, key, mystrdup(vstring_str(data)));
+	memcache_printf(fp, "STORED");
+    } else if (strcmp(verb, "delete") == 0
+	       && (key = mystrtok(&bp, " ")) != 0) {
+	if (htable_find(table, key) != 0) {
+	    htable_delete(table, key, myfree);
+	    memcache_printf(fp, "DELETED");
+	} else
+	    memcache_printf(fp, "NOT_FOUND");
+    } else {
+	memcache_printf(fp, "ERROR");
+    }
+}
+
+/* stub_server - memcache protocol stand-in */
+
+static pid_t stub_server(const char *path)
+{
+    HTABLE *table;
+    VSTRING *cmd;
+    VSTRING *data;
+    VSTREAM *fp;
+    int     listen_fd;
+    int     fd;
+    pid_t   pid;
+
+    (void) unlink(path);
+    listen_fd = unix_listen(path, 10, BLOCKING);
+    if ((pid = fork()) < 0)
+	msg_fatal("fork: %m");
+    if (pid > 0) {
+	(void) close(listen_fd);
+	return (pid);
+    }
+
+    /*
+     * The client keeps at most one connection per server.
+     */
+    table = htable_create(10);
+    cmd = vstring_alloc(100);
+    data = vstring_alloc(100);
+    for (;;) {
+	if ((fd = sane_accept(listen_fd, (struct sockaddr *) 0,
+			      (SOCKADDR_SIZE *) 0)) < 0)
+	    msg_fatal("accept: %m");
+	fp = vstream_fdopen(fd, O_RDWR);
+	vstream_control(fp, CA_VSTREAM_CTL_DOUBLE, CA_VSTREAM_CTL_END);
+	while (memcache_get(fp, cmd, 0) == 0) {
+	    vstream_fprintf(VSTREAM_ERR, "%s: %s\n", path, vstring_str(cmd));
+	    vstream_fflush(VSTREAM_ERR);
+	    stub_reply(fp, table, vstring_str(cmd), data);
+	    if (vstream_peek(fp) <= 0)
+		vstream_fflush(fp);
+	}
+	(void) vstream_fclose(fp);
+    }
+}
+
+int     main(int argc, char **argv)
+{
+    char   *progname = argv[0];
+    pid_t   pids[MAX_STUB];
+    char   *paths[MAX_STUB];
+    int     nstub = 0;
+
+    signal(SIGPIPE, SIG_IGN);
+    msg_vstream_init(progname, VSTREAM_ERR);
+    while (argc > 2 && strcmp(argv[1], "-s") == 0 && nstub < MAX_STUB) {
+	paths[nstub] = argv[2];
+	pids[nstub] = stub_server(argv[2]);
+	nstub++;
+	argc -= 2;
+	argv += 2;
+	argv[0] = progname;
+    }
+    dict_open_register(DICT_TYPE_MEMCACHE, dict_memcache_open);
+    dict_test(argc, argv);
+    while (nstub-- > 0) {
+	(void) kill(pids[nstub], SIGTERM);
+	(void) waitpid(pids[nstub], (int *) 0, 0);
+	(void) unlink(paths[nstub]);
+    }
+    return (0);
+}
+
+#endif
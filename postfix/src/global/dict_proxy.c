@@ -17,7 +17,16 @@
 /*	The \fIopen_flags\fR argument must specify O_RDONLY
 /*	or O_RDWR. Depending on this, the client
 /*	connects to the proxymap multiserver or to the
-/*	proxywrite single updater.
+/*	proxywrite single updater. With O_RDONLY, the
+/*	proxymap_service_maps parameter may specify a different
+/*	proxymap service for the table, so that a slow table
+/*	does not delay lookups in tables that are served by other
+/*	proxymap processes.
+/*
+/*	Bulk lookups (see dict_get_bulk() in dict(3)) send up to
+/*	1024 keys in one request, so that a table with multi-key
+/*	query support in the proxymap server can handle them at
+/*	once.
 /*
 /*	The connection to the Postfix proxymap server is automatically
 /*	closed after $ipc_idle seconds of idle time, or after $ipc_ttl
@@ -53,6 +62,7 @@
 #include <sys_defs.h>
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
 
 /* Utility library. */
 
@@ -62,6 +72,9 @@
 #include <vstring.h>
 #include <vstream.h>
 #include <attr.h>
+#include <htable.h>
+#include <argv.h>
+#include <argv_attr.h>
 #include <dict.h>
 
 /* Global library. */
@@ -69,6 +82,7 @@
 #include <mail_proto.h>
 #include <mail_params.h>
 #include <clnt_stream.h>
+#include <maps.h>
 #include <dict_proxy.h>
 
 /* Application-specific. */
@@ -80,8 +94,14 @@ typedef struct {
     int     inst_flags;			/* saved dict flags */
     VSTRING *reskey;			/* result key storage */
     VSTRING *result;			/* storage */
+    ARGV   *bulk_keys;			/* bulk lookup request */
 } DICT_PROXY;
 
+ /*
+  * Bulk lookups are sent in chunks that the server will accept.
+  */
+#define DICT_PROXY_BULK_MAX	ARGV_ATTR_MAX
+
  /*
   * SLMs.
   */
@@ -89,10 +109,12 @@ typedef struct {
 #define VSTREQ(v,s)	(strcmp(STR(v),s) == 0)
 
  /*
-  * All proxied maps of the same type share the same query/reply socket.
+  * All proxied maps that use the same service share the same query/reply
+  * socket. Read-only maps may be assigned to their own proxymap service with
+  * proxymap_service_maps.
   */
-static CLNT_STREAM *proxymap_stream;	/* read-only maps */
-static CLNT_STREAM *proxywrite_stream;	/* read-write maps */
+static HTABLE *dict_proxy_streams;	/* service name -> CLNT_STREAM */
+static MAPS *dict_proxy_service_maps;	/* table name -> service name */
 
 /* dict_proxy_handshake - receive server protocol announcement */
 
@@ -103,6 +125,27 @@ static int dict_proxy_handshake(VSTREAM *stream)
 		      ATTR_TYPE_END));
 }
 
+/* dict_proxy_service - choose read-only proxymap service for table */
+
+static const char *dict_proxy_service(const char *map)
+{
+    const char *service;
+
+    if (*var_proxymap_service_maps == 0)
+	return (var_proxymap_service);
+    if (dict_proxy_service_maps == 0)
+	dict_proxy_service_maps =
+	    maps_create(VAR_PROXYMAP_SERVICE_MAPS, var_proxymap_service_maps,
+			DICT_FLAG_LOCK | DICT_FLAG_FOLD_FIX
+			| DICT_FLAG_NO_PROXY);
+    if ((service = maps_find(dict_proxy_service_maps, map, 0)) != 0)
+	return (service);
+    if (dict_proxy_service_maps->error != 0)
+	msg_fatal("%s: lookup error for table \"%s\"",
+		  dict_proxy_service_maps->title, map);
+    return (var_proxymap_service);
+}
+
 /* dict_proxy_sequence - find first/next entry */
 
 static int dict_proxy_sequence(DICT *dict, int function,
@@ -258,6 +301,152 @@ static const char *dict_proxy_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_proxy_bulk_reply - receive per-key bulk lookup results */
+
+static int dict_proxy_bulk_reply(DICT_PROXY *dict_proxy, VSTREAM *stream,
+				         int count, const char **values)
+{
+    DICT   *dict = &dict_proxy->dict;
+    int     status;
+    int     n;
+
+    /*
+     * Save a copy of each value, and remember which keys were found. The
+     * caller fills in the value pointers once the buffer is complete.
+     */
+    for (n = 0; n < count; n++) {
+	if (attr_scan(stream, ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
+		      RECV_ATTR_INT(MAIL_ATTR_STATUS, &status),
+		      RECV_ATTR_STR(MAIL_ATTR_VALUE, dict_proxy->result),
+		      ATTR_TYPE_END) != 2)
+	    return (-1);
+	switch (status) {
+	case PROXY_STAT_OK:
+	    vstring_strcat(dict->bulk_buf, STR(dict_proxy->result));
+	    VSTRING_ADDCH(dict->bulk_buf, 0);
+	    values[n] = "";
+	    break;
+	case PROXY_STAT_NOKEY:
+	    values[n] = 0;
+	    break;
+	default:
+	    msg_warn("%s bulk lookup for table \"%s\": "
+		     "unexpected key status %d",
+		     dict_proxy->service, dict->name, status);
+	    return (-1);
+	}
+    }
+    return (0);
+}
+
+/* dict_proxy_bulk_chunk - look up one chunk of keys */
+
+static int dict_proxy_bulk_chunk(DICT_PROXY *dict_proxy, int request_flags,
+				         int count, const char **keys,
+				         const char **values)
+{
+    const char *myname = "dict_proxy_bulk_chunk";
+    DICT   *dict = &dict_proxy->dict;
+    VSTREAM *stream;
+    ssize_t start = VSTRING_LEN(dict->bulk_buf);
+    int     status;
+    int     tries = 0;
+    int     n;
+
+    argv_truncate(dict_proxy->bulk_keys, 0);
+    for (n = 0; n < count; n++)
+	argv_add(dict_proxy->bulk_keys, keys[n], ARGV_END);
+
+    for (;;) {
+	stream = clnt_stream_access(dict_proxy->clnt);
+	errno = 0;
+	tries += 1;
+	vstring_truncate(dict->bulk_buf, start);
+	if (stream == 0
+	    || attr_print(stream, ATTR_FLAG_NONE,
+			  SEND_ATTR_STR(MAIL_ATTR_REQ, PROXY_REQ_BULK_LOOKUP),
+			  SEND_ATTR_STR(MAIL_ATTR_TABLE, dict->name),
+			  SEND_ATTR_INT(MAIL_ATTR_FLAGS, request_flags),
+			  SEND_ATTR_FUNC(argv_attr_print,
+					 (const void *) dict_proxy->bulk_keys),
+			  ATTR_TYPE_END) != 0
+	    || vstream_fflush(stream)
+	    || attr_scan(stream, ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
+			 RECV_ATTR_INT(MAIL_ATTR_STATUS, &status),
+			 ATTR_TYPE_END) != 1
+	    || (status == PROXY_STAT_OK
+		&& dict_proxy_bulk_reply(dict_proxy, stream, count, values) != 0)
+	    || attr_scan(stream, ATTR_FLAG_STRICT, ATTR_TYPE_END) != 0) {
+	    if (msg_verbose || tries > 1 || (errno && errno != EPIPE && errno != ENOENT))
+		msg_warn("%s: service %s: %m", myname, dict_proxy->service);
+	} else {
+	    if (msg_verbose)
+		msg_info("%s: table=%s flags=%s keys=%d -> status=%d",
+			 myname, dict->name, dict_flags_str(request_flags),
+			 count, status);
+	    switch (status) {
+	    case PROXY_STAT_BAD:
+		msg_fatal("%s bulk lookup failed for table \"%s\": "
+			  "invalid request", dict_proxy->service, dict->name);
+	    case PROXY_STAT_DENY:
+		msg_fatal("%s service is not configured for table \"%s\"",
+			  dict_proxy->service, dict->name);
+	    case PROXY_STAT_OK:
+		return (DICT_ERR_NONE);
+	    case PROXY_STAT_RETRY:
+		return (DICT_ERR_RETRY);
+	    case PROXY_STAT_CONFIG:
+		return (DICT_ERR_CONFIG);
+	    default:
+		msg_warn("%s bulk lookup failed for table \"%s\": "
+			 "unexpected reply status %d",
+			 dict_proxy->service, dict->name, status);
+	    }
+	}
+	clnt_stream_recover(dict_proxy->clnt);
+	sleep(1);				/* XXX make configurable */
+    }
+}
+
+/* dict_proxy_bulk_lookup - find multiple table entries */
+
+static int dict_proxy_bulk_lookup(DICT *dict, int count, const char **keys,
+				          const char **values)
+{
+    DICT_PROXY *dict_proxy = (DICT_PROXY *) dict;
+    int     request_flags;
+    int     status;
+    int     chunk;
+    int     n;
+    char   *cp;
+
+    /*
+     * As with single-key lookups, each request specifies the table and the
+     * flags that were specified to dict_proxy_open().
+     */
+    if (dict->bulk_buf == 0)
+	dict->bulk_buf = vstring_alloc(100);
+    if (dict_proxy->bulk_keys == 0)
+	dict_proxy->bulk_keys = argv_alloc(DICT_PROXY_BULK_MAX);
+    VSTRING_RESET(dict->bulk_buf);
+    request_flags = dict_proxy->inst_flags
+	| (dict->flags & DICT_FLAG_RQST_MASK);
+    for (n = 0; n < count; n += chunk) {
+	chunk = (count - n > DICT_PROXY_BULK_MAX ?
+		 DICT_PROXY_BULK_MAX : count - n);
+	if ((status = dict_proxy_bulk_chunk(dict_proxy, request_flags, chunk,
+					    keys + n, values + n)) != 0)
+	    DICT_ERR_VAL_RETURN(dict, status, status);
+    }
+    for (cp = STR(dict->bulk_buf), n = 0; n < count; n++) {
+	if (values[n] != 0) {
+	    values[n] = cp;
+	    cp += strlen(cp) + 1;
+	}
+    }
+    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, DICT_ERR_NONE);
+}
+
 /* dict_proxy_update - update table entry */
 
 static int dict_proxy_update(DICT *dict, const char *key, const char *value)
@@ -406,6 +595,8 @@ static void dict_proxy_close(DICT *dict)
 
     vstring_free(dict_proxy->reskey);
     vstring_free(dict_proxy->result);
+    if (dict_proxy->bulk_keys)
+	argv_free(dict_proxy->bulk_keys);
     dict_free(dict);
 }
 
@@ -422,7 +613,7 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
     char   *relative_path;
     char   *kludge = 0;
     char   *prefix;
-    CLNT_STREAM **pstream;
+    HTABLE_INFO *ht;
 
     /*
      * If this map can't be proxied then we silently do a direct open. This
@@ -433,7 +624,8 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
 	return (dict_open(map, open_flags, dict_flags));
 
     /*
-     * Use a shared stream for proxied table lookups of the same type.
+     * Use a shared stream for proxied table lookups through the same
+     * service.
      * 
      * XXX A complete implementation would also allow O_RDWR without O_CREAT.
      * But we must not pass on every possible set of flags to the proxy
@@ -443,16 +635,16 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
      * XXX Use absolute pathname to make this work from non-daemon processes.
      */
     if (open_flags == O_RDONLY) {
-	pstream = &proxymap_stream;
-	service = var_proxymap_service;
+	service = dict_proxy_service(map);
     } else if ((open_flags & O_RDWR) == O_RDWR) {
-	pstream = &proxywrite_stream;
 	service = var_proxywrite_service;
     } else
 	msg_fatal("%s: %s map open requires O_RDONLY or O_RDWR mode",
 		  map, DICT_TYPE_PROXY);
 
-    if (*pstream == 0) {
+    if (dict_proxy_streams == 0)
+	dict_proxy_streams = htable_create(1);
+    if ((ht = htable_locate(dict_proxy_streams, service)) == 0) {
 	relative_path = concatenate(MAIL_CLASS_PRIVATE "/",
 				    service, (char *) 0);
 	if (access(relative_path, F_OK) == 0)
@@ -460,9 +652,11 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
 	else
 	    prefix = kludge = concatenate(var_queue_dir, "/",
 					  MAIL_CLASS_PRIVATE, (char *) 0);
-	*pstream = clnt_stream_create(prefix, service, var_ipc_idle_limit,
-				      var_ipc_ttl_limit,
-				      dict_proxy_handshake);
+	ht = htable_enter(dict_proxy_streams, service, (void *)
+			  clnt_stream_create(prefix, service,
+					     var_ipc_idle_limit,
+					     var_ipc_ttl_limit,
+					     dict_proxy_handshake));
 	if (kludge)
 	    myfree(kludge);
 	myfree(relative_path);
@@ -477,12 +671,14 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
     dict_proxy->dict.update = dict_proxy_update;
     dict_proxy->dict.delete = dict_proxy_delete;
     dict_proxy->dict.sequence = dict_proxy_sequence;
+    dict_proxy->dict.bulk_lookup = dict_proxy_bulk_lookup;
     dict_proxy->dict.close = dict_proxy_close;
     dict_proxy->inst_flags = (dict_flags & DICT_FLAG_INST_MASK);
     dict_proxy->reskey = vstring_alloc(10);
     dict_proxy->result = vstring_alloc(10);
-    dict_proxy->clnt = *pstream;
-    dict_proxy->service = service;
+    dict_proxy->bulk_keys = 0;
+    dict_proxy->clnt = (CLNT_STREAM *) ht->value;
+    dict_proxy->service = ht->key;
 
     /*
      * Establish initial contact and get the map type specific flags.
@@ -37,10 +37,19 @@
 /* .PP
 /*	Configuration parameters:
 /* .IP dbpath
-/*	Path to SQLite database
+/*	Path to SQLite database. The database is opened read-only.
+/* .IP mmap_size
+/*	The amount of database file that SQLite may access with
+/*	memory-mapped I/O. Specify 0 to disable.
 /* .IP query
 /*	Query template. Before the query is actually issued, variable
 /*	substitutions are performed. See sqlite_table(5) for details.
+/*
+/*	When every substitution is enclosed in its own pair of single
+/*	quotes (for example, \fBWHERE mailbox = '%s'\fR), the query
+/*	is compiled once, and each lookup binds the substituted values
+/*	as query parameters. Otherwise, each lookup compiles the
+/*	expanded query text.
 /* .IP result_format
 /*	The format used to expand results from queries.  Substitutions
 /*	are performed as described in sqlite_table(5). Defaults to
@@ -77,6 +86,10 @@
 #define sqlite3_prepare_v2 sqlite3_prepare
 #endif
 
+#if !defined(SQLITE_VERSION_NUMBER) || (SQLITE_VERSION_NUMBER < 3005000)
+#define sqlite3_open_v2(path, db, flags, vfs) sqlite3_open((path), (db))
+#endif
+
 /* Utility library. */
 
 #include <msg.h>
@@ -84,6 +97,7 @@
 #include <vstring.h>
 #include <stringops.h>
 #include <mymalloc.h>
+#include <argv.h>
 
 /* Global library. */
 
@@ -103,8 +117,15 @@ typedef struct {
     void   *ctx;			/* db_common_parse() context */
     char   *dbpath;			/* dbpath config attribute */
     int     expansion_limit;		/* expansion_limit config attribute */
+    int     mmap_size;			/* mmap_size config attribute */
+    char   *stmt_query;			/* query with parameters, or null */
+    char   *stmt_params;		/* db_common_expand() parameters */
+    ARGV   *stmt_args;			/* expanded parameters */
+    sqlite3_stmt *stmt;			/* compiled stmt_query, or null */
 } DICT_SQLITE;
 
+#define DICT_SQLITE_DEF_MMAP_SIZE	(256 * 1024 * 1024)
+
 /* dict_sqlite_quote - escape SQL metacharacters in input string */
 
 static void dict_sqlite_quote(DICT *dict, const char *raw_text, VSTRING *result)
@@ -119,6 +140,15 @@ static void dict_sqlite_quote(DICT *dict, const char *raw_text, VSTRING *result)
     sqlite3_free(quoted_text);
 }
 
+/* dict_sqlite_param - save query parameter */
+
+static void dict_sqlite_param(DICT *dict, const char *raw_text, VSTRING *unused)
+{
+    DICT_SQLITE *dict_sqlite = (DICT_SQLITE *) dict;
+
+    argv_add(dict_sqlite->stmt_args, raw_text, ARGV_END);
+}
+
 /* dict_sqlite_close - close the database */
 
 static void dict_sqlite_close(DICT *dict)
@@ -129,12 +159,20 @@ static void dict_sqlite_close(DICT *dict)
     if (msg_verbose)
 	msg_info("%s: %s", myname, dict_sqlite->parser->name);
 
+    if (dict_sqlite->stmt && sqlite3_finalize(dict_sqlite->stmt) != SQLITE_OK)
+	msg_fatal("%s: %s: SQL finalize failed: %s", myname,
+		  dict_sqlite->parser->name, sqlite3_errmsg(dict_sqlite->db));
     if (sqlite3_close(dict_sqlite->db) != SQLITE_OK)
 	msg_fatal("%s: close %s failed", myname, dict_sqlite->parser->name);
     cfg_parser_free(dict_sqlite->parser);
     myfree(dict_sqlite->dbpath);
     myfree(dict_sqlite->query);
     myfree(dict_sqlite->result_format);
+    if (dict_sqlite->stmt_query) {
+	myfree(dict_sqlite->stmt_query);
+	myfree(dict_sqlite->stmt_params);
+	argv_free(dict_sqlite->stmt_args);
+    }
     if (dict_sqlite->ctx)
 	db_common_free_ctx(dict_sqlite->ctx);
     if (dict->fold_buf)
@@ -150,12 +188,14 @@ static const char *dict_sqlite_lookup(DICT *dict, const char *name)
     DICT_SQLITE *dict_sqlite = (DICT_SQLITE *) dict;
     sqlite3_stmt *sql_stmt;
     const char *query_remainder;
+    const char *query_text;
     static VSTRING *query;
     static VSTRING *result;
     const char *retval;
     int     expansion = 0;
     int     status;
     int     domain_rc;
+    int     n;
 
     /*
      * In case of return without lookup (skipped key, etc.).
@@ -207,23 +247,56 @@ static const char *dict_sqlite_lookup(DICT *dict, const char *name)
 
     INIT_VSTR(query, 10);
 
-    if (!db_common_expand(dict_sqlite->ctx, dict_sqlite->query,
-			  name, 0, query, dict_sqlite_quote))
-	return (0);
+    if (dict_sqlite->stmt_query == 0) {
+	if (!db_common_expand(dict_sqlite->ctx, dict_sqlite->query,
+			      name, 0, query, dict_sqlite_quote))
+	    return (0);
+	query_text = vstring_str(query);
+    } else {
+	argv_truncate(dict_sqlite->stmt_args, 0);
+	if (!db_common_expand(dict_sqlite->ctx, dict_sqlite->stmt_params,
+			      name, 0, query, dict_sqlite_param))
+	    return (0);
+	query_text = dict_sqlite->stmt_query;
+    }
 
     if (msg_verbose)
 	msg_info("%s: %s: Searching with query %s",
-		 myname, dict_sqlite->parser->name, vstring_str(query));
-
-    if (sqlite3_prepare_v2(dict_sqlite->db, vstring_str(query), -1,
-			   &sql_stmt, &query_remainder) != SQLITE_OK)
-	msg_fatal("%s: %s: SQL prepare failed: %s\n",
-		  myname, dict_sqlite->parser->name,
-		  sqlite3_errmsg(dict_sqlite->db));
+		 myname, dict_sqlite->parser->name, query_text);
 
-    if (*query_remainder && msg_verbose)
-	msg_info("%s: %s: Ignoring text at end of query: %s",
-		 myname, dict_sqlite->parser->name, query_remainder);
+    /*
+     * Compile the parameterized query once, and reuse it for all lookups.
+     * The values are bound, not quoted, so that they need no SQL escapes.
+     */
+    if (dict_sqlite->stmt_query == 0 || dict_sqlite->stmt == 0) {
+	if (sqlite3_prepare_v2(dict_sqlite->db, query_text, -1,
+			       &sql_stmt, &query_remainder) != SQLITE_OK)
+	    msg_fatal("%s: %s: SQL prepare failed: %s\n",
+		      myname, dict_sqlite->parser->name,
+		      sqlite3_errmsg(dict_sqlite->db));
+
+	if (*query_remainder && msg_verbose)
+	    msg_info("%s: %s: Ignoring text at end of query: %s",
+		     myname, dict_sqlite->parser->name, query_remainder);
+	if (dict_sqlite->stmt_query != 0)
+	    dict_sqlite->stmt = sql_stmt;
+    } else
+	sql_stmt = dict_sqlite->stmt;
+
+    if (dict_sqlite->stmt_query != 0) {
+	for (n = 0; n < dict_sqlite->stmt_args->argc; n++) {
+	    if (msg_verbose)
+		msg_info("%s: %s: Parameter %d: %s", myname,
+			 dict_sqlite->parser->name, n + 1,
+			 dict_sqlite->stmt_args->argv[n]);
+	    if (sqlite3_bind_text(sql_stmt, n + 1,
+				  dict_sqlite->stmt_args->argv[n], -1,
+				  SQLITE_STATIC) != SQLITE_OK)
+		msg_fatal("%s: %s: SQL bind failed for query '%s': %s\n",
+			  myname, dict_sqlite->parser->name, query_text,
+			  sqlite3_errmsg(dict_sqlite->db));
+	}
+    }
 
     /*
      * Retrieve and expand the result(s).
@@ -246,24 +319,79 @@ static const char *dict_sqlite_lookup(DICT *dict, const char *name)
 	else {
 	    msg_warn("%s: %s: SQL step failed for query '%s': %s\n",
 		     myname, dict_sqlite->parser->name,
-		     vstring_str(query), sqlite3_errmsg(dict_sqlite->db));
+		     query_text, sqlite3_errmsg(dict_sqlite->db));
 	    dict->error = DICT_ERR_RETRY;
 	    break;
 	}
     }
 
     /*
-     * Clean up.
+     * Clean up. sqlite3_reset() repeats the error from a failed step, which
+     * was already reported.
      */
-    if (sqlite3_finalize(sql_stmt))
+    if (sql_stmt == dict_sqlite->stmt) {
+	(void) sqlite3_reset(sql_stmt);
+	if (sqlite3_clear_bindings(sql_stmt) != SQLITE_OK)
+	    msg_fatal("%s: %s: SQL reset failed for query '%s': %s\n",
+		      myname, dict_sqlite->parser->name,
+		      query_text, sqlite3_errmsg(dict_sqlite->db));
+    } else if (sqlite3_finalize(sql_stmt))
 	msg_fatal("%s: %s: SQL finalize failed for query '%s': %s\n",
 		  myname, dict_sqlite->parser->name,
-		  vstring_str(query), sqlite3_errmsg(dict_sqlite->db));
+		  query_text, sqlite3_errmsg(dict_sqlite->db));
 
     return ((dict->error == 0 && *(retval = vstring_str(result)) != 0) ?
 	    retval : 0);
 }
 
+/* sqlite_parse_params - convert quoted substitutions to query parameters */
+
+static void sqlite_parse_params(DICT_SQLITE *dict_sqlite)
+{
+    const char *myname = "sqlite_parse_params";
+    VSTRING *query = vstring_alloc(100);
+    VSTRING *params = vstring_alloc(10);
+    const char *open_quote = 0;
+    const char *cp;
+
+    /*
+     * Replace each '%x' string literal with a "?" parameter, and save the
+     * %x in a template for db_common_expand(). A '' escape before or after
+     * the substitution means that it is part of a larger literal. Give up
+     * when a substitution is not a literal by itself; that query will be
+     * expanded and compiled for each lookup, as before.
+     */
+    for (cp = dict_sqlite->query; *cp; cp++) {
+	if (*cp == '\'') {
+	    open_quote = (open_quote ? 0 : cp);
+	} else if (*cp == '%' && cp[1] == '%') {
+	    cp += 1;
+	} else if (*cp == '%') {
+	    if (open_quote == 0 || open_quote != cp - 1
+		|| (open_quote > dict_sqlite->query && open_quote[-1] == '\'')
+		|| cp[1] == 0 || cp[2] != '\'' || cp[3] == '\'') {
+		if (msg_verbose)
+		    msg_info("%s: %s: query is not parameterized: %s", myname,
+			     dict_sqlite->parser->name, dict_sqlite->query);
+		vstring_free(query);
+		vstring_free(params);
+		return;
+	    }
+	    vstring_truncate(query, VSTRING_LEN(query) - 1);
+	    VSTRING_ADDCH(query, '?');
+	    vstring_strncat(params, cp, 2);
+	    open_quote = 0;
+	    cp += 2;
+	    continue;
+	}
+	VSTRING_ADDCH(query, *cp);
+    }
+    VSTRING_TERMINATE(query);
+    dict_sqlite->stmt_query = vstring_export(query);
+    dict_sqlite->stmt_params = vstring_export(params);
+    dict_sqlite->stmt_args = argv_alloc(2);
+}
+
 /* sqlite_parse_config - parse sqlite configuration file */
 
 static void sqlite_parse_config(DICT_SQLITE *dict_sqlite, const char *sqlitecf)
@@ -286,6 +414,8 @@ static void sqlite_parse_config(DICT_SQLITE *dict_sqlite, const char *sqlitecf)
 	cfg_get_str(dict_sqlite->parser, "result_format", "%s", 1, 0);
     dict_sqlite->expansion_limit =
 	cfg_get_int(dict_sqlite->parser, "expansion_limit", 0, 0, 0);
+    dict_sqlite->mmap_size = cfg_get_int(dict_sqlite->parser, "mmap_size",
+					 DICT_SQLITE_DEF_MMAP_SIZE, 0, 0);
 
     /*
      * Parse the query / result templates and the optional domain filter.
@@ -295,6 +425,9 @@ static void sqlite_parse_config(DICT_SQLITE *dict_sqlite, const char *sqlitecf)
 			   dict_sqlite->query, 1);
     (void) db_common_parse(0, &dict_sqlite->ctx, dict_sqlite->result_format, 0);
     db_common_parse_domain(dict_sqlite->parser, dict_sqlite->ctx);
+    dict_sqlite->stmt_query = 0;
+    dict_sqlite->stmt = 0;
+    sqlite_parse_params(dict_sqlite);
 
     /*
      * Maps that use substring keys should only be used with the full input
@@ -312,6 +445,7 @@ DICT   *dict_sqlite_open(const char *name, int open_flags, int dict_flags)
 {
     DICT_SQLITE *dict_sqlite;
     CFG_PARSER *parser;
+    VSTRING *pragma;
 
     /*
      * Sanity checks.
@@ -337,13 +471,163 @@ DICT   *dict_sqlite_open(const char *name, int open_flags, int dict_flags)
     dict_sqlite->parser = parser;
     sqlite_parse_config(dict_sqlite, name);
 
-    if (sqlite3_open(dict_sqlite->dbpath, &dict_sqlite->db))
+    if (sqlite3_open_v2(dict_sqlite->dbpath, &dict_sqlite->db,
+			SQLITE_OPEN_READONLY, (char *) 0))
 	msg_fatal("%s:%s: Can't open database: %s\n",
 		  DICT_TYPE_SQLITE, name, sqlite3_errmsg(dict_sqlite->db));
 
+    /*
+     * Older SQLite versions silently ignore this.
+     */
+    if (dict_sqlite->mmap_size > 0) {
+	pragma = vstring_alloc(30);
+	vstring_sprintf(pragma, "PRAGMA mmap_size = %d", dict_sqlite->mmap_size);
+	if (sqlite3_exec(dict_sqlite->db, vstring_str(pragma), 0, 0, 0)
+	    != SQLITE_OK)
+	    msg_warn("%s:%s: %s: %s", DICT_TYPE_SQLITE, name,
+		     vstring_str(pragma), sqlite3_errmsg(dict_sqlite->db));
+	vstring_free(pragma);
+    }
+
     dict_sqlite->dict.owner = cfg_get_owner(dict_sqlite->parser);
 
     return (DICT_DEBUG (&dict_sqlite->dict));
 }
 
+#ifdef TEST
+
+ /*
+  * Proof-of-concept benchmark. Create a table with the specified number of
+  * rows, then time lookups with the compiled query, and with a query that
+  * is expanded and compiled for each lookup. Both runs look up the same
+  * keys in the same scattered order.
+  */
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <vstream.h>
+
+#define BENCH_DB	"./dict_sqlite_bench.db"
+#define BENCH_CF	"./dict_sqlite_bench.cf"
+
+/* dict_sqlite_bench_load - create the benchmark table */
+
+static void dict_sqlite_bench_load(int rows)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    VSTRING *key = vstring_alloc(100);
+    VSTRING *value = vstring_alloc(100);
+    int     n;
+
+    (void) unlink(BENCH_DB);
+    if (sqlite3_open(BENCH_DB, &db) != SQLITE_OK
+	|| sqlite3_exec(db, "CREATE TABLE mailbox (address TEXT PRIMARY KEY, "
+			"maildir TEXT); BEGIN", 0, 0, 0) != SQLITE_OK
+	|| sqlite3_prepare_v2(db, "INSERT INTO mailbox VALUES (?, ?)", -1,
+			      &stmt, (const char **) 0) != SQLITE_OK)
+	msg_fatal("create %s: %s", BENCH_DB, sqlite3_errmsg(db));
+    for (n = 0; n < rows; n++) {
+	vstring_sprintf(key, "user%d@example.com", n);
+	vstring_sprintf(value, "example.com/user%d/", n);
+	if (sqlite3_bind_text(stmt, 1, vstring_str(key), -1,
+			      SQLITE_STATIC) != SQLITE_OK
+	    || sqlite3_bind_text(stmt, 2, vstring_str(value), -1,
+				 SQLITE_STATIC) != SQLITE_OK
+	    || sqlite3_step(stmt) != SQLITE_DONE
+	    || sqlite3_reset(stmt) != SQLITE_OK)
+	    msg_fatal("insert %s: %s", BENCH_DB, sqlite3_errmsg(db));
+    }
+    if (sqlite3_finalize(stmt) != SQLITE_OK
+	|| sqlite3_exec(db, "COMMIT", 0, 0, 0) != SQLITE_OK
+	|| sqlite3_close(db) != SQLITE_OK)
+	msg_fatal("close %s: %s", BENCH_DB, sqlite3_errmsg(db));
+    vstring_free(key);
+    vstring_free(value);
+}
+
+/* dict_sqlite_bench_run - time lookups */
+
+static void dict_sqlite_bench_run(const char *query, int rows, int lookups)
+{
+    VSTREAM *fp;
+    DICT   *dict;
+    VSTRING *key = vstring_alloc(100);
+    struct timeval start;
+    struct timeval finish;
+    double  elapsed;
+    int     found = 0;
+    int     n;
+
+    if ((fp = vstream_fopen(BENCH_CF, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == 0)
+	msg_fatal("create %s: %m", BENCH_CF);
+    vstream_fprintf(fp, "dbpath = %s\nquery = %s\n", BENCH_DB, query);
+    if (vstream_fclose(fp))
+	msg_fatal("write %s: %m", BENCH_CF);
+    dict = dict_sqlite_open(BENCH_CF, O_RDONLY, DICT_FLAG_NONE);
+    if (dict->lookup != dict_sqlite_lookup)
+	msg_fatal("open %s failed", BENCH_CF);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < lookups; n++) {
+	vstring_sprintf(key, "user%d@example.com",
+			(int) ((n * 7919L) % rows));
+	if (dict_get(dict, vstring_str(key)) != 0)
+	    found++;
+    }
+    GETTIMEOFDAY(&finish);
+    elapsed = (finish.tv_sec - start.tv_sec)
+	+ (finish.tv_usec - start.tv_usec) / 1000000.0;
+    vstream_printf("%s: %d lookups (%d found) in %.3f seconds (%.0f/s)\n",
+		   ((DICT_SQLITE *) dict)->stmt_query ?
+		   "compiled once" : "compiled per lookup",
+		   lookups, found, elapsed,
+		   elapsed > 0 ? lookups / elapsed : 0);
+    vstream_fflush(VSTREAM_OUT);
+    dict_close(dict);
+    (void) unlink(BENCH_CF);
+    vstring_free(key);
+}
+
+int     main(int argc, char **argv)
+{
+    int     rows;
+    int     lookups;
+
+    if (argc != 4 || strcmp(argv[1], "-b") != 0
+	|| (rows = atoi(argv[2])) <= 0 || (lookups = atoi(argv[3])) <= 0)
+	msg_fatal("usage: %s -b rows lookups", argv[0]);
+    dict_sqlite_bench_load(rows);
+
+    /*
+     * The second query is not parameterized because the substitution is
+     * not a literal by itself.
+     */
+    dict_sqlite_bench_run("SELECT maildir FROM mailbox WHERE address = '%s'",
+			  rows, lookups);
+    dict_sqlite_bench_run("SELECT maildir FROM mailbox "
+			  "WHERE address = trim(' %s ')", rows, lookups);
+    (void) unlink(BENCH_DB);
+    return (0);
+}
+
+#endif
+
+#endif
+
+#if defined(TEST) && !defined(HAS_SQLITE)
+
+ /*
+  * Without SQLite support there is nothing to benchmark.
+  */
+#include <stdlib.h>
+#include <msg.h>
+#include <msg_vstream.h>
+
+int     main(int argc, char **argv)
+{
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    msg_warn("SQLite support is not compiled in");
+    exit(0);
+}
+
 #endif
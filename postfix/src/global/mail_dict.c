@@ -112,6 +112,7 @@ int     main(int argc, char **argv)
     var_queue_dir = DEF_QUEUE_DIR;
     var_proxymap_service = DEF_PROXYMAP_SERVICE;
     var_proxywrite_service = DEF_PROXYWRITE_SERVICE;
+    var_proxymap_service_maps = DEF_PROXYMAP_SERVICE_MAPS;
     var_ipc_timeout = 3600;
     mail_dict_init();
     dict_test(argc, argv);
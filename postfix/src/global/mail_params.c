@@ -97,9 +97,11 @@
 /*	char   *var_trace_service;
 /*	char   *var_proxymap_service;
 /*	char   *var_proxywrite_service;
+/*	char   *var_proxymap_service_maps;
 /*	int	var_db_create_buf;
 /*	int	var_db_read_buf;
 /*	long	var_lmdb_map_size;
+/*	int	var_postmap_sort_buf;
 /*	int	var_proc_limit;
 /*	int	var_mime_maxdepth;
 /*	int	var_mime_bound_len;
@@ -155,6 +157,7 @@
 /*	char	*var_maillog_file_pfxs;
 /*	char	*var_maillog_file_comp;
 /*	char	*var_maillog_file_stamp;
+/*	int	var_maillog_batch_size;
 /*	char	*var_postlog_service;
 /*
 /*	char	*var_dnssec_probe;
@@ -324,9 +327,11 @@ char   *var_verify_service;
 char   *var_trace_service;
 char   *var_proxymap_service;
 char   *var_proxywrite_service;
+char   *var_proxymap_service_maps;
 int     var_db_create_buf;
 int     var_db_read_buf;
 long    var_lmdb_map_size;
+int     var_postmap_sort_buf;
 int     var_proc_limit;
 int     var_mime_maxdepth;
 int     var_mime_bound_len;
@@ -366,6 +371,7 @@ char   *var_maillog_file;
 char   *var_maillog_file_pfxs;
 char   *var_maillog_file_comp;
 char   *var_maillog_file_stamp;
+int     var_maillog_batch_size;
 char   *var_postlog_service;
 
 char   *var_dnssec_probe;
@@ -705,6 +711,7 @@ void    mail_params_init()
 {
     static const CONFIG_INT_TABLE first_int_defaults[] = {
 	VAR_COMPAT_LEVEL, DEF_COMPAT_LEVEL, &var_compat_level, 0, 0,
+	VAR_MAILLOG_BATCH_SIZE, DEF_MAILLOG_BATCH_SIZE, &var_maillog_batch_size, 0, 0,
 	0,
     };
     static const CONFIG_STR_TABLE first_str_defaults[] = {
@@ -788,6 +795,7 @@ void    mail_params_init()
 	VAR_TRACE_SERVICE, DEF_TRACE_SERVICE, &var_trace_service, 1, 0,
 	VAR_PROXYMAP_SERVICE, DEF_PROXYMAP_SERVICE, &var_proxymap_service, 1, 0,
 	VAR_PROXYWRITE_SERVICE, DEF_PROXYWRITE_SERVICE, &var_proxywrite_service, 1, 0,
+	VAR_PROXYMAP_SERVICE_MAPS, DEF_PROXYMAP_SERVICE_MAPS, &var_proxymap_service_maps, 0, 0,
 	VAR_INT_FILT_CLASSES, DEF_INT_FILT_CLASSES, &var_int_filt_classes, 0, 0,
 	/* multi_instance_wrapper may have dependencies but not dependents. */
 	VAR_MULTI_WRAPPER, DEF_MULTI_WRAPPER, &var_multi_wrapper, 0, 0,
@@ -813,6 +821,7 @@ void    mail_params_init()
 	VAR_FAULT_INJ_CODE, DEF_FAULT_INJ_CODE, &var_fault_inj_code, 0, 0,
 	VAR_DB_CREATE_BUF, DEF_DB_CREATE_BUF, &var_db_create_buf, 1, 0,
 	VAR_DB_READ_BUF, DEF_DB_READ_BUF, &var_db_read_buf, 1, 0,
+	VAR_POSTMAP_SORT_BUF, DEF_POSTMAP_SORT_BUF, &var_postmap_sort_buf, 0, 0,
 	VAR_HEADER_LIMIT, DEF_HEADER_LIMIT, &var_header_limit, 1, 0,
 	VAR_TOKEN_LIMIT, DEF_TOKEN_LIMIT, &var_token_limit, 1, 0,
 	VAR_MIME_MAXDEPTH, DEF_MIME_MAXDEPTH, &var_mime_maxdepth, 1, 0,
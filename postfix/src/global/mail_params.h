@@ -1971,6 +1971,14 @@ extern int var_virt_recur_limit;
 #define DEF_VIRT_EXPAN_LIMIT	1000
 extern int var_virt_expan_limit;
 
+#define VAR_VIRT_CACHE_SIZE	"virtual_alias_expansion_cache_size"
+#define DEF_VIRT_CACHE_SIZE	0
+extern int var_virt_cache_size;
+
+#define VAR_VIRT_CACHE_TTL	"virtual_alias_expansion_cache_ttl"
+#define DEF_VIRT_CACHE_TTL	"60s"
+extern int var_virt_cache_ttl;
+
 #define VAR_VIRT_ADDRLEN_LIMIT	"virtual_alias_address_length_limit"
 #define DEF_VIRT_ADDRLEN_LIMIT	1000
 extern int var_virt_addrlen_limit;
@@ -2962,6 +2970,10 @@ extern char *var_proxymap_service;
 #define DEF_PROXYWRITE_SERVICE		MAIL_SERVICE_PROXYWRITE
 extern char *var_proxywrite_service;
 
+#define VAR_PROXYMAP_SERVICE_MAPS	"proxymap_service_maps"
+#define DEF_PROXYMAP_SERVICE_MAPS	""
+extern char *var_proxymap_service_maps;
+
  /*
   * Mailbox/maildir delivery errors that cause delivery to be tried again.
   */
@@ -2991,6 +3003,13 @@ extern int var_db_read_buf;
 #define DEF_LMDB_MAP_SIZE		(16 * 1024 *1024)
 extern long var_lmdb_map_size;
 
+ /*
+  * postmap(1) sorted bulk load.
+  */
+#define VAR_POSTMAP_SORT_BUF		"postmap_sort_buffer_size"
+#define DEF_POSTMAP_SORT_BUF		(64 * 1024 * 1024)
+extern int var_postmap_sort_buf;
+
  /*
   * Named queue file attributes.
   */
@@ -4219,6 +4238,10 @@ extern char *var_maillog_file_comp;
 #define DEF_MAILLOG_FILE_STAMP	"%Y%m%d-%H%M%S"
 extern char *var_maillog_file_stamp;
 
+#define VAR_MAILLOG_BATCH_SIZE	"maillog_batch_size"
+#define DEF_MAILLOG_BATCH_SIZE	0
+extern int var_maillog_batch_size;
+
 #define VAR_POSTLOG_SERVICE	"postlog_service_name"
 #define DEF_POSTLOG_SERVICE	MAIL_SERVICE_POSTLOG
 extern char *var_postlog_service;
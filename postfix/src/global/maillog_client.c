@@ -36,6 +36,11 @@
 /*	if logging to the internal postlog service is enabled, but
 /*	the postlog service is unavailable. If the fallback fails,
 /*	die with a fatal error.
+/* .IP MAILLOG_CLIENT_FLAG_BATCH
+/*	Send records to the internal postlog service in batches of
+/*	up to "maillog_batch_size" bytes. This is for daemon
+/*	processes that call msg_logger_flush() before they wait
+/*	for work.
 /* .RE
 /* ENVIRONMENT
 /* .ad
@@ -53,6 +58,9 @@
 /* CONFIGURATION PARAMETERS
 /* .ad
 /* .fi
+/* .IP "maillog_batch_size (0)"
+/*	The maximal size of a batch of records that a daemon process
+/*	sends to the internal postlog service.
 /* .IP "maillog_file (empty)"
 /*	The name of an optional logfile. If the value is empty, or
 /*	unitialized and the process environment does not specify
@@ -266,6 +274,9 @@ void    maillog_client_init(const char *progname, int flags)
 	if (service_path != import_service_path)
 	    myfree(service_path);
 	msg_logger_control(CA_MSG_LOGGER_CTL_CONNECT_NOW,
+			   CA_MSG_LOGGER_CTL_BATCH_SIZE(
+					 (flags & MAILLOG_CLIENT_FLAG_BATCH) ?
+					 (ssize_t) var_maillog_batch_size : 0),
 			   CA_MSG_LOGGER_CTL_END);
     }
 
@@ -30,6 +30,18 @@
 /*	MIME_STATE *mime_state_free(state)
 /*	MIME_STATE *state;
 /*
+/*	typedef struct {
+/* .in +4
+/*		ssize_t	name_len;	/* header name length */
+/*		ssize_t	value_offset;	/* value start, after ':' and blanks */
+/*		int	line_count;	/* number of physical lines */
+/*		int	flags;		/* MIME_HEADER_FLAG_8BIT */
+/* .in -4
+/*	} MIME_HEADER_INFO;
+/*
+/*	const MIME_HEADER_INFO *mime_state_header_info(state)
+/*	MIME_STATE *state;
+/*
 /*	const char *mime_state_error(error_code)
 /*	int	error_code;
 /*
@@ -195,6 +207,15 @@
 /*	This module will not glue together multipart boundary strings that
 /*	span multiple input records.
 /*
+/*	mime_state_header_info() returns information about the
+/*	logical header that is being passed to the head_out call-back
+/*	routine: the length of the header name, the offset of the
+/*	header value (after the colon and any blanks on the first
+/*	line), the number of physical lines, and whether the header
+/*	contains 8-bit characters. The information is collected
+/*	while the header is assembled, and is valid only during the
+/*	head_out call-back, for the unmodified header buffer.
+/*
 /*	This module will not glue together RFC 2231 formatted (boundary)
 /*	parameter values. RFC 2231 claims compatibility with existing
 /*	MIME processors. Splitting boundary strings is not backwards
@@ -300,6 +321,7 @@ struct MIME_STATE {
     int     curr_encoding;		/* last or default content encoding */
     int     curr_domain;		/* last or default encoding unit */
     VSTRING *output_buffer;		/* headers, quoted-printable body */
+    MIME_HEADER_INFO header_info;	/* logical header in output buffer */
     int     prev_rec_type;		/* previous input record type */
     int     nesting_level;		/* safety */
     MIME_STACK *stack;			/* for composite types */
@@ -433,6 +455,18 @@ static const MIME_ENCODING mime_encoding_map[] = {	/* RFC 2045 */
 	} \
     } while(0)
 
+#define HEADER_SCAN_8BIT(ptr, text, len) do { \
+	if (((ptr)->header_info.flags & MIME_HEADER_FLAG_8BIT) == 0) { \
+	    const unsigned char *_cp = CU_CHAR_PTR(text); \
+	    const unsigned char *_end = _cp + (len); \
+	    for (/* void */; _cp < _end; _cp++) \
+		if (*_cp & 0200) { \
+		    (ptr)->header_info.flags |= MIME_HEADER_FLAG_8BIT; \
+		    break; \
+		} \
+	} \
+    } while (0)
+
 #define BODY_OUT(ptr, rec_type, text, len) do { \
 	if ((ptr)->body_out) { \
 	    (ptr)->body_out((ptr)->app_context, (rec_type), \
@@ -509,6 +543,10 @@ MIME_STATE *mime_state_alloc(int flags,
 		   MIME_CTYPE_TEXT, MIME_STYPE_PLAIN,
 		   MIME_ENC_7BIT, MIME_ENC_7BIT);
     state->output_buffer = vstring_alloc(100);
+    state->header_info.name_len = 0;
+    state->header_info.value_offset = 0;
+    state->header_info.line_count = 0;
+    state->header_info.flags = 0;
     state->prev_rec_type = 0;
     state->stack = 0;
     state->token_buffer = vstring_alloc(1);
@@ -538,6 +576,13 @@ MIME_STATE *mime_state_free(MIME_STATE *state)
     return (0);
 }
 
+/* mime_state_header_info - information about current logical header */
+
+const MIME_HEADER_INFO *mime_state_header_info(MIME_STATE *state)
+{
+    return (&state->header_info);
+}
+
 /* mime_state_content_type - process content-type header */
 
 static void mime_state_content_type(MIME_STATE *state,
@@ -797,6 +842,7 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 		if (state->prev_rec_type == REC_TYPE_CONT) {
 		    if (LEN(state->output_buffer) < var_header_limit) {
 			vstring_strncat(state->output_buffer, text, len);
+			HEADER_SCAN_8BIT(state, text, len);
 		    } else {
 			if (state->static_flags & MIME_OPT_REPORT_TRUNC_HEADER)
 			    REPORT_ERROR_BUF(state, MIME_ERR_TRUNC_HEADER,
@@ -808,6 +854,8 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 		    if (LEN(state->output_buffer) < var_header_limit) {
 			vstring_strcat(state->output_buffer, "\n");
 			vstring_strncat(state->output_buffer, text, len);
+			state->header_info.line_count += 1;
+			HEADER_SCAN_8BIT(state, text, len);
 		    } else {
 			if (state->static_flags & MIME_OPT_REPORT_TRUNC_HEADER)
 			    REPORT_ERROR_BUF(state, MIME_ERR_TRUNC_HEADER,
@@ -837,15 +885,10 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 			mime_state_content_encoding(state, header_info);
 		}
 		if ((state->static_flags & MIME_OPT_REPORT_8BIT_IN_HEADER) != 0
-		    && (state->err_flags & MIME_ERR_8BIT_IN_HEADER) == 0) {
-		    for (cp = CU_CHAR_PTR(STR(state->output_buffer));
-			 cp < CU_CHAR_PTR(END(state->output_buffer)); cp++)
-			if (*cp & 0200) {
-			    REPORT_ERROR_BUF(state, MIME_ERR_8BIT_IN_HEADER,
-					     state->output_buffer);
-			    break;
-			}
-		}
+		    && (state->err_flags & MIME_ERR_8BIT_IN_HEADER) == 0
+		    && (state->header_info.flags & MIME_HEADER_FLAG_8BIT))
+		    REPORT_ERROR_BUF(state, MIME_ERR_8BIT_IN_HEADER,
+				     state->output_buffer);
 		/* Output routine is explicitly allowed to change the data. */
 		if (header_info == 0
 		    || header_info->type != HDR_CONTENT_TRANSFER_ENCODING
@@ -879,6 +922,17 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 		     text++, len--)
 		     /* void */ ;
 		vstring_strncat(state->output_buffer, text, len);
+		state->header_info.name_len = header_len;
+		state->header_info.line_count = 1;
+		state->header_info.flags = 0;
+		HEADER_SCAN_8BIT(state, STR(state->output_buffer),
+				 LEN(state->output_buffer));
+		for (cp = CU_CHAR_PTR(STR(state->output_buffer)) + header_len + 1;
+		     cp < CU_CHAR_PTR(END(state->output_buffer))
+		     && IS_SPACE_TAB(*cp); cp++)
+		     /* void */ ;
+		state->header_info.value_offset =
+		    cp - CU_CHAR_PTR(STR(state->output_buffer));
 		SAVE_PREV_REC_TYPE_AND_RETURN_ERR_FLAGS(state, rec_type);
 	    }
 	}
@@ -894,8 +948,9 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 	 * broken beyond recovery, because the Postfix SMTP server sanitizes
 	 * record boundaries, treating broken record boundaries as CRLF.
 	 * 
-	 * Clear the output buffer, we will need it for storage of the
-	 * conversion result.
+	 * The synthesized header replaces the information about the last
+	 * input header. Clear the output buffer, we will need it for storage
+	 * of the conversion result.
 	 */
 	if ((state->static_flags & MIME_OPT_DOWNGRADE)
 	    && state->curr_domain != MIME_ENC_7BIT) {
@@ -907,6 +962,11 @@ int     mime_state_update(MIME_STATE *state, int rec_type,
 		cp = CU_CHAR_PTR("quoted-printable");
 	    vstring_sprintf(state->output_buffer,
 			    "Content-Transfer-Encoding: %s", cp);
+	    state->header_info.name_len =
+		sizeof("Content-Transfer-Encoding") - 1;
+	    state->header_info.value_offset = state->header_info.name_len + 2;
+	    state->header_info.line_count = 1;
+	    state->header_info.flags = 0;
 	    HEAD_OUT(state, (HEADER_OPTS *) 0, len);
 	    VSTRING_RESET(state->output_buffer);
 	}
@@ -1188,16 +1248,29 @@ const MIME_STATE_DETAIL *mime_state_detail(int error_code)
 
 #define REC_LEN	1024
 
+ /*
+  * With "-i", also show the header information that is passed to head_out.
+  */
+static MIME_STATE *show_info;
+
 static void head_out(void *context, int class, const HEADER_OPTS *unused_info,
 		             VSTRING *buf, off_t offset)
 {
     VSTREAM *stream = (VSTREAM *) context;
+    const MIME_HEADER_INFO *info;
 
     vstream_fprintf(stream, "%s %ld\t|%s\n",
 		    class == MIME_HDR_PRIMARY ? "MAIN" :
 		    class == MIME_HDR_MULTIPART ? "MULT" :
 		    class == MIME_HDR_NESTED ? "NEST" :
 		    "ERROR", (long) offset, STR(buf));
+    if (show_info) {
+	info = mime_state_header_info(show_info);
+	vstream_fprintf(stream, "INFO name %ld value %ld lines %d%s\n",
+			(long) info->name_len, (long) info->value_offset,
+			info->line_count,
+			(info->flags & MIME_HEADER_FLAG_8BIT) ? " 8bit" : "");
+    }
 }
 
 static void head_end(void *context)
@@ -1237,7 +1310,7 @@ int     var_mime_maxdepth = 20;
 int     var_mime_bound_len = 2000;
 char   *var_drop_hdrs = DEF_DROP_HDRS;
 
-int     main(int unused_argc, char **argv)
+int     main(int argc, char **argv)
 {
     int     rec_type;
     int     last = 0;
@@ -1264,6 +1337,8 @@ int     main(int unused_argc, char **argv)
 			     body_out, body_end,
 			     err_print,
 			     (void *) VSTREAM_OUT);
+    if (argc > 1 && strcmp(argv[1], "-i") == 0)
+	show_info = state;
 
     /*
      * Main loop.
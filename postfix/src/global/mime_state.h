@@ -34,6 +34,22 @@ extern MIME_STATE *mime_state_alloc(int, MIME_STATE_HEAD_OUT, MIME_STATE_ANY_END
 extern int mime_state_update(MIME_STATE *, int, const char *, ssize_t);
 extern MIME_STATE *mime_state_free(MIME_STATE *);
 
+ /*
+  * Information about the logical header that is passed to the head_out
+  * call-back routine. This is computed while the header is assembled, so
+  * that head_out routines don't have to scan the header again.
+  */
+typedef struct MIME_HEADER_INFO {
+    ssize_t name_len;			/* header name length */
+    ssize_t value_offset;		/* value start, after ':' and blanks */
+    int     line_count;			/* number of physical lines */
+    int     flags;			/* see below */
+} MIME_HEADER_INFO;
+
+#define MIME_HEADER_FLAG_8BIT	(1<<0)	/* header has 8-bit content */
+
+extern const MIME_HEADER_INFO *mime_state_header_info(MIME_STATE *);
+
  /*
   * Processing options.
   */
@@ -44,6 +44,7 @@ extern MKMAP *mkmap_lmdb_open(const char *);
 extern MKMAP *mkmap_sdbm_open(const char *);
 extern MKMAP *mkmap_proxy_open(const char *);
 extern MKMAP *mkmap_fail_open(const char *);
+extern MKMAP *mkmap_mph_open(const char *);
 
 typedef MKMAP *(*MKMAP_OPEN_FN) (const char *);
 typedef MKMAP_OPEN_FN (*MKMAP_OPEN_EXTEND_FN) (const char *);
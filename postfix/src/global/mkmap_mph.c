@@ -0,0 +1,61 @@
+/*++
+/* NAME
+/*	mkmap_mph 3
+/* SUMMARY
+/*	create or open database, minimal perfect hash style
+/* SYNOPSIS
+/*	#include <mkmap.h>
+/*
+/*	MKMAP	*mkmap_mph_open(path)
+/*	const char *path;
+/* DESCRIPTION
+/*	This module implements support for creating minimal perfect
+/*	hash files.
+/*
+/*	mkmap_mph_open() takes a file name, appends the ".mph.tmp"
+/*	suffix, and creates the named database. On close, this file
+/*	is renamed to the file name with the ".mph" suffix appended.
+/*	This routine is an mph-specific helper for the more general
+/*	mkmap_open() interface.
+/*
+/*	All errors are fatal.
+/* SEE ALSO
+/*	dict_mph(3), minimal perfect hash dictionary interface.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <mymalloc.h>
+#include <dict.h>
+
+/* Application-specific. */
+
+#include <mkmap.h>
+#include <dict_mph.h>
+
+ /*
+  * Dummy module: the dict_mph module has all the functionality built-in,
+  * including the lock on the temporary file.
+  */
+MKMAP  *mkmap_mph_open(const char *unused_path)
+{
+    MKMAP  *mkmap = (MKMAP *) mymalloc(sizeof(*mkmap));
+
+    mkmap->open = dict_mph_open;
+    mkmap->after_open = 0;
+    mkmap->after_close = 0;
+    return (mkmap);
+}
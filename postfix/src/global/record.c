@@ -17,6 +17,13 @@
 /*	ssize_t	maxsize;
 /*	int	flags;
 /*
+/*	int	rec_get_content(stream, buf, maxsize, data, len)
+/*	VSTREAM	*stream;
+/*	VSTRING	*buf;
+/*	ssize_t	maxsize;
+/*	const char **data;
+/*	ssize_t	*len;
+/*
 /*	int	rec_put(stream, type, data, len)
 /*	VSTREAM	*stream;
 /*	int	type;
@@ -92,6 +99,17 @@
 /*	enables the REC_FLAG_FOLLOW_PTR, REC_FLAG_SKIP_DTXT
 /*	and REC_FLAG_SEEK_END features.
 /*
+/*	rec_get_content() is like rec_get(), but avoids copying
+/*	message content. When the next record is a REC_TYPE_NORM
+/*	or REC_TYPE_CONT record that is already in the stream
+/*	buffer, \fIdata\fR points to the record data in the stream
+/*	buffer, and \fIbuf\fR is not used. Otherwise, the record is
+/*	read with rec_get() into \fIbuf\fR, and \fIdata\fR points
+/*	to the \fIbuf\fR content. In both cases, \fIlen\fR is the
+/*	record data length. The data is not null-terminated, and
+/*	remains valid until the next operation on \fIstream\fR or
+/*	\fIbuf\fR.
+/*
 /*	REC_GET_HIDDEN_TYPE() is an unsafe macro that returns
 /*	non-zero when the specified record type is "not exposed"
 /*	by rec_get().
@@ -189,10 +207,68 @@ int     rec_put_type(VSTREAM *stream, int type, off_t offset)
     }
 }
 
+/* rec_get_content - get message content record without copying */
+
+int     rec_get_content(VSTREAM *stream, VSTRING *buf, ssize_t maxsize,
+			        const char **data, ssize_t *len)
+{
+    const unsigned char *start;
+    const unsigned char *cp;
+    const unsigned char *end;
+    ssize_t avail;
+    ssize_t rec_len;
+    unsigned shift;
+    int     type;
+
+    /*
+     * Fast path: decode the record header in the stream buffer. Leave
+     * anything unusual to rec_get(), including records that are not entirely
+     * buffered, records that need special processing, and malformed records.
+     */
+    if ((avail = vstream_peek(stream)) >= 2) {
+	cp = start = (const unsigned char *) vstream_peek_data(stream);
+	end = start + avail;
+	type = *cp++;
+	if (type == REC_TYPE_NORM || type == REC_TYPE_CONT) {
+	    for (rec_len = 0, shift = 0; /* void */ ; shift += 7) {
+		if (cp >= end || shift >= (int) (NBBY * sizeof(int))) {
+		    rec_len = -1;
+		    break;
+		}
+		rec_len |= (*cp & 0177) << shift;
+		if ((*cp++ & 0200) == 0)
+		    break;
+	    }
+	    if (rec_len >= 0 && rec_len <= end - cp
+		&& (maxsize == 0 || rec_len <= maxsize)) {
+		*data = (const char *) cp;
+		*len = rec_len;
+		(void) vstream_peek_skip(stream, cp + rec_len - start);
+		if (msg_verbose > 2)
+		    msg_info("rec_get: type %c len %ld data %.*s", type,
+			     (long) rec_len, (int) (rec_len < 10 ? rec_len : 10),
+			     *data);
+		return (type);
+	    }
+	}
+    }
+
+    /*
+     * Slow path.
+     */
+    type = rec_get(stream, buf, maxsize);
+    *data = vstring_str(buf);
+    *len = VSTRING_LEN(buf);
+    return (type);
+}
+
 /* rec_put - store typed record */
 
 int     rec_put(VSTREAM *stream, int type, const char *data, ssize_t len)
 {
+    unsigned char hdr[1 + (sizeof(len) * NBBY + 6) / 7];
+    struct iovec iov[2];
+    ssize_t hdr_len;
     ssize_t len_rest;
     int     len_byte;
 
@@ -204,13 +280,13 @@ int     rec_put(VSTREAM *stream, int type, const char *data, ssize_t len)
 		 type, (long) len, data);
 
     /*
-     * Write the record type, one byte.
+     * Format the record type, one byte.
      */
-    if (VSTREAM_PUTC(type, stream) == VSTREAM_EOF)
-	return (REC_TYPE_ERROR);
+    hdr[0] = type;
+    hdr_len = 1;
 
     /*
-     * Write the record data length in 7-bit portions, using the 8th bit to
+     * Format the record data length in 7-bit portions, using the 8th bit to
      * indicate that there is more. Use as many length bytes as needed.
      */
     len_rest = len;
@@ -218,15 +294,18 @@ int     rec_put(VSTREAM *stream, int type, const char *data, ssize_t len)
 	len_byte = len_rest & 0177;
 	if (len_rest >>= 7U)
 	    len_byte |= 0200;
-	if (VSTREAM_PUTC(len_byte, stream) == VSTREAM_EOF) {
-	    return (REC_TYPE_ERROR);
-	}
+	hdr[hdr_len++] = len_byte;
     } while (len_rest != 0);
 
     /*
-     * Write the record data portion. Use as many length bytes as needed.
+     * Write the record header and data portion. Large data is not copied
+     * into the stream buffer.
      */
-    if (len && vstream_fwrite(stream, data, len) != len)
+    iov[0].iov_base = (void *) hdr;
+    iov[0].iov_len = hdr_len;
+    iov[1].iov_base = (void *) data;
+    iov[1].iov_len = len;
+    if (vstream_fwritev(stream, iov, len ? 2 : 1) != hdr_len + len)
 	return (REC_TYPE_ERROR);
     return (type);
 }
@@ -412,3 +491,103 @@ int     rec_pad(VSTREAM *stream, int type, ssize_t len)
     return (rec_fprintf(stream, type, "%*s",
 			width < 1 ? 1 : width, "0"));
 }
+
+#ifdef TEST
+
+ /*
+  * Proof-of-concept test program. Read commands from stdin that write
+  * records to a scratch file, and that read those records back with
+  * rec_get_content(). Report whether each record was returned from the
+  * stream buffer or copied into the result buffer.
+  */
+#include <stdlib.h>
+#include <fcntl.h>
+#include <vstring_vstream.h>
+#include <msg_vstream.h>
+
+#define STR(x)	vstring_str(x)
+
+static void rec_test_read(VSTREAM *fp, VSTRING *buf, ssize_t maxsize)
+{
+    const char *data;
+    ssize_t len;
+    int     type;
+
+    if (vstream_fseek(fp, (off_t) 0, SEEK_SET) < 0)
+	msg_fatal("seek %s: %m", VSTREAM_PATH(fp));
+    for (;;) {
+	type = rec_get_content(fp, buf, maxsize, &data, &len);
+	if (type == REC_TYPE_EOF) {
+	    vstream_printf("EOF\n");
+	    break;
+	}
+	if (type == REC_TYPE_ERROR) {
+	    vstream_printf("ERROR\n");
+	    break;
+	}
+	vstream_printf("type %c len %ld %s: %.*s%s\n", type, (long) len,
+		       data == STR(buf) ? "copy" : "buffer",
+		       (int) (len < 30 ? len : 30), data,
+		       len > 30 ? "..." : "");
+	vstream_fflush(VSTREAM_OUT);
+    }
+}
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    VSTRING *data = vstring_alloc(100);
+    VSTRING *rec_buf = vstring_alloc(100);
+    VSTREAM *fp;
+    char   *cp;
+    char   *cmd;
+    char   *type;
+    char   *arg;
+    ssize_t count;
+    ssize_t len;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 2)
+	msg_fatal("usage: %s scratch-file", argv[0]);
+    if ((fp = vstream_fopen(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0600)) == 0)
+	msg_fatal("open %s: %m", argv[1]);
+    (void) unlink(argv[1]);
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	cp = STR(buf);
+	if (*cp == 0 || *cp == '#')
+	    continue;
+	vstream_printf("> %s\n", cp);
+	vstream_fflush(VSTREAM_OUT);
+	if ((cmd = mystrtok(&cp, " \t")) == 0)
+	    continue;
+	type = mystrtok(&cp, " \t");
+	arg = mystrtok(&cp, "");
+	if (strcmp(cmd, "put") == 0 && type != 0 && type[1] == 0) {
+	    vstring_strcpy(data, arg ? arg : "");
+	} else if (strcmp(cmd, "fill") == 0 && type != 0 && type[1] == 0
+		   && arg != 0 && (count = atol(arg)) >= 0) {
+	    VSTRING_RESET(data);
+	    while ((len = VSTRING_LEN(data)) < count)
+		VSTRING_ADDCH(data, '0' + len % 10);
+	    VSTRING_TERMINATE(data);
+	} else if (strcmp(cmd, "read") == 0) {
+	    rec_test_read(fp, rec_buf, type ? atol(type) : 0);
+	    continue;
+	} else {
+	    msg_warn("usage: put type [text] | fill type count | read [maxsize]");
+	    continue;
+	}
+	if (vstream_fseek(fp, (off_t) 0, SEEK_END) < 0)
+	    msg_fatal("seek %s: %m", VSTREAM_PATH(fp));
+	if (REC_PUT_BUF(fp, *type, data) != *type)
+	    msg_fatal("write %s: %m", VSTREAM_PATH(fp));
+    }
+    if (vstream_fclose(fp))
+	msg_fatal("close %s: %m", argv[1]);
+    vstring_free(buf);
+    vstring_free(data);
+    vstring_free(rec_buf);
+    exit(0);
+}
+
+#endif
@@ -433,17 +433,22 @@ int     smtp_get_noexcept(VSTRING *vp, VSTREAM *stream, ssize_t bound, int flags
 
 void    smtp_fputs(const char *cp, ssize_t todo, VSTREAM *stream)
 {
+    struct iovec iov[2];
     int     err;
 
     if (todo < 0)
 	msg_panic("smtp_fputs: negative todo %ld", (long) todo);
 
     /*
-     * Do the I/O, protected against timeout.
+     * Do the I/O, protected against timeout. Send the line and its
+     * terminator together; long lines are not copied into the stream buffer.
      */
     smtp_timeout_reset(stream);
-    err = (vstream_fwrite(stream, cp, todo) != todo
-	   || vstream_fputs("\r\n", stream) == VSTREAM_EOF);
+    iov[0].iov_base = (void *) cp;
+    iov[0].iov_len = todo;
+    iov[1].iov_base = (void *) "\r\n";
+    iov[1].iov_len = 2;
+    err = (vstream_fwritev(stream, iov, 2) != todo + 2);
 
     /*
      * See if there was a problem.
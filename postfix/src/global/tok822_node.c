@@ -25,6 +25,12 @@
 /*
 /*	tok822_free() releases the memory used for the specified token
 /*	and conveniently returns a null pointer value.
+/*
+/*	To avoid one malloc()/free() pair per token, a bounded
+/*	number of released token structures is kept for reuse by
+/*	later tok822_alloc() calls. Token trees are typically created
+/*	and destroyed once per message header or address. Token
+/*	strings are recycled by vstring_alloc(3) itself.
 /* LICENSE
 /* .ad
 /* .fi
@@ -50,6 +56,14 @@
 
 #include "tok822.h"
 
+ /*
+  * Pool with released tokens, linked through the token's next field.
+  */
+#define TOK822_POOL_LIMIT	1024	/* max number of saved tokens */
+
+static TOK822 *tok822_token_pool;
+static int tok822_token_count;
+
 /* tok822_alloc - allocate and initialize token */
 
 TOK822 *tok822_alloc(int type, const char *strval)
@@ -59,7 +73,12 @@ TOK822 *tok822_alloc(int type, const char *strval)
 #define CONTAINER_TOKEN(x) \
 	((x) == TOK822_ADDR || (x) == TOK822_STARTGRP)
 
-    tp = (TOK822 *) mymalloc(sizeof(*tp));
+    if ((tp = tok822_token_pool) != 0) {
+	tok822_token_pool = tp->next;
+	tok822_token_count--;
+    } else {
+	tp = (TOK822 *) mymalloc(sizeof(*tp));
+    }
     tp->type = type;
     tp->next = tp->prev = tp->head = tp->tail = tp->owner = 0;
     tp->vstr = (type < TOK822_MINTOK || CONTAINER_TOKEN(type) ? 0 :
@@ -74,6 +93,12 @@ TOK822 *tok822_free(TOK822 *tp)
 {
     if (tp->vstr)
 	vstring_free(tp->vstr);
-    myfree((void *) tp);
+    if (tok822_token_count < TOK822_POOL_LIMIT) {
+	tp->next = tok822_token_pool;
+	tok822_token_pool = tp;
+	tok822_token_count++;
+    } else {
+	myfree((void *) tp);
+    }
     return (0);
 }
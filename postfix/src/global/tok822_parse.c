@@ -655,9 +655,12 @@ TOK822 *tok822_scan_addr(const char *addr)
 
 #ifdef TEST
 
+#include <stdlib.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <vstream.h>
 #include <readlline.h>
+#include <argv.h>
 
 /* tok822_print - display token */
 
@@ -685,14 +688,62 @@ static void tok822_print(TOK822 *list, int indent)
     }
 }
 
-int     main(int unused_argc, char **unused_argv)
+/* tok822_bench - time repeated parsing of the same input */
+
+static void tok822_bench(int count)
 {
     VSTRING *vp = vstring_alloc(100);
-    TOK822 *list;
     VSTRING *buf = vstring_alloc(100);
+    ARGV   *lines = argv_alloc(10);
+    TOK822 *list;
+    struct timeval start;
+    struct timeval finish;
+    double  elapsed;
+    char  **cpp;
+    int     n;
+
+    /*
+     * Parse, externalize, and destroy each input line, the same way that
+     * cleanup(8) processes an address header.
+     */
+    while (readlline(buf, VSTREAM_IN, (int *) 0))
+	argv_add(lines, vstring_str(buf), ARGV_END);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++) {
+	for (cpp = lines->argv; *cpp; cpp++) {
+	    list = tok822_parse(*cpp);
+	    tok822_externalize(vp, list, TOK822_STR_DEFL);
+	    tok822_free_tree(list);
+	}
+    }
+    GETTIMEOFDAY(&finish);
+    elapsed = (finish.tv_sec - start.tv_sec)
+	+ (finish.tv_usec - start.tv_usec) / 1000000.0;
+    vstream_printf("%ld parses in %.3f seconds (%.0f/s)\n",
+		   (long) count * lines->argc, elapsed,
+		   elapsed > 0 ? count * lines->argc / elapsed : 0);
+    vstream_fflush(VSTREAM_OUT);
+    argv_free(lines);
+    vstring_free(vp);
+    vstring_free(buf);
+}
+
+int     main(int argc, char **argv)
+{
+    VSTRING *vp;
+    TOK822 *list;
+    VSTRING *buf;
 
 #define TEST_TOKEN_LIMIT 20
 
+    if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+	tok822_bench(atoi(argv[2]));
+	return (0);
+    } else if (argc != 1) {
+	msg_fatal("usage: %s [-b iterations]", argv[0]);
+    }
+    vp = vstring_alloc(100);
+    buf = vstring_alloc(100);
     while (readlline(buf, VSTREAM_IN, (int *) 0)) {
 	while (VSTRING_LEN(buf) > 0 && vstring_end(buf)[-1] == '\n') {
 	    vstring_end(buf)[-1] = 0;
@@ -39,6 +39,9 @@
 /*
 /*	uxtext_unquote_append() is like uxtext_unquote(), but appends
 /*	the conversion result to the result buffer.
+/*
+/*	All functions copy runs of characters that need no conversion
+/*	with one operation.
 /* BUGS
 /*	This module cannot process null characters in data.
 /* LICENSE
@@ -76,19 +79,28 @@
 #define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
+static const char hex_chars[] = "0123456789ABCDEF";
+
+#define NEEDS_QUOTE(ch, special) \
+	((ch) == '\\' || (ch) <= 32 || (ch) >= 127 \
+	 || (*(special) != 0 && strchr((special), (ch)) != 0))
+
 /* uxtext_quote_append - append unquoted data to quoted data */
 
 VSTRING *uxtext_quote_append(VSTRING *quoted, const char *unquoted,
 			             const char *special)
 {
     unsigned const char *cp;
+    unsigned const char *start;
     int     ch;
 
     for (cp = (unsigned const char *) unquoted; (ch = *cp) != 0; cp++) {
 	/* Fix 20140709: the '\' character must always be quoted. */
-	if (ch != '\\' && ch > 32 && ch < 127
-	    && (*special == 0 || strchr(special, ch) == 0)) {
-	    VSTRING_ADDCH(quoted, ch);
+	if (!NEEDS_QUOTE(ch, special)) {
+	    for (start = cp; (ch = cp[1]) != 0
+		 && !NEEDS_QUOTE(ch, special); cp++)
+		 /* void */ ;
+	    vstring_memcat(quoted, (const char *) start, cp + 1 - start);
 	} else {
 
 	    /*
@@ -131,7 +143,14 @@ VSTRING *uxtext_quote_append(VSTRING *quoted, const char *unquoted,
 		unicode = unicode << 6 | (ch & 0x3f);
 		pick--;
 	    }
-	    vstring_sprintf_append(quoted, "\\x{%02X}", unicode);
+	    if (unicode < 0x100) {
+		vstring_strcat(quoted, "\\x{");
+		VSTRING_ADDCH(quoted, hex_chars[unicode >> 4]);
+		VSTRING_ADDCH(quoted, hex_chars[unicode & 0xf]);
+		VSTRING_ADDCH(quoted, '}');
+	    } else {
+		vstring_sprintf_append(quoted, "\\x{%02X}", unicode);
+	    }
 	}
     }
     VSTRING_TERMINATE(quoted);
@@ -152,10 +171,19 @@ VSTRING *uxtext_quote(VSTRING *quoted, const char *unquoted, const char *special
 VSTRING *uxtext_unquote_append(VSTRING *unquoted, const char *quoted)
 {
     const unsigned char *cp;
+    const unsigned char *next;
     int     ch;
 
     for (cp = (const unsigned char *) quoted; (ch = *cp) != 0; cp++) {
-	if (ch == '\\' && cp[1] == 'x' && cp[2] == '{') {
+	if (ch != '\\') {
+	    next = (const unsigned char *) strchr((const char *) cp, '\\');
+	    if (next == 0) {
+		vstring_strcat(unquoted, (const char *) cp);
+		break;
+	    }
+	    vstring_memcat(unquoted, (const char *) cp, next - cp);
+	    cp = next - 1;
+	} else if (cp[1] == 'x' && cp[2] == '{') {
 	    int     unicode = 0;
 
 	    cp += 2;
@@ -256,6 +284,16 @@ int     main(int unused_argc, char **unused_argv)
     if (uxtext_unquote(unquoted, "\\x{33") != 0)
 	msg_warn("undetected error pattern 3");
 
+    /*
+     * Known answers.
+     */
+    if (strcmp(STR(uxtext_quote(quoted, "a\\b \303\251\342\202\254", "")),
+	       "a\\x{5C}b\\x{20}\\x{E9}\\x{20AC}") != 0)
+	msg_fatal("bad quote result: %s", STR(quoted));
+    if (uxtext_unquote(unquoted, "a\\b\\x{e9}\\x{20ac}") == 0
+	|| strcmp(STR(unquoted), "a\\b\303\251\342\202\254") != 0)
+	msg_fatal("bad unquote result");
+
     /*
      * Positive tests.
      */
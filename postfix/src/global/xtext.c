@@ -38,6 +38,9 @@
 /*
 /*	xtext_unquote_append() is like xtext_unquote(), but appends
 /*	the conversion result to the result buffer.
+/*
+/*	All functions copy runs of characters that need no conversion
+/*	with one operation.
 /* BUGS
 /*	This module cannot process null characters in data.
 /* LICENSE
@@ -73,20 +76,32 @@
 #define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
+static const char hex_chars[] = "0123456789ABCDEF";
+
+#define NEEDS_QUOTE(ch, special) \
+	((ch) == '+' || (ch) <= 32 || (ch) >= 127 \
+	 || (*(special) != 0 && strchr((special), (ch)) != 0))
+
 /* xtext_quote_append - append unquoted data to quoted data */
 
 VSTRING *xtext_quote_append(VSTRING *quoted, const char *unquoted,
 			            const char *special)
 {
     const char *cp;
+    const char *start;
     int     ch;
 
-    for (cp = unquoted; (ch = *(unsigned const char *) cp) != 0; cp++) {
-	if (ch != '+' && ch > 32 && ch < 127
-	    && (*special == 0 || strchr(special, ch) == 0)) {
-	    VSTRING_ADDCH(quoted, ch);
+    for (cp = unquoted; (ch = *(unsigned const char *) cp) != 0; /* void */ ) {
+	if (NEEDS_QUOTE(ch, special)) {
+	    VSTRING_ADDCH(quoted, '+');
+	    VSTRING_ADDCH(quoted, hex_chars[ch >> 4]);
+	    VSTRING_ADDCH(quoted, hex_chars[ch & 0xf]);
+	    cp++;
 	} else {
-	    vstring_sprintf_append(quoted, "+%02X", ch);
+	    for (start = cp++; (ch = *(unsigned const char *) cp) != 0
+		 && !NEEDS_QUOTE(ch, special); cp++)
+		 /* void */ ;
+	    vstring_memcat(quoted, start, cp - start);
 	}
     }
     VSTRING_TERMINATE(quoted);
@@ -106,29 +121,33 @@ VSTRING *xtext_quote(VSTRING *quoted, const char *unquoted, const char *special)
 
 VSTRING *xtext_unquote_append(VSTRING *unquoted, const char *quoted)
 {
-    const unsigned char *cp;
+    const char *cp;
+    const char *next;
     int     ch;
 
-    for (cp = (const unsigned char *) quoted; (ch = *cp) != 0; cp++) {
-	if (ch == '+') {
-	    if (ISDIGIT(cp[1]))
-		ch = (cp[1] - '0') << 4;
-	    else if (cp[1] >= 'a' && cp[1] <= 'f')
-		ch = (cp[1] - 'a' + 10) << 4;
-	    else if (cp[1] >= 'A' && cp[1] <= 'F')
-		ch = (cp[1] - 'A' + 10) << 4;
-	    else
-		return (0);
-	    if (ISDIGIT(cp[2]))
-		ch |= (cp[2] - '0');
-	    else if (cp[2] >= 'a' && cp[2] <= 'f')
-		ch |= (cp[2] - 'a' + 10);
-	    else if (cp[2] >= 'A' && cp[2] <= 'F')
-		ch |= (cp[2] - 'A' + 10);
-	    else
-		return (0);
-	    cp += 2;
+    for (cp = quoted; *cp != 0; cp += 3) {
+	if ((next = strchr(cp, '+')) == 0) {
+	    vstring_strcat(unquoted, cp);
+	    break;
 	}
+	vstring_memcat(unquoted, cp, next - cp);
+	cp = next;
+	if (ISDIGIT(cp[1]))
+	    ch = (cp[1] - '0') << 4;
+	else if (cp[1] >= 'a' && cp[1] <= 'f')
+	    ch = (cp[1] - 'a' + 10) << 4;
+	else if (cp[1] >= 'A' && cp[1] <= 'F')
+	    ch = (cp[1] - 'A' + 10) << 4;
+	else
+	    return (0);
+	if (ISDIGIT(cp[2]))
+	    ch |= (cp[2] - '0');
+	else if (cp[2] >= 'a' && cp[2] <= 'f')
+	    ch |= (cp[2] - 'a' + 10);
+	else if (cp[2] >= 'A' && cp[2] <= 'F')
+	    ch |= (cp[2] - 'A' + 10);
+	else
+	    return (0);
 	VSTRING_ADDCH(unquoted, ch);
     }
     VSTRING_TERMINATE(unquoted);
@@ -174,6 +193,16 @@ int     main(int unused_argc, char **unused_argv)
     if (xtext_unquote(unquoted, "+2+") != 0)
 	msg_warn("undetected error pattern 2");
 
+    /*
+     * Known answers.
+     */
+    if (strcmp(STR(xtext_quote(quoted, "a+b=c d\001", "+=")),
+	       "a+2Bb+3Dc+20d+01") != 0)
+	msg_fatal("bad quote result: %s", STR(quoted));
+    if (xtext_unquote(unquoted, "a+2bB+3D") == 0
+	|| strcmp(STR(unquoted), "a+B=") != 0)
+	msg_fatal("bad unquote result");
+
     /*
      * Positive tests.
      */
@@ -33,7 +33,8 @@
 /*	data read from the datagram port; this data corresponds to
 /*	request.  The len argument specifies how much client data
 /*	is available.  The maximal size of the buffer is specified
-/*	via the DGRAM_BUF_SIZE manifest constant.  The service name
+/*	via the DGRAM_BUF_SIZE manifest constant; the data is
+/*	followed by a null byte.  The service name
 /*	argument corresponds to the service name in the master.cf
 /*	file.  The argv argument specifies command-line arguments
 /*	left over after options processing.
@@ -258,7 +259,7 @@ static void dgram_server_timeout(int unused_event, void *unused_context)
 
 static void dgram_server_wakeup(int fd)
 {
-    char    buf[DGRAM_BUF_SIZE];
+    char    buf[DGRAM_BUF_SIZE + 1];
     ssize_t len;
 
     /*
@@ -269,8 +270,10 @@ static void dgram_server_wakeup(int fd)
 	 /* void */ ;
     if (dgram_server_in_flow_delay && mail_flow_get(1) < 0)
 	doze(var_in_flow_delay * 1000000);
-    if ((len = recv(fd, buf, sizeof(buf), 0)) >= 0)
+    if ((len = recv(fd, buf, DGRAM_BUF_SIZE, 0)) >= 0) {
+	buf[len] = 0;
 	dgram_server_service(buf, len, dgram_server_name, dgram_server_argv);
+    }
     if (master_notify(var_pid, dgram_server_generation, MASTER_STAT_AVAIL) < 0)
 	dgram_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
     if (var_idle_limit > 0)
@@ -215,6 +215,7 @@
 /* Utility library. */
 
 #include <msg.h>
+#include <msg_logger.h>
 #include <msg_vstream.h>
 #include <chroot_uid.h>
 #include <listen.h>
@@ -712,7 +713,7 @@ NORETURN event_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
      * non-default program name or logging destination.
      */
     mail_params_init();
-    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_NONE);
+    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_BATCH);
 
     /*
      * Register higher-level dictionaries and initialize the support for
@@ -954,6 +955,8 @@ NORETURN event_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
      * The event loop, at last.
      */
     while (var_use_limit == 0 || use_count < var_use_limit || client_count > 0) {
+	/* Don't sit on batched log records while we wait for work. */
+	msg_logger_flush();
 	if (event_server_lock != 0) {
 	    watchdog_stop(watchdog);
 	    if (myflock(vstream_fileno(event_server_lock), INTERNAL_LOCK,
@@ -962,6 +965,7 @@ NORETURN event_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
 	}
 	watchdog_start(watchdog);
 	delay = loop ? loop(event_server_name, event_server_argv) : -1;
+	msg_logger_flush();
 	event_loop(delay);
     }
     event_server_exit();
@@ -136,6 +136,10 @@ extern NORETURN trigger_server_main(int, char **, TRIGGER_SERVER_FN,...);
 typedef void (*DGRAM_SERVER_FN) (char *, ssize_t, char *, char **);
 extern NORETURN dgram_server_main(int, char **, DGRAM_SERVER_FN,...);
 
+ /*
+  * Must not be smaller than MSG_LOGGER_BATCH_LIMIT, the largest batch of
+  * msg_logger(3) records.
+  */
 #define DGRAM_BUF_SIZE	4096
 
 /* LICENSE
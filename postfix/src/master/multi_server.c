@@ -140,6 +140,14 @@
 /*	multi_server_disconnect() should be called by the application
 /*	to close a client connection.
 /*
+/*	When a client sends requests without waiting for replies,
+/*	the service routine is called again while the client stream
+/*	buffer contains unprocessed input, because there will be no
+/*	read event for that input. After a few requests, the remainder
+/*	is serviced after other clients have had their turn. Client
+/*	streams are double-buffered, so that sending a reply does
+/*	not discard those requests.
+/*
 /*	multi_server_drain() should be called when the application
 /*	no longer wishes to accept new client connections. Existing
 /*	clients are handled in a background process, and the process
@@ -203,6 +211,7 @@
 /* Utility library. */
 
 #include <msg.h>
+#include <msg_logger.h>
 #include <msg_vstream.h>
 #include <chroot_uid.h>
 #include <listen.h>
@@ -260,6 +269,13 @@ static VSTREAM *multi_server_lock;
 static int multi_server_in_flow_delay;
 static unsigned multi_server_generation;
 static void (*multi_server_pre_disconn) (VSTREAM *, char *, char **);
+static VSTREAM *multi_server_curr_stream;	/* stream being serviced */
+
+ /*
+  * The number of buffered pipelined requests that we service before giving
+  * other clients a chance.
+  */
+#define MULTI_SERVER_PIPELINE_LIMIT	10
 
 /* multi_server_exit - normal termination */
 
@@ -318,15 +334,21 @@ int     multi_server_drain(void)
     }
 }
 
+static void multi_server_execute(int, void *);
+static void multi_server_enable_read(int, void *);
+
 /* multi_server_disconnect - terminate client session */
 
 void    multi_server_disconnect(VSTREAM *stream)
 {
     if (msg_verbose)
 	msg_info("connection closed fd %d", vstream_fileno(stream));
+    if (stream == multi_server_curr_stream)
+	multi_server_curr_stream = 0;
     if (multi_server_pre_disconn)
 	multi_server_pre_disconn(stream, multi_server_name, multi_server_argv);
     event_disable_readwrite(vstream_fileno(stream));
+    event_cancel_timer(multi_server_execute, (void *) stream);
     (void) vstream_fclose(stream);
     client_count--;
     /* Avoid integer wrap-around in a persistent process.  */
@@ -338,9 +360,10 @@ void    multi_server_disconnect(VSTREAM *stream)
 
 /* multi_server_execute - in case (char *) != (struct *) */
 
-static void multi_server_execute(int unused_event, void *context)
+static void multi_server_execute(int event, void *context)
 {
     VSTREAM *stream = (VSTREAM *) context;
+    int     count = 0;
 
     if (multi_server_lock != 0
 	&& myflock(vstream_fileno(multi_server_lock), INTERNAL_LOCK,
@@ -352,10 +375,33 @@ static void multi_server_execute(int unused_event, void *context)
      * the already accepted client request after "postfix reload"; that would
      * be rude.
      */
-    if (peekfd(vstream_fileno(stream)) > 0) {
+    if (vstream_peek(stream) > 0 || peekfd(vstream_fileno(stream)) > 0) {
 	if (master_notify(var_pid, multi_server_generation, MASTER_STAT_TAKEN) < 0)
 	     /* void */ ;
-	multi_server_service(stream, multi_server_name, multi_server_argv);
+
+	/*
+	 * Service pipelined requests that are already in the stream buffer,
+	 * because there will be no read event for them. The service routine
+	 * may have disconnected the stream. Don't let one client hog the
+	 * server: after a few requests, come back for the remainder after
+	 * other clients have had their turn. Meanwhile, suspend read events,
+	 * so that a stale read event can't make us mistake an empty socket
+	 * for a client disconnect.
+	 */
+	multi_server_curr_stream = stream;
+	do {
+	    multi_server_service(stream, multi_server_name, multi_server_argv);
+	} while (multi_server_curr_stream == stream && vstream_peek(stream) > 0
+		 && ++count < MULTI_SERVER_PIPELINE_LIMIT);
+	if (multi_server_curr_stream == stream) {
+	    if (vstream_peek(stream) > 0) {
+		event_disable_readwrite(vstream_fileno(stream));
+		event_request_timer(multi_server_execute, (void *) stream, 0);
+	    } else if (event == EVENT_TIME) {
+		multi_server_enable_read(0, (void *) stream);
+	    }
+	}
+	multi_server_curr_stream = 0;
 	if (master_notify(var_pid, multi_server_generation, MASTER_STAT_AVAIL) < 0)
 	    multi_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
     } else {
@@ -405,6 +451,7 @@ static void multi_server_wakeup(int fd, HTABLE *attr)
     tmp = concatenate(multi_server_name, " socket", (char *) 0);
     vstream_control(stream,
 		    CA_VSTREAM_CTL_PATH(tmp),
+		    CA_VSTREAM_CTL_DOUBLE,
 		    CA_VSTREAM_CTL_END);
     myfree(tmp);
     timed_ipc_setup(stream);
@@ -690,7 +737,7 @@ NORETURN multi_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
      * non-default program name or logging destination.
      */
     mail_params_init();
-    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_NONE);
+    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_BATCH);
 
     /*
      * Register higher-level dictionaries and initialize the support for
@@ -917,6 +964,8 @@ NORETURN multi_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
      * The event loop, at last.
      */
     while (var_use_limit == 0 || use_count < var_use_limit || client_count > 0) {
+	/* Don't sit on batched log records while we wait for work. */
+	msg_logger_flush();
 	if (multi_server_lock != 0) {
 	    watchdog_stop(watchdog);
 	    if (myflock(vstream_fileno(multi_server_lock), INTERNAL_LOCK,
@@ -925,6 +974,7 @@ NORETURN multi_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
 	}
 	watchdog_start(watchdog);
 	delay = loop ? loop(multi_server_name, multi_server_argv) : -1;
+	msg_logger_flush();
 	event_loop(delay);
     }
     multi_server_exit();
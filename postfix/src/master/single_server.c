@@ -181,6 +181,7 @@
 /* Utility library. */
 
 #include <msg.h>
+#include <msg_logger.h>
 #include <msg_vstream.h>
 #include <chroot_uid.h>
 #include <vstring.h>
@@ -583,7 +584,7 @@ NORETURN single_server_main(int argc, char **argv, SINGLE_SERVER_FN service,...)
      * Initialize generic parameters.
      */
     mail_params_init();
-    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_NONE);
+    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_BATCH);
 
     /*
      * Register higher-level dictionaries and initialize the support for
@@ -808,6 +809,8 @@ NORETURN single_server_main(int argc, char **argv, SINGLE_SERVER_FN service,...)
      * The event loop, at last.
      */
     while (var_use_limit == 0 || use_count < var_use_limit) {
+	/* Don't sit on batched log records while we wait for work. */
+	msg_logger_flush();
 	if (single_server_lock != 0) {
 	    watchdog_stop(watchdog);
 	    if (myflock(vstream_fileno(single_server_lock), INTERNAL_LOCK,
@@ -816,6 +819,7 @@ NORETURN single_server_main(int argc, char **argv, SINGLE_SERVER_FN service,...)
 	}
 	watchdog_start(watchdog);
 	delay = loop ? loop(single_server_name, single_server_argv) : -1;
+	msg_logger_flush();
 	event_loop(delay);
     }
     single_server_exit();
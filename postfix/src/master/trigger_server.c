@@ -184,6 +184,7 @@
 /* Utility library. */
 
 #include <msg.h>
+#include <msg_logger.h>
 #include <msg_vstream.h>
 #include <chroot_uid.h>
 #include <vstring.h>
@@ -566,7 +567,7 @@ NORETURN trigger_server_main(int argc, char **argv, TRIGGER_SERVER_FN service,..
      * non-default program name or logging destination.
      */
     mail_params_init();
-    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_NONE);
+    maillog_client_init(mail_task(var_procname), MAILLOG_CLIENT_FLAG_BATCH);
 
     /*
      * Register higher-level dictionaries and initialize the support for
@@ -795,6 +796,8 @@ NORETURN trigger_server_main(int argc, char **argv, TRIGGER_SERVER_FN service,..
      * The event loop, at last.
      */
     while (var_use_limit == 0 || use_count < var_use_limit) {
+	/* Don't sit on batched log records while we wait for work. */
+	msg_logger_flush();
 	if (trigger_server_lock != 0) {
 	    watchdog_stop(watchdog);
 	    if (myflock(vstream_fileno(trigger_server_lock), INTERNAL_LOCK,
@@ -803,6 +806,7 @@ NORETURN trigger_server_main(int argc, char **argv, TRIGGER_SERVER_FN service,..
 	}
 	watchdog_start(watchdog);
 	delay = loop ? loop(trigger_server_name, trigger_server_argv) : -1;
+	msg_logger_flush();
 	event_loop(delay);
     }
     trigger_server_exit();
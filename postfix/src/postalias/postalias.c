@@ -133,6 +133,10 @@
 /*	A table that reliably fails all requests. The lookup table
 /*	name is used for logging only. This table exists to simplify
 /*	Postfix error tests.
+/* .IP \fBmph\fR
+/*	The output is one file named \fIfile_name\fB.mph\fR.
+/*	This is a minimal perfect hash file, available with Postfix
+/*	3.6 and later.
 /* .IP \fBsdbm\fR
 /*	The output consists of two files, named \fIfile_name\fB.pag\fR and
 /*	\fIfile_name\fB.dir\fR.
@@ -238,6 +238,17 @@
 /* .IP \fBbtree\fR
 /*	A sorted, balanced tree structure.  Available on systems
 /*	with support for Berkeley DB databases.
+/* .IP "\fBcachemap\fR (read-only)"
+/*	A table that remembers recent lookup results of another
+/*	table in process memory. Example:
+/*	"\fBcachemap:{\fItype:name\fB, size=\fIcount\fB,
+/*	ttl=\fIseconds\fB, negative_ttl=\fIseconds\fB}\fR".
+/*	The optional settings specify the maximal number of results
+/*	(default: 1000), and how long to remember a found result
+/*	(default: 300) and a not-found result (default: 60). Lookup
+/*	errors are not remembered.
+/*
+/*	This feature is available with Postfix 3.6 and later.
 /* .IP \fBcdb\fR
 /*	A read-optimized structure with no support for incremental
 /*	updates.  Available on systems with support for CDB databases.
@@ -292,6 +303,12 @@
 /*	\fBmemcache_table\fR(5).
 /*
 /*	This feature is available with Postfix 2.9 and later.
+/* .IP "\fBmph\fR"
+/*	A read-optimized minimal perfect hash file, with no support
+/*	for incremental updates. The file is memory-mapped, and a
+/*	lookup compares only one key.
+/*
+/*	This feature is available with Postfix 3.6 and later.
 /* .IP "\fBmysql\fR (read-only)"
 /*	MySQL database client.  Available on systems with support
 /*	for MySQL databases.  This is described in \fBmysql_table\fR(5).
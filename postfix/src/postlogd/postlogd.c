@@ -56,6 +56,11 @@
 /* .IP "\fBpostlogd_watchdog_timeout (10s)\fR"
 /*	How much time a \fBpostlogd\fR(8) process may take to process a request
 /*	before it is terminated by a built-in watchdog timer.
+/* .PP
+/*	Available in Postfix 3.6 and later:
+/* .IP "\fBmaillog_batch_size (0)\fR"
+/*	The maximal size of a batch of records that a Postfix daemon
+/*	process sends to the \fBpostlogd\fR(8) service.
 /* SEE ALSO
 /*	postconf(5), configuration parameters
 /*	syslogd(8), system logging
@@ -86,10 +91,12 @@
   * System library.
   */
 #include <sys_defs.h>
+#include <string.h>
 
  /*
   * Utility library.
   */
+#include <events.h>
 #include <logwriter.h>
 #include <msg.h>
 #include <msg_logger.h>
@@ -121,10 +128,12 @@ int     var_postlogd_watchdog;
 #define LEN(x)			VSTRING_LEN(x)
 
  /*
-  * Logfile stream.
+  * Logfile stream. With batching, buffer appends in a larger buffer.
   */
 static VSTREAM *postlogd_stream = 0;
 
+#define POSTLOGD_BUFSIZE	65536
+
 /* postlogd_fallback - log messages from postlogd(8) itself */
 
 static void postlogd_fallback(const char *buf)
@@ -132,50 +141,94 @@ static void postlogd_fallback(const char *buf)
     (void) logwriter_write(postlogd_stream, buf, strlen(buf));
 }
 
+/* postlogd_flush - write buffered logfile records */
+
+static void postlogd_flush(int unused_event, void *unused_context)
+{
+    (void) vstream_fflush(postlogd_stream);
+}
+
+/* postlogd_exit - write buffered logfile records before exit */
+
+static void postlogd_exit(char *unused_service, char **unused_argv)
+{
+    if (postlogd_stream)
+	(void) vstream_fflush(postlogd_stream);
+}
+
+/* postlogd_proxy - redirect one record to the current logging mechanism */
+
+static void postlogd_proxy(char *buf, ssize_t len)
+{
+    char   *bp = buf;
+    char   *progname_pid;
+
+    /*
+     * Avoid surprises: strip off the date, time, host, and program[pid]:
+     * prefix that were prepended by msg_logger(3). Then, hope that the
+     * current logging driver suppresses its own PID, when it sees that there
+     * is a PID embedded in the 'program name'.
+     */
+    (void) mystrtok(&bp, CHARS_SPACE);		/* month */
+    (void) mystrtok(&bp, CHARS_SPACE);		/* day */
+    (void) mystrtok(&bp, CHARS_SPACE);		/* time */
+    (void) mystrtok(&bp, CHARS_SPACE);		/* host */
+    progname_pid = mystrtok(&bp, ":" CHARS_SPACE);	/* name[pid] sans ':' */
+    bp += strspn(bp, CHARS_SPACE);
+    if (progname_pid)
+	maillog_client_init(progname_pid, MAILLOG_CLIENT_FLAG_NONE);
+    msg_info("%.*s", (int) (len - (bp - buf)), bp);
+
+    /*
+     * Restore the program name, in case postlogd(8) needs to log something
+     * about itself. We have to call maillog_client_init() in any case,
+     * because neither msg_syslog_init() nor openlog() make a copy of the
+     * name argument. We can't leave that pointing into the middle of the
+     * above message buffer.
+     */
+    maillog_client_init(mail_task((char *) 0), MAILLOG_CLIENT_FLAG_NONE);
+}
+
 /* postlogd_service - perform service for client */
 
 static void postlogd_service(char *buf, ssize_t len, char *unused_service,
 			             char **unused_argv)
 {
+    char   *start;
+    char   *end;
 
+    /*
+     * A datagram contains one record, or a newline-separated batch of
+     * records. A batch can be appended to the logfile as is.
+     * 
+     * With batching enabled, leave records in the logfile stream buffer, and
+     * write them when the buffer fills up, or when the oldest record has
+     * waited for about a second.
+     */
     if (postlogd_stream) {
-	(void) logwriter_write(postlogd_stream, buf, len);
+	if (var_maillog_batch_size > 0) {
+	    if (vstream_bufstat(postlogd_stream, VSTREAM_BST_OUT_PEND) == 0)
+		event_request_timer(postlogd_flush, (void *) 0, 1);
+	    (void) logwriter_append(postlogd_stream, buf, len);
+	} else {
+	    (void) logwriter_write(postlogd_stream, buf, len);
+	}
     }
 
     /*
      * After a configuration change that removes the maillog_file pathname,
      * this service may still receive messages (after "postfix reload" or
      * after process refresh) from programs that use the old maillog_file
-     * setting. Redirect those messages to the current logging mechanism.
+     * setting. Redirect those messages to the current logging mechanism,
+     * one record at a time.
      */
     else {
-	char   *bp = buf;
-	char   *progname_pid;
-
-	/*
-	 * Avoid surprises: strip off the date, time, host, and program[pid]:
-	 * prefix that were prepended by msg_logger(3). Then, hope that the
-	 * current logging driver suppresses its own PID, when it sees that
-	 * there is a PID embedded in the 'program name'.
-	 */
-	(void) mystrtok(&bp, CHARS_SPACE);	/* month */
-	(void) mystrtok(&bp, CHARS_SPACE);	/* day */
-	(void) mystrtok(&bp, CHARS_SPACE);	/* time */
-	(void) mystrtok(&bp, CHARS_SPACE);	/* host */
-	progname_pid = mystrtok(&bp, ":" CHARS_SPACE);	/* name[pid] sans ':' */
-	bp += strspn(bp, CHARS_SPACE);
-	if (progname_pid)
-	    maillog_client_init(progname_pid, MAILLOG_CLIENT_FLAG_NONE);
-	msg_info("%.*s", (int) (len - (bp - buf)), bp);
-
-	/*
-	 * Restore the program name, in case postlogd(8) needs to log
-	 * something about itself. We have to call maillog_client_init() in
-	 * any case, because neither msg_syslog_init() nor openlog() make a
-	 * copy of the name argument. We can't leave that pointing into the
-	 * middle of the above message buffer.
-	 */
-	maillog_client_init(mail_task((char *) 0), MAILLOG_CLIENT_FLAG_NONE);
+	for (start = buf; start < buf + len; start = end + 1) {
+	    if ((end = memchr(start, '\n', buf + len - start)) == 0)
+		end = buf + len;
+	    *end = 0;
+	    postlogd_proxy(start, end - start);
+	}
     }
 }
 
@@ -210,6 +263,10 @@ static void pre_jail_init(char *unused_service_name, char **argv)
 	 * Instantiate the logwriter or bust.
 	 */
 	postlogd_stream = logwriter_open_or_die(var_maillog_file);
+	if (var_maillog_batch_size > 0)
+	    vstream_control(postlogd_stream,
+			    CA_VSTREAM_CTL_BUFSIZE((ssize_t) POSTLOGD_BUFSIZE),
+			    CA_VSTREAM_CTL_END);
 
 	/*
 	 * Inform the msg_logger client to stop using the postlog socket, and
@@ -261,6 +318,7 @@ int     main(int argc, char **argv)
 		      CA_MAIL_SERVER_TIME_TABLE(time_table),
 		      CA_MAIL_SERVER_PRE_INIT(pre_jail_init),
 		      CA_MAIL_SERVER_POST_INIT(post_jail_init),
+		      CA_MAIL_SERVER_EXIT(postlogd_exit),
 		      CA_MAIL_SERVER_SOLITARY,
 		      CA_MAIL_SERVER_WATCHDOG(&var_postlogd_watchdog),
 		      0);
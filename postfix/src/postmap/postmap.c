@@ -217,6 +217,10 @@
 /*	A table that reliably fails all requests. The lookup table
 /*	name is used for logging only. This table exists to simplify
 /*	Postfix error tests.
+/* .IP \fBmph\fR
+/*	The output consists of one file, named \fIfile_name\fB.mph\fR.
+/*	This is a minimal perfect hash file, available with Postfix
+/*	3.6 and later.
 /* .IP \fBsdbm\fR
 /*	The output consists of two files, named \fIfile_name\fB.pag\fR and
 /*	\fIfile_name\fB.dir\fR.
@@ -329,6 +333,10 @@
 #include <set_eugid.h>
 #include <warn_stat.h>
 #include <clean_env.h>
+#include <extsort.h>
+#include <dict_db.h>
+#include <dict_lmdb.h>
+#include <dict_thash.h>
 
 /* Global library. */
 
@@ -372,6 +380,78 @@ typedef struct {
     int     found;			/* result */
 } POSTMAP_KEY_STATE;
 
+/* postmap_append - store one entry */
+
+static void postmap_append(MKMAP *mkmap, const char *key, const char *value)
+{
+
+    /*
+     * Store the value under a (possibly case-insensitive) key, as specified
+     * with open_flags.
+     */
+    mkmap_append(mkmap, key, value);
+    if (mkmap->dict->error)
+	msg_fatal("table %s:%s: write error: %m",
+		  mkmap->dict->type, mkmap->dict->name);
+}
+
+/* postmap_load - parse source file, store or sort entries */
+
+static void postmap_load(MKMAP *mkmap, VSTREAM *source_fp, int dict_flags,
+			         VSTRING *line_buffer, EXTSORT *sort)
+{
+    VSTRING *fold_buf = 0;
+    int     lineno;
+    int     last_line;
+    char   *key;
+    char   *value;
+
+    /*
+     * Add records to the database.
+     */
+    last_line = 0;
+    while (readllines(line_buffer, source_fp, &last_line, &lineno)) {
+	if (dict_thash_parse(mkmap->dict, VSTREAM_PATH(source_fp), lineno,
+			     line_buffer, &key, &value) == 0)
+	    continue;
+
+	/*
+	 * Optionally treat the vale as a filename, and replace the value
+	 * with the BASE64-encoded content of the named file.
+	 */
+	if (dict_flags & DICT_FLAG_SRC_RHS_IS_FILE) {
+	    VSTRING *base64_buf;
+	    char   *err;
+
+	    if ((base64_buf = dict_file_to_b64(mkmap->dict, value)) == 0) {
+		err = dict_file_get_error(mkmap->dict);
+		msg_warn("%s, line %d: %s: skipping this entry",
+			 VSTREAM_PATH(source_fp), lineno, err);
+		myfree(err);
+		continue;
+	    }
+	    value = vstring_str(base64_buf);
+	}
+
+	/*
+	 * Store the entry now, or sort it by the key that the database will
+	 * use.
+	 */
+	if (sort == 0) {
+	    postmap_append(mkmap, key, value);
+	} else {
+	    if (mkmap->dict->flags & DICT_FLAG_FOLD_FIX) {
+		if (fold_buf == 0)
+		    fold_buf = vstring_alloc(100);
+		key = casefold(fold_buf, key);
+	    }
+	    extsort_add(sort, key, value);
+	}
+    }
+    if (fold_buf)
+	vstring_free(fold_buf);
+}
+
 /* postmap - create or update mapping database */
 
 static void postmap(char *map_type, char *path_name, int postmap_flags,
@@ -380,10 +460,11 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     VSTREAM *NOCLOBBER source_fp;
     VSTRING *line_buffer;
     MKMAP  *mkmap;
-    int     lineno;
-    int     last_line;
-    char   *key;
-    char   *value;
+    EXTSORT *sort = 0;
+    char   *sort_prefix;
+    const char *key;
+    const char *value;
+    int     how;
     struct stat st;
     mode_t  saved_mask;
 
@@ -434,6 +515,21 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     if ((postmap_flags & POSTMAP_FLAG_SAVE_PERM) && S_ISREG(st.st_mode))
 	umask(saved_mask);
 
+    /*
+     * With a B-tree database, inserting keys in sorted order fills pages
+     * completely, and with LMDB it avoids a tree search per key. Sort the
+     * input first, using temporary files next to the source file when the
+     * input does not fit in memory.
+     */
+    if ((open_flags & O_TRUNC) && var_postmap_sort_buf > 0
+	&& (strcmp(map_type, DICT_TYPE_LMDB) == 0
+	    || strcmp(map_type, DICT_TYPE_BTREE) == 0)) {
+	sort_prefix = concatenate(path_name, ".sort", (char *) 0);
+	sort = extsort_create(sort_prefix, var_postmap_sort_buf);
+	myfree(sort_prefix);
+	postmap_load(mkmap, source_fp, dict_flags, line_buffer, sort);
+    }
+
     /*
      * Trap "exceptions" so that we can restart a bulk-mode update after a
      * recoverable error.
@@ -441,103 +537,18 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     for (;;) {
 	if (dict_isjmp(mkmap->dict) != 0
 	    && dict_setjmp(mkmap->dict) != 0
+	    && sort == 0
 	    && vstream_fseek(source_fp, SEEK_SET, 0) < 0)
 	    msg_fatal("seek %s: %m", VSTREAM_PATH(source_fp));
 
-	/*
-	 * Add records to the database. XXX This duplicates the parser in
-	 * dict_thash.c.
-	 */
-	last_line = 0;
-	while (readllines(line_buffer, source_fp, &last_line, &lineno)) {
-	    int     in_quotes = 0;
-
-	    /*
-	     * First some UTF-8 checks sans casefolding.
-	     */
-	    if ((mkmap->dict->flags & DICT_FLAG_UTF8_ACTIVE)
-		&& !allascii(STR(line_buffer))
-		&& !valid_utf8_string(STR(line_buffer), LEN(line_buffer))) {
-		msg_warn("%s, line %d: non-UTF-8 input \"%s\""
-			 " -- ignoring this line",
-			 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
-		continue;
-	    }
-
-	    /*
-	     * Terminate the key on the first unquoted whitespace character,
-	     * then trim leading and trailing whitespace from the value.
-	     */
-	    for (value = STR(line_buffer); *value; value++) {
-		if (*value == '\\') {
-		    if (*++value == 0)
-			break;
-		} else if (ISSPACE(*value)) {
-		    if (!in_quotes)
-			break;
-		} else if (*value == '"') {
-		    in_quotes = !in_quotes;
-		}
-	    }
-	    if (in_quotes) {
-		msg_warn("%s, line %d: unbalanced '\"' in '%s'"
-			 " -- ignoring this line",
-			 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
-		continue;
-	    }
-	    if (*value)
-		*value++ = 0;
-	    while (ISSPACE(*value))
-		value++;
-	    trimblanks(value, 0)[0] = 0;
-
-	    /*
-	     * Leave the key in quoted form, because 1) postmap cannot assume
-	     * that a string without @ contains an email address localpart,
-	     * and 2) an address localpart may require quoting even when the
-	     * quoted form contains no backslash or ".
-	     */
-	    key = STR(line_buffer);
-
-	    /*
-	     * Enforce the "key whitespace value" format. Disallow missing
-	     * keys or missing values.
-	     */
-	    if (*key == 0 || *value == 0) {
-		msg_warn("%s, line %d: expected format: key whitespace value",
-			 VSTREAM_PATH(source_fp), lineno);
-		continue;
-	    }
-	    if (key[strlen(key) - 1] == ':')
-		msg_warn("%s, line %d: record is in \"key: value\" format; is this an alias file?",
-			 VSTREAM_PATH(source_fp), lineno);
-
-	    /*
-	     * Optionally treat the vale as a filename, and replace the value
-	     * with the BASE64-encoded content of the named file.
-	     */
-	    if (dict_flags & DICT_FLAG_SRC_RHS_IS_FILE) {
-		VSTRING *base64_buf;
-		char   *err;
-
-		if ((base64_buf = dict_file_to_b64(mkmap->dict, value)) == 0) {
-		    err = dict_file_get_error(mkmap->dict);
-		    msg_warn("%s, line %d: %s: skipping this entry",
-			     VSTREAM_PATH(source_fp), lineno, err);
-		    myfree(err);
-		    continue;
-		}
-		value = vstring_str(base64_buf);
-	    }
-
-	    /*
-	     * Store the value under a (possibly case-insensitive) key, as
-	     * specified with open_flags.
-	     */
-	    mkmap_append(mkmap, key, value);
-	    if (mkmap->dict->error)
-		msg_fatal("table %s:%s: write error: %m",
-			  mkmap->dict->type, mkmap->dict->name);
+	if (sort == 0) {
+	    postmap_load(mkmap, source_fp, dict_flags, line_buffer,
+			 (EXTSORT *) 0);
+	} else {
+	    for (how = EXTSORT_SEQ_FIRST;
+		 extsort_sequence(sort, how, &key, &value) != 0;
+		 how = EXTSORT_SEQ_NEXT)
+		postmap_append(mkmap, key, value);
 	}
 	break;
     }
@@ -550,6 +561,8 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     /*
      * Cleanup. We're about to terminate, but it is a good sanity check.
      */
+    if (sort)
+	extsort_free(sort);
     vstring_free(line_buffer);
     if (source_fp != VSTREAM_IN)
 	vstream_fclose(source_fp);
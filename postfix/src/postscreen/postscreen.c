@@ -874,6 +874,28 @@ static int psc_cache_validator(const char *client_addr,
     return ((dummy_state.flags & PSC_STATE_MASK_ANY_TODO) == 0);
 }
 
+/* psc_cache_expiry - earliest time that psc_cache_validator() drops entry */
+
+static time_t psc_cache_expiry(const char *client_addr,
+			               const char *stamp_str,
+			               void *unused_context)
+{
+    PSC_STATE dummy_state;
+    PSC_CLIENT_INFO dummy_client_info;
+    time_t  todo_time;
+
+    /*
+     * This function is called by the cache cleanup pseudo thread, to file
+     * an entry in the expiration index. The validator removes an entry when
+     * some enabled test expired longer ago than the cache retention time.
+     */
+    dummy_state.client_info = &dummy_client_info;
+    psc_parse_tests(&dummy_state, stamp_str, event_time() - var_psc_cache_ret);
+    if ((todo_time = psc_todo_time(&dummy_state)) == PSC_TIME_STAMP_INVALID)
+	return (event_time() + var_psc_cache_ret);
+    return (todo_time + var_psc_cache_ret + 1);
+}
+
 /* pre_jail_init - pre-jail initialization */
 
 static void pre_jail_init(char *unused_name, char **unused_argv)
@@ -1052,6 +1074,7 @@ static void post_jail_init(char *unused_name, char **unused_argv)
 			   CA_DICT_CACHE_CTL_FLAGS(cache_flags),
 			   CA_DICT_CACHE_CTL_INTERVAL(var_psc_cache_scan),
 			   CA_DICT_CACHE_CTL_VALIDATOR(psc_cache_validator),
+			   CA_DICT_CACHE_CTL_EXPIRY(psc_cache_expiry),
 			   CA_DICT_CACHE_CTL_CONTEXT((void *) 0),
 			   CA_DICT_CACHE_CTL_END);
 
@@ -507,6 +507,7 @@ extern int psc_dnsbl_request(const char *, void (*) (int, void *), void *);
 extern void psc_new_tests(PSC_STATE *);
 extern void psc_parse_tests(PSC_STATE *, const char *, time_t);
 extern void psc_todo_tests(PSC_STATE *, time_t);
+extern time_t psc_todo_time(PSC_STATE *);
 extern char *psc_print_tests(VSTRING *, PSC_STATE *);
 extern char *psc_print_grey_key(VSTRING *, const char *, const char *,
 				        const char *, const char *);
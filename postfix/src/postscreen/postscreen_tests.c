@@ -22,6 +22,9 @@
 /*	const char *stamp_text;
 /*	time_t time_value;
 /*
+/*	time_t	psc_todo_time(state)
+/*	PSC_STATE *state;
+/*
 /*	char	*psc_print_tests(buffer, state)
 /*	VSTRING	*buffer;
 /*	PSC_STATE *state;
@@ -62,6 +65,10 @@
 /*	tests are flagged as "expired"; the object is flagged as
 /*	"new" if some enabled tests have "new" time stamps.
 /*
+/*	psc_todo_time() returns the earliest expiration time stamp
+/*	of an enabled test, or PSC_TIME_STAMP_INVALID when no test
+/*	is enabled.
+/*
 /*	psc_print_tests() creates a cache file record for the
 /*	specified flags and per-test expiration time stamps.
 /*	This may modify the time stamps for disabled tests.
@@ -272,6 +279,27 @@ void    psc_todo_tests(PSC_STATE *state, time_t time_value)
 #endif
 }
 
+/* psc_todo_time - earliest expiration time of an enabled test */
+
+time_t  psc_todo_time(PSC_STATE *state)
+{
+    time_t *expire_time = state->client_info->expire_time;
+    time_t  todo_time = PSC_TIME_STAMP_INVALID;
+
+#define PSC_TODO_TIME_MIN(enable, tindx) do { \
+	if ((enable) && (todo_time == PSC_TIME_STAMP_INVALID \
+			 || expire_time[tindx] < todo_time)) \
+	    todo_time = expire_time[tindx]; \
+    } while (0)
+
+    PSC_TODO_TIME_MIN(PSC_PREGR_TEST_ENABLE(), PSC_TINDX_PREGR);
+    PSC_TODO_TIME_MIN(PSC_DNSBL_TEST_ENABLE(), PSC_TINDX_DNSBL);
+    PSC_TODO_TIME_MIN(var_psc_pipel_enable, PSC_TINDX_PIPEL);
+    PSC_TODO_TIME_MIN(var_psc_nsmtp_enable, PSC_TINDX_NSMTP);
+    PSC_TODO_TIME_MIN(var_psc_barlf_enable, PSC_TINDX_BARLF);
+    return (todo_time);
+}
+
 /* psc_print_tests - print postscreen cache record */
 
 char   *psc_print_tests(VSTRING *buf, PSC_STATE *state)
@@ -76,6 +76,17 @@
 /*	a lookup key and result value, if found.
 /* .sp
 /*	This request is supported in Postfix 2.9 and later.
+/* .IP "\fBbulk_lookup\fR \fImaptype:mapname flags key...\fR"
+/*	Look up the data stored under each of up to 1024 keys.
+/*	The reply is the request completion status code, followed
+/*	by a completion status code (OK or NOKEY) and lookup result
+/*	value for each key, in request order. Tables that support
+/*	multi-key queries receive all keys at once; other tables
+/*	are searched one key at a time.
+/*	The \fImaptype:mapname\fR and \fIflags\fR are the same
+/*	as with the \fBopen\fR request.
+/* .sp
+/*	This request is supported in Postfix 3.6 and later.
 /* .PP
 /*	The request completion status is one of OK, RETRY, NOKEY
 /*	(lookup failed because the key was not found), BAD (malformed
@@ -129,7 +140,23 @@
 /* BUGS
 /*	The \fBproxymap\fR(8) server provides service to multiple clients,
 /*	and must therefore not be used for tables that have high-latency
-/*	lookups.
+/*	lookups, unless those tables have their own proxymap service.
+/*	For example, with the following settings, LDAP lookups are
+/*	handled by a separate pool of \fBproxymap\fR(8) processes,
+/*	so that a slow LDAP server does not delay lookups in other
+/*	proxied tables:
+/* .sp
+/* .nf
+/*	/etc/postfix/master.cf:
+/*	    proxymap-ldap unix -  -  n  -  -  proxymap
+/*
+/*	/etc/postfix/main.cf:
+/*	    proxymap_service_maps = inline:{
+/*	        ldap:/etc/postfix/aliases.cf = proxymap-ldap }
+/* .fi
+/* .sp
+/*	Any service name other than \fBproxywrite\fR provides read-only
+/*	service.
 /*
 /*	The \fBproxymap\fR(8) read-write service does not explicitly
 /*	close lookup tables (even if it did, this could not be relied on,
@@ -186,6 +213,12 @@
 /*	Available in Postfix 3.3 and later:
 /* .IP "\fBservice_name (read-only)\fR"
 /*	The master.cf service name of a Postfix daemon process.
+/* .PP
+/*	Available in Postfix 3.6 and later:
+/* .IP "\fBproxymap_service_maps (empty)\fR"
+/*	Optional lookup tables that map a proxied read-only table
+/*	name (\fItype:name\fR) to the name of the \fBproxymap\fR(8)
+/*	service that handles its lookups.
 /* SEE ALSO
 /*	postconf(5), configuration parameters
 /*	master(5), generic daemon options
@@ -232,6 +265,8 @@
 #include <htable.h>
 #include <stringops.h>
 #include <dict.h>
+#include <argv.h>
+#include <argv_attr.h>
 
 /* Global library. */
 
@@ -452,6 +487,68 @@ static void proxymap_lookup_service(VSTREAM *client_stream)
 	       ATTR_TYPE_END);
 }
 
+/* proxymap_bulk_lookup_service - remote multi-key lookup service */
+
+static void proxymap_bulk_lookup_service(VSTREAM *client_stream)
+{
+    int     request_flags;
+    DICT   *dict;
+    ARGV   *request_keys = 0;
+    const char **reply_values = 0;
+    int     reply_status;
+    int     n;
+
+    /*
+     * Process the request.
+     */
+    if (attr_scan(client_stream, ATTR_FLAG_STRICT,
+		  RECV_ATTR_STR(MAIL_ATTR_TABLE, request_map),
+		  RECV_ATTR_INT(MAIL_ATTR_FLAGS, &request_flags),
+		  RECV_ATTR_FUNC(argv_attr_scan, (void *) &request_keys),
+		  ATTR_TYPE_END) != 3
+	|| request_keys == 0) {
+	reply_status = PROXY_STAT_BAD;
+    } else if ((dict = proxy_map_find(STR(request_map), request_flags,
+				      &reply_status)) == 0) {
+	 /* void */ ;
+    } else {
+	dict->flags = ((dict->flags & ~DICT_FLAG_RQST_MASK)
+		       | (request_flags & DICT_FLAG_RQST_MASK));
+	reply_values = (const char **)
+	    mymalloc(request_keys->argc * sizeof(*reply_values));
+	if (dict_get_bulk(dict, request_keys->argc,
+			  (const char **) request_keys->argv,
+			  reply_values) == DICT_ERR_NONE) {
+	    reply_status = PROXY_STAT_OK;
+	} else {
+	    reply_status = (dict->error == DICT_ERR_RETRY ?
+			    PROXY_STAT_RETRY : PROXY_STAT_CONFIG);
+	}
+    }
+
+    /*
+     * Respond to the client. The per-key results follow only after an OK
+     * status.
+     */
+    attr_print(client_stream, ATTR_FLAG_MORE,
+	       SEND_ATTR_INT(MAIL_ATTR_STATUS, reply_status),
+	       ATTR_TYPE_END);
+    if (reply_status == PROXY_STAT_OK) {
+	for (n = 0; n < request_keys->argc; n++)
+	    attr_print(client_stream, ATTR_FLAG_MORE,
+		       SEND_ATTR_INT(MAIL_ATTR_STATUS, reply_values[n] ?
+				     PROXY_STAT_OK : PROXY_STAT_NOKEY),
+		       SEND_ATTR_STR(MAIL_ATTR_VALUE, reply_values[n] ?
+				     reply_values[n] : ""),
+		       ATTR_TYPE_END);
+    }
+    attr_print(client_stream, ATTR_FLAG_NONE, ATTR_TYPE_END);
+    if (reply_values)
+	myfree((void *) reply_values);
+    if (request_keys)
+	argv_free(request_keys);
+}
+
 /* proxymap_update_service - remote update service */
 
 static void proxymap_update_service(VSTREAM *client_stream)
@@ -627,6 +724,8 @@ static void proxymap_service(VSTREAM *client_stream, char *unused_service,
 		  ATTR_TYPE_END) == 1) {
 	if (VSTREQ(request, PROXY_REQ_LOOKUP)) {
 	    proxymap_lookup_service(client_stream);
+	} else if (VSTREQ(request, PROXY_REQ_BULK_LOOKUP)) {
+	    proxymap_bulk_lookup_service(client_stream);
 	} else if (VSTREQ(request, PROXY_REQ_UPDATE)) {
 	    proxymap_update_service(client_stream);
 	} else if (VSTREQ(request, PROXY_REQ_DELETE)) {
@@ -671,13 +770,11 @@ static void post_jail_init(char *service_name, char **unused_argv)
     char   *type_name;
 
     /*
-     * Are we proxy writer?
+     * Are we proxy writer? Any other service name, including a dedicated
+     * service for slow tables, provides read-only service.
      */
     if (strcmp(service_name, MAIL_SERVICE_PROXYWRITE) == 0)
 	proxy_writer = 1;
-    else if (strcmp(service_name, MAIL_SERVICE_PROXYMAP) != 0)
-	msg_fatal("service name must be one of %s or %s",
-		  MAIL_SERVICE_PROXYMAP, MAIL_SERVICE_PROXYMAP);
 
     /*
      * Pre-allocate buffers.
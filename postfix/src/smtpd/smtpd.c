@@ -2802,6 +2802,12 @@ static void mail_reset(SMTPD_STATE *state)
     }
     if (state->bdat_get_buffer)
 	VSTRING_RESET(state->bdat_get_buffer);
+
+    /*
+     * Don't keep memory for strings that were released during the
+     * transaction.
+     */
+    vstring_pool_reset();
 }
 
 /* rcpt_cmd - process RCPT TO command */
@@ -20,6 +20,8 @@
 /*	tls_stream_start() enables TLS on the named stream. All read
 /*	and write operations are directed through the TLS library,
 /*	using the state information specified with the context argument.
+/*	Data from vstream_fwritev() is sent as one TLS record where
+/*	possible.
 /*
 /*	tls_stream_stop() replaces the VSTREAM read/write routines
 /*	by dummies that have no side effects, and deletes the
@@ -69,11 +71,14 @@
 
 #ifdef USE_TLS
 
+#include <string.h>
+
 /* Utility library. */
 
 #include <iostuff.h>
 #include <vstream.h>
 #include <msg.h>
+#include <mymalloc.h>
 
 /* TLS library. */
 
@@ -129,6 +134,39 @@ static ssize_t tls_timed_write(int fd, void *buf, size_t len, int timeout,
     return (NORMALIZED_VSTREAM_RETURN(ret));
 }
 
+/* tls_timed_writev - TLS encapsulate gathered content, then write */
+
+static ssize_t tls_timed_writev(int fd, const struct iovec *iov, int iovcnt,
+				        int timeout, void *context)
+{
+    static char *buf;
+    size_t  len;
+    size_t  count;
+    int     n;
+
+    /*
+     * Copy the pieces into one plaintext buffer, so that they are sent as
+     * one TLS record instead of one record per piece. A piece that fills a
+     * record by itself is sent without copying. The vstream(3) caller
+     * handles partial writes.
+     */
+#define TLS_WRITEV_BUFSIZE	16384		/* TLS record payload limit */
+
+    if (iovcnt > 0 && iov[0].iov_len >= TLS_WRITEV_BUFSIZE)
+	return (tls_timed_write(fd, iov[0].iov_base, iov[0].iov_len,
+				timeout, context));
+    if (buf == 0)
+	buf = mymalloc(TLS_WRITEV_BUFSIZE);
+    for (len = 0, n = 0; n < iovcnt && len < TLS_WRITEV_BUFSIZE; n++) {
+	count = TLS_WRITEV_BUFSIZE - len;
+	if (count > iov[n].iov_len)
+	    count = iov[n].iov_len;
+	memcpy(buf + len, iov[n].iov_base, count);
+	len += count;
+    }
+    return (tls_timed_write(fd, buf, len, timeout, context));
+}
+
 /* tls_stream_start - start VSTREAM over TLS */
 
 void    tls_stream_start(VSTREAM *stream, TLS_SESS_STATE *context)
@@ -136,6 +174,7 @@ void    tls_stream_start(VSTREAM *stream, TLS_SESS_STATE *context)
     vstream_control(stream,
 		    CA_VSTREAM_CTL_READ_FN(tls_timed_read),
 		    CA_VSTREAM_CTL_WRITE_FN(tls_timed_write),
+		    CA_VSTREAM_CTL_WRITEV_FN(tls_timed_writev),
 		    CA_VSTREAM_CTL_CONTEXT(context),
 		    CA_VSTREAM_CTL_END);
 }
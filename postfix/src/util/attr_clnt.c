@@ -9,6 +9,7 @@
 /*	typedef int (*ATTR_CLNT_PRINT_FN) (VSTREAM *, int, va_list);
 /*	typedef int (*ATTR_CLNT_SCAN_FN) (VSTREAM *, int, va_list);
 /*	typedef int (*ATTR_CLNT_HANDSHAKE_FN) (VSTREAM *);
+/*	typedef void (*ATTR_CLNT_REPLY_FN) (ATTR_CLNT *, int, void *);
 /*
 /*	ATTR_CLNT *attr_clnt_create(server, timeout, max_idle, max_ttl)
 /*	const char *server;
@@ -27,6 +28,25 @@
 /*	int	recv_type;
 /*	const char *recv_name;
 /*
+/*	int	attr_clnt_send(client, reply_fn, context,
+/*			send_flags, send_type, send_name, ..., ATTR_TYPE_END)
+/*	ATTR_CLNT *client;
+/*	ATTR_CLNT_REPLY_FN reply_fn;
+/*	void	*context;
+/*	int	send_flags;
+/*	int	send_type;
+/*	const char *send_name;
+/*
+/*	int	attr_clnt_reply(client,
+/*			recv_flags, recv_type, recv_name, ..., ATTR_TYPE_END)
+/*	ATTR_CLNT *client;
+/*	int	recv_flags;
+/*	int	recv_type;
+/*	const char *recv_name;
+/*
+/*	int	attr_clnt_pending(client)
+/*	ATTR_CLNT *client;
+/*
 /*	void	attr_clnt_free(client)
 /*	ATTR_CLNT *client;
 /*
@@ -45,7 +65,40 @@
 /*	The other arguments are as described in attr_print_plain(3). The
 /*	result is the number of attributes received or -1 in case of trouble.
 /*
+/*	attr_clnt_send() sends the specified request attributes,
+/*	and returns without waiting for the reply. Multiple requests
+/*	may be in flight over the same connection; the server must
+/*	process pipelined requests in order. When the reply arrives,
+/*	the event loop calls reply_fn() with the client, a status,
+/*	and the context argument. With status 0, reply_fn() must
+/*	receive the reply with attr_clnt_reply(). With status -1,
+/*	there is no reply because the connection broke; reply_fn()
+/*	must not call attr_clnt_reply(). The reply_fn() call-back
+/*	may send new requests. The result of attr_clnt_send() is 0
+/*	in case of success, or -1 in case of trouble; then reply_fn()
+/*	will not be called for this request. Requests that were
+/*	sent with attr_clnt_send() are not retried. When the server
+/*	does not reply within the client timeout after a request
+/*	is sent to an idle connection, or after the previous reply,
+/*	all pending requests fail with status -1. The connection
+/*	is made double-buffered, so that sending a request does not
+/*	discard replies that were already received.
+/*
+/*	attr_clnt_reply() receives the reply for the oldest request
+/*	that was sent with attr_clnt_send(). It must be called only
+/*	from a reply_fn() call-back with status 0. The arguments are
+/*	as described in attr_scan_plain(3). The result is the number
+/*	of attributes received or -1 in case of trouble. In case of
+/*	trouble, the requests that are still in flight fail with
+/*	status -1.
+/*
+/*	attr_clnt_pending() returns the number of requests that are
+/*	waiting for a reply. The caller should limit this number, so
+/*	that the client and server do not both block while writing.
+/*
 /*	attr_clnt_free() destroys a client handle and closes its connection.
+/*	Requests that are waiting for a reply are discarded without
+/*	reply_fn() call-back.
 /*
 /*	attr_clnt_control() allows the user to fine tune the behavior of
 /*	the specified client. The arguments are a list of (name, value)
@@ -70,7 +123,18 @@
 /*      A pointer to function that will be called at the start of a
 /*      new connection, and that returns 0 in case of success.
 /* DIAGNOSTICS
-/*	Warnings: communication failure.
+/*	Warnings: communication failure, reply timeout.
+/*
+/*	Panic: attr_clnt_request() is called while requests sent
+/*	with attr_clnt_send() are waiting for a reply; attr_clnt_reply()
+/*	is called outside a reply_fn() call-back; reply_fn() did not
+/*	call attr_clnt_reply().
+/* BUGS
+/*	When only part of a reply has arrived, attr_clnt_reply() waits
+/*	for the remainder, subject to the client timeout.
+/*
+/*	The request limit is enforced only when no requests are
+/*	waiting for a reply.
 /* SEE ALSO
 /*	auto_clnt(3), client endpoint management
 /*	attr_scan_plain(3), attribute protocol
@@ -106,11 +170,22 @@
 #include <attr.h>
 #include <iostuff.h>
 #include <compat_va_copy.h>
+#include <events.h>
 #include <auto_clnt.h>
 #include <attr_clnt.h>
 
 /* Application-specific. */
 
+ /*
+  * A request that was sent with attr_clnt_send(), and that is waiting for
+  * its reply. Replies arrive in the order that requests were sent.
+  */
+typedef struct ATTR_CLNT_PEND {
+    ATTR_CLNT_REPLY_FN reply_fn;	/* reply call-back */
+    void   *context;			/* call-back context */
+    struct ATTR_CLNT_PEND *next;	/* next request */
+} ATTR_CLNT_PEND;
+
 struct ATTR_CLNT {
     AUTO_CLNT *auto_clnt;
     /* Remaining properties are set with attr_clnt_control(). */
@@ -120,16 +195,37 @@ struct ATTR_CLNT {
     int     req_count;
     int     try_limit;
     int     try_delay;
+    /* Asynchronous requests. */
+    int     flags;			/* see below */
+    VSTREAM *async_stream;		/* stream with pending requests */
+    ATTR_CLNT_PEND *pend_head;		/* oldest pending request */
+    ATTR_CLNT_PEND *pend_tail;		/* newest pending request */
+    int     pend_count;			/* number of pending requests */
+    int     timeout;			/* reply deadline */
 };
 
+#define ATTR_CLNT_FLAG_EVENT	(1<<0)	/* auto_clnt event call-back set */
+#define ATTR_CLNT_FLAG_REPLY	(1<<1)	/* reply expected from reply_fn() */
+#define ATTR_CLNT_FLAG_CLOSE	(1<<2)	/* close after the last reply */
+
 #define ATTR_CLNT_DEF_REQ_LIMIT	(0)	/* default per-session request limit */
 #define ATTR_CLNT_DEF_TRY_LIMIT	(2)	/* default request (re)try limit */
 #define ATTR_CLNT_DEF_TRY_DELAY	(1)	/* default request (re)try delay */
 
+static void attr_clnt_async_timeout(int, void *);
+
 /* attr_clnt_free - destroy attribute client */
 
 void    attr_clnt_free(ATTR_CLNT *client)
 {
+    ATTR_CLNT_PEND *pend;
+
+    if (client->pend_count > 0 && client->timeout > 0)
+	event_cancel_timer(attr_clnt_async_timeout, (void *) client);
+    while ((pend = client->pend_head) != 0) {
+	client->pend_head = pend->next;
+	myfree((void *) pend);
+    }
     auto_clnt_free(client->auto_clnt);
     myfree((void *) client);
 }
@@ -149,6 +245,11 @@ ATTR_CLNT *attr_clnt_create(const char *service, int timeout,
     client->req_count = 0;
     client->try_limit = ATTR_CLNT_DEF_TRY_LIMIT;
     client->try_delay = ATTR_CLNT_DEF_TRY_DELAY;
+    client->flags = 0;
+    client->async_stream = 0;
+    client->pend_head = client->pend_tail = 0;
+    client->pend_count = 0;
+    client->timeout = timeout;
     return (client);
 }
 
@@ -166,6 +267,10 @@ int     attr_clnt_request(ATTR_CLNT *client, int send_flags,...)
     int     err;
     int     ret;
 
+    if (client->pend_count > 0)
+	msg_panic("%s: %d asynchronous requests are pending",
+		  myname, client->pend_count);
+
     /*
      * XXX If the stream is readable before we send anything, then assume the
      * remote end disconnected.
@@ -250,6 +355,235 @@ int     attr_clnt_request(ATTR_CLNT *client, int send_flags,...)
     return (ret);
 }
 
+/* attr_clnt_async_fail - fail all pending requests */
+
+static void attr_clnt_async_fail(ATTR_CLNT *client)
+{
+    ATTR_CLNT_PEND *list;
+    ATTR_CLNT_PEND *pend;
+
+    /*
+     * Detach the list before making call-backs, so that a call-back can
+     * send a new request over a new connection.
+     */
+    if (client->pend_count > 0 && client->timeout > 0)
+	event_cancel_timer(attr_clnt_async_timeout, (void *) client);
+    auto_clnt_recover(client->auto_clnt);
+    client->req_count = 0;
+    client->async_stream = 0;
+    client->flags &= ~(ATTR_CLNT_FLAG_CLOSE | ATTR_CLNT_FLAG_REPLY);
+    list = client->pend_head;
+    client->pend_head = client->pend_tail = 0;
+    client->pend_count = 0;
+    while ((pend = list) != 0) {
+	list = pend->next;
+	pend->reply_fn(client, -1, pend->context);
+	myfree((void *) pend);
+    }
+}
+
+/* attr_clnt_async_timeout - no reply within the deadline */
+
+static void attr_clnt_async_timeout(int unused_event, void *context)
+{
+    ATTR_CLNT *client = (ATTR_CLNT *) context;
+
+    msg_warn("timeout waiting for reply from server %s"
+	     " with %d request(s) pending",
+	     auto_clnt_name(client->auto_clnt), client->pend_count);
+    attr_clnt_async_fail(client);
+}
+
+/* attr_clnt_async_event - reply, disconnect, or idle/ttl timer */
+
+static void attr_clnt_async_event(int event, void *context)
+{
+    const char *myname = "attr_clnt_async_event";
+    ATTR_CLNT *client = (ATTR_CLNT *) context;
+    ATTR_CLNT_PEND *pend;
+    VSTREAM *stream;
+
+    /*
+     * Without pending requests, a read event means that the server
+     * disconnected, and a timer event means that the connection is idle or
+     * too old. Either way, close the connection as auto_clnt(3) would. With
+     * pending requests, a timer event closes the connection after the last
+     * reply.
+     */
+    if (client->pend_count == 0) {
+	auto_clnt_recover(client->auto_clnt);
+	client->req_count = 0;
+	client->async_stream = 0;
+	client->flags &= ~ATTR_CLNT_FLAG_CLOSE;
+	return;
+    }
+    if (event != EVENT_READ) {
+	client->flags |= ATTR_CLNT_FLAG_CLOSE;
+	return;
+    }
+
+    /*
+     * Readable without data means end-of-file.
+     */
+    stream = client->async_stream;
+    if (vstream_peek(stream) <= 0 && peekfd(vstream_fileno(stream)) <= 0) {
+	msg_warn("server %s disconnected with %d request(s) pending",
+		 auto_clnt_name(client->auto_clnt), client->pend_count);
+	attr_clnt_async_fail(client);
+	return;
+    }
+
+    /*
+     * Deliver replies in order. Replies that are already in the stream
+     * buffer must be delivered now, because there will be no read event for
+     * them.
+     */
+    do {
+	pend = client->pend_head;
+	if ((client->pend_head = pend->next) == 0)
+	    client->pend_tail = 0;
+	client->pend_count -= 1;
+	client->flags |= ATTR_CLNT_FLAG_REPLY;
+	pend->reply_fn(client, 0, pend->context);
+	myfree((void *) pend);
+	if (client->flags & ATTR_CLNT_FLAG_REPLY)
+	    msg_panic("%s: reply call-back did not receive the reply", myname);
+    } while ((stream = client->async_stream) != 0 && client->pend_count > 0
+	     && vstream_peek(stream) > 0);
+
+    /*
+     * Give the server another timeout interval for the next reply.
+     */
+    if (client->pend_count > 0 && client->timeout > 0)
+	event_request_timer(attr_clnt_async_timeout, (void *) client,
+			    client->timeout);
+    else if (client->timeout > 0)
+	event_cancel_timer(attr_clnt_async_timeout, (void *) client);
+
+    /*
+     * Enforce the request limit, and the idle and ttl time limits, when no
+     * requests are waiting for a reply.
+     */
+    if (client->async_stream != 0 && client->pend_count == 0
+	&& (client->flags & ATTR_CLNT_FLAG_CLOSE)) {
+	auto_clnt_recover(client->auto_clnt);
+	client->req_count = 0;
+	client->async_stream = 0;
+	client->flags &= ~ATTR_CLNT_FLAG_CLOSE;
+    }
+}
+
+/* attr_clnt_send - send query, reply will be delivered via event loop */
+
+int     attr_clnt_send(ATTR_CLNT *client, ATTR_CLNT_REPLY_FN reply_fn,
+		               void *context, int send_flags,...)
+{
+    ATTR_CLNT_PEND *pend;
+    VSTREAM *stream;
+    va_list ap;
+    int     count;
+    int     err;
+
+    /*
+     * Replies are delivered from the auto_clnt read event.
+     */
+    if ((client->flags & ATTR_CLNT_FLAG_EVENT) == 0) {
+	auto_clnt_control(client->auto_clnt,
+			  AUTO_CLNT_CTL_EVENT, attr_clnt_async_event,
+			  (void *) client,
+			  AUTO_CLNT_CTL_END);
+	client->flags |= ATTR_CLNT_FLAG_EVENT;
+    }
+
+    /*
+     * Without pending requests, a readable stream means that the server
+     * disconnected; see attr_clnt_request(). In that case, try once more
+     * with a new connection. With pending requests, don't retry: the server
+     * may already have processed some of them.
+     */
+    for (count = 0; /* see below */ ; count++) {
+	errno = 0;
+	if ((stream = auto_clnt_access(client->auto_clnt)) != 0
+	    && (client->pend_count > 0
+		|| readable(vstream_fileno(stream)) == 0)) {
+
+	    /*
+	     * Don't discard buffered replies when we switch from reading to
+	     * writing.
+	     */
+	    vstream_control(stream,
+			    CA_VSTREAM_CTL_DOUBLE,
+			    CA_VSTREAM_CTL_END);
+	    va_start(ap, send_flags);
+	    err = (client->print(stream, send_flags, ap) != 0
+		   || vstream_fflush(stream) != 0);
+	    va_end(ap);
+	    if (err == 0)
+		break;
+	}
+	if (client->pend_count > 0 || count > 0) {
+	    msg_warn("problem talking to server %s: %m",
+		     auto_clnt_name(client->auto_clnt));
+	    attr_clnt_async_fail(client);
+	    return (-1);
+	}
+	auto_clnt_recover(client->auto_clnt);
+	client->req_count = 0;
+    }
+
+    /*
+     * Wait for the reply.
+     */
+    pend = (ATTR_CLNT_PEND *) mymalloc(sizeof(*pend));
+    pend->reply_fn = reply_fn;
+    pend->context = context;
+    pend->next = 0;
+    if (client->pend_tail)
+	client->pend_tail->next = pend;
+    else
+	client->pend_head = pend;
+    client->pend_tail = pend;
+    if ((client->pend_count += 1) == 1 && client->timeout > 0)
+	event_request_timer(attr_clnt_async_timeout, (void *) client,
+			    client->timeout);
+    client->async_stream = stream;
+    if (client->req_limit > 0
+	&& (client->req_count += 1) >= client->req_limit)
+	client->flags |= ATTR_CLNT_FLAG_CLOSE;
+    return (0);
+}
+
+/* attr_clnt_reply - receive reply from reply call-back */
+
+int     attr_clnt_reply(ATTR_CLNT *client, int recv_flags,...)
+{
+    const char *myname = "attr_clnt_reply";
+    va_list ap;
+    int     ret;
+
+    if ((client->flags & ATTR_CLNT_FLAG_REPLY) == 0)
+	msg_panic("%s: no reply is expected", myname);
+    client->flags &= ~ATTR_CLNT_FLAG_REPLY;
+    errno = 0;
+    va_start(ap, recv_flags);
+    ret = client->scan(client->async_stream, recv_flags, ap);
+    va_end(ap);
+    if (ret <= 0) {
+	msg_warn("problem talking to server %s: %m",
+		 auto_clnt_name(client->auto_clnt));
+	attr_clnt_async_fail(client);
+	return (-1);
+    }
+    return (ret);
+}
+
+/* attr_clnt_pending - number of requests waiting for a reply */
+
+int     attr_clnt_pending(ATTR_CLNT *client)
+{
+    return (client->pend_count);
+}
+
 /* attr_clnt_control - fine control */
 
 void    attr_clnt_control(ATTR_CLNT *client, int name,...)
@@ -298,3 +632,234 @@ void    attr_clnt_control(ATTR_CLNT *client, int name,...)
     }
     va_end(ap);
 }
+
+#ifdef TEST
+
+ /*
+  * Test program. A child process runs a server that returns the request
+  * number in each reply, that ignores TEST_SEQ_IGNORE requests, and that
+  * disconnects when the request number is otherwise negative. The parent
+  * sends synchronous requests, pipelined asynchronous requests, requests
+  * that fail when the server disconnects, and requests that time out. With "-b
+  * count", compare the time for count synchronous requests and count
+  * pipelined requests.
+  */
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <listen.h>
+#include <msg_vstream.h>
+
+#define TEST_SOCK	"attr_clnt_test.sock"
+#define TEST_ATTR_SEQ	"seq"
+#define TEST_WINDOW	100		/* max pending requests */
+#define TEST_SEQ_IGNORE	(-2)		/* server does not reply */
+
+static ATTR_CLNT *test_client;
+static int sent;
+static int received;
+static int failed;
+static int limit;
+static pid_t server_pid;
+
+/* test_cleanup - don't leave the server behind after fatal error */
+
+static void test_cleanup(void)
+{
+    if (server_pid > 0)
+	(void) kill(server_pid, SIGKILL);
+}
+
+/* test_server - reply to requests, disconnect on request */
+
+static NORETURN test_server(int listen_fd)
+{
+    VSTREAM *stream;
+    int     fd;
+    int     seq;
+
+    for (;;) {
+	if ((fd = unix_accept(listen_fd)) < 0)
+	    msg_fatal("accept: %m");
+	stream = vstream_fdopen(fd, O_RDWR);
+	vstream_control(stream,
+			CA_VSTREAM_CTL_DOUBLE,
+			CA_VSTREAM_CTL_END);
+	while (attr_scan_plain(stream, ATTR_FLAG_STRICT,
+			       RECV_ATTR_INT(TEST_ATTR_SEQ, &seq),
+			       ATTR_TYPE_END) == 1
+	       && (seq >= 0 || seq == TEST_SEQ_IGNORE)) {
+	    if (seq == TEST_SEQ_IGNORE)
+		continue;
+	    attr_print_plain(stream, ATTR_FLAG_NONE,
+			     SEND_ATTR_INT(TEST_ATTR_SEQ, seq),
+			     ATTR_TYPE_END);
+	    if (vstream_peek(stream) <= 0 && vstream_fflush(stream) != 0)
+		break;
+	}
+	(void) vstream_fclose(stream);
+    }
+}
+
+static void test_send(int);
+
+/* test_reply - receive one asynchronous reply, keep the pipeline full */
+
+static void test_reply(ATTR_CLNT *client, int status, void *context)
+{
+    int     expect = CAST_ANY_PTR_TO_INT(context);
+    int     seq;
+
+    if (status < 0
+	|| attr_clnt_reply(client, ATTR_FLAG_STRICT,
+			   RECV_ATTR_INT(TEST_ATTR_SEQ, &seq),
+			   ATTR_TYPE_END) != 1) {
+	failed++;
+	return;
+    }
+    if (seq != expect)
+	msg_fatal("received reply %d for request %d", seq, expect);
+    received++;
+    while (sent < limit && attr_clnt_pending(client) < TEST_WINDOW)
+	test_send(sent++);
+}
+
+/* test_send - send one asynchronous request */
+
+static void test_send(int seq)
+{
+    if (attr_clnt_send(test_client, test_reply, CAST_INT_TO_VOID_PTR(seq),
+		       ATTR_FLAG_NONE,
+		       SEND_ATTR_INT(TEST_ATTR_SEQ, seq),
+		       ATTR_TYPE_END) < 0)
+	failed++;
+}
+
+/* test_sync - send one synchronous request */
+
+static void test_sync(int seq)
+{
+    int     reply;
+
+    if (attr_clnt_request(test_client, ATTR_FLAG_NONE,
+			  SEND_ATTR_INT(TEST_ATTR_SEQ, seq),
+			  ATTR_TYPE_END,
+			  ATTR_FLAG_STRICT,
+			  RECV_ATTR_INT(TEST_ATTR_SEQ, &reply),
+			  ATTR_TYPE_END) != 1)
+	msg_fatal("request %d failed", seq);
+    if (reply != seq)
+	msg_fatal("received reply %d for request %d", reply, seq);
+}
+
+/* test_pipeline - send count requests, up to TEST_WINDOW at a time */
+
+static void test_pipeline(int count)
+{
+    sent = received = failed = 0;
+    limit = count;
+    while (sent < limit && attr_clnt_pending(test_client) < TEST_WINDOW)
+	test_send(sent++);
+    while (received + failed < count)
+	event_loop(-1);
+}
+
+/* elapsed - report time since start */
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+int     main(int argc, char **argv)
+{
+    struct timeval start;
+    int     listen_fd;
+    int     count = 0;
+    int     n;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc == 3 && strcmp(argv[1], "-b") == 0)
+	count = atoi(argv[2]);
+    else if (argc != 1)
+	msg_fatal("usage: %s [-b count]", argv[0]);
+    signal(SIGPIPE, SIG_IGN);
+
+    (void) unlink(TEST_SOCK);
+    if ((listen_fd = unix_listen(TEST_SOCK, 10, BLOCKING)) < 0)
+	msg_fatal("listen %s: %m", TEST_SOCK);
+    if ((server_pid = fork()) < 0)
+	msg_fatal("fork: %m");
+    if (server_pid == 0)
+	test_server(listen_fd);
+    msg_cleanup(test_cleanup);
+    (void) close(listen_fd);
+    test_client = attr_clnt_create("unix:" TEST_SOCK, 10, 0, 0);
+
+    if (count > 0) {
+	GETTIMEOFDAY(&start);
+	for (n = 0; n < count; n++)
+	    test_sync(n);
+	vstream_printf("%d synchronous requests: %.3f s\n",
+		       count, elapsed(&start));
+	GETTIMEOFDAY(&start);
+	test_pipeline(count);
+	vstream_printf("%d pipelined requests: %.3f s\n",
+		       count, elapsed(&start));
+    } else {
+
+	/*
+	 * Synchronous and asynchronous requests over the same connection.
+	 */
+	test_sync(1);
+	test_pipeline(1000);
+	vstream_printf("pipeline: %d replies, %d failures\n", received, failed);
+	test_sync(2);
+
+	/*
+	 * The server disconnects after it replies to the first two requests.
+	 */
+	sent = received = failed = limit = 0;
+	test_send(1);
+	test_send(2);
+	test_send(-1);
+	while (received + failed < 3)
+	    event_loop(-1);
+	vstream_printf("disconnect: %d replies, %d failures\n",
+		       received, failed);
+
+	/*
+	 * A new connection.
+	 */
+	test_sync(3);
+	vstream_printf("reconnect: ok\n");
+
+	/*
+	 * The server replies to the first request only. The second request
+	 * fails when the one-second reply deadline passes.
+	 */
+	attr_clnt_free(test_client);
+	test_client = attr_clnt_create("unix:" TEST_SOCK, 1, 0, 0);
+	sent = received = failed = limit = 0;
+	test_send(1);
+	test_send(TEST_SEQ_IGNORE);
+	while (received + failed < 2)
+	    event_loop(-1);
+	vstream_printf("timeout: %d replies, %d failures\n",
+		       received, failed);
+    }
+    vstream_fflush(VSTREAM_OUT);
+    attr_clnt_free(test_client);
+    (void) kill(server_pid, SIGKILL);
+    (void) waitpid(server_pid, (int *) 0, 0);
+    (void) unlink(TEST_SOCK);
+    exit(0);
+}
+
+#endif
@@ -28,9 +28,13 @@ typedef struct ATTR_CLNT ATTR_CLNT;
 typedef int (*ATTR_CLNT_PRINT_FN) (VSTREAM *, int, va_list);
 typedef int (*ATTR_CLNT_SCAN_FN) (VSTREAM *, int, va_list);
 typedef int (*ATTR_CLNT_HANDSHAKE_FN) (VSTREAM *);
+typedef void (*ATTR_CLNT_REPLY_FN) (ATTR_CLNT *, int, void *);
 
 extern ATTR_CLNT *attr_clnt_create(const char *, int, int, int);
 extern int attr_clnt_request(ATTR_CLNT *, int,...);
+extern int attr_clnt_send(ATTR_CLNT *, ATTR_CLNT_REPLY_FN, void *, int,...);
+extern int attr_clnt_reply(ATTR_CLNT *, int,...);
+extern int attr_clnt_pending(ATTR_CLNT *);
 extern void attr_clnt_free(ATTR_CLNT *);
 extern void attr_clnt_control(ATTR_CLNT *, int,...);
 
@@ -8,6 +8,8 @@
 /*
 /*	typedef void (*AUTO_CLNT_HANDSHAKE_FN)(VSTREAM *);
 /*
+/*	typedef void (*AUTO_CLNT_EVENT_FN)(int, void *);
+/*
 /*	AUTO_CLNT *auto_clnt_create(service, timeout, max_idle, max_ttl)
 /*	const char *service;
 /*	int	timeout;
@@ -61,6 +63,15 @@
 /* .IP "AUTO_CLNT_CTL_HANDSHAKE(VSTREAM *)"
 /*      A pointer to function that will be called at the start of a
 /*      new connection, and that returns 0 in case of success.
+/* .IP "AUTO_CLNT_CTL_EVENT(AUTO_CLNT_EVENT_FN, void *)"
+/*	A pointer to function, and its context argument. When the
+/*	stream becomes readable, or when the max_idle or max_ttl
+/*	time limit is reached, this function is called with
+/*	EVENT_READ or EVENT_TIME and the context, instead of closing
+/*	the stream. The function is expected to call auto_clnt_recover()
+/*	when the stream must be closed. This allows an application
+/*	to receive replies asynchronously. Specify a null pointer
+/*	to restore the default behavior.
 /* .PP
 /*	Arguments:
 /* .IP service
@@ -145,6 +156,8 @@ struct AUTO_CLNT {
     int     max_idle;			/* time before client disconnect */
     int     max_ttl;			/* time before client disconnect */
     AUTO_CLNT_HANDSHAKE_FN handshake;	/* new connection only */
+    AUTO_CLNT_EVENT_FN event_fn;	/* read or timer event */
+    void   *event_context;		/* event_fn context */
     int     (*connect) (const char *, int, int);	/* unix, local, inet */
 };
 
@@ -152,7 +165,7 @@ static void auto_clnt_close(AUTO_CLNT *);
 
 /* auto_clnt_event - server-initiated disconnect or client-side max_idle */
 
-static void auto_clnt_event(int unused_event, void *context)
+static void auto_clnt_event(int event, void *context)
 {
     AUTO_CLNT *auto_clnt = (AUTO_CLNT *) context;
 
@@ -163,7 +176,14 @@ static void auto_clnt_event(int unused_event, void *context)
     if (auto_clnt->vstream == 0)
 	msg_panic("auto_clnt_event: stream is closed");
 
-    auto_clnt_close(auto_clnt);
+    /*
+     * Let the application decide if the stream has replies that it is
+     * waiting for.
+     */
+    if (auto_clnt->event_fn != 0)
+	auto_clnt->event_fn(event, auto_clnt->event_context);
+    else
+	auto_clnt_close(auto_clnt);
 }
 
 /* auto_clnt_ttl_event - client-side expiration */
@@ -321,6 +341,8 @@ AUTO_CLNT *auto_clnt_create(const char *service, int timeout,
     auto_clnt->max_idle = max_idle;
     auto_clnt->max_ttl = max_ttl;
     auto_clnt->handshake = 0;
+    auto_clnt->event_fn = 0;
+    auto_clnt->event_context = 0;
     if (strcmp(transport, "inet") == 0) {
 	auto_clnt->connect = inet_connect;
     } else if (strcmp(transport, "local") == 0) {
@@ -364,6 +386,10 @@ void    auto_clnt_control(AUTO_CLNT *client, int name,...)
 	case AUTO_CLNT_CTL_HANDSHAKE:
 	    client->handshake = va_arg(ap, AUTO_CLNT_HANDSHAKE_FN);
 	    break;
+	case AUTO_CLNT_CTL_EVENT:
+	    client->event_fn = va_arg(ap, AUTO_CLNT_EVENT_FN);
+	    client->event_context = va_arg(ap, void *);
+	    break;
 	default:
 	    msg_panic("%s: bad name %d", myname, name);
 	}
@@ -21,6 +21,7 @@
   */
 typedef struct AUTO_CLNT AUTO_CLNT;
 typedef int (*AUTO_CLNT_HANDSHAKE_FN) (VSTREAM *);
+typedef void (*AUTO_CLNT_EVENT_FN) (int, void *);
 
 extern AUTO_CLNT *auto_clnt_create(const char *, int, int, int);
 extern VSTREAM *auto_clnt_access(AUTO_CLNT *);
@@ -31,6 +32,7 @@ extern void auto_clnt_control(AUTO_CLNT *, int,...);
 
 #define AUTO_CLNT_CTL_END       0
 #define AUTO_CLNT_CTL_HANDSHAKE 1	/* handshake before first request */
+#define AUTO_CLNT_CTL_EVENT     2	/* read or timer event call-back */
 
 /* LICENSE
 /* .ad
@@ -42,6 +42,10 @@
 /*	Append the result, instead of overwriting the result buffer.
 /* .PP
 /*	For convenience, BASE64_FLAG_NONE specifies none of the above.
+/*
+/*	Both functions convert complete 3-byte or 4-character groups
+/*	straight into the result buffer, and handle only the final
+/*	group one character at a time.
 /* DIAGNOSTICS
 /*	base64_decode () returns a null pointer when the input contains
 /*	characters not in the base 64 alphabet.
@@ -80,6 +84,14 @@ static unsigned char to_b64[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
 #define UNSIG_CHAR_PTR(x) ((unsigned char *)(x))
+#define STR(x)	vstring_str(x)
+
+ /*
+  * The result buffer is extended once per chunk instead of once per output
+  * byte. The chunk sizes are multiples of the group sizes.
+  */
+#define BASE64_ENCODE_CHUNK	3072	/* input bytes per extension */
+#define BASE64_DECODE_CHUNK	4096	/* input chars per extension */
 
 /* base64_encode - raw data to encoded */
 
@@ -96,14 +108,36 @@ VSTRING *base64_encode_opt(VSTRING *result, const char *in, ssize_t len,
 			           int flags)
 {
     const unsigned char *cp;
+    const unsigned char *end;
+    unsigned char *out;
     ssize_t count;
+    ssize_t chunk;
+    unsigned int word;
 
     /*
-     * Encode 3 -> 4.
+     * Encode 3 -> 4, complete groups first.
      */
     if ((flags & BASE64_FLAG_APPEND) == 0)
 	VSTRING_RESET(result);
-    for (cp = UNSIG_CHAR_PTR(in), count = len; count > 0; count -= 3, cp += 3) {
+    for (cp = UNSIG_CHAR_PTR(in), count = len; count >= 3; count -= chunk) {
+	chunk = (count > BASE64_ENCODE_CHUNK ?
+		 BASE64_ENCODE_CHUNK : count / 3 * 3);
+	VSTRING_SPACE(result, chunk / 3 * 4);
+	out = UNSIG_CHAR_PTR(vstring_end(result));
+	for (end = cp + chunk; cp < end; cp += 3, out += 4) {
+	    word = cp[0] << 16 | cp[1] << 8 | cp[2];
+	    out[0] = to_b64[word >> 18];
+	    out[1] = to_b64[(word >> 12) & 0x3f];
+	    out[2] = to_b64[(word >> 6) & 0x3f];
+	    out[3] = to_b64[word & 0x3f];
+	}
+	vstring_set_payload_size(result, out - UNSIG_CHAR_PTR(STR(result)));
+    }
+
+    /*
+     * The final partial group, with padding.
+     */
+    for ( /* void */ ; count > 0; count -= 3, cp += 3) {
 	VSTRING_ADDCH(result, to_b64[cp[0] >> 2]);
 	if (count > 1) {
 	    VSTRING_ADDCH(result, to_b64[(cp[0] & 0x3) << 4 | cp[1] >> 4]);
@@ -142,7 +176,10 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
 {
     static unsigned char *un_b64 = 0;
     const unsigned char *cp;
-    ssize_t count;
+    const unsigned char *end;
+    const unsigned char *group_end;
+    unsigned char *out;
+    ssize_t chunk;
     unsigned int ch0;
     unsigned int ch1;
     unsigned int ch2;
@@ -168,11 +205,37 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
     }
 
     /*
-     * Decode 4 -> 3.
+     * Decode 4 -> 3. Groups without padding or invalid characters are
+     * decoded in bulk; all valid table entries fit in 6 bits.
      */
     if ((flags & BASE64_FLAG_APPEND) == 0)
 	VSTRING_RESET(result);
-    for (cp = UNSIG_CHAR_PTR(in), count = 0; count < len; count += 4) {
+    for (cp = UNSIG_CHAR_PTR(in), end = cp + len; cp < end; /* void */ ) {
+	chunk = end - cp;
+	if (chunk > BASE64_DECODE_CHUNK)
+	    chunk = BASE64_DECODE_CHUNK;
+	VSTRING_SPACE(result, chunk / 4 * 3);
+	out = UNSIG_CHAR_PTR(vstring_end(result));
+	for (group_end = cp + chunk; cp < group_end; cp += 4, out += 3) {
+	    ch0 = un_b64[cp[0]];
+	    ch1 = un_b64[cp[1]];
+	    ch2 = un_b64[cp[2]];
+	    ch3 = un_b64[cp[3]];
+	    if ((ch0 | ch1 | ch2 | ch3) & ~0x3f)
+		break;
+	    out[0] = ch0 << 2 | ch1 >> 4;
+	    out[1] = ch1 << 4 | ch2 >> 2;
+	    out[2] = ch2 << 6 | ch3;
+	}
+	vstring_set_payload_size(result, out - UNSIG_CHAR_PTR(STR(result)));
+	if (cp < group_end)
+	    break;
+    }
+
+    /*
+     * The group with padding, or with an invalid character.
+     */
+    while (cp < end) {
 	if ((ch0 = un_b64[*cp++]) == INVALID
 	    || (ch1 = un_b64[*cp++]) == INVALID)
 	    return (0);
@@ -195,19 +258,210 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
 #ifdef TEST
 
  /*
-  * Proof-of-concept test program: convert to base 64 and back.
+  * Proof-of-concept test program: convert to base 64 and back. With "-c
+  * size", compare results against the old one-byte-at-a-time
+  * implementation, with random data of up to size bytes and with corrupted
+  * encodings. With "-b count size", also compare the speed.
   */
+#include <stdlib.h>
+#include <sys/time.h>
+#include <myrand.h>
+#include <vstream.h>
 
-#define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
-int     main(int unused_argc, char **unused_argv)
+/* old_encode - old implementation, for comparison */
+
+static VSTRING *old_encode(VSTRING *result, const char *in, ssize_t len)
+{
+    const unsigned char *cp;
+    ssize_t count;
+
+    VSTRING_RESET(result);
+    for (cp = UNSIG_CHAR_PTR(in), count = len; count > 0; count -= 3, cp += 3) {
+	VSTRING_ADDCH(result, to_b64[cp[0] >> 2]);
+	if (count > 1) {
+	    VSTRING_ADDCH(result, to_b64[(cp[0] & 0x3) << 4 | cp[1] >> 4]);
+	    if (count > 2) {
+		VSTRING_ADDCH(result, to_b64[(cp[1] & 0xf) << 2 | cp[2] >> 6]);
+		VSTRING_ADDCH(result, to_b64[cp[2] & 0x3f]);
+	    } else {
+		VSTRING_ADDCH(result, to_b64[(cp[1] & 0xf) << 2]);
+		VSTRING_ADDCH(result, '=');
+		break;
+	    }
+	} else {
+	    VSTRING_ADDCH(result, to_b64[(cp[0] & 0x3) << 4]);
+	    VSTRING_ADDCH(result, '=');
+	    VSTRING_ADDCH(result, '=');
+	    break;
+	}
+    }
+    VSTRING_TERMINATE(result);
+    return (result);
+}
+
+/* old_decode - old implementation, for comparison */
+
+static VSTRING *old_decode(VSTRING *result, const char *in, ssize_t len)
 {
-    VSTRING *b1 = vstring_alloc(1);
-    VSTRING *b2 = vstring_alloc(1);
+    unsigned char un_b64[CHARS_PER_BYTE];
+    const unsigned char *cp;
+    ssize_t count;
+    unsigned int ch0;
+    unsigned int ch1;
+    unsigned int ch2;
+    unsigned int ch3;
+
+    if (len % 4)
+	return (0);
+    memset(un_b64, INVALID, CHARS_PER_BYTE);
+    for (cp = to_b64; cp < to_b64 + sizeof(to_b64) - 1; cp++)
+	un_b64[*cp] = cp - to_b64;
+    VSTRING_RESET(result);
+    for (cp = UNSIG_CHAR_PTR(in), count = 0; count < len; count += 4) {
+	if ((ch0 = un_b64[*cp++]) == INVALID
+	    || (ch1 = un_b64[*cp++]) == INVALID)
+	    return (0);
+	VSTRING_ADDCH(result, ch0 << 2 | ch1 >> 4);
+	if ((ch2 = *cp++) == '=')
+	    break;
+	if ((ch2 = un_b64[ch2]) == INVALID)
+	    return (0);
+	VSTRING_ADDCH(result, ch1 << 4 | ch2 >> 2);
+	if ((ch3 = *cp++) == '=')
+	    break;
+	if ((ch3 = un_b64[ch3]) == INVALID)
+	    return (0);
+	VSTRING_ADDCH(result, ch2 << 6 | ch3);
+    }
+    VSTRING_TERMINATE(result);
+    return (result);
+}
+
+/* same_result - compare old and new results */
+
+static void same_result(const char *what, VSTRING *old, VSTRING *new,
+			        int old_ok, int new_ok)
+{
+    if (old_ok != new_ok)
+	msg_panic("%s: old status %d, new status %d", what, old_ok, new_ok);
+    if (old_ok && (LEN(old) != LEN(new)
+		   || memcmp(STR(old), STR(new), LEN(old) + 1) != 0))
+	msg_panic("%s: old and new result differ", what);
+}
+
+/* elapsed - report time since start */
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/* conform - compare old and new results */
+
+static void conform(ssize_t size)
+{
+    VSTRING *data = vstring_alloc(size + 1);
+    VSTRING *enc = vstring_alloc(1);
+    VSTRING *old = vstring_alloc(1);
+    VSTRING *new = vstring_alloc(1);
+    ssize_t len;
+    ssize_t n;
+    int     old_ok;
+    int     new_ok;
+
+    /*
+     * All lengths up to the specified size, and random damage.
+     */
+    for (len = 0; len <= size; len++) {
+	VSTRING_RESET(data);
+	for (n = 0; n < len; n++)
+	    VSTRING_ADDCH(data, myrand());
+	VSTRING_TERMINATE(data);
+	old_encode(old, STR(data), LEN(data));
+	base64_encode(enc, STR(data), LEN(data));
+	same_result("encode", old, enc, 1, 1);
+	if (LEN(enc) > 0 && myrand() % 2)
+	    STR(enc)[myrand() % LEN(enc)] = "A=*\0"[myrand() % 4];
+	old_ok = (old_decode(old, STR(enc), LEN(enc)) != 0);
+	new_ok = (base64_decode(new, STR(enc), LEN(enc)) != 0);
+	same_result("decode", old, new, old_ok, new_ok);
+    }
+    vstring_free(data);
+    vstring_free(enc);
+    vstring_free(old);
+    vstring_free(new);
+}
+
+/* bench - compare old and new speed */
+
+static void bench(int count, ssize_t size)
+{
+    VSTRING *data = vstring_alloc(size + 1);
+    VSTRING *enc = vstring_alloc(1);
+    VSTRING *old = vstring_alloc(1);
+    VSTRING *new = vstring_alloc(1);
+    struct timeval start;
+    ssize_t n;
+    int     i;
+
+    VSTRING_RESET(data);
+    for (n = 0; n < size; n++)
+	VSTRING_ADDCH(data, myrand());
+    base64_encode(enc, STR(data), LEN(data));
+    GETTIMEOFDAY(&start);
+    for (i = 0; i < count; i++)
+	old_encode(old, STR(data), LEN(data));
+    vstream_printf("old: %d x encode %ld bytes: %.3f s\n",
+		   count, (long) size, elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (i = 0; i < count; i++)
+	base64_encode(new, STR(data), LEN(data));
+    vstream_printf("new: %d x encode %ld bytes: %.3f s\n",
+		   count, (long) size, elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (i = 0; i < count; i++)
+	if (old_decode(old, STR(enc), LEN(enc)) == 0)
+	    msg_panic("old: bad base64: %s", STR(enc));
+    vstream_printf("old: %d x decode %ld bytes: %.3f s\n",
+		   count, (long) LEN(enc), elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (i = 0; i < count; i++)
+	if (base64_decode(new, STR(enc), LEN(enc)) == 0)
+	    msg_panic("new: bad base64: %s", STR(enc));
+    vstream_printf("new: %d x decode %ld bytes: %.3f s\n",
+		   count, (long) LEN(enc), elapsed(&start));
+    vstream_fflush(VSTREAM_OUT);
+    vstring_free(data);
+    vstring_free(enc);
+    vstring_free(old);
+    vstring_free(new);
+}
+
+int     main(int argc, char **argv)
+{
+    VSTRING *b1;
+    VSTRING *b2;
     char    test[256];
     int     n;
 
+    if (argc == 3 && strcmp(argv[1], "-c") == 0) {
+	conform(atol(argv[2]));
+	return (0);
+    }
+    if (argc == 4 && strcmp(argv[1], "-b") == 0) {
+	conform(atol(argv[3]));
+	bench(atoi(argv[2]), atol(argv[3]));
+	return (0);
+    }
+    b1 = vstring_alloc(1);
+    b2 = vstring_alloc(1);
+
     for (n = 0; n < sizeof(test); n++)
 	test[n] = n;
     base64_encode(b1, test, sizeof(test));
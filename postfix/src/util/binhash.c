@@ -54,7 +54,9 @@
 /* DESCRIPTION
 /*	This module maintains one or more hash tables. Each table entry
 /*	consists of a unique binary-valued lookup key and a generic
-/*	character-pointer value.
+/*	character-pointer value. Lookup keys are hashed with a keyed
+/*	hash function, so that clients cannot easily choose keys that
+/*	collide.
 /*	The tables are automatically resized when they fill up. When the
 /*	values to be remembered are not character pointers, proper casts
 /*	should be used or the code will not be portable.
@@ -86,11 +88,12 @@
 /*
 /*	binhash_walk() invokes the action function for each table entry, with
 /*	a pointer to the entry as its argument. The ptr argument is passed
-/*	on to the action function.
+/*	on to the action function. Entries are visited in the order that
+/*	they were added to the table.
 /*
 /*	binhash_list() returns a null-terminated list of pointers to
-/*	all elements in the named table. The list should be passed to
-/*	myfree().
+/*	all elements in the named table, in the order that they were
+/*	added to the table. The list should be passed to myfree().
 /* RESTRICTIONS
 /*	A callback function should not modify the hash table that is
 /*	specified to its caller.
@@ -99,6 +102,7 @@
 /*	terminate immediately: memory allocation failure; an attempt
 /*	to delete a non-existent entry.
 /* SEE ALSO
+/*	hash_sip(3) keyed hash function
 /*	mymalloc(3) memory management wrapper
 /* LICENSE
 /* .ad
@@ -120,54 +124,108 @@
 
 #include "mymalloc.h"
 #include "msg.h"
+#include "hash_sip.h"
 #include "binhash.h"
 
-/* binhash_hash - hash a string */
-
-static size_t binhash_hash(const void *key, ssize_t len, size_t size)
+ /*
+  * The table uses open addressing, with the same layout as htable(3):
+  * groups of control bytes with the state or the high 7 bits of the hash
+  * value of each entry, followed by the pointers to the entries. Entries
+  * are not moved when the table is resized, and are also kept on a list in
+  * insertion order.
+  */
+typedef unsigned long BINHASH_WORD;
+
+#define BINHASH_GROUP_SIZE	((ssize_t) sizeof(BINHASH_WORD))
+
+struct BINHASH_GROUP {
+    unsigned char ctrl[sizeof(BINHASH_WORD)];	/* per-entry state */
+    BINHASH_INFO *info[sizeof(BINHASH_WORD)];	/* entries */
+};
+
+#define BINHASH_CTRL_EMPTY	0x80
+#define BINHASH_CTRL_DELETED	0xfe
+#define BINHASH_CTRL_TAG(h)	(((h) >> 25) & 0x7f)
+
+#define BINHASH_WORD_LSB		(~(BINHASH_WORD) 0 / 0xff)
+#define BINHASH_WORD_MSB		(BINHASH_WORD_LSB << 7)
+
+ /*
+  * Non-zero if a control byte may match the tag. This may produce false
+  * positives, but never false negatives.
+  */
+#define BINHASH_WORD_MATCH(w, tag) \
+	((((w) ^ (BINHASH_WORD_LSB * (tag))) - BINHASH_WORD_LSB) \
+	 & ~((w) ^ (BINHASH_WORD_LSB * (tag))) & BINHASH_WORD_MSB)
+
+ /*
+  * Non-zero if a control byte is empty, or is empty or deleted.
+  */
+#define BINHASH_WORD_EMPTY(w)	((w) & ~((w) << 6) & BINHASH_WORD_MSB)
+#define BINHASH_WORD_FREE(w)	((w) & BINHASH_WORD_MSB)
+
+#define BINHASH_MIN_SIZE		(2 * BINHASH_GROUP_SIZE)
+#define BINHASH_MAX_FILL(size)	((size) - (size) / 8)
+
+ /*
+  * Probe groups in triangular order. This visits every group when the
+  * number of groups is a power of 2.
+  */
+#define BINHASH_PROBE_START(table, hash, g, stride) \
+	((stride) = 0, \
+	 (g) = (hash) & ((table)->size / BINHASH_GROUP_SIZE - 1))
+
+#define BINHASH_PROBE_NEXT(table, g, stride) \
+	((stride) += 1, \
+	 (g) = ((g) + (stride)) & ((table)->size / BINHASH_GROUP_SIZE - 1))
+
+/* binhash_word - load control bytes of group */
+
+static BINHASH_WORD binhash_word(struct BINHASH_GROUP *group)
 {
-    size_t  h = 0;
-    size_t  g;
-
-    /*
-     * From the "Dragon" book by Aho, Sethi and Ullman.
-     */
-
-    while (len-- > 0) {
-	h = (h << 4U) + *(unsigned const char *) key++;
-	if ((g = (h & 0xf0000000)) != 0) {
-	    h ^= (g >> 24U);
-	    h ^= g;
-	}
-    }
-    return (h % size);
+    BINHASH_WORD word;
+
+    memcpy((void *) &word, group->ctrl, sizeof(word));
+    return (word);
 }
 
 /* binhash_link - insert element into table */
 
-#define binhash_link(table, elm) { \
-    BINHASH_INFO **_h = table->data + binhash_hash(elm->key, elm->key_len, table->size);\
-    elm->prev = 0; \
-    if ((elm->next = *_h) != 0) \
-	(*_h)->prev = elm; \
-    *_h = elm; \
-    table->used++; \
+static void binhash_link(BINHASH *table, BINHASH_INFO *element)
+{
+    struct BINHASH_GROUP *group;
+    ssize_t g;
+    ssize_t stride;
+    ssize_t i;
+
+    for (BINHASH_PROBE_START(table, element->hash, g, stride); /* void */ ;
+	 BINHASH_PROBE_NEXT(table, g, stride)) {
+	group = table->data + g;
+	if (BINHASH_WORD_FREE(binhash_word(group)))
+	    break;
+    }
+    for (i = 0; (group->ctrl[i] & BINHASH_CTRL_EMPTY) == 0; i++)
+	 /* void */ ;
+    if (group->ctrl[i] == BINHASH_CTRL_EMPTY)
+	table->fill++;
+    group->ctrl[i] = BINHASH_CTRL_TAG(element->hash);
+    group->info[i] = element;
+    table->used++;
 }
 
 /* binhash_size - allocate and initialize hash table */
 
 static void binhash_size(BINHASH *table, size_t size)
 {
-    BINHASH_INFO **h;
-
-    size |= 1;
+    ssize_t g;
 
-    table->data = h = (BINHASH_INFO **) mymalloc(size * sizeof(BINHASH_INFO *));
+    table->data = (struct BINHASH_GROUP *)
+	mymalloc(size / BINHASH_GROUP_SIZE * sizeof(struct BINHASH_GROUP));
+    for (g = 0; g < size / BINHASH_GROUP_SIZE; g++)
+	memset(table->data[g].ctrl, BINHASH_CTRL_EMPTY, BINHASH_GROUP_SIZE);
     table->size = size;
     table->used = 0;
-
-    while (size-- > 0)
-	*h++ = 0;
+    table->fill = 0;
 }
 
 /* binhash_create - create initial hash table */
@@ -175,31 +233,28 @@ static void binhash_size(BINHASH *table, size_t size)
 BINHASH *binhash_create(ssize_t size)
 {
     BINHASH *table;
+    ssize_t new_size;
 
+    for (new_size = BINHASH_MIN_SIZE; BINHASH_MAX_FILL(new_size) <= size;
+	 new_size *= 2)
+	 /* void */ ;
     table = (BINHASH *) mymalloc(sizeof(BINHASH));
-    binhash_size(table, size < 13 ? 13 : size);
+    binhash_size(table, new_size);
+    table->head = table->tail = 0;
     return (table);
 }
 
-/* binhash_grow - extend existing table */
+/* binhash_grow - extend existing table, or purge deleted entries */
 
 static void binhash_grow(BINHASH *table)
 {
     BINHASH_INFO *ht;
-    BINHASH_INFO *next;
     ssize_t old_size = table->size;
-    BINHASH_INFO **h = table->data;
-    BINHASH_INFO **old_entries = h;
-
-    binhash_size(table, 2 * old_size);
 
-    while (old_size-- > 0) {
-	for (ht = *h++; ht; ht = next) {
-	    next = ht->next;
-	    binhash_link(table, ht);
-	}
-    }
-    myfree((void *) old_entries);
+    myfree((void *) table->data);
+    binhash_size(table, table->used >= old_size / 2 ? 2 * old_size : old_size);
+    for (ht = table->head; ht; ht = ht->next)
+	binhash_link(table, ht);
 }
 
 /* binhash_enter - enter (key, value) pair */
@@ -208,28 +263,68 @@ BINHASH_INFO *binhash_enter(BINHASH *table, const void *key, ssize_t key_len, vo
 {
     BINHASH_INFO *ht;
 
-    if (table->used >= table->size)
+    if (table->fill >= BINHASH_MAX_FILL(table->size))
 	binhash_grow(table);
     ht = (BINHASH_INFO *) mymalloc(sizeof(BINHASH_INFO));
     ht->key = mymemdup(key, key_len);
     ht->key_len = key_len;
     ht->value = value;
+    ht->hash = hash_sip(key, key_len);
     binhash_link(table, ht);
+    ht->next = 0;
+    if ((ht->prev = table->tail) != 0)
+	table->tail->next = ht;
+    else
+	table->head = ht;
+    table->tail = ht;
     return (ht);
 }
 
-/* binhash_find - lookup value */
+/* binhash_index - find table position of entry */
 
-void   *binhash_find(BINHASH *table, const void *key, ssize_t key_len)
+static ssize_t binhash_index(BINHASH *table, const void *key, ssize_t key_len)
 {
+    unsigned hash = hash_sip(key, key_len);
+    int     tag = BINHASH_CTRL_TAG(hash);
+    struct BINHASH_GROUP *group;
+    BINHASH_WORD word;
     BINHASH_INFO *ht;
+    ssize_t g;
+    ssize_t stride;
+    ssize_t i;
 
-#define	KEY_EQ(x,y,l) (((unsigned char *) x)[0] == ((unsigned char *) y)[0] && memcmp(x,y,l) == 0)
+#define	KEY_EQ(x,y,l) (memcmp(x,y,l) == 0)
+
+    for (BINHASH_PROBE_START(table, hash, g, stride); /* void */ ;
+	 BINHASH_PROBE_NEXT(table, g, stride)) {
+	group = table->data + g;
+	word = binhash_word(group);
+	if (BINHASH_WORD_MATCH(word, tag)) {
+	    for (i = 0; i < BINHASH_GROUP_SIZE; i++) {
+		if (group->ctrl[i] == tag) {
+		    ht = group->info[i];
+		    if (ht->hash == hash && key_len == ht->key_len
+			&& KEY_EQ(key, ht->key, key_len))
+			return (g * BINHASH_GROUP_SIZE + i);
+		}
+	    }
+	}
+	if (BINHASH_WORD_EMPTY(word))
+	    return (-1);
+    }
+}
+
+#define BINHASH_INFO_AT(table, pos) \
+	((table)->data[(pos) / BINHASH_GROUP_SIZE].info[(pos) % BINHASH_GROUP_SIZE])
+
+/* binhash_find - lookup value */
+
+void   *binhash_find(BINHASH *table, const void *key, ssize_t key_len)
+{
+    ssize_t pos;
 
-    if (table != 0)
-	for (ht = table->data[binhash_hash(key, key_len, table->size)]; ht; ht = ht->next)
-	    if (key_len == ht->key_len && KEY_EQ(key, ht->key, key_len))
-		return (ht->value);
+    if (table && (pos = binhash_index(table, key, key_len)) >= 0)
+	return (BINHASH_INFO_AT(table, pos)->value);
     return (0);
 }
 
@@ -237,12 +332,10 @@ void   *binhash_find(BINHASH *table, const void *key, ssize_t key_len)
 
 BINHASH_INFO *binhash_locate(BINHASH *table, const void *key, ssize_t key_len)
 {
-    BINHASH_INFO *ht;
+    ssize_t pos;
 
-    if (table != 0)
-	for (ht = table->data[binhash_hash(key, key_len, table->size)]; ht; ht = ht->next)
-	    if (key_len == ht->key_len && KEY_EQ(key, ht->key, key_len))
-		return (ht);
+    if (table && (pos = binhash_index(table, key, key_len)) >= 0)
+	return (BINHASH_INFO_AT(table, pos));
     return (0);
 }
 
@@ -251,26 +344,35 @@ BINHASH_INFO *binhash_locate(BINHASH *table, const void *key, ssize_t key_len)
 void    binhash_delete(BINHASH *table, const void *key, ssize_t key_len, void (*free_fn) (void *))
 {
     if (table != 0) {
+	struct BINHASH_GROUP *group;
 	BINHASH_INFO *ht;
-	BINHASH_INFO **h = table->data + binhash_hash(key, key_len, table->size);
-
-	for (ht = *h; ht; ht = ht->next) {
-	    if (key_len == ht->key_len && KEY_EQ(key, ht->key, key_len)) {
-		if (ht->next)
-		    ht->next->prev = ht->prev;
-		if (ht->prev)
-		    ht->prev->next = ht->next;
-		else
-		    *h = ht->next;
-		table->used--;
-		myfree(ht->key);
-		if (free_fn)
-		    (*free_fn) (ht->value);
-		myfree((void *) ht);
-		return;
-	    }
+	ssize_t pos;
+	ssize_t i;
+
+	if ((pos = binhash_index(table, key, key_len)) < 0)
+	    msg_panic("binhash_delete: unknown_key: \"%s\"", (char *) key);
+	group = table->data + pos / BINHASH_GROUP_SIZE;
+	i = pos % BINHASH_GROUP_SIZE;
+	ht = group->info[i];
+	if (BINHASH_WORD_EMPTY(binhash_word(group))) {
+	    group->ctrl[i] = BINHASH_CTRL_EMPTY;
+	    table->fill--;
+	} else {
+	    group->ctrl[i] = BINHASH_CTRL_DELETED;
 	}
-	msg_panic("binhash_delete: unknown_key: \"%s\"", (char *) key);
+	if (ht->next)
+	    ht->next->prev = ht->prev;
+	else
+	    table->tail = ht->prev;
+	if (ht->prev)
+	    ht->prev->next = ht->next;
+	else
+	    table->head = ht->next;
+	table->used--;
+	myfree(ht->key);
+	if (free_fn)
+	    (*free_fn) (ht->value);
+	myfree((void *) ht);
     }
 }
 
@@ -279,19 +381,15 @@ void    binhash_delete(BINHASH *table, const void *key, ssize_t key_len, void (*
 void    binhash_free(BINHASH *table, void (*free_fn) (void *))
 {
     if (table != 0) {
-	ssize_t i = table->size;
 	BINHASH_INFO *ht;
 	BINHASH_INFO *next;
-	BINHASH_INFO **h = table->data;
-
-	while (i-- > 0) {
-	    for (ht = *h++; ht; ht = next) {
-		next = ht->next;
-		myfree(ht->key);
-		if (free_fn)
-		    (*free_fn) (ht->value);
-		myfree((void *) ht);
-	    }
+
+	for (ht = table->head; ht; ht = next) {
+	    next = ht->next;
+	    myfree(ht->key);
+	    if (free_fn)
+		(*free_fn) (ht->value);
+	    myfree((void *) ht);
 	}
 	myfree((void *) table->data);
 	table->data = 0;
@@ -304,13 +402,10 @@ void    binhash_free(BINHASH *table, void (*free_fn) (void *))
 void    binhash_walk(BINHASH *table, void (*action) (BINHASH_INFO *, void *),
 		             void *ptr) {
     if (table != 0) {
-	ssize_t i = table->size;
-	BINHASH_INFO **h = table->data;
 	BINHASH_INFO *ht;
 
-	while (i-- > 0)
-	    for (ht = *h++; ht; ht = ht->next)
-		(*action) (ht, ptr);
+	for (ht = table->head; ht; ht = ht->next)
+	    (*action) (ht, ptr);
     }
 }
 
@@ -322,13 +417,11 @@ BINHASH *table;
     BINHASH_INFO **list;
     BINHASH_INFO *member;
     ssize_t count = 0;
-    ssize_t i;
 
     if (table != 0) {
 	list = (BINHASH_INFO **) mymalloc(sizeof(*list) * (table->used + 1));
-	for (i = 0; i < table->size; i++)
-	    for (member = table->data[i]; member != 0; member = member->next)
-		list[count++] = member;
+	for (member = table->head; member != 0; member = member->next)
+	    list[count++] = member;
     } else {
 	list = (BINHASH_INFO **) mymalloc(sizeof(*list));
     }
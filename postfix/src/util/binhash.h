@@ -17,8 +17,9 @@ typedef struct BINHASH_INFO {
     void   *key;			/* lookup key */
     ssize_t key_len;			/* key length */
     void   *value;			/* associated value */
-    struct BINHASH_INFO *next;		/* colliding entry */
-    struct BINHASH_INFO *prev;		/* colliding entry */
+    struct BINHASH_INFO *next;		/* next entry, in insertion order */
+    struct BINHASH_INFO *prev;		/* previous entry */
+    unsigned hash;			/* keyed hash of lookup key */
 } BINHASH_INFO;
 
  /* Structure of one hash table. */
@@ -26,7 +27,10 @@ typedef struct BINHASH_INFO {
 typedef struct BINHASH {
     ssize_t size;			/* length of entries array */
     ssize_t used;			/* number of entries in table */
-    BINHASH_INFO **data;		/* entries array, auto-resized */
+    ssize_t fill;			/* used + deleted entries */
+    struct BINHASH_GROUP *data;		/* entries array, auto-resized */
+    BINHASH_INFO *head;			/* first entry, in insertion order */
+    BINHASH_INFO *tail;			/* last entry, in insertion order */
 } BINHASH;
 
 extern BINHASH *binhash_create(ssize_t);
@@ -15,6 +15,17 @@
 /*	CIDR_MATCH *info;
 /*	const char *address;
 /* AUXILIARY FUNCTIONS
+/*	int	cidr_match_addr(address, addr_bytes)
+/*	const char *address;
+/*	unsigned char addr_bytes[CIDR_MATCH_ABYTES];
+/*
+/*	CIDR_MATCH *cidr_match_execute_addr(info, stop, addr_family,
+/*					addr_bytes)
+/*	CIDR_MATCH *info;
+/*	CIDR_MATCH *stop;
+/*	int	addr_family;
+/*	const unsigned char *addr_bytes;
+/*
 /*	VSTRING *cidr_match_parse_if(info, pattern, match, why)
 /*	CIDR_MATCH *info;
 /*	char	*pattern;
@@ -50,6 +61,16 @@
 /*	cidr_match_execute() matches the specified address against
 /*	a list of parsed expressions, and returns the matching
 /*	expression's data structure.
+/*
+/*	cidr_match_addr() converts a printable address to binary
+/*	form, and returns the address family, or zero if the address
+/*	is invalid.
+/*
+/*	cidr_match_execute_addr() is like cidr_match_execute(), but
+/*	takes an address that was converted with cidr_match_addr(),
+/*	and stops at the specified list member (a null pointer means
+/*	the end of the list). The stop member must not be inside an
+/*	IF..ENDIF block that starts before it.
 /* SEE ALSO
 /*	dict_cidr(3) CIDR-style lookup table
 /* AUTHOR(S)
@@ -114,11 +135,11 @@
 /* cidr_match_entry - match one entry */
 
 static inline int cidr_match_entry(CIDR_MATCH *entry,
-				           unsigned char *addr_bytes)
+				           const unsigned char *addr_bytes)
 {
     unsigned char *mp;
     unsigned char *np;
-    unsigned char *ap;
+    const unsigned char *ap;
 
     /* Unoptimized case: netmask with some or all bits zero. */
     if (entry->mask_shift < entry->addr_bit_count) {
@@ -143,19 +164,40 @@ static inline int cidr_match_entry(CIDR_MATCH *entry,
     return (!entry->match);
 }
 
+/* cidr_match_addr - convert address to binary form */
+
+int     cidr_match_addr(const char *addr, unsigned char *addr_bytes)
+{
+    int     addr_family;
+
+    addr_family = CIDR_MATCH_ADDR_FAMILY(addr);
+    if (inet_pton(addr_family, addr, addr_bytes) != 1)
+	return (0);
+    return (addr_family);
+}
+
 /* cidr_match_execute - match address against compiled CIDR pattern list */
 
 CIDR_MATCH *cidr_match_execute(CIDR_MATCH *list, const char *addr)
 {
     unsigned char addr_bytes[CIDR_MATCH_ABYTES];
-    unsigned addr_family;
-    CIDR_MATCH *entry;
+    int     addr_family;
 
-    addr_family = CIDR_MATCH_ADDR_FAMILY(addr);
-    if (inet_pton(addr_family, addr, addr_bytes) != 1)
+    if ((addr_family = cidr_match_addr(addr, addr_bytes)) == 0)
 	return (0);
+    return (cidr_match_execute_addr(list, (CIDR_MATCH *) 0,
+				    addr_family, addr_bytes));
+}
+
+/* cidr_match_execute_addr - match binary address against partial list */
+
+CIDR_MATCH *cidr_match_execute_addr(CIDR_MATCH *list, CIDR_MATCH *stop,
+				            int addr_family,
+				            const unsigned char *addr_bytes)
+{
+    CIDR_MATCH *entry;
 
-    for (entry = list; entry; entry = entry->next) {
+    for (entry = list; entry != stop; entry = entry->next) {
 
 	switch (entry->op) {
 
@@ -62,6 +62,9 @@ extern VSTRING *cidr_match_parse_if(CIDR_MATCH *, char *, int, VSTRING *);
 extern void cidr_match_endif(CIDR_MATCH *);
 
 extern CIDR_MATCH *cidr_match_execute(CIDR_MATCH *, const char *);
+extern int cidr_match_addr(const char *, unsigned char *);
+extern CIDR_MATCH *cidr_match_execute_addr(CIDR_MATCH *, CIDR_MATCH *, int,
+					           const unsigned char *);
 
 /* LICENSE
 /* .ad
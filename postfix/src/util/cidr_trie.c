@@ -0,0 +1,492 @@
+/*++
+/* NAME
+/*	cidr_trie 3
+/* SUMMARY
+/*	first-match index for CIDR patterns
+/* SYNOPSIS
+/*	#include <cidr_trie.h>
+/*
+/*	CIDR_TRIE *cidr_trie_create()
+/*
+/*	void	cidr_trie_add(trie, info)
+/*	CIDR_TRIE *trie;
+/*	CIDR_MATCH *info;
+/*
+/*	CIDR_MATCH *cidr_trie_find(trie, addr_family, addr_bytes)
+/*	CIDR_TRIE *trie;
+/*	int	addr_family;
+/*	const unsigned char *addr_bytes;
+/*
+/*	void	cidr_trie_free(trie)
+/*	CIDR_TRIE *trie;
+/* DESCRIPTION
+/*	This module indexes a sequence of positive CIDR patterns
+/*	(as parsed with cidr_match_parse()) in a path-compressed
+/*	binary radix tree, one tree per address family. A search
+/*	returns the same pattern as a linear cidr_match_execute()
+/*	search of the same sequence: the first pattern in insertion
+/*	order that matches the address, not the longest one.
+/*
+/*	Each tree node remembers the first pattern with exactly
+/*	that network prefix, and the lowest insertion order in its
+/*	subtree. A search walks down the bits of the address, and
+/*	stops when no subtree pattern can beat the best match so
+/*	far. The cost is proportional to the address length, not
+/*	to the number of patterns.
+/*
+/*	cidr_trie_create() creates an empty index.
+/*
+/*	cidr_trie_add() appends the specified pattern. The pattern
+/*	must be a positive CIDR_MATCH_OP_MATCH pattern, and must
+/*	not be modified or destroyed before the index is destroyed.
+/*	Of patterns with the same network and mask, only the first
+/*	one can be found.
+/*
+/*	cidr_trie_find() returns the first pattern that matches the
+/*	specified binary address, or a null pointer.
+/*
+/*	cidr_trie_free() destroys the index, but not the patterns.
+/* SEE ALSO
+/*	cidr_match(3) CIDR-style pattern matching
+/*	dict_cidr(3) CIDR-style lookup table
+/* DIAGNOSTICS
+/*	Panic: invalid pattern.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <cidr_trie.h>
+
+/* Application-specific. */
+
+ /*
+  * A tree node has a network prefix that is shared by all nodes in its
+  * subtree. The prefix bits are borrowed from a pattern below this node.
+  * Only nodes with a pattern are matched; other nodes are branch points.
+  */
+typedef struct CIDR_TRIE_NODE {
+    const unsigned char *net_bytes;	/* network prefix */
+    int     mask_shift;			/* prefix length */
+    int     order;			/* insertion order of info */
+    int     min_order;			/* lowest order in subtree */
+    CIDR_MATCH *info;			/* pattern or null */
+    struct CIDR_TRIE_NODE *child[2];	/* next bit 0 or 1 */
+} CIDR_TRIE_NODE;
+
+ /*
+  * One tree per address family.
+  */
+#ifdef HAS_IPV6
+#define CIDR_TRIE_FAMILIES	2
+#define CIDR_TRIE_FAMILY_INDEX(f) ((f) == AF_INET6)
+#else
+#define CIDR_TRIE_FAMILIES	1
+#define CIDR_TRIE_FAMILY_INDEX(f) 0
+#endif
+
+struct CIDR_TRIE {
+    CIDR_TRIE_NODE *root[CIDR_TRIE_FAMILIES];
+    int     count;			/* patterns added so far */
+};
+
+#define CIDR_TRIE_BIT(bytes, n) (((bytes)[(n) >> 3] >> (7 - ((n) & 7))) & 1)
+
+/* cidr_trie_common - length of common prefix, up to limit bits */
+
+static int cidr_trie_common(const unsigned char *a, const unsigned char *b,
+			            int limit)
+{
+    int     bits;
+    unsigned char diff;
+
+    for (bits = 0; bits < limit; bits += 8) {
+	if ((diff = a[bits >> 3] ^ b[bits >> 3]) != 0) {
+	    while ((diff & 0x80) == 0) {
+		diff <<= 1;
+		bits++;
+	    }
+	    break;
+	}
+    }
+    return (bits < limit ? bits : limit);
+}
+
+/* cidr_trie_node - create tree node */
+
+static CIDR_TRIE_NODE *cidr_trie_node(const unsigned char *net_bytes,
+				              int mask_shift)
+{
+    CIDR_TRIE_NODE *node;
+
+    node = (CIDR_TRIE_NODE *) mymalloc(sizeof(*node));
+    node->net_bytes = net_bytes;
+    node->mask_shift = mask_shift;
+    node->order = 0;
+    node->min_order = 0;
+    node->info = 0;
+    node->child[0] = node->child[1] = 0;
+    return (node);
+}
+
+/* cidr_trie_create - create empty index */
+
+CIDR_TRIE *cidr_trie_create(void)
+{
+    CIDR_TRIE *trie;
+    int     n;
+
+    trie = (CIDR_TRIE *) mymalloc(sizeof(*trie));
+    for (n = 0; n < CIDR_TRIE_FAMILIES; n++)
+	trie->root[n] = 0;
+    trie->count = 0;
+    return (trie);
+}
+
+/* cidr_trie_add - append pattern to index */
+
+void    cidr_trie_add(CIDR_TRIE *trie, CIDR_MATCH *info)
+{
+    const char *myname = "cidr_trie_add";
+    CIDR_TRIE_NODE **link;
+    CIDR_TRIE_NODE *node;
+    CIDR_TRIE_NODE *fork;
+    CIDR_TRIE_NODE *leaf;
+    int     order;
+    int     common;
+
+    if (info->op != CIDR_MATCH_OP_MATCH || info->match != CIDR_MATCH_TRUE)
+	msg_panic("%s: bad pattern op=%d match=%d",
+		  myname, info->op, info->match);
+
+    order = ++trie->count;
+    link = trie->root + CIDR_TRIE_FAMILY_INDEX(info->addr_family);
+
+    /*
+     * Walk down the tree until the pattern's prefix is reached, or until
+     * the pattern diverges from a compressed path. Patterns are added in
+     * order, so the subtree order of existing nodes stays the same.
+     */
+    for (;;) {
+	if ((node = *link) == 0) {
+	    node = cidr_trie_node(info->net_bytes, info->mask_shift);
+	    node->info = info;
+	    node->order = node->min_order = order;
+	    *link = node;
+	    return;
+	}
+	common = cidr_trie_common(node->net_bytes, info->net_bytes,
+				  node->mask_shift < info->mask_shift ?
+				  node->mask_shift : info->mask_shift);
+	if (common < node->mask_shift) {
+	    /* The pattern is a prefix of this node, or they diverge. */
+	    if (common == info->mask_shift) {
+		fork = cidr_trie_node(info->net_bytes, info->mask_shift);
+		fork->info = info;
+		fork->order = order;
+	    } else {
+		fork = cidr_trie_node(info->net_bytes, common);
+		leaf = cidr_trie_node(info->net_bytes, info->mask_shift);
+		leaf->info = info;
+		leaf->order = leaf->min_order = order;
+		fork->child[CIDR_TRIE_BIT(info->net_bytes, common)] = leaf;
+	    }
+	    fork->child[CIDR_TRIE_BIT(node->net_bytes, common)] = node;
+	    fork->min_order = node->min_order;
+	    *link = fork;
+	    return;
+	}
+	if (node->mask_shift == info->mask_shift) {
+	    /* Same network and mask: an earlier pattern always wins. */
+	    if (node->info == 0) {
+		node->info = info;
+		node->order = order;
+	    }
+	    return;
+	}
+	link = node->child + CIDR_TRIE_BIT(info->net_bytes, node->mask_shift);
+    }
+}
+
+/* cidr_trie_find - find first matching pattern */
+
+CIDR_MATCH *cidr_trie_find(CIDR_TRIE *trie, int addr_family,
+			           const unsigned char *addr_bytes)
+{
+    CIDR_TRIE_NODE *node;
+    CIDR_TRIE_NODE *best = 0;
+
+#ifndef HAS_IPV6
+    if (addr_family != AF_INET)
+	return (0);
+#endif
+
+    /*
+     * Stop at the first node whose prefix does not match, or when no
+     * pattern in the subtree was added before the best match so far. A node
+     * with a full-length prefix has no children.
+     */
+    node = trie->root[CIDR_TRIE_FAMILY_INDEX(addr_family)];
+    while (node != 0 && (best == 0 || node->min_order < best->order)) {
+	if (cidr_trie_common(node->net_bytes, addr_bytes, node->mask_shift)
+	    < node->mask_shift)
+	    break;
+	if (node->info != 0 && (best == 0 || node->order < best->order))
+	    best = node;
+	if (node->child[0] == 0 && node->child[1] == 0)
+	    break;
+	node = node->child[CIDR_TRIE_BIT(addr_bytes, node->mask_shift)];
+    }
+    return (best ? best->info : 0);
+}
+
+/* cidr_trie_free_node - destroy subtree */
+
+static void cidr_trie_free_node(CIDR_TRIE_NODE *node)
+{
+    if (node->child[0])
+	cidr_trie_free_node(node->child[0]);
+    if (node->child[1])
+	cidr_trie_free_node(node->child[1]);
+    myfree((void *) node);
+}
+
+/* cidr_trie_free - destroy index */
+
+void    cidr_trie_free(CIDR_TRIE *trie)
+{
+    int     n;
+
+    for (n = 0; n < CIDR_TRIE_FAMILIES; n++)
+	if (trie->root[n])
+	    cidr_trie_free_node(trie->root[n]);
+    myfree((void *) trie);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Usage:
+  * 
+  * cidr_trie map_file <address_file
+  * 
+  * Each map file line has a CIDR pattern, and optional text. Each input line
+  * has an address. The program reports the text of the first matching
+  * pattern, and complains when a linear search finds a different pattern.
+  * 
+  * cidr_trie -b patterns lookups
+  * 
+  * Compares the cost of linear and indexed lookups, with a table of random
+  * patterns, and random addresses that mostly match some pattern.
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <arpa/inet.h>
+#include <msg_vstream.h>
+#include <myrand.h>
+#include <stringops.h>
+#include <vstring_vstream.h>
+
+typedef struct {
+    CIDR_MATCH info;			/* must be first */
+    char   *text;
+} TEST_ENTRY;
+
+static TEST_ENTRY *test_entry(char *pattern, const char *text, VSTRING *why)
+{
+    TEST_ENTRY *entry;
+
+    entry = (TEST_ENTRY *) mymalloc(sizeof(*entry));
+    if (cidr_match_parse(&entry->info, pattern, CIDR_MATCH_TRUE, why) != 0) {
+	myfree((void *) entry);
+	return (0);
+    }
+    entry->text = mystrdup(text);
+    return (entry);
+}
+
+static double test_elapsed(struct timeval * start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static void test_bench(int npatterns, int nlookups)
+{
+    CIDR_TRIE *trie = cidr_trie_create();
+    CIDR_MATCH *head = 0;
+    CIDR_MATCH **link = &head;
+    TEST_ENTRY *entry;
+    VSTRING *buf = vstring_alloc(100);
+    VSTRING *why = vstring_alloc(100);
+    unsigned char (*addrs)[MAI_V4ADDR_BYTES];
+    unsigned char net[MAI_V4ADDR_BYTES];
+    CIDR_MATCH *linear_match;
+    CIDR_MATCH *trie_match;
+    struct timeval start;
+    double  linear_time;
+    double  trie_time;
+    int     mask_shift;
+    int     found = 0;
+    int     n;
+    int     i;
+
+    /*
+     * A blocklist-like mix of /32 hosts and /16../24 networks.
+     */
+    mysrand(1);
+    addrs = (unsigned char (*)[MAI_V4ADDR_BYTES])
+	mymalloc(sizeof(*addrs) * nlookups);
+    for (n = 0; n < npatterns; n++) {
+	mask_shift = (n % 4 == 0 ? 32 : 16 + myrand() % 9);
+	for (i = 0; i < MAI_V4ADDR_BYTES; i++)
+	    net[i] = myrand() & 0xff;
+	for (i = mask_shift; i < MAI_V4ADDR_BITS; i++)
+	    net[i >> 3] &= ~(1 << (7 - (i & 7)));
+	vstring_sprintf(buf, "%d.%d.%d.%d/%d",
+			net[0], net[1], net[2], net[3], mask_shift);
+	if ((entry = test_entry(vstring_str(buf), "", why)) == 0)
+	    msg_fatal("%s", vstring_str(why));
+	*link = &entry->info;
+	link = &entry->info.next;
+	cidr_trie_add(trie, &entry->info);
+	if (n < nlookups)
+	    memcpy(addrs[n], net, MAI_V4ADDR_BYTES);
+    }
+    for (n = 0; n < nlookups; n++) {
+	if (n >= npatterns || myrand() % 4 == 0)
+	    for (i = 0; i < MAI_V4ADDR_BYTES; i++)
+		addrs[n][i] = myrand() & 0xff;
+	else
+	    addrs[n][MAI_V4ADDR_BYTES - 1] |= myrand() & 0xff;
+    }
+
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < nlookups; n++)
+	(void) cidr_match_execute_addr(head, (CIDR_MATCH *) 0, AF_INET,
+				       addrs[n]);
+    linear_time = test_elapsed(&start);
+
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < nlookups; n++)
+	(void) cidr_trie_find(trie, AF_INET, addrs[n]);
+    trie_time = test_elapsed(&start);
+
+    for (n = 0; n < nlookups; n++) {
+	linear_match = cidr_match_execute_addr(head, (CIDR_MATCH *) 0,
+					       AF_INET, addrs[n]);
+	trie_match = cidr_trie_find(trie, AF_INET, addrs[n]);
+	if (linear_match != trie_match)
+	    msg_fatal("lookup %d: linear and indexed results differ", n);
+	found += (trie_match != 0);
+    }
+    vstream_printf("%d patterns, %d lookups, %d found\n",
+		   npatterns, nlookups, found);
+    vstream_printf("linear: %.3f us/lookup\n",
+		   linear_time * 1000000.0 / nlookups);
+    vstream_printf("radix:  %.3f us/lookup\n",
+		   trie_time * 1000000.0 / nlookups);
+    vstream_fflush(VSTREAM_OUT);
+
+    cidr_trie_free(trie);
+    myfree((void *) addrs);
+    vstring_free(buf);
+    vstring_free(why);
+}
+
+int     main(int argc, char **argv)
+{
+    CIDR_TRIE *trie;
+    CIDR_MATCH *head = 0;
+    CIDR_MATCH **link = &head;
+    TEST_ENTRY *entry;
+    VSTREAM *fp;
+    VSTRING *buf;
+    VSTRING *why;
+    char   *cp;
+    char   *pattern;
+    unsigned char addr_bytes[CIDR_MATCH_ABYTES];
+    int     addr_family;
+    CIDR_MATCH *linear_match;
+    CIDR_MATCH *trie_match;
+    int     errors = 0;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+
+    if (argc == 4 && strcmp(argv[1], "-b") == 0) {
+	test_bench(atoi(argv[2]), atoi(argv[3]));
+	exit(0);
+    }
+    if (argc != 2)
+	msg_fatal("usage: %s map_file | -b patterns lookups", argv[0]);
+
+    buf = vstring_alloc(100);
+    why = vstring_alloc(100);
+    trie = cidr_trie_create();
+    if ((fp = vstream_fopen(argv[1], O_RDONLY, 0)) == 0)
+	msg_fatal("open %s: %m", argv[1]);
+    while (vstring_get_nonl(buf, fp) != VSTREAM_EOF) {
+	cp = vstring_str(buf);
+	if ((pattern = mystrtok(&cp, CHARS_SPACE)) == 0 || *pattern == '#')
+	    continue;
+	while (*cp && ISSPACE(*cp))
+	    cp++;
+	if ((entry = test_entry(pattern, cp, why)) == 0) {
+	    msg_warn("%s", vstring_str(why));
+	    continue;
+	}
+	*link = &entry->info;
+	link = &entry->info.next;
+	cidr_trie_add(trie, &entry->info);
+    }
+    (void) vstream_fclose(fp);
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	cp = vstring_str(buf);
+	if ((pattern = mystrtok(&cp, CHARS_SPACE)) == 0 || *pattern == '#')
+	    continue;
+	if ((addr_family = cidr_match_addr(pattern, addr_bytes)) == 0) {
+	    vstream_printf("%s: bad address\n", pattern);
+	    vstream_fflush(VSTREAM_OUT);
+	    continue;
+	}
+	linear_match = cidr_match_execute_addr(head, (CIDR_MATCH *) 0,
+					       addr_family, addr_bytes);
+	trie_match = cidr_trie_find(trie, addr_family, addr_bytes);
+	vstream_printf("%s: %s\n", pattern, trie_match ?
+		       ((TEST_ENTRY *) trie_match)->text : "not found");
+	if (trie_match != linear_match) {
+	    vstream_printf("%s: linear search result: %s\n", pattern,
+			   linear_match ?
+			   ((TEST_ENTRY *) linear_match)->text : "not found");
+	    errors++;
+	}
+	vstream_fflush(VSTREAM_OUT);
+    }
+    cidr_trie_free(trie);
+    vstring_free(buf);
+    vstring_free(why);
+    exit(errors != 0);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _CIDR_TRIE_H_INCLUDED_
+#define _CIDR_TRIE_H_INCLUDED_
+
+/*++
+/* NAME
+/*	cidr_trie 3h
+/* SUMMARY
+/*	first-match index for CIDR patterns
+/* SYNOPSIS
+/*	#include <cidr_trie.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <cidr_match.h>
+
+ /*
+  * External interface.
+  */
+typedef struct CIDR_TRIE CIDR_TRIE;
+
+extern CIDR_TRIE *cidr_trie_create(void);
+extern void cidr_trie_add(CIDR_TRIE *, CIDR_MATCH *);
+extern CIDR_MATCH *cidr_trie_find(CIDR_TRIE *, int, const unsigned char *);
+extern void cidr_trie_free(CIDR_TRIE *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
@@ -83,6 +83,7 @@ typedef struct DICT {
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
     int     (*sequence) (struct DICT *, int, const char **, const char **);
+    int     (*bulk_lookup) (struct DICT *, int, const char **, const char **);
     int     (*lock) (struct DICT *, int);
     void    (*close) (struct DICT *);
     int     lock_type;			/* for read/write lock */
@@ -96,6 +97,7 @@ typedef struct DICT {
     struct DICT_UTF8_BACKUP *utf8_backup;	/* see below */
     struct VSTRING *file_buf;		/* dict_file_to_buf() */
     struct VSTRING *file_b64;		/* dict_file_to_b64() */
+    struct VSTRING *bulk_buf;		/* dict_get_bulk() results */
 } DICT;
 
 extern DICT *dict_alloc(const char *, const char *, ssize_t);
@@ -241,6 +243,8 @@ extern DICT_OPEN_EXTEND_FN dict_open_extend(DICT_OPEN_EXTEND_FN);
 #define dict_put(dp, key, val)	(dp)->update((dp), (key), (val))
 #define dict_del(dp, key)	(dp)->delete((dp), (key))
 #define dict_seq(dp, f, key, val) (dp)->sequence((dp), (f), (key), (val))
+#define dict_get_bulk(dp, n, keys, vals) \
+	(dp)->bulk_lookup((dp), (n), (keys), (vals))
 #define dict_close(dp)		(dp)->close(dp)
 typedef void (*DICT_WALK_ACTION) (const char *, DICT *, void *);
 extern void dict_walk(DICT_WALK_ACTION, void *);
@@ -257,6 +261,7 @@ typedef struct DICT_UTF8_BACKUP {
     const char *(*lookup) (struct DICT *, const char *);
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
+    int     (*bulk_lookup) (struct DICT *, int, const char **, const char **);
 } DICT_UTF8_BACKUP;
 
 extern DICT *dict_utf8_activate(DICT *);
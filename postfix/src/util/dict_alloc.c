@@ -26,7 +26,11 @@
 /*	The purpose of the default methods is to trap an attempt to
 /*	invoke an unsupported method.
 /*
-/*	One exception is the default lock function.  When the
+/*	One exception is the default bulk lookup function, which
+/*	performs one lookup per key with the lookup method, and
+/*	saves the results in the \fBbulk_buf\fR member.
+/*
+/*	Another exception is the default lock function.  When the
 /*	dictionary provides a file handle for locking, the default
 /*	lock function returns the result from myflock with the
 /*	locking method specified in the lock_type member, otherwise
@@ -74,12 +78,14 @@
 /* System libraries. */
 
 #include "sys_defs.h"
+#include <string.h>
 
 /* Utility library. */
 
 #include "msg.h"
 #include "mymalloc.h"
 #include "myflock.h"
+#include "vstring.h"
 #include "dict.h"
 
 /* dict_default_lookup - trap unimplemented operation */
@@ -116,6 +122,44 @@ static int dict_default_sequence(DICT *dict, int unused_function,
 	      dict->type, dict->name);
 }
 
+/* dict_default_bulk_lookup - one lookup per key */
+
+static int dict_default_bulk_lookup(DICT *dict, int count, const char **keys,
+				            const char **values)
+{
+    const char *value;
+    char   *cp;
+    int     n;
+
+    /*
+     * Each lookup result is invalidated by the next lookup, so we save a
+     * copy. We can't save pointers while the buffer may be reallocated;
+     * instead, remember which keys were found, and fill in the pointers
+     * after all lookups have completed.
+     */
+    if (dict->bulk_buf == 0)
+	dict->bulk_buf = vstring_alloc(100);
+    VSTRING_RESET(dict->bulk_buf);
+    for (n = 0; n < count; n++) {
+	if ((value = dict_get(dict, keys[n])) != 0) {
+	    vstring_strcat(dict->bulk_buf, value);
+	    VSTRING_ADDCH(dict->bulk_buf, 0);
+	    values[n] = "";
+	} else if (dict->error != 0) {
+	    return (dict->error);
+	} else {
+	    values[n] = 0;
+	}
+    }
+    for (cp = vstring_str(dict->bulk_buf), n = 0; n < count; n++) {
+	if (values[n] != 0) {
+	    values[n] = cp;
+	    cp += strlen(cp) + 1;
+	}
+    }
+    return (DICT_ERR_NONE);
+}
+
 /* dict_default_lock - default lock handler */
 
 static int dict_default_lock(DICT *dict, int operation)
@@ -148,6 +192,7 @@ DICT   *dict_alloc(const char *dict_type, const char *dict_name, ssize_t size)
     dict->update = dict_default_update;
     dict->delete = dict_default_delete;
     dict->sequence = dict_default_sequence;
+    dict->bulk_lookup = dict_default_bulk_lookup;
     dict->close = dict_default_close;
     dict->lock = dict_default_lock;
     dict->lock_type = INTERNAL_LOCK;
@@ -162,6 +207,7 @@ DICT   *dict_alloc(const char *dict_type, const char *dict_name, ssize_t size)
     dict->utf8_backup = 0;
     dict->file_buf = 0;
     dict->file_b64 = 0;
+    dict->bulk_buf = 0;
     return dict;
 }
 
@@ -179,6 +225,8 @@ void    dict_free(DICT *dict)
 	vstring_free(dict->file_buf);
     if (dict->file_b64)
 	vstring_free(dict->file_b64);
+    if (dict->bulk_buf)
+	vstring_free(dict->bulk_buf);
     myfree((void *) dict);
 }
 
@@ -40,6 +40,9 @@
 /*	typedef int (*DICT_CACHE_VALIDATOR_FN) (const char *cache_key,
 /*		const char *cache_val, void *context);
 /*
+/*	typedef time_t (*DICT_CACHE_EXPIRY_FN) (const char *cache_key,
+/*		const char *cache_val, void *context);
+/*
 /*	const char *dict_cache_name(cache)
 /*	DICT_CACHE	*cache;
 /* DESCRIPTION
@@ -105,7 +108,8 @@
 /* .IP CA_DICT_CACHE_CTL_FLAG_VERBOSE
 /*	Enable verbose logging of cache activity.
 /* .IP CA_DICT_CACHE_CTL_FLAG_EXP_SUMMARY
-/*	Log cache statistics after each cache cleanup run.
+/*	Log cache statistics after each cache cleanup run, and
+/*	progress statistics during a long cleanup run.
 /* .RE
 /* .IP "CA_DICT_CACHE_CTL_INTERVAL(int interval)"
 /*	The interval between cache cleanup runs.  Specify a null
@@ -116,7 +120,23 @@
 /*	not make changes to the cache. Specify a null validator or
 /*	interval to stop cache cleanup.
 /* .IP "CA_DICT_CACHE_CTL_CONTEXT(void *context)"
-/*	Application context that is passed to the validator function.
+/*	Application context that is passed to the validator and
+/*	expiry functions.
+/* .IP "CA_DICT_CACHE_CTL_EXPIRY(DICT_CACHE_EXPIRY_FN expiry)"
+/*	An optional application call-back routine that returns the
+/*	earliest time when the validator may reject a cache entry.
+/*	With this, the cache maintains an in-memory index of cache
+/*	keys by expiration time, grouped in buckets of one cleanup
+/*	interval. The first cleanup run scans the entire cache as
+/*	usual; later runs examine only the entries in buckets that
+/*	have expired, and entries that were updated with
+/*	dict_cache_update(). The validator still decides whether
+/*	an entry is removed; an entry that is kept is filed under
+/*	its new expiration time.
+/* .IP "CA_DICT_CACHE_CTL_BATCH(int batch)"
+/*	The maximal number of cache entries that are examined before
+/*	the cleanup pseudo thread yields to other events (default:
+/*	100).
 /* .RE
 /* .PP
 /*	dict_cache_name() returns the name of the specified cache.
@@ -155,6 +175,9 @@
 /*	the DICT_CACHE_FLAG_VERBOSE flag (see above) to log all
 /*	warnings.
 /* BUGS
+/*	The expiration index uses memory in proportion to the number
+/*	of cache entries, and is lost when the program terminates.
+/*
 /*	There should be a way to suspend automatic program suicide
 /*	until a cache cleanup run is completed. Some entries may
 /*	never be removed when the process max_idle time is less
@@ -183,6 +206,7 @@
 /* System library. */
 
 #include <sys_defs.h>
+#include <stdio.h>			/* sprintf */
 #include <string.h>
 #include <stdlib.h>
 
@@ -192,6 +216,8 @@
 #include <dict.h>
 #include <mymalloc.h>
 #include <events.h>
+#include <htable.h>
+#include <argv.h>
 #include <dict_cache.h>
 
 /* Application-specific. */
@@ -225,9 +251,18 @@ struct DICT_CACHE {
     int     exp_interval;		/* time between cleanup runs */
     DICT_CACHE_VALIDATOR_FN exp_validator;	/* expiration call-back */
     void   *exp_context;		/* call-back context */
+    int     exp_batch;			/* entries per cleanup step */
     int     retained;			/* entries retained in cleanup run */
     int     dropped;			/* entries removed in cleanup run */
 
+    /* Expiration index support. */
+    DICT_CACHE_EXPIRY_FN exp_expiry;	/* expiration time call-back */
+    HTABLE *exp_index;			/* cache key -> bucket */
+    HTABLE *exp_buckets;		/* bucket name -> cache keys */
+    char   *exp_curr_name;		/* bucket being cleaned up */
+    ARGV   *exp_curr_bucket;		/* bucket being cleaned up */
+    ssize_t exp_curr_pos;		/* position in that bucket */
+
     /* Rate-limited logging support. */
     int     log_delay;
     time_t  upd_log_stamp;		/* last update warning */
@@ -237,12 +272,22 @@ struct DICT_CACHE {
 };
 
 #define DC_FLAG_DEL_SAVED_CURRENT_KEY	(1<<0)	/* delete-behind is scheduled */
+#define DC_FLAG_CLEAN_RUNNING	(1<<1)	/* cleanup run in progress */
+#define DC_FLAG_INDEX_RUN	(1<<2)	/* cleanup run uses the index */
+#define DC_FLAG_INDEX_COMPLETE	(1<<3)	/* the index covers all entries */
 
  /*
   * Don't log cache access errors more than once per second.
   */
 #define DC_DEF_LOG_DELAY	1
 
+ /*
+  * Examine this many entries before yielding to other events, and log
+  * progress after this many entries.
+  */
+#define DC_DEF_CLEAN_BATCH	100
+#define DC_PROGRESS_STEP	100000
+
  /*
   * Macros to make obscure code more readable.
   */
@@ -264,6 +309,94 @@ struct DICT_CACHE {
   */
 #define DC_LAST_CACHE_CLEANUP_COMPLETED "_LAST_CACHE_CLEANUP_COMPLETED_"
 
+ /*
+  * An entry in the expiration index is filed under the bucket for its
+  * expiration time. The index maps each cache key to its current bucket;
+  * when an entry moves to a different bucket, its old bucket keeps a stale
+  * copy of the key that is skipped when that bucket is cleaned up.
+  */
+#define DC_BUCKET_ID(cp, when)	((long) ((when) / (cp)->exp_interval))
+
+ /*
+  * The test program sets the clock for cache cleanup runs.
+  */
+#ifdef TEST
+static time_t dc_test_time;
+
+#define DC_TIME()	dc_test_time
+#else
+#define DC_TIME()	event_time()
+#endif
+
+/* dict_cache_bucket_free - destroy one expiration bucket */
+
+static void dict_cache_bucket_free(void *ptr)
+{
+    argv_free((ARGV *) ptr);
+}
+
+/* dict_cache_index_create - create expiration index */
+
+static void dict_cache_index_create(DICT_CACHE *cp)
+{
+    cp->exp_index = htable_create(1000);
+    cp->exp_buckets = htable_create(10);
+    cp->exp_curr_name = 0;
+    cp->exp_curr_bucket = 0;
+    cp->exp_curr_pos = 0;
+    cp->cache_flags &= ~DC_FLAG_INDEX_COMPLETE;
+}
+
+/* dict_cache_index_free - destroy expiration index */
+
+static void dict_cache_index_free(DICT_CACHE *cp)
+{
+    htable_free(cp->exp_index, (void (*) (void *)) 0);
+    htable_free(cp->exp_buckets, dict_cache_bucket_free);
+    cp->exp_index = cp->exp_buckets = 0;
+    if (cp->exp_curr_name) {
+	myfree(cp->exp_curr_name);
+	cp->exp_curr_name = 0;
+    }
+    cp->exp_curr_bucket = 0;
+    cp->cache_flags &= ~(DC_FLAG_INDEX_RUN | DC_FLAG_INDEX_COMPLETE);
+}
+
+/* dict_cache_index_enter - file entry under its expiration time */
+
+static void dict_cache_index_enter(DICT_CACHE *cp, const char *cache_key,
+				           const char *cache_val)
+{
+    const char *myname = "dict_cache_index_enter";
+    time_t  expires;
+    char    name[sizeof(long) * 3 + 2];
+    ARGV   *bucket;
+    HTABLE_INFO *ht;
+
+    /*
+     * An entry that has already expired goes into the current bucket, which
+     * is examined by the next cleanup run.
+     */
+    expires = cp->exp_expiry(cache_key, cache_val, cp->exp_context);
+    if (expires < DC_TIME())
+	expires = DC_TIME();
+    sprintf(name, "%ld", DC_BUCKET_ID(cp, expires));
+    if ((bucket = (ARGV *) htable_find(cp->exp_buckets, name)) == 0) {
+	bucket = argv_alloc(10);
+	htable_enter(cp->exp_buckets, name, (void *) bucket);
+    }
+    if ((ht = htable_locate(cp->exp_index, cache_key)) == 0) {
+	htable_enter(cp->exp_index, cache_key, (void *) bucket);
+    } else if (ht->value == (void *) bucket) {
+	return;
+    } else {
+	ht->value = (void *) bucket;
+    }
+    argv_add(bucket, cache_key, (char *) 0);
+    if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
+	msg_info("%s: key=%s bucket=%s", myname, cache_key, name);
+}
+
 /* dict_cache_lookup - load entry from cache */
 
 const char *dict_cache_lookup(DICT_CACHE *cp, const char *cache_key)
@@ -320,6 +453,8 @@ int     dict_cache_update(DICT_CACHE *cp, const char *cache_key,
     if (put_res != 0)
 	msg_rate_delay(&cp->upd_log_stamp, cp->log_delay, msg_warn,
 		  "%s: could not update entry for %s", cp->name, cache_key);
+    else if (cp->exp_index)
+	dict_cache_index_enter(cp, cache_key, cache_val);
     DICT_ERR_VAL_RETURN(cp, db->error, put_res);
 }
 
@@ -458,43 +593,34 @@ static void dict_cache_clean_stat_log_reset(DICT_CACHE *cp,
     cp->retained = cp->dropped = 0;
 }
 
-/* dict_cache_clean_event - examine one cache entry */
+/* dict_cache_clean_done - finish a cache cleanup run */
 
-static void dict_cache_clean_event(int unused_event, void *cache_context)
+static void dict_cache_clean_done(DICT_CACHE *cp, const char *full_partial)
 {
-    const char *myname = "dict_cache_clean_event";
-    DICT_CACHE *cp = (DICT_CACHE *) cache_context;
-    const char *cache_key;
-    const char *cache_val;
-    int     next_interval;
     VSTRING *stamp_buf;
-    int     first_next;
 
-    /*
-     * We interleave cache cleanup with other processing, so that the
-     * application's service remains available, with perhaps increased
-     * latency.
-     */
-
-    /*
-     * Start a new cache cleanup run.
-     */
-    if (cp->saved_curr_key == 0) {
-	cp->retained = cp->dropped = 0;
-	first_next = DICT_SEQ_FUN_FIRST;
-	if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
-	    msg_info("%s: start %s cache cleanup", myname, cp->name);
+    cp->cache_flags &= ~(DC_FLAG_CLEAN_RUNNING | DC_FLAG_INDEX_RUN);
+    dict_cache_clean_stat_log_reset(cp, full_partial);
+    if (strcmp(full_partial, "partial") != 0) {
+	stamp_buf = vstring_alloc(100);
+	vstring_sprintf(stamp_buf, "%ld", (long) DC_TIME());
+	dict_put(cp->db, DC_LAST_CACHE_CLEANUP_COMPLETED,
+		 vstring_str(stamp_buf));
+	vstring_free(stamp_buf);
     }
+}
 
-    /*
-     * Continue a cache cleanup run in progress.
-     */
-    else {
-	first_next = DICT_SEQ_FUN_NEXT;
-    }
+/* dict_cache_clean_scan - examine the next cache entry in sequence */
+
+static int dict_cache_clean_scan(DICT_CACHE *cp, int first_next)
+{
+    const char *myname = "dict_cache_clean_scan";
+    const char *cache_key;
+    const char *cache_val;
 
     /*
-     * Examine one cache entry.
+     * Examine one cache entry. With an expiration index, file the entries
+     * that are kept, so that later cleanup runs need not scan the cache.
      */
     if (dict_cache_sequence(cp, first_next, &cache_key, &cache_val) == 0) {
 	if (cp->exp_validator(cache_key, cache_val, cp->exp_context) == 0) {
@@ -508,8 +634,10 @@ static void dict_cache_clean_event(int unused_event, void *cache_context)
 	    if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
 		msg_info("%s: keep %s cache entry for %s",
 			 myname, cp->name, cache_key);
+	    if (cp->exp_index)
+		dict_cache_index_enter(cp, cache_key, cache_val);
 	}
-	next_interval = 0;
+	return (1);
     }
 
     /*
@@ -517,20 +645,156 @@ static void dict_cache_clean_event(int unused_event, void *cache_context)
      */
     else if (cp->error != 0) {
 	msg_warn("%s: cache cleanup scan terminated due to error", cp->name);
-	dict_cache_clean_stat_log_reset(cp, "partial");
-	next_interval = cp->exp_interval;
+	dict_cache_clean_done(cp, "partial");
+	return (0);
     } else {
 	if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
 	    msg_info("%s: done %s cache cleanup scan", myname, cp->name);
-	dict_cache_clean_stat_log_reset(cp, "full");
-	stamp_buf = vstring_alloc(100);
-	vstring_sprintf(stamp_buf, "%ld", (long) event_time());
-	dict_put(cp->db, DC_LAST_CACHE_CLEANUP_COMPLETED,
-		 vstring_str(stamp_buf));
-	vstring_free(stamp_buf);
-	next_interval = cp->exp_interval;
+	if (cp->exp_index)
+	    cp->cache_flags |= DC_FLAG_INDEX_COMPLETE;
+	dict_cache_clean_done(cp, "full");
+	return (0);
     }
-    event_request_timer(dict_cache_clean_event, cache_context, next_interval);
+}
+
+/* dict_cache_clean_index - examine the next entry in an expired bucket */
+
+static int dict_cache_clean_index(DICT_CACHE *cp)
+{
+    const char *myname = "dict_cache_clean_index";
+    HTABLE_INFO **list;
+    HTABLE_INFO **ht;
+    const char *cache_key;
+    const char *cache_val;
+    long    now_id = DC_BUCKET_ID(cp, DC_TIME());
+
+    for (;;) {
+
+	/*
+	 * Find a bucket whose expiration time has passed.
+	 */
+	if (cp->exp_curr_bucket == 0) {
+	    list = htable_list(cp->exp_buckets);
+	    for (ht = list; *ht; ht++)
+		if (atol(ht[0]->key) < now_id)
+		    break;
+	    if (*ht) {
+		cp->exp_curr_name = mystrdup(ht[0]->key);
+		cp->exp_curr_bucket = (ARGV *) ht[0]->value;
+		cp->exp_curr_pos = 0;
+	    }
+	    myfree((void *) list);
+	    if (cp->exp_curr_bucket == 0) {
+		if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
+		    msg_info("%s: done %s cache cleanup", myname, cp->name);
+		dict_cache_clean_done(cp, "indexed");
+		return (0);
+	    }
+	}
+
+	/*
+	 * Discard a bucket after all its entries were examined.
+	 */
+	if (cp->exp_curr_pos >= cp->exp_curr_bucket->argc) {
+	    htable_delete(cp->exp_buckets, cp->exp_curr_name,
+			  dict_cache_bucket_free);
+	    myfree(cp->exp_curr_name);
+	    cp->exp_curr_name = 0;
+	    cp->exp_curr_bucket = 0;
+	    continue;
+	}
+
+	/*
+	 * Skip a stale copy of a key that was moved to a different bucket.
+	 * Otherwise, remove the key from the index, and file it again if the
+	 * validator keeps the entry.
+	 */
+	cache_key = cp->exp_curr_bucket->argv[cp->exp_curr_pos++];
+	if (htable_find(cp->exp_index, cache_key) != (void *) cp->exp_curr_bucket)
+	    return (1);
+	htable_delete(cp->exp_index, cache_key, (void (*) (void *)) 0);
+	if ((cache_val = dict_get(cp->db, cache_key)) == 0) {
+	    if (cp->db->error)
+		msg_rate_delay(&cp->get_log_stamp, cp->log_delay, msg_warn,
+			       "%s: cache lookup for '%s' failed due to error",
+			       cp->name, cache_key);
+	} else if (cp->exp_validator(cache_key, cache_val,
+				     cp->exp_context) == 0) {
+	    cp->dropped++;
+	    if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
+		msg_info("%s: drop %s cache entry for %s",
+			 myname, cp->name, cache_key);
+	    (void) dict_cache_delete(cp, cache_key);
+	} else {
+	    cp->retained++;
+	    if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
+		msg_info("%s: keep %s cache entry for %s",
+			 myname, cp->name, cache_key);
+	    dict_cache_index_enter(cp, cache_key, cache_val);
+	}
+	return (1);
+    }
+}
+
+/* dict_cache_clean_event - examine a batch of cache entries */
+
+static void dict_cache_clean_event(int unused_event, void *cache_context)
+{
+    const char *myname = "dict_cache_clean_event";
+    DICT_CACHE *cp = (DICT_CACHE *) cache_context;
+    int     first_next;
+    int     more;
+    int     count;
+    int     done;
+
+    /*
+     * We interleave cache cleanup with other processing, so that the
+     * application's service remains available, with perhaps increased
+     * latency. Each event examines a bounded number of cache entries.
+     */
+
+    /*
+     * Start a new cache cleanup run. Scan the entire cache, unless an
+     * expiration index was built during an earlier run.
+     */
+    if ((cp->cache_flags & DC_FLAG_CLEAN_RUNNING) == 0) {
+	cp->retained = cp->dropped = 0;
+	cp->cache_flags |= DC_FLAG_CLEAN_RUNNING;
+	if (cp->cache_flags & DC_FLAG_INDEX_COMPLETE)
+	    cp->cache_flags |= DC_FLAG_INDEX_RUN;
+	first_next = DICT_SEQ_FUN_FIRST;
+	if (cp->user_flags & DICT_CACHE_FLAG_VERBOSE)
+	    msg_info("%s: start %s %s cache cleanup", myname, cp->name,
+		     (cp->cache_flags & DC_FLAG_INDEX_RUN) ?
+		     "indexed" : "full");
+    }
+
+    /*
+     * Continue a cache cleanup run in progress.
+     */
+    else {
+	first_next = DICT_SEQ_FUN_NEXT;
+    }
+
+    /*
+     * Examine a batch of cache entries.
+     */
+    for (more = 1, count = 0; more && count < cp->exp_batch; count++) {
+	done = cp->retained + cp->dropped;
+	if (cp->cache_flags & DC_FLAG_INDEX_RUN) {
+	    more = dict_cache_clean_index(cp);
+	} else {
+	    more = dict_cache_clean_scan(cp, first_next);
+	    first_next = DICT_SEQ_FUN_NEXT;
+	}
+	if (more && (cp->user_flags & DICT_CACHE_FLAG_STATISTICS)
+	    && cp->retained + cp->dropped > done
+	    && (cp->retained + cp->dropped) % DC_PROGRESS_STEP == 0)
+	    msg_info("cache %s cleanup in progress: retained=%d dropped=%d entries",
+		     cp->name, cp->retained, cp->dropped);
+    }
+    event_request_timer(dict_cache_clean_event, cache_context,
+			more ? 0 : cp->exp_interval);
 }
 
 /* dict_cache_control - schedule or stop the cache cleanup thread */
@@ -569,6 +833,15 @@ void    dict_cache_control(DICT_CACHE *cp,...)
 	case DICT_CACHE_CTL_CONTEXT:
 	    cp->exp_context = va_arg(ap, void *);
 	    break;
+	case DICT_CACHE_CTL_EXPIRY:
+	    cp->exp_expiry = va_arg(ap, DICT_CACHE_EXPIRY_FN);
+	    break;
+	case DICT_CACHE_CTL_BATCH:
+	    cp->exp_batch = va_arg(ap, int);
+	    if (cp->exp_batch <= 0)
+		msg_panic("%s: bad %s cache cleanup batch size %d",
+			  myname, cp->name, cp->exp_batch);
+	    break;
 	default:
 	    msg_panic("%s: bad command: %d", myname, name);
 	}
@@ -601,6 +874,8 @@ void    dict_cache_control(DICT_CACHE *cp,...)
 	if ((cp->user_flags & DICT_CACHE_FLAG_VERBOSE) && next_interval > 0)
 	    msg_info("%s cache cleanup will start after %ds",
 		     cp->name, (int) next_interval);
+	if (cp->exp_expiry)
+	    dict_cache_index_create(cp);
 	event_request_timer(dict_cache_clean_event, (void *) cp,
 			    (int) next_interval);
     }
@@ -611,7 +886,10 @@ void    dict_cache_control(DICT_CACHE *cp,...)
     else if (cache_cleanup_is_active) {
 	if (cp->retained || cp->dropped)
 	    dict_cache_clean_stat_log_reset(cp, "partial");
+	cp->cache_flags &= ~DC_FLAG_CLEAN_RUNNING;
 	dict_cache_delete_behind_reset(cp);
+	if (cp->exp_index)
+	    dict_cache_index_free(cp);
 	event_cancel_timer(dict_cache_clean_event, (void *) cp);
     }
 }
@@ -642,11 +920,18 @@ DICT_CACHE *dict_cache_open(const char *dbname, int open_flags, int dict_flags)
     cp->exp_interval = 0;
     cp->exp_validator = 0;
     cp->exp_context = 0;
+    cp->exp_batch = DC_DEF_CLEAN_BATCH;
     cp->retained = 0;
     cp->dropped = 0;
     cp->log_delay = DC_DEF_LOG_DELAY;
     cp->upd_log_stamp = cp->get_log_stamp =
 	cp->del_log_stamp = cp->seq_log_stamp = 0;
+    cp->exp_expiry = 0;
+    cp->exp_index = 0;
+    cp->exp_buckets = 0;
+    cp->exp_curr_name = 0;
+    cp->exp_curr_bucket = 0;
+    cp->exp_curr_pos = 0;
 
     return (cp);
 }
@@ -686,7 +971,10 @@ const char *dict_cache_name(DICT_CACHE *cp)
  /*
   * Test driver with support for interleaved access. First, enter a number of
   * requests to look up, update or delete a sequence of cache entries, then
-  * interleave those sequences with the "run" command.
+  * interleave those sequences with the "run" command. The "expiry" command
+  * enables cache cleanup with an expiration index; an entry with key
+  * "N-suffix" expires at time N. The "time" command sets the clock, and the
+  * "clean" command runs a cache cleanup to completion.
   */
 #ifdef TEST
 #include <msg_vstream.h>
@@ -701,6 +989,10 @@ const char *dict_cache_name(DICT_CACHE *cp)
 		"\n\tlmdb_map_size <limit> (initial LMDB size limit)" \
 		"\n\tcache <type>:<name> (switch to named database)" \
 		"\n\tstatus (show map size, cache, pending requests)" \
+		"\n\n\tTo manage cache cleanup:" \
+		"\n\texpiry <interval> <batch> (enable indexed cleanup)" \
+		"\n\ttime <seconds> (set the cleanup clock)" \
+		"\n\tclean (run cache cleanup to completion)" \
 		"\n\n\tTo manage pending requests:" \
 		"\n\treset (discard pending requests)" \
 		"\n\trun (execute pending requests in interleaved order)" \
@@ -1045,6 +1337,66 @@ static void add_request(DICT_CACHE_TEST *tp, ARGV *argv)
     tp->used += 1;
 }
 
+/* test_expiry - expiration time is the key's numerical prefix */
+
+static time_t test_expiry(const char *cache_key, const char *unused_val,
+			          void *unused_context)
+{
+    return ((time_t) atol(cache_key));
+}
+
+/* test_validator - keep entries that have not expired */
+
+static int test_validator(const char *cache_key, const char *cache_val,
+			          void *context)
+{
+    return (test_expiry(cache_key, cache_val, context) > dc_test_time);
+}
+
+/* enable_cleanup - enable cache cleanup with expiration index */
+
+static void enable_cleanup(DICT_CACHE *dp, ARGV *argv)
+{
+    int     interval;
+    int     batch;
+
+    if (dp == 0) {
+	msg_warn("no cache");
+	return;
+    }
+    if ((interval = atoi(argv->argv[1])) <= 0
+	|| (batch = atoi(argv->argv[2])) <= 0) {
+	msg_warn("bad interval or batch size");
+	return;
+    }
+    dict_cache_control(dp, CA_DICT_CACHE_CTL_INTERVAL(0),
+		       CA_DICT_CACHE_CTL_END);
+    dict_cache_control(dp,
+		       CA_DICT_CACHE_CTL_FLAGS(DICT_CACHE_FLAG_STATISTICS),
+		       CA_DICT_CACHE_CTL_VALIDATOR(test_validator),
+		       CA_DICT_CACHE_CTL_EXPIRY(test_expiry),
+		       CA_DICT_CACHE_CTL_BATCH(batch),
+		       CA_DICT_CACHE_CTL_INTERVAL(interval),
+		       CA_DICT_CACHE_CTL_END);
+}
+
+/* run_cleanup - run cache cleanup to completion */
+
+static void run_cleanup(DICT_CACHE *dp)
+{
+    int     batches = 0;
+
+    if (dp == 0 || dp->exp_validator == 0) {
+	msg_warn("no cache cleanup");
+	return;
+    }
+    do {
+	dict_cache_clean_event(0, (void *) dp);
+	batches++;
+    } while (dp->cache_flags & DC_FLAG_CLEAN_RUNNING);
+    vstream_printf("cleanup: %d batches\n", batches);
+}
+
 /* main - main program */
 
 int     main(int argc, char **argv)
@@ -1104,6 +1456,12 @@ int     main(int argc, char **argv)
 	    run_requests(test_job, cache, inbuf);
 	} else if (strcmp(args->argv[0], "status") == 0 && args->argc == 1) {
 	    show_status(test_job, cache);
+	} else if (strcmp(args->argv[0], "expiry") == 0 && args->argc == 3) {
+	    enable_cleanup(cache, args);
+	} else if (strcmp(args->argv[0], "time") == 0 && args->argc == 2) {
+	    dc_test_time = atol(args->argv[1]);
+	} else if (strcmp(args->argv[0], "clean") == 0 && args->argc == 1) {
+	    run_cleanup(cache);
 	} else {
 	    add_request(test_job, args);
 	}
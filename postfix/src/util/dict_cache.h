@@ -22,6 +22,7 @@
   */
 typedef struct DICT_CACHE DICT_CACHE;
 typedef int (*DICT_CACHE_VALIDATOR_FN) (const char *, const char *, void *);
+typedef time_t (*DICT_CACHE_EXPIRY_FN) (const char *, const char *, void *);
 
 extern DICT_CACHE *dict_cache_open(const char *, int, int);
 extern void dict_cache_close(DICT_CACHE *);
@@ -41,6 +42,8 @@ extern const char *dict_cache_name(DICT_CACHE *);
 #define DICT_CACHE_CTL_INTERVAL		2	/* cleanup interval */
 #define DICT_CACHE_CTL_VALIDATOR	3	/* call-back validator */
 #define DICT_CACHE_CTL_CONTEXT		4	/* call-back context */
+#define DICT_CACHE_CTL_EXPIRY		5	/* call-back expiration time */
+#define DICT_CACHE_CTL_BATCH		6	/* entries per cleanup step */
 
 /* Safer API: type-checked arguments, external use. */
 #define CA_DICT_CACHE_CTL_END		DICT_CACHE_CTL_END
@@ -48,9 +51,12 @@ extern const char *dict_cache_name(DICT_CACHE *);
 #define CA_DICT_CACHE_CTL_INTERVAL(v)	DICT_CACHE_CTL_INTERVAL, CHECK_VAL(DICT_CACHE, int, (v))
 #define CA_DICT_CACHE_CTL_VALIDATOR(v)	DICT_CACHE_CTL_VALIDATOR, CHECK_VAL(DICT_CACHE, DICT_CACHE_VALIDATOR_FN, (v))
 #define CA_DICT_CACHE_CTL_CONTEXT(v)	DICT_CACHE_CTL_CONTEXT, CHECK_PTR(DICT_CACHE, void, (v))
+#define CA_DICT_CACHE_CTL_EXPIRY(v)	DICT_CACHE_CTL_EXPIRY, CHECK_VAL(DICT_CACHE, DICT_CACHE_EXPIRY_FN, (v))
+#define CA_DICT_CACHE_CTL_BATCH(v)	DICT_CACHE_CTL_BATCH, CHECK_VAL(DICT_CACHE, int, (v))
 
 CHECK_VAL_HELPER_DCL(DICT_CACHE, int);
 CHECK_VAL_HELPER_DCL(DICT_CACHE, DICT_CACHE_VALIDATOR_FN);
+CHECK_VAL_HELPER_DCL(DICT_CACHE, DICT_CACHE_EXPIRY_FN);
 CHECK_PTR_HELPER_DCL(DICT_CACHE, void);
 
 /* LICENSE
@@ -0,0 +1,341 @@
+/*++
+/* NAME
+/*	dict_cachemap 3
+/* SUMMARY
+/*	dictionary manager interface for cached lookups
+/* SYNOPSIS
+/*	#include <dict_cachemap.h>
+/*
+/*	DICT	*dict_cachemap_open(name, open_flags, dict_flags)
+/*	const char *name;
+/*	int	open_flags;
+/*	int	dict_flags;
+/* DESCRIPTION
+/*	dict_cachemap_open() opens a table, and remembers recent
+/*	lookup results in memory.
+/*	Example: "\fBcachemap:{\fItype:name, name=value...\fR}".
+/*
+/*	The first and last characters of a "cachemap:" table name
+/*	must be '{' and '}'. Within these, the first element is the
+/*	table whose results are cached, and the remaining elements
+/*	are optional settings, separated with comma or whitespace:
+/* .IP "\fBsize=\fIcount\fR (default: 1000)"
+/*	The maximal number of results to remember. When the cache
+/*	is full, the least-recently used result is forgotten.
+/* .IP "\fBttl=\fIseconds\fR (default: 300)"
+/*	How long to remember a found result. Specify 0 to disable.
+/* .IP "\fBnegative_ttl=\fIseconds\fR (default: 60)"
+/*	How long to remember that a key was not found. Specify 0
+/*	to disable.
+/* .IP "\fBstats_lookups=\fIcount\fR (default: 100000)"
+/*	How often to log the numbers of lookups, cache hits and
+/*	cache misses. Specify 0 to disable.
+/* .PP
+/*	Lookup errors are never remembered; the next query for the
+/*	same key is given to the table again. Cached results are
+/*	forgotten when the request flags (such as DICT_FLAG_NO_REGSUB)
+/*	change.
+/*
+/*	The numbers of lookups, cache hits and cache misses are
+/*	logged after every stats_lookups lookups, and
+/*	when the table is closed. The numbers are totals since the
+/*	table was opened.
+/*
+/*	The open_flags and dict_flags arguments are passed on to
+/*	the underlying dictionary.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/*	ctable(3) cache manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#ifdef STRCASECMP_IN_STRINGS_H
+#include <strings.h>
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <ctable.h>
+#include <dict.h>
+#include <dict_cachemap.h>
+#include <stringops.h>
+#include <vstring.h>
+
+/* Application-specific. */
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    char   *dict_type_name;		/* cached table name */
+    DICT   *map;			/* cached table */
+    CTABLE *cache;			/* recent lookup results */
+    ssize_t size;			/* cache size limit */
+    int     ttl;			/* found result lifetime */
+    int     negative_ttl;		/* not-found result lifetime */
+    int     rqst_flags;			/* cached request flags */
+    unsigned long lookups;		/* statistics */
+    unsigned long misses;		/* statistics */
+    int     stats_lookups;		/* statistics logging interval */
+} DICT_CACHEMAP;
+
+typedef struct {
+    char   *value;			/* lookup result or null */
+    int     error;			/* lookup error */
+    time_t  expires;			/* end of lifetime */
+} DICT_CACHEMAP_ENTRY;
+
+#define DICT_CACHEMAP_DEF_SIZE		1000
+#define DICT_CACHEMAP_DEF_TTL		300
+#define DICT_CACHEMAP_DEF_NEG_TTL	60
+#define DICT_CACHEMAP_DEF_STATS_LOOKUPS	100000
+
+/* dict_cachemap_stats - log statistics */
+
+static void dict_cachemap_stats(DICT_CACHEMAP *dict_cachemap)
+{
+    msg_info("%s:%s: lookups=%lu hits=%lu misses=%lu",
+	     dict_cachemap->dict.type, dict_cachemap->dict.name,
+	     dict_cachemap->lookups,
+	     dict_cachemap->lookups - dict_cachemap->misses,
+	     dict_cachemap->misses);
+}
+
+/* dict_cachemap_create - look up result for cache */
+
+static void *dict_cachemap_create(const char *key, void *context)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) context;
+    DICT   *map = dict_cachemap->map;
+    DICT_CACHEMAP_ENTRY *entry;
+    const char *value;
+
+    map->flags = ((map->flags & ~DICT_FLAG_RQST_MASK)
+		  | dict_cachemap->rqst_flags);
+    value = dict_get(map, key);
+    entry = (DICT_CACHEMAP_ENTRY *) mymalloc(sizeof(*entry));
+    entry->value = value ? mystrdup(value) : 0;
+    entry->error = map->error;
+    entry->expires = (entry->error != 0 ? 0 : time((time_t *) 0)
+		  + (value ? dict_cachemap->ttl : dict_cachemap->negative_ttl));
+    dict_cachemap->misses += 1;
+    return ((void *) entry);
+}
+
+/* dict_cachemap_delete - forget cached result */
+
+static void dict_cachemap_delete(void *ptr, void *unused_context)
+{
+    DICT_CACHEMAP_ENTRY *entry = (DICT_CACHEMAP_ENTRY *) ptr;
+
+    if (entry->value)
+	myfree(entry->value);
+    myfree((void *) entry);
+}
+
+/* dict_cachemap_lookup - search the cache, then the table */
+
+static const char *dict_cachemap_lookup(DICT *dict, const char *key)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+    const DICT_CACHEMAP_ENTRY *entry;
+    unsigned long misses;
+    int     rqst_flags = (dict->flags & DICT_FLAG_RQST_MASK);
+    time_t  now;
+
+    /*
+     * A result may depend on the request flags. Start over when those
+     * flags change; in practice they are the same for every lookup.
+     */
+    if (rqst_flags != dict_cachemap->rqst_flags) {
+	ctable_free(dict_cachemap->cache);
+	dict_cachemap->cache = ctable_create(dict_cachemap->size,
+					     dict_cachemap_create,
+					     dict_cachemap_delete,
+					     (void *) dict_cachemap);
+	dict_cachemap->rqst_flags = rqst_flags;
+    }
+
+    /*
+     * Don't look up a result twice when it was just created, even if its
+     * lifetime is zero. An error result has already expired.
+     */
+    dict_cachemap->lookups += 1;
+    misses = dict_cachemap->misses;
+    now = time((time_t *) 0);
+    entry = (const DICT_CACHEMAP_ENTRY *)
+	ctable_locate(dict_cachemap->cache, key);
+    if (dict_cachemap->misses == misses && entry->expires <= now)
+	entry = (const DICT_CACHEMAP_ENTRY *)
+	    ctable_refresh(dict_cachemap->cache, key);
+
+    /*
+     * Long-running processes rarely close a table. Log the statistics now
+     * and then.
+     */
+    if (dict_cachemap->stats_lookups > 0
+	&& dict_cachemap->lookups % dict_cachemap->stats_lookups == 0)
+	dict_cachemap_stats(dict_cachemap);
+    DICT_ERR_VAL_RETURN(dict, entry->error, entry->value);
+}
+
+/* dict_cachemap_close - log statistics and disassociate from table */
+
+static void dict_cachemap_close(DICT *dict)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+
+    if (dict_cachemap->lookups > 0)
+	dict_cachemap_stats(dict_cachemap);
+    ctable_free(dict_cachemap->cache);
+    dict_unregister(dict_cachemap->dict_type_name);
+    myfree(dict_cachemap->dict_type_name);
+    dict_free(dict);
+}
+
+/* dict_cachemap_number - convert setting to number */
+
+static int dict_cachemap_number(const char *value, int min_value, int *result)
+{
+    char   *end;
+    long    number;
+
+    number = strtol(value, &end, 10);
+    if (*value == 0 || *end != 0 || number < min_value || number > INT_MAX)
+	return (0);
+    *result = (int) number;
+    return (1);
+}
+
+/* dict_cachemap_open - open table with cache */
+
+DICT   *dict_cachemap_open(const char *name, int open_flags, int dict_flags)
+{
+    static const char myname[] = "dict_cachemap_open";
+    DICT_CACHEMAP *dict_cachemap;
+    char   *saved_name = 0;
+    ARGV   *argv = 0;
+    char  **cpp;
+    char   *dict_type_name;
+    char   *attr_name;
+    char   *attr_value;
+    const char *err;
+    DICT   *dict;
+    int     size = DICT_CACHEMAP_DEF_SIZE;
+    int     ttl = DICT_CACHEMAP_DEF_TTL;
+    int     negative_ttl = DICT_CACHEMAP_DEF_NEG_TTL;
+    int     stats_lookups = DICT_CACHEMAP_DEF_STATS_LOOKUPS;
+    size_t  len;
+
+    /*
+     * Clarity first. Let the optimizer worry about redundant code.
+     */
+#define DICT_CACHEMAP_RETURN(x) do { \
+	      if (saved_name != 0) \
+	          myfree(saved_name); \
+	      if (argv != 0) \
+	          argv_free(argv); \
+	      return (x); \
+	  } while (0)
+
+#define DICT_CACHEMAP_SYNTAX_ERROR() \
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name, \
+					    open_flags, dict_flags, \
+					    "bad syntax: \"%s:%s\"; " \
+					    "need \"%s:{type:name, " \
+					    "name=value...}\"", \
+					    DICT_TYPE_CACHEMAP, name, \
+					    DICT_TYPE_CACHEMAP))
+
+    /*
+     * Sanity checks.
+     */
+    if (open_flags != O_RDONLY)
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+					    open_flags, dict_flags,
+				  "%s:%s map requires O_RDONLY access mode",
+					    DICT_TYPE_CACHEMAP, name));
+
+    /*
+     * Split the table name into the cached table and its settings.
+     */
+    if ((len = balpar(name, CHARS_BRACE)) == 0 || name[len] != 0
+	|| *(saved_name = mystrndup(name + 1, len - 2)) == 0
+	|| ((argv = argv_splitq(saved_name, CHARS_COMMA_SP, CHARS_BRACE)),
+	    (argv->argc == 0))
+	|| strchr(dict_type_name = argv->argv[0], ':') == 0)
+	DICT_CACHEMAP_SYNTAX_ERROR();
+    for (cpp = argv->argv + 1; *cpp != 0; cpp++) {
+	if ((err = split_nameval(*cpp, &attr_name, &attr_value)) != 0)
+	    DICT_CACHEMAP_SYNTAX_ERROR();
+	if (strcasecmp(attr_name, "size") == 0
+	    && dict_cachemap_number(attr_value, 1, &size))
+	    continue;
+	if (strcasecmp(attr_name, "ttl") == 0
+	    && dict_cachemap_number(attr_value, 0, &ttl))
+	    continue;
+	if (strcasecmp(attr_name, "negative_ttl") == 0
+	    && dict_cachemap_number(attr_value, 0, &negative_ttl))
+	    continue;
+	if (strcasecmp(attr_name, "stats_lookups") == 0
+	    && dict_cachemap_number(attr_value, 0, &stats_lookups))
+	    continue;
+	/* Format the error before the setting is destroyed. */
+	dict = dict_surrogate(DICT_TYPE_CACHEMAP, name, open_flags, dict_flags,
+			      "%s:%s: bad setting \"%s=%s\"",
+			      DICT_TYPE_CACHEMAP, name, attr_name, attr_value);
+	DICT_CACHEMAP_RETURN(dict);
+    }
+
+    /*
+     * Open the cached table, or share an existing instance.
+     */
+    if (msg_verbose)
+	msg_info("%s: %s size=%d ttl=%d negative_ttl=%d stats_lookups=%d",
+		 myname, dict_type_name, size, ttl, negative_ttl,
+		 stats_lookups);
+    if ((dict = dict_handle(dict_type_name)) == 0)
+	dict = dict_open(dict_type_name, open_flags, dict_flags);
+    dict_register(dict_type_name, dict);
+
+    /*
+     * Bundle up the result.
+     */
+    dict_cachemap = (DICT_CACHEMAP *)
+	dict_alloc(DICT_TYPE_CACHEMAP, name, sizeof(*dict_cachemap));
+    dict_cachemap->dict.lookup = dict_cachemap_lookup;
+    dict_cachemap->dict.close = dict_cachemap_close;
+    dict_cachemap->dict.flags = dict_flags
+	| (dict->flags & (DICT_FLAG_FIXED | DICT_FLAG_PATTERN));
+    dict_cachemap->dict.owner = dict->owner;
+    dict_cachemap->dict_type_name = mystrdup(dict_type_name);
+    dict_cachemap->map = dict;
+    dict_cachemap->size = size;
+    dict_cachemap->ttl = ttl;
+    dict_cachemap->negative_ttl = negative_ttl;
+    dict_cachemap->rqst_flags = (dict_cachemap->dict.flags
+				 & DICT_FLAG_RQST_MASK);
+    dict_cachemap->cache = ctable_create(size, dict_cachemap_create,
+					 dict_cachemap_delete,
+					 (void *) dict_cachemap);
+    dict_cachemap->lookups = 0;
+    dict_cachemap->misses = 0;
+    dict_cachemap->stats_lookups = stats_lookups;
+    DICT_CACHEMAP_RETURN(DICT_DEBUG (&dict_cachemap->dict));
+}
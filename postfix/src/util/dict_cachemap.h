@@ -0,0 +1,37 @@
+#ifndef _DICT_CACHEMAP_H_INCLUDED_
+#define _DICT_CACHEMAP_H_INCLUDED_
+
+/*++
+/* NAME
+/*	dict_cachemap 3h
+/* SUMMARY
+/*	dictionary manager interface for cached lookups
+/* SYNOPSIS
+/*	#include <dict_cachemap.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <dict.h>
+
+ /*
+  * External interface.
+  */
+#define DICT_TYPE_CACHEMAP	"cachemap"
+
+extern DICT *dict_cachemap_open(const char *, int, int);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
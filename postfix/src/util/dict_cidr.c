@@ -14,6 +14,12 @@
 /*	dict_cidr_open() opens the named file and stores
 /*	the key/value pairs where the key must be either a
 /*	"naked" IP address or a netblock in CIDR notation.
+/*
+/*	Consecutive positive address patterns outside IF..ENDIF
+/*	blocks are indexed with a radix tree (see cidr_trie(3)),
+/*	so that the lookup cost does not grow with the number of
+/*	such patterns. The table is still searched in rule order,
+/*	and the first matching rule wins.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
 /* AUTHOR(S)
@@ -57,6 +63,7 @@
 #include <dict.h>
 #include <myaddrinfo.h>
 #include <cidr_match.h>
+#include <cidr_trie.h>
 #include <dict_cidr.h>
 #include <warn_stat.h>
 #include <mvect.h>
@@ -72,29 +79,95 @@ typedef struct DICT_CIDR_ENTRY {
     int     lineno;
 } DICT_CIDR_ENTRY;
 
+
+ /*
+  * The rule list is searched as a sequence of segments. A segment is either
+  * a run of consecutive positive address patterns at the top level, which
+  * is searched with a radix tree index, or a range of other rules that is
+  * searched linearly.
+  */
+typedef struct DICT_CIDR_SEGMENT {
+    CIDR_TRIE *trie;			/* indexed rules, or null */
+    CIDR_MATCH *first;			/* first rule in linear range */
+    CIDR_MATCH *stop;			/* first rule after range */
+    struct DICT_CIDR_SEGMENT *next;	/* next segment */
+} DICT_CIDR_SEGMENT;
+
 typedef struct {
     DICT    dict;			/* generic members */
     DICT_CIDR_ENTRY *head;		/* first entry */
+    DICT_CIDR_SEGMENT *segments;	/* search plan */
 } DICT_CIDR;
 
+#define DICT_CIDR_INDEXABLE(info) \
+	((info)->op == CIDR_MATCH_OP_MATCH && (info)->match == CIDR_MATCH_TRUE)
+
 /* dict_cidr_lookup - CIDR table lookup */
 
 static const char *dict_cidr_lookup(DICT *dict, const char *key)
 {
     DICT_CIDR *dict_cidr = (DICT_CIDR *) dict;
+    DICT_CIDR_SEGMENT *seg;
     DICT_CIDR_ENTRY *entry;
+    unsigned char addr_bytes[CIDR_MATCH_ABYTES];
+    int     addr_family;
 
     if (msg_verbose)
 	msg_info("dict_cidr_lookup: %s: %s", dict->name, key);
 
     dict->error = 0;
 
-    if ((entry = (DICT_CIDR_ENTRY *)
-	 cidr_match_execute(&(dict_cidr->head->cidr_info), key)) != 0)
-	return (entry->value);
+    if ((addr_family = cidr_match_addr(key, addr_bytes)) == 0)
+	return (0);
+    for (seg = dict_cidr->segments; seg != 0; seg = seg->next) {
+	if ((entry = (DICT_CIDR_ENTRY *) (seg->trie ?
+		       cidr_trie_find(seg->trie, addr_family, addr_bytes) :
+			  cidr_match_execute_addr(seg->first, seg->stop,
+						addr_family, addr_bytes))) != 0)
+	    return (entry->value);
+    }
     return (0);
 }
 
+/* dict_cidr_plan - group rules into indexed and linear segments */
+
+static DICT_CIDR_SEGMENT *dict_cidr_plan(DICT_CIDR_ENTRY *head)
+{
+    DICT_CIDR_SEGMENT *segments = 0;
+    DICT_CIDR_SEGMENT **link = &segments;
+    DICT_CIDR_SEGMENT *seg = 0;
+    CIDR_MATCH *info;
+    int     indexable;
+
+    /*
+     * Walk the rule list at the top level only: an IF..ENDIF block, or an
+     * IF without ENDIF, ends up in a linear segment as a whole.
+     */
+    for (info = head ? &head->cidr_info : 0; info != 0; /* see below */ ) {
+	indexable = DICT_CIDR_INDEXABLE(info);
+	if (seg == 0 || (seg->trie != 0) != indexable) {
+	    if (seg != 0 && seg->trie == 0)
+		seg->stop = info;
+	    seg = (DICT_CIDR_SEGMENT *) mymalloc(sizeof(*seg));
+	    seg->trie = indexable ? cidr_trie_create() : 0;
+	    seg->first = info;
+	    seg->stop = 0;
+	    seg->next = 0;
+	    *link = seg;
+	    link = &seg->next;
+	}
+	if (indexable) {
+	    cidr_trie_add(seg->trie, info);
+	    info = info->next;
+	} else if (info->op == CIDR_MATCH_OP_IF) {
+	    info = info->block_end ? info->block_end->next : 0;
+	} else {
+	    info = info->next;
+	}
+    }
+    return (segments);
+}
+
 /* dict_cidr_close - close the CIDR table */
 
 static void dict_cidr_close(DICT *dict)
@@ -102,7 +175,14 @@ static void dict_cidr_close(DICT *dict)
     DICT_CIDR *dict_cidr = (DICT_CIDR *) dict;
     DICT_CIDR_ENTRY *entry;
     DICT_CIDR_ENTRY *next;
+    DICT_CIDR_SEGMENT *seg;
 
+    while ((seg = dict_cidr->segments) != 0) {
+	dict_cidr->segments = seg->next;
+	if (seg->trie)
+	    cidr_trie_free(seg->trie);
+	myfree((void *) seg);
+    }
     for (entry = dict_cidr->head; entry; entry = next) {
 	next = (DICT_CIDR_ENTRY *) entry->cidr_info.next;
 	myfree(entry->value);
@@ -309,6 +389,7 @@ DICT   *dict_cidr_open(const char *mapname, int open_flags, int dict_flags)
     dict_cidr->dict.close = dict_cidr_close;
     dict_cidr->dict.flags = dict_flags | DICT_FLAG_PATTERN;
     dict_cidr->head = 0;
+    dict_cidr->segments = 0;
 
     dict_cidr->dict.owner.uid = st.st_uid;
     dict_cidr->dict.owner.status = (st.st_uid != 0);
@@ -358,6 +439,8 @@ DICT   *dict_cidr_open(const char *mapname, int open_flags, int dict_flags)
     if (rule_stack)
 	(void) mvect_free(&mvect);
 
+    dict_cidr->segments = dict_cidr_plan(dict_cidr->head);
+
     dict_file_purge_buffers(&dict_cidr->dict);
     DICT_CIDR_OPEN_RETURN(DICT_DEBUG (&dict_cidr->dict));
 }
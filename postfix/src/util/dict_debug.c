@@ -121,6 +121,26 @@ static int dict_debug_sequence(DICT *dict, int function,
     DICT_ERR_VAL_RETURN(dict, real_dict->error, result);
 }
 
+/* dict_debug_bulk_lookup - log bulk lookup operation */
+
+static int dict_debug_bulk_lookup(DICT *dict, int count, const char **keys,
+				          const char **values)
+{
+    DICT_DEBUG *dict_debug = (DICT_DEBUG *) dict;
+    DICT   *real_dict = dict_debug->real_dict;
+    int     result;
+    int     n;
+
+    real_dict->flags = dict->flags;
+    result = dict_get_bulk(real_dict, count, keys, values);
+    dict->flags = real_dict->flags;
+    for (n = 0; n < count; n++)
+	msg_info("%s:%s lookup: \"%s\" = \"%s\"", dict->type, dict->name,
+		 keys[n], result ? "error" : values[n] ? values[n] :
+		 "not_found");
+    DICT_ERR_VAL_RETURN(dict, real_dict->error, result);
+}
+
 /* dict_debug_close - log operation */
 
 static void dict_debug_close(DICT *dict)
@@ -144,6 +164,7 @@ DICT   *dict_debug(DICT *real_dict)
     dict_debug->dict.update = dict_debug_update;
     dict_debug->dict.delete = dict_debug_delete;
     dict_debug->dict.sequence = dict_debug_sequence;
+    dict_debug->dict.bulk_lookup = dict_debug_bulk_lookup;
     dict_debug->dict.close = dict_debug_close;
     dict_debug->real_dict = real_dict;
     return (&dict_debug->dict);
@@ -87,6 +87,7 @@ typedef struct {
     SLMDB   slmdb;			/* sane LMDB API */
     VSTRING *key_buf;			/* key buffer */
     VSTRING *val_buf;			/* value buffer */
+    VSTRING *last_key;			/* largest key, append mode */
 } DICT_LMDB;
 
  /*
@@ -209,6 +210,26 @@ static const char *dict_lmdb_lookup(DICT *dict, const char *name)
     return (result);
 }
 
+/* dict_lmdb_after_last - key sorts after all keys in the database */
+
+static int dict_lmdb_after_last(DICT_LMDB *dict_lmdb, MDB_val *mdb_key)
+{
+    VSTRING *last_key = dict_lmdb->last_key;
+    size_t  len;
+    int     diff;
+
+    /*
+     * Use the default LMDB key order: memcmp(), then shortest first.
+     */
+    if (VSTRING_LEN(last_key) == 0)
+	return (1);
+    len = (mdb_key->mv_size < VSTRING_LEN(last_key) ?
+	   mdb_key->mv_size : VSTRING_LEN(last_key));
+    if ((diff = memcmp(mdb_key->mv_data, vstring_str(last_key), len)) != 0)
+	return (diff > 0);
+    return (mdb_key->mv_size > VSTRING_LEN(last_key));
+}
+
 /* dict_lmdb_update - add or update database entry */
 
 static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
@@ -217,6 +238,7 @@ static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
     MDB_val mdb_key;
     MDB_val mdb_value;
     int     status;
+    int     append;
 
     dict->error = 0;
 
@@ -269,10 +291,18 @@ static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
 	msg_fatal("%s: lock dictionary: %m", dict->name);
 
     /*
-     * Do the update.
+     * Do the update. When a bulk-mode transaction fills an empty database,
+     * a key that sorts after all other keys is appended without a B-tree
+     * search, and pages are filled completely. Sorted input (see postmap)
+     * makes every update an append.
      */
+    append = (dict_lmdb->last_key != 0
+	      && dict_lmdb_after_last(dict_lmdb, &mdb_key));
     status = slmdb_put(&dict_lmdb->slmdb, &mdb_key, &mdb_value,
-	       (dict->flags & DICT_FLAG_DUP_REPLACE) ? 0 : MDB_NOOVERWRITE);
+	       ((dict->flags & DICT_FLAG_DUP_REPLACE) ? 0 : MDB_NOOVERWRITE)
+		       | (append ? MDB_APPEND : 0));
+    if (status == 0 && append)
+	vstring_memcpy(dict_lmdb->last_key, mdb_key.mv_data, mdb_key.mv_size);
     if (status != 0) {
 	if (status == MDB_KEYEXIST) {
 	    if (dict->flags & DICT_FLAG_DUP_IGNORE)
@@ -477,6 +507,8 @@ static void dict_lmdb_close(DICT *dict)
 	vstring_free(dict_lmdb->key_buf);
     if (dict_lmdb->val_buf)
 	vstring_free(dict_lmdb->val_buf);
+    if (dict_lmdb->last_key)
+	vstring_free(dict_lmdb->last_key);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     dict_free(dict);
@@ -488,6 +520,9 @@ static void dict_lmdb_longjmp(void *context, int val)
 {
     DICT_LMDB *dict_lmdb = (DICT_LMDB *) context;
 
+    /* The bulk transaction starts over with an empty database. */
+    if (dict_lmdb->last_key)
+	VSTRING_RESET(dict_lmdb->last_key);
     dict_longjmp(&dict_lmdb->dict, val);
 }
 
@@ -655,6 +690,10 @@ DICT   *dict_lmdb_open(const char *path, int open_flags, int dict_flags)
 
     dict_lmdb->key_buf = 0;
     dict_lmdb->val_buf = 0;
+    if ((dict_flags & DICT_FLAG_BULK_UPDATE) && (open_flags & O_TRUNC))
+	dict_lmdb->last_key = vstring_alloc(100);
+    else
+	dict_lmdb->last_key = 0;
 
     /*
      * Warn if the source file is newer than the indexed file, except when
@@ -0,0 +1,815 @@
+/*++
+/* NAME
+/*	dict_mph 3
+/* SUMMARY
+/*	dictionary manager interface to minimal perfect hash files
+/* SYNOPSIS
+/*	#include <dict_mph.h>
+/*
+/*	DICT	*dict_mph_open(path, open_flags, dict_flags)
+/*	const char *path;
+/*	int	open_flags;
+/*	int	dict_flags;
+/* DESCRIPTION
+/*	dict_mph_open() opens the specified minimal perfect hash file.
+/*	The result is a pointer to a structure that can be used to
+/*	access the dictionary using the generic methods documented
+/*	in dict_open(3).
+/*
+/*	A minimal perfect hash file is built once, and is never
+/*	updated. It contains a small displacement table that maps
+/*	every key to a different slot, an offset table with one entry
+/*	per slot, and the key and value strings of each entry. In
+/*	query mode the file is mapped into memory, and a lookup
+/*	computes two hash values, reads two table entries, and
+/*	compares one key; the result points into the file mapping.
+/*	Processes that open the same file share its memory.
+/*
+/*	In create mode, entries are kept in memory until the
+/*	dictionary is closed, then the hash function is computed and
+/*	the file is written as path.mph.tmp and renamed to path.mph.
+/*
+/*	Arguments:
+/* .IP path
+/*	The database pathname, not including the ".mph" suffix.
+/* .IP open_flags
+/*	Flags passed to open(). Specify O_RDONLY or O_WRONLY|O_CREAT|O_TRUNC.
+/* .IP dict_flags
+/*	Flags used by the dictionary interface.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/* DIAGNOSTICS
+/*	Fatal errors: cannot open file, write error, corrupted file,
+/*	out of memory.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *) -1)
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <vstream.h>
+#include <stringops.h>
+#include <iostuff.h>
+#include <myflock.h>
+#include <htable.h>
+#include <dict.h>
+#include <dict_mph.h>
+#include <hash_fnv.h>
+
+/* Application-specific. */
+
+#define MPH_SUFFIX	".mph"
+#define MPH_TMP_SUFFIX	MPH_SUFFIX ".tmp"
+
+ /*
+  * File layout. All numbers are 32-bit little-endian. The header is followed
+  * by one displacement per bucket, one record offset per slot, and the
+  * records in slot order. Each record is a null-terminated key followed by
+  * a null-terminated value.
+  */
+#define MPH_MAGIC	"PFMPH001"
+#define MPH_MAGIC_LEN	8
+#define MPH_HDR_NKEYS	8
+#define MPH_HDR_NBUCKETS 12
+#define MPH_HDR_SEED	16
+#define MPH_HDR_SIZE	32		/* 12 bytes reserved */
+
+#define MPH_GET32(p) \
+	((UINT32_TYPE) (p)[0] | ((UINT32_TYPE) (p)[1] << 8) \
+	 | ((UINT32_TYPE) (p)[2] << 16) | ((UINT32_TYPE) (p)[3] << 24))
+
+#define MPH_PUT32(p, v) do { \
+	(p)[0] = (v) & 0xff; \
+	(p)[1] = ((v) >> 8) & 0xff; \
+	(p)[2] = ((v) >> 16) & 0xff; \
+	(p)[3] = ((v) >> 24) & 0xff; \
+    } while (0)
+
+ /*
+  * A bucket with one key stores that key's slot number. Other buckets store
+  * a number that is mixed into the hash of each member key, chosen such
+  * that all members land in different free slots.
+  */
+#define MPH_DIRECT		0x80000000U
+#define MPH_SLOT(b, d, n) \
+	(((d) & MPH_DIRECT) ? (d) & ~MPH_DIRECT : \
+	 hash_fnv_fmix((b) + (d) * 0x9e3779b1U) % (n))
+
+#define MPH_KEYS_PER_BUCKET	4
+#define MPH_MAX_BUCKET_SIZE	64	/* else try another seed */
+#define MPH_MAX_DISP		(1 << 20)	/* else try another seed */
+#define MPH_MAX_SEEDS		100
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    char   *base;			/* file mapping */
+    size_t  size;			/* file size */
+    UINT32_TYPE nkeys;			/* number of slots */
+    UINT32_TYPE nbuckets;		/* number of buckets */
+    UINT32_TYPE seed;			/* hash function seed */
+    const unsigned char *disp;		/* displacement table */
+    const unsigned char *offs;		/* record offset table */
+    UINT32_TYPE seq_slot;		/* sequence position */
+} DICT_MPHQ;				/* query interface */
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    HTABLE *table;			/* pending entries */
+    VSTREAM *fp;			/* temporary file */
+    char   *mph_path;			/* database pathname (.mph) */
+    char   *tmp_path;			/* temporary pathname (.tmp) */
+} DICT_MPHM;				/* create interface */
+
+typedef struct {
+    UINT32_TYPE bucket;			/* bucket number */
+    UINT32_TYPE hash;			/* second hash */
+    HTABLE_INFO *info;			/* key and value */
+} MPH_KEY;
+
+/* mph_hash - compute two independent hashes */
+
+static void mph_hash(const char *key, UINT32_TYPE seed,
+		             UINT32_TYPE *h1, UINT32_TYPE *h2)
+{
+    const unsigned char *cp;
+    UINT32_TYPE b = seed * 0x9e3779b1U + 0x7f4a7c15U;
+
+    for (cp = (const unsigned char *) key; *cp; cp++) {
+	b = (b ^ *cp) * 0x5bd1e995U;
+	b ^= b >> 15;
+    }
+    *h1 = hash_fnv_fmix(hash_fnvz_seed(key, seed));
+    *h2 = hash_fnv_fmix(b ^ (UINT32_TYPE) (cp - (const unsigned char *) key));
+}
+
+/* dict_mphq_lookup - find database entry, query mode */
+
+static const char *dict_mphq_lookup(DICT *dict, const char *name)
+{
+    DICT_MPHQ *dict_mphq = (DICT_MPHQ *) dict;
+    UINT32_TYPE h1;
+    UINT32_TYPE h2;
+    UINT32_TYPE disp;
+    UINT32_TYPE slot;
+    const char *key;
+    size_t  len;
+
+    dict->error = 0;
+
+    /* The file is never updated, so do not try to acquire a lock. */
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_FIX) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(10);
+	vstring_strcpy(dict->fold_buf, name);
+	name = lowercase(vstring_str(dict->fold_buf));
+    }
+    if (dict_mphq->nkeys == 0)
+	return (0);
+
+    /*
+     * Every key maps to a different slot; compare the one candidate. Record
+     * offsets were checked when the file was opened, and the file ends in a
+     * null byte.
+     */
+    mph_hash(name, dict_mphq->seed, &h1, &h2);
+    disp = MPH_GET32(dict_mphq->disp + 4 * (h1 % dict_mphq->nbuckets));
+    slot = MPH_SLOT(h2, disp, dict_mphq->nkeys);
+    if (slot >= dict_mphq->nkeys)
+	msg_fatal("%s: corrupted database", dict->name);
+    key = dict_mphq->base + MPH_GET32(dict_mphq->offs + 4 * slot);
+    if (strcmp(key, name) != 0)
+	return (0);
+    if ((len = strlen(key) + 1) >= dict_mphq->size - (key - dict_mphq->base))
+	msg_fatal("%s: corrupted database", dict->name);
+    return (key + len);
+}
+
+/* dict_mphq_sequence - traverse the database in slot order */
+
+static int dict_mphq_sequence(DICT *dict, int function,
+			              const char **key, const char **value)
+{
+    DICT_MPHQ *dict_mphq = (DICT_MPHQ *) dict;
+    const char *cp;
+    size_t  len;
+
+    dict->error = 0;
+
+    switch (function) {
+    case DICT_SEQ_FUN_FIRST:
+	dict_mphq->seq_slot = 0;
+	break;
+    case DICT_SEQ_FUN_NEXT:
+	break;
+    default:
+	msg_panic("%s: invalid function %d", dict->name, function);
+    }
+    if (dict_mphq->seq_slot >= dict_mphq->nkeys)
+	return (DICT_STAT_FAIL);
+    cp = dict_mphq->base + MPH_GET32(dict_mphq->offs
+				     + 4 * dict_mphq->seq_slot);
+    if ((len = strlen(cp) + 1) >= dict_mphq->size - (cp - dict_mphq->base))
+	msg_fatal("%s: corrupted database", dict->name);
+    *key = cp;
+    *value = cp + len;
+    dict_mphq->seq_slot += 1;
+    return (DICT_STAT_SUCCESS);
+}
+
+/* dict_mphq_close - close data base, query mode */
+
+static void dict_mphq_close(DICT *dict)
+{
+    DICT_MPHQ *dict_mphq = (DICT_MPHQ *) dict;
+
+    if (munmap(dict_mphq->base, dict_mphq->size) < 0)
+	msg_warn("munmap %s: %m", dict->name);
+    close(dict->stat_fd);
+    if (dict->fold_buf)
+	vstring_free(dict->fold_buf);
+    dict_free(dict);
+}
+
+/* dict_mphq_open - open data base, query mode */
+
+static DICT *dict_mphq_open(const char *path, int dict_flags)
+{
+    DICT_MPHQ *dict_mphq;
+    struct stat st;
+    char   *mph_path;
+    const unsigned char *hdr;
+    char   *base;
+    size_t  records;
+    UINT32_TYPE slot;
+    UINT32_TYPE off;
+    int     fd;
+
+    /*
+     * Let the optimizer worry about eliminating redundant code.
+     */
+#define DICT_MPHQ_OPEN_RETURN(d) do { \
+	DICT *__d = (d); \
+	myfree(mph_path); \
+	return (__d); \
+    } while (0)
+
+    mph_path = concatenate(path, MPH_SUFFIX, (char *) 0);
+
+    if ((fd = open(mph_path, O_RDONLY)) < 0)
+	DICT_MPHQ_OPEN_RETURN(dict_surrogate(DICT_TYPE_MPH, path,
+					     O_RDONLY, dict_flags,
+					 "open database %s: %m", mph_path));
+    if (fstat(fd, &st) < 0)
+	msg_fatal("dict_mphq_open: fstat: %m");
+    if (st.st_size < MPH_HDR_SIZE || st.st_size > 0xffffffffU) {
+	close(fd);
+	DICT_MPHQ_OPEN_RETURN(dict_surrogate(DICT_TYPE_MPH, path,
+					     O_RDONLY, dict_flags,
+					   "%s: bad file size", mph_path));
+    }
+    if ((base = mmap((void *) 0, st.st_size, PROT_READ, MAP_SHARED,
+		     fd, (off_t) 0)) == MAP_FAILED)
+	msg_fatal("mmap %s: %m", mph_path);
+
+    dict_mphq = (DICT_MPHQ *) dict_alloc(DICT_TYPE_MPH,
+					 mph_path, sizeof(*dict_mphq));
+    dict_mphq->dict.lookup = dict_mphq_lookup;
+    dict_mphq->dict.sequence = dict_mphq_sequence;
+    dict_mphq->dict.close = dict_mphq_close;
+    dict_mphq->dict.stat_fd = fd;
+    dict_mphq->dict.mtime = st.st_mtime;
+    dict_mphq->dict.owner.uid = st.st_uid;
+    dict_mphq->dict.owner.status = (st.st_uid != 0);
+    close_on_exec(fd, CLOSE_ON_EXEC);
+    dict_mphq->base = base;
+    dict_mphq->size = st.st_size;
+
+    /*
+     * Check the file structure once, so that a lookup needs no bounds
+     * checks other than the slot number and the value position.
+     */
+    hdr = (const unsigned char *) base;
+    dict_mphq->nkeys = MPH_GET32(hdr + MPH_HDR_NKEYS);
+    dict_mphq->nbuckets = MPH_GET32(hdr + MPH_HDR_NBUCKETS);
+    dict_mphq->seed = MPH_GET32(hdr + MPH_HDR_SEED);
+    dict_mphq->disp = hdr + MPH_HDR_SIZE;
+    dict_mphq->offs = dict_mphq->disp + 4 * (size_t) dict_mphq->nbuckets;
+    records = (dict_mphq->offs - hdr) + 4 * (size_t) dict_mphq->nkeys;
+    if (memcmp(base, MPH_MAGIC, MPH_MAGIC_LEN) != 0
+	|| dict_mphq->nbuckets == 0
+	|| dict_mphq->nkeys >= MPH_DIRECT
+	|| dict_mphq->nbuckets >= MPH_DIRECT
+	|| records > dict_mphq->size
+	|| base[dict_mphq->size - 1] != 0)
+	msg_fatal("%s: bad file format", mph_path);
+    for (slot = 0; slot < dict_mphq->nkeys; slot++) {
+	off = MPH_GET32(dict_mphq->offs + 4 * slot);
+	if (off < records || off >= dict_mphq->size)
+	    msg_fatal("%s: corrupted database", mph_path);
+    }
+
+    /*
+     * Warn if the source file is newer than the indexed file, except when
+     * the source file changed only seconds ago.
+     */
+    if (stat(path, &st) == 0
+	&& st.st_mtime > dict_mphq->dict.mtime
+	&& st.st_mtime < time((time_t *) 0) - 100)
+	msg_warn("database %s is older than source file %s", mph_path, path);
+
+    dict_mphq->dict.flags = dict_flags | DICT_FLAG_FIXED;
+    if (dict_flags & DICT_FLAG_FOLD_FIX)
+	dict_mphq->dict.fold_buf = vstring_alloc(10);
+
+    DICT_MPHQ_OPEN_RETURN(DICT_DEBUG (&dict_mphq->dict));
+}
+
+/* dict_mphm_update - add database entry, create mode */
+
+static int dict_mphm_update(DICT *dict, const char *name, const char *value)
+{
+    DICT_MPHM *dict_mphm = (DICT_MPHM *) dict;
+    HTABLE_INFO *ht;
+
+    dict->error = 0;
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_FIX) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(10);
+	vstring_strcpy(dict->fold_buf, name);
+	name = lowercase(vstring_str(dict->fold_buf));
+    }
+
+    /*
+     * Entries are written when the table is closed.
+     */
+    if ((ht = htable_locate(dict_mphm->table, name)) == 0) {
+	(void) htable_enter(dict_mphm->table, name, mystrdup(value));
+	return (DICT_STAT_SUCCESS);
+    }
+    if (dict->flags & DICT_FLAG_DUP_REPLACE) {
+	myfree(ht->value);
+	ht->value = mystrdup(value);
+	return (DICT_STAT_SUCCESS);
+    }
+    if (dict->flags & DICT_FLAG_DUP_IGNORE)
+	 /* void */ ;
+    else if (dict->flags & DICT_FLAG_DUP_WARN)
+	msg_warn("%s: duplicate entry: \"%s\"", dict_mphm->dict.name, name);
+    else
+	msg_fatal("%s: duplicate entry: \"%s\"", dict_mphm->dict.name, name);
+    return (DICT_STAT_FAIL);
+}
+
+/* mph_build - try to compute a minimal perfect hash function */
+
+static int mph_build(MPH_KEY *keys, UINT32_TYPE nkeys, UINT32_TYPE nbuckets,
+		             UINT32_TYPE *disp, UINT32_TYPE *slots)
+{
+    UINT32_TYPE *start;
+    UINT32_TYPE *members;
+    UINT32_TYPE *order;
+    UINT32_TYPE by_size[MPH_MAX_BUCKET_SIZE + 2];
+    UINT32_TYPE pos[MPH_MAX_BUCKET_SIZE];
+    char   *taken;
+    UINT32_TYPE free_slot = 0;
+    UINT32_TYPE bucket;
+    UINT32_TYPE size;
+    UINT32_TYPE d;
+    UINT32_TYPE i;
+    UINT32_TYPE j;
+    UINT32_TYPE k;
+    int     ok = 1;
+
+    /*
+     * Group the keys by bucket, with counting sorts: keys by bucket number,
+     * and buckets by decreasing size. Give up on this seed when a bucket is
+     * too large.
+     */
+    start = (UINT32_TYPE *) mymalloc(sizeof(*start) * (nbuckets + 1));
+    members = (UINT32_TYPE *) mymalloc(sizeof(*members) * (nkeys + 1));
+    order = (UINT32_TYPE *) mymalloc(sizeof(*order) * nbuckets);
+    taken = mymalloc(nkeys + 1);
+    memset((void *) start, 0, sizeof(*start) * (nbuckets + 1));
+    memset(taken, 0, nkeys + 1);
+    for (i = 0; i < nkeys; i++)
+	if ((start[keys[i].bucket + 1] += 1) > MPH_MAX_BUCKET_SIZE)
+	    ok = 0;
+    if (ok) {
+	memset((void *) by_size, 0, sizeof(by_size));
+	for (bucket = 0; bucket < nbuckets; bucket++)
+	    by_size[MPH_MAX_BUCKET_SIZE - start[bucket + 1] + 1] += 1;
+	for (size = 1; size <= MPH_MAX_BUCKET_SIZE + 1; size++)
+	    by_size[size] += by_size[size - 1];
+	for (bucket = 0; bucket < nbuckets; bucket++)
+	    order[by_size[MPH_MAX_BUCKET_SIZE - start[bucket + 1]]++] = bucket;
+	for (bucket = 0; bucket < nbuckets; bucket++)
+	    start[bucket + 1] += start[bucket];
+	for (i = 0; i < nkeys; i++)
+	    members[start[keys[i].bucket]++] = i;
+	for (bucket = nbuckets; bucket > 0; bucket--)
+	    start[bucket] = start[bucket - 1];
+	start[0] = 0;
+    }
+
+    /*
+     * Place the largest buckets first, while most slots are still free. A
+     * bucket with one key takes the next free slot.
+     */
+    for (j = 0; ok && j < nbuckets; j++) {
+	bucket = order[j];
+	size = start[bucket + 1] - start[bucket];
+	if (size == 0) {
+	    disp[bucket] = 0;
+	    continue;
+	}
+	if (size == 1) {
+	    while (taken[free_slot])
+		free_slot++;
+	    taken[free_slot] = 1;
+	    disp[bucket] = MPH_DIRECT | free_slot;
+	    slots[free_slot] = members[start[bucket]];
+	    continue;
+	}
+	for (i = 0; ok && i < size; i++)
+	    for (k = 0; ok && k < i; k++)
+		if (keys[members[start[bucket] + i]].hash
+		    == keys[members[start[bucket] + k]].hash)
+		    ok = 0;
+	for (d = 0; ok && d < MPH_MAX_DISP; d++) {
+	    for (i = 0; i < size; i++) {
+		pos[i] = MPH_SLOT(keys[members[start[bucket] + i]].hash,
+				  d, nkeys);
+		if (taken[pos[i]])
+		    break;
+		for (k = 0; k < i && pos[k] != pos[i]; k++)
+		     /* void */ ;
+		if (k < i)
+		    break;
+	    }
+	    if (i == size)
+		break;
+	}
+	if (d >= MPH_MAX_DISP)
+	    ok = 0;
+	if (ok) {
+	    for (i = 0; i < size; i++) {
+		taken[pos[i]] = 1;
+		slots[pos[i]] = members[start[bucket] + i];
+	    }
+	    disp[bucket] = d;
+	}
+    }
+    myfree((void *) start);
+    myfree((void *) members);
+    myfree((void *) order);
+    myfree(taken);
+    return (ok);
+}
+
+/* mph_put32 - write one number */
+
+static void mph_put32(VSTREAM *fp, UINT32_TYPE value)
+{
+    unsigned char buf[4];
+
+    MPH_PUT32(buf, value);
+    vstream_fwrite(fp, (void *) buf, sizeof(buf));
+}
+
+/* dict_mphm_close - write database and rename file.tmp to file.mph */
+
+static void dict_mphm_close(DICT *dict)
+{
+    DICT_MPHM *dict_mphm = (DICT_MPHM *) dict;
+    HTABLE_INFO **list;
+    MPH_KEY *keys;
+    UINT32_TYPE *disp;
+    UINT32_TYPE *slots;
+    UINT32_TYPE nkeys = dict_mphm->table->used;
+    UINT32_TYPE nbuckets = nkeys / MPH_KEYS_PER_BUCKET + 1;
+    UINT32_TYPE seed;
+    UINT32_TYPE h1;
+    UINT32_TYPE i;
+    size_t  offset;
+    HTABLE_INFO *ht;
+
+    if (dict_mphm->table->used >= MPH_DIRECT)
+	msg_fatal("%s: too many entries", dict_mphm->tmp_path);
+
+    /*
+     * Find a seed that produces a perfect hash function. Most of the time,
+     * the first seed will do.
+     */
+    list = htable_list(dict_mphm->table);
+    keys = (MPH_KEY *) mymalloc(sizeof(*keys) * (nkeys + 1));
+    disp = (UINT32_TYPE *) mymalloc(sizeof(*disp) * nbuckets);
+    slots = (UINT32_TYPE *) mymalloc(sizeof(*slots) * (nkeys + 1));
+    for (seed = 0; /* see below */ ; seed++) {
+	if (seed >= MPH_MAX_SEEDS)
+	    msg_fatal("%s: unable to compute a perfect hash function",
+		      dict_mphm->tmp_path);
+	for (i = 0; i < nkeys; i++) {
+	    mph_hash(list[i]->key, seed, &h1, &keys[i].hash);
+	    keys[i].bucket = h1 % nbuckets;
+	    keys[i].info = list[i];
+	}
+	if (mph_build(keys, nkeys, nbuckets, disp, slots))
+	    break;
+	if (msg_verbose)
+	    msg_info("%s: seed %u failed", dict_mphm->tmp_path, seed);
+    }
+
+    /*
+     * Write the header, the tables, and the records in slot order.
+     */
+    vstream_fwrite(dict_mphm->fp, MPH_MAGIC, MPH_MAGIC_LEN);
+    mph_put32(dict_mphm->fp, nkeys);
+    mph_put32(dict_mphm->fp, nbuckets);
+    mph_put32(dict_mphm->fp, seed);
+    for (i = MPH_HDR_SEED + 4; i < MPH_HDR_SIZE; i += 4)
+	mph_put32(dict_mphm->fp, 0);
+    for (i = 0; i < nbuckets; i++)
+	mph_put32(dict_mphm->fp, disp[i]);
+    offset = MPH_HDR_SIZE + 4 * (size_t) nbuckets + 4 * (size_t) nkeys;
+    for (i = 0; i < nkeys; i++) {
+	ht = keys[slots[i]].info;
+	mph_put32(dict_mphm->fp, (UINT32_TYPE) offset);
+	offset += strlen(ht->key) + strlen(ht->value) + 2;
+	if (offset > 0xffffffffU)
+	    msg_fatal("%s: database too large", dict_mphm->tmp_path);
+    }
+    for (i = 0; i < nkeys; i++) {
+	ht = keys[slots[i]].info;
+	vstream_fwrite(dict_mphm->fp, ht->key, strlen(ht->key) + 1);
+	vstream_fwrite(dict_mphm->fp, ht->value, strlen(ht->value) + 1);
+    }
+    if (nkeys == 0)
+	VSTREAM_PUTC(0, dict_mphm->fp);
+
+    /*
+     * Note: if FCNTL locking is used, closing any file descriptor on a
+     * locked file cancels all locks that the process may have on that file.
+     * The stream owns the only file descriptor, which is used for database
+     * I/O and locking.
+     */
+    if (vstream_fflush(dict_mphm->fp) != 0)
+	msg_fatal("write database %s: %m", dict_mphm->tmp_path);
+    if (rename(dict_mphm->tmp_path, dict_mphm->mph_path) < 0)
+	msg_fatal("rename database from %s to %s: %m",
+		  dict_mphm->tmp_path, dict_mphm->mph_path);
+    if (vstream_fclose(dict_mphm->fp) != 0)	/* releases a lock */
+	msg_fatal("close database %s: %m", dict_mphm->mph_path);
+    myfree((void *) list);
+    myfree((void *) keys);
+    myfree((void *) disp);
+    myfree((void *) slots);
+    htable_free(dict_mphm->table, myfree);
+    myfree(dict_mphm->mph_path);
+    myfree(dict_mphm->tmp_path);
+    if (dict->fold_buf)
+	vstring_free(dict->fold_buf);
+    dict_free(dict);
+}
+
+/* dict_mphm_open - create database as file.tmp */
+
+static DICT *dict_mphm_open(const char *path, int dict_flags)
+{
+    DICT_MPHM *dict_mphm;
+    char   *mph_path;
+    char   *tmp_path;
+    int     fd;
+    struct stat st0, st1;
+
+    /*
+     * Let the optimizer worry about eliminating redundant code.
+     */
+#define DICT_MPHM_OPEN_RETURN(d) do { \
+	DICT *__d = (d); \
+	if (mph_path) \
+	    myfree(mph_path); \
+	if (tmp_path) \
+	    myfree(tmp_path); \
+	return (__d); \
+    } while (0)
+
+    mph_path = concatenate(path, MPH_SUFFIX, (char *) 0);
+    tmp_path = concatenate(path, MPH_TMP_SUFFIX, (char *) 0);
+
+    /*
+     * Repeat until we have opened *and* locked *existing* file. The new
+     * (tmp) file will be renamed to the .mph file; see dict_cdb(3) for the
+     * race conditions that this avoids.
+     */
+    for (;;) {
+	if ((fd = open(tmp_path, O_RDWR | O_CREAT, 0644)) < 0)
+	    DICT_MPHM_OPEN_RETURN(dict_surrogate(DICT_TYPE_MPH, path,
+						 O_RDWR, dict_flags,
+						 "open database %s: %m",
+						 tmp_path));
+	if (fstat(fd, &st0) < 0)
+	    msg_fatal("fstat(%s): %m", tmp_path);
+	if (myflock(fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0)
+	    msg_fatal("lock %s: %m", tmp_path);
+	if (stat(tmp_path, &st1) < 0)
+	    msg_fatal("stat(%s): %m", tmp_path);
+	if (st0.st_ino == st1.st_ino && st0.st_dev == st1.st_dev
+	    && st0.st_rdev == st1.st_rdev && st0.st_nlink == st1.st_nlink
+	    && st0.st_nlink > 0)
+	    break;
+	close(fd);
+    }
+
+#ifndef NO_FTRUNCATE
+    if (st0.st_size)
+	ftruncate(fd, 0);
+#endif
+
+    dict_mphm = (DICT_MPHM *) dict_alloc(DICT_TYPE_MPH, path,
+					 sizeof(*dict_mphm));
+    dict_mphm->dict.close = dict_mphm_close;
+    dict_mphm->dict.update = dict_mphm_update;
+    dict_mphm->table = htable_create(1000);
+    dict_mphm->fp = vstream_fdopen(fd, O_WRONLY);
+    dict_mphm->mph_path = mph_path;
+    dict_mphm->tmp_path = tmp_path;
+    mph_path = tmp_path = 0;			/* DICT_MPHM_OPEN_RETURN() */
+    dict_mphm->dict.owner.uid = st1.st_uid;
+    dict_mphm->dict.owner.status = (st1.st_uid != 0);
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    dict_mphm->dict.flags = dict_flags | DICT_FLAG_FIXED;
+    if (dict_flags & DICT_FLAG_FOLD_FIX)
+	dict_mphm->dict.fold_buf = vstring_alloc(10);
+
+    DICT_MPHM_OPEN_RETURN(DICT_DEBUG (&dict_mphm->dict));
+}
+
+/* dict_mph_open - open data base for query mode or create mode */
+
+DICT   *dict_mph_open(const char *path, int open_flags, int dict_flags)
+{
+    switch (open_flags & (O_RDONLY | O_RDWR | O_WRONLY | O_CREAT | O_TRUNC)) {
+    case O_RDONLY:				/* query mode */
+	return (dict_mphq_open(path, dict_flags));
+    case O_WRONLY | O_CREAT | O_TRUNC:		/* create mode */
+    case O_RDWR | O_CREAT | O_TRUNC:		/* sloppiness */
+	return (dict_mphm_open(path, dict_flags));
+    default:
+	return (dict_surrogate(DICT_TYPE_MPH, path, open_flags, dict_flags,
+			       "%s:%s map requires O_RDONLY or "
+			       "O_WRONLY|O_CREAT|O_TRUNC access mode",
+			       DICT_TYPE_MPH, path));
+    }
+}
+
+#ifdef TEST
+
+ /*
+  * Benchmark. Usage:
+  *
+  * dict_mph -b entries lookups [type...]
+  *
+  * Creates a table with the specified number of entries for each file-based
+  * type (default: mph, cdb, lmdb, hash, when available), then reports the
+  * build time and the cost of random lookups, three out of four of which
+  * find an entry. The files are created in the current directory as
+  * dict_mph_bench.suffix.
+  */
+#include <stdlib.h>
+#include <msg_vstream.h>
+#include <myrand.h>
+
+static double test_elapsed(struct timeval * start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static void test_bench(const char *type, int nentries, int nlookups,
+		               char **names)
+{
+    VSTRING *spec = vstring_alloc(100);
+    VSTRING *key = vstring_alloc(100);
+    VSTRING *value = vstring_alloc(100);
+    struct timeval start;
+    double  build_time;
+    double  lookup_time;
+    DICT   *dict;
+    int     found = 0;
+    int     n;
+
+    vstring_sprintf(spec, "%s:dict_mph_bench", type);
+    GETTIMEOFDAY(&start);
+    dict = dict_open(vstring_str(spec), O_RDWR | O_CREAT | O_TRUNC,
+		     DICT_FLAG_DUP_REPLACE | DICT_FLAG_TRY1NULL);
+    for (n = 0; n < nentries; n++) {
+	vstring_sprintf(key, "user%d@example.com", n);
+	vstring_sprintf(value, "mailbox%d@example.net", n);
+	if (dict_put(dict, vstring_str(key), vstring_str(value)) < 0)
+	    msg_fatal("%s: update error", vstring_str(spec));
+    }
+    dict_close(dict);
+    build_time = test_elapsed(&start);
+
+    dict = dict_open(vstring_str(spec), O_RDONLY, DICT_FLAG_TRY1NULL);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < nlookups; n++)
+	found += (dict_get(dict, names[n]) != 0);
+    lookup_time = test_elapsed(&start);
+    if (dict->error)
+	msg_fatal("%s: lookup error", vstring_str(spec));
+    dict_close(dict);
+
+    vstream_printf("%-6s build: %.3f s, lookup: %.3f us/lookup, %d found\n",
+		   type, build_time, lookup_time * 1000000.0 / nlookups,
+		   found);
+    vstream_fflush(VSTREAM_OUT);
+    vstring_free(spec);
+    vstring_free(key);
+    vstring_free(value);
+}
+
+int     main(int argc, char **argv)
+{
+    static char *default_types[] = {
+	DICT_TYPE_MPH, "cdb", "lmdb", "hash", 0,
+    };
+    char  **types;
+    char  **cpp;
+    char  **names;
+    ARGV   *mapnames;
+    VSTRING *buf;
+    int     nentries;
+    int     nlookups;
+    int     n;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+
+    if (argc < 4 || strcmp(argv[1], "-b") != 0
+	|| (nentries = atoi(argv[2])) <= 0 || (nlookups = atoi(argv[3])) <= 0)
+	msg_fatal("usage: %s -b entries lookups [type...]", argv[0]);
+    types = (argc > 4 ? argv + 4 : default_types);
+
+    buf = vstring_alloc(100);
+    mysrand(1);
+    names = (char **) mymalloc(sizeof(*names) * nlookups);
+    for (n = 0; n < nlookups; n++) {
+	vstring_sprintf(buf, "user%d@example.%s", myrand() % nentries,
+			myrand() % 4 ? "com" : "org");
+	names[n] = mystrdup(vstring_str(buf));
+    }
+    mapnames = dict_mapnames();
+    for (cpp = types; *cpp; cpp++) {
+	for (n = 0; n < mapnames->argc; n++)
+	    if (strcmp(mapnames->argv[n], *cpp) == 0)
+		break;
+	if (n < mapnames->argc)
+	    test_bench(*cpp, nentries, nlookups, names);
+	else
+	    msg_info("%s: table type is not available", *cpp);
+    }
+    argv_free(mapnames);
+    for (n = 0; n < nlookups; n++)
+	myfree(names[n]);
+    myfree((void *) names);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _DICT_MPH_H_INCLUDED_
+#define _DICT_MPH_H_INCLUDED_
+
+/*++
+/* NAME
+/*	dict_mph 3h
+/* SUMMARY
+/*	dictionary manager interface to minimal perfect hash files
+/* SYNOPSIS
+/*	#include <dict_mph.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <dict.h>
+
+ /*
+  * External interface.
+  */
+#define DICT_TYPE_MPH	"mph"
+
+extern DICT *dict_mph_open(const char *, int, int);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
@@ -36,6 +36,12 @@
 /*	const char **key;
 /*	const char **value;
 /*
+/*	int	dict_get_bulk(dict, count, keys, values)
+/*	DICT	*dict;
+/*	int	count;
+/*	const char **keys;
+/*	const char **values;
+/*
 /*	void	dict_close(dict)
 /*	DICT	*dict;
 /*
@@ -212,8 +218,8 @@
 /*	dict_open3() takes separate arguments for dictionary type and
 /*	name, but otherwise performs the same functions as dict_open().
 /*
-/*	The dict_get(), dict_put(), dict_del(), and dict_seq()
-/*	macros evaluate their first argument multiple times.
+/*	The dict_get(), dict_put(), dict_del(), dict_seq() and
+/*	dict_get_bulk() macros evaluate their first argument multiple times.
 /*	These names should have been in uppercase.
 /*
 /*	dict_get() retrieves the value stored in the named dictionary
@@ -234,6 +240,17 @@
 /*	DICT_SEQ_FUN_NEXT (select next member). A zero (DICT_STAT_SUCCESS)
 /*	result means that an entry was found.
 /*
+/*	dict_get_bulk() looks up \fIcount\fR keys in one operation,
+/*	and stores the result for \fIkeys[i]\fR in \fIvalues[i]\fR,
+/*	with a null pointer for a key that was not found. The result
+/*	is DICT_ERR_NONE when all lookups completed, otherwise it
+/*	is the dictionary error code, and the content of \fIvalues\fR
+/*	is undefined. The values are owned by the lookup table and
+/*	remain valid until the next dict_get_bulk() call on the
+/*	same table. Tables that can send multiple keys to a server
+/*	in one request (such as proxy:) implement this natively;
+/*	other tables perform one lookup per key.
+/*
 /*	dict_close() closes the specified dictionary and cleans up the
 /*	associated data structures.
 /*
@@ -343,7 +360,9 @@
 #include <dict_pipe.h>
 #include <dict_random.h>
 #include <dict_union.h>
+#include <dict_cachemap.h>
 #include <dict_inline.h>
+#include <dict_mph.h>
 #include <stringops.h>
 #include <split_at.h>
 #include <htable.h>
@@ -389,7 +408,9 @@ static const DICT_OPEN_INFO dict_open_info[] = {
     DICT_TYPE_PIPE, dict_pipe_open,
     DICT_TYPE_RANDOM, dict_random_open,
     DICT_TYPE_UNION, dict_union_open,
+    DICT_TYPE_CACHEMAP, dict_cachemap_open,
     DICT_TYPE_INLINE, dict_inline_open,
+    DICT_TYPE_MPH, dict_mph_open,
 #ifndef USE_DYNAMIC_MAPS
 #ifdef HAS_PCRE
     DICT_TYPE_PCRE, dict_pcre_open,
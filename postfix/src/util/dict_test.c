@@ -19,6 +19,8 @@
 /* Utility library. */
 
 #include <msg.h>
+#include <mymalloc.h>
+#include <argv.h>
 #include <stringops.h>
 #include <vstring.h>
 #include <vstream.h>
@@ -33,6 +35,35 @@ static NORETURN usage(char *myname)
     msg_fatal("usage: %s type:file read|write|create [flags...]", myname);
 }
 
+/* dict_test_bulk - look up multiple keys at once */
+
+static void dict_test_bulk(DICT *dict, char *bufp)
+{
+    ARGV   *keys = argv_alloc(10);
+    VSTRING *keybuf = vstring_alloc(10);
+    const char **values;
+    const char *key;
+    int     n;
+
+    while ((key = mystrtok(&bufp, " ")) != 0)
+	argv_add(keys, vstring_str(unescape(keybuf, key)), ARGV_END);
+    values = (const char **) mymalloc(keys->argc * sizeof(*values));
+    if (dict_get_bulk(dict, keys->argc, (const char **) keys->argv,
+		      values) != DICT_ERR_NONE) {
+	vstream_printf("error\n");
+    } else {
+	for (n = 0; n < keys->argc; n++) {
+	    if (values[n] == 0)
+		vstream_printf("%s: not found\n", keys->argv[n]);
+	    else
+		vstream_printf("%s=%s\n", keys->argv[n], values[n]);
+	}
+    }
+    myfree((void *) values);
+    vstring_free(keybuf);
+    argv_free(keys);
+}
+
 void    dict_test(int argc, char **argv)
 {
     VSTRING *keybuf = vstring_alloc(1);
@@ -49,7 +80,7 @@ void    dict_test(int argc, char **argv)
     int     n;
     int     rc;
 
-#define USAGE	"verbose|del key|get key|put key=value|first|next|masks|flags"
+#define USAGE	"verbose|del key|get key|bulk key...|put key=value|first|next|masks|flags"
 
     signal(SIGPIPE, SIG_IGN);
 
@@ -109,6 +140,11 @@ void    dict_test(int argc, char **argv)
 	}
 	if (dict_changed_name())
 	    msg_warn("dictionary has changed");
+	if (strcmp(cmd, "bulk") == 0 && *bufp) {
+	    dict_test_bulk(dict, bufp);
+	    vstream_fflush(VSTREAM_OUT);
+	    continue;
+	}
 	key = *bufp ? vstring_str(unescape(keybuf, mystrtok(&bufp, " ="))) : 0;
 	value = mystrtok(&bufp, " =");
 	if (strcmp(cmd, "verbose") == 0 && !key) {
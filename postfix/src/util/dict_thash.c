@@ -11,11 +11,27 @@
 /*	const char *path;
 /*	int	open_flags;
 /*	int	dict_flags;
+/*
+/*	int	dict_thash_parse(dict, path, lineno, line_buffer, key, value)
+/*	DICT	*dict;
+/*	const char *path;
+/*	int	lineno;
+/*	VSTRING	*line_buffer;
+/*	char	**key;
+/*	char	**value;
 /* DESCRIPTION
 /*	dict_thash_open() opens the named flat text file, creates
 /*	an in-memory hash table, and makes it available via the
 /*	generic interface described in dict_open(3). The input
 /*	format is as with postmap(1).
+/*
+/*	dict_thash_parse() splits a logical input line, as returned
+/*	by readllines(), into a key and a value. The key is left in
+/*	quoted form. The result is zero, after logging a warning,
+/*	when the line must be ignored. Input that is not valid UTF-8
+/*	is ignored when UTF-8 checks are enabled for \fIdict\fR.
+/*	The \fIpath\fR and \fIlineno\fR arguments are used for
+/*	logging only. The key and value are stored in \fIline_buffer\fR.
 /* DIAGNOSTICS
 /*	Fatal errors: cannot open file, out of memory.
 /* SEE ALSO
@@ -59,6 +75,75 @@
 #define STR	vstring_str
 #define LEN	VSTRING_LEN
 
+/* dict_thash_parse - split "key whitespace value" input line */
+
+int     dict_thash_parse(DICT *dict, const char *path, int lineno,
+			         VSTRING *line_buffer, char **key, char **value)
+{
+    int     in_quotes = 0;
+    char   *cp;
+
+    /*
+     * First some UTF-8 checks sans casefolding.
+     */
+    if ((dict->flags & DICT_FLAG_UTF8_ACTIVE)
+	&& allascii(STR(line_buffer)) == 0
+	&& valid_utf8_string(STR(line_buffer), LEN(line_buffer)) == 0) {
+	msg_warn("%s, line %d: non-UTF-8 input \"%s\""
+		 " -- ignoring this line", path, lineno, STR(line_buffer));
+	return (0);
+    }
+
+    /*
+     * Terminate the key on the first unquoted whitespace character, then
+     * trim leading and trailing whitespace from the value.
+     */
+    for (cp = STR(line_buffer); *cp; cp++) {
+	if (*cp == '\\') {
+	    if (*++cp == 0)
+		break;
+	} else if (ISSPACE(*cp)) {
+	    if (!in_quotes)
+		break;
+	} else if (*cp == '"') {
+	    in_quotes = !in_quotes;
+	}
+    }
+    if (in_quotes) {
+	msg_warn("%s, line %d: unbalanced '\"' in '%s'"
+		 " -- ignoring this line", path, lineno, STR(line_buffer));
+	return (0);
+    }
+    if (*cp)
+	*cp++ = 0;
+    while (ISSPACE(*cp))
+	cp++;
+    trimblanks(cp, 0)[0] = 0;
+
+    /*
+     * Leave the key in quoted form, because 1) postmap cannot assume that a
+     * string without @ contains an email address localpart, and 2) an
+     * address localpart may require quoting even when the quoted form
+     * contains no backslash or ". This is consistent with dict_inline.c.
+     */
+    *key = STR(line_buffer);
+    *value = cp;
+
+    /*
+     * Enforce the "key whitespace value" format. Disallow missing keys or
+     * missing values.
+     */
+    if (**key == 0 || **value == 0) {
+	msg_warn("%s, line %d: expected format: key whitespace value"
+		 " -- ignoring this line", path, lineno);
+	return (0);
+    }
+    if ((*key)[strlen(*key) - 1] == ':')
+	msg_warn("%s, line %d: record is in \"key: value\" format;"
+		 " is this an alias file?", path, lineno);
+    return (1);
+}
+
 /* dict_thash_open - open flat text data base */
 
 DICT   *dict_thash_open(const char *path, int open_flags, int dict_flags)
@@ -112,72 +197,13 @@ DICT   *dict_thash_open(const char *path, int open_flags, int dict_flags)
 	dict = dict_open3(DICT_TYPE_HT, path, open_flags, dict_flags);
 	dict_type_override(dict, DICT_TYPE_THASH);
 
-	/*
-	 * XXX This duplicates the parser in postmap.c.
-	 */
 	if (line_buffer == 0)
 	    line_buffer = vstring_alloc(100);
 	last_line = 0;
 	while (readllines(line_buffer, fp, &last_line, &lineno)) {
-	    int     in_quotes = 0;
-
-	    /*
-	     * First some UTF-8 checks sans casefolding.
-	     */
-	    if ((dict->flags & DICT_FLAG_UTF8_ACTIVE)
-		&& allascii(STR(line_buffer)) == 0
-	    && valid_utf8_string(STR(line_buffer), LEN(line_buffer)) == 0) {
-		msg_warn("%s, line %d: non-UTF-8 input \"%s\""
-			 " -- ignoring this line",
-			 VSTREAM_PATH(fp), lineno, STR(line_buffer));
-		continue;
-	    }
-
-	    /*
-	     * Split on the first whitespace character, then trim leading and
-	     * trailing whitespace from key and value.
-	     */
-	    for (value = STR(line_buffer); *value; value++) {
-		if (*value == '\\') {
-		    if (*++value == 0)
-			break;
-		} else if (ISSPACE(*value)) {
-		    if (!in_quotes)
-			break;
-		} else if (*value == '"') {
-		    in_quotes = !in_quotes;
-		}
-	    }
-	    if (in_quotes) {
-		msg_warn("%s, line %d: unbalanced '\"' in '%s'"
-			 " -- ignoring this line",
-			 VSTREAM_PATH(fp), lineno, STR(line_buffer));
+	    if (dict_thash_parse(dict, VSTREAM_PATH(fp), lineno,
+				 line_buffer, &key, &value) == 0)
 		continue;
-	    }
-	    if (*value)
-		*value++ = 0;
-	    while (ISSPACE(*value))
-		value++;
-	    trimblanks(value, 0)[0] = 0;
-
-	    /*
-	     * Leave the key in quoted form, for consistency with postmap.c
-	     * and dict_inline.c.
-	     */
-	    key = STR(line_buffer);
-
-	    /*
-	     * Enforce the "key whitespace value" format. Disallow missing
-	     * keys or missing values.
-	     */
-	    if (*key == 0 || *value == 0) {
-		msg_warn("%s, line %d: expected format: key whitespace value"
-			 " -- ignoring this line", path, lineno);
-		continue;
-	    }
-	    if (key[strlen(key) - 1] == ':')
-		msg_warn("%s, line %d: record is in \"key: value\" format;"
-			 " is this an alias file?", path, lineno);
 
 	    /*
 	     * Store the value under the key. Handle duplicates
@@ -14,6 +14,7 @@
  /*
   * Utility library.
   */
+#include <vstring.h>
 #include <dict.h>
 
  /*
@@ -22,6 +23,7 @@
 #define DICT_TYPE_THASH	"texthash"
 
 extern DICT *dict_thash_open(const char *, int, int);
+extern int dict_thash_parse(DICT *, const char *, int, VSTRING *, char **, char **);
 
 /* LICENSE
 /* .ad
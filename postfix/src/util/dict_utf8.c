@@ -10,7 +10,7 @@
 /*	DICT	*dict)
 /* DESCRIPTION
 /*	dict_utf8_activate() wraps a dictionary's lookup/update/delete
-/*	methods with code that enforces UTF-8 checks on keys and
+/*	and bulk lookup methods with code that enforces UTF-8 checks on keys and
 /*	values, and that logs a warning when incorrect UTF-8 is
 /*	encountered. The original dictionary handle becomes invalid.
 /*
@@ -173,6 +173,88 @@ static const char *dict_utf8_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_utf8_bulk_lookup - UTF-8 bulk lookup method wrapper */
+
+static int dict_utf8_bulk_lookup(DICT *dict, int count, const char **keys,
+				         const char **values)
+{
+    DICT_UTF8_BACKUP *backup;
+    const char *utf8_err;
+    const char *fold_res;
+    VSTRING *fold_keys;
+    const char **bulk_keys;
+    const char **bulk_values;
+    int    *bulk_index;
+    int     bulk_count;
+    int     saved_flags;
+    const char *(*saved_lookup) (DICT *, const char *);
+    int     status;
+    char   *cp;
+    int     n;
+
+    /*
+     * Validate and optionally fold each key, and if invalid skip that key.
+     * Save a copy of each folded key, because the folding buffer is reused.
+     */
+    fold_keys = vstring_alloc(100);
+    bulk_keys = (const char **) mymalloc(count * sizeof(*bulk_keys));
+    bulk_values = (const char **) mymalloc(count * sizeof(*bulk_values));
+    bulk_index = (int *) mymalloc(count * sizeof(*bulk_index));
+    for (bulk_count = n = 0; n < count; n++) {
+	values[n] = 0;
+	if ((fold_res = dict_utf8_check_fold(dict, keys[n], &utf8_err)) == 0) {
+	    msg_warn("%s:%s: non-UTF-8 key \"%s\": %s",
+		     dict->type, dict->name, keys[n], utf8_err);
+	    continue;
+	}
+	vstring_strcat(fold_keys, fold_res);
+	VSTRING_ADDCH(fold_keys, 0);
+	bulk_index[bulk_count++] = n;
+    }
+    for (cp = vstring_str(fold_keys), n = 0; n < bulk_count; n++) {
+	bulk_keys[n] = cp;
+	cp += strlen(cp) + 1;
+    }
+
+    /*
+     * Proxy the request with casefolding turned off. The default bulk lookup
+     * method calls dict->lookup() for each key; have it call the original
+     * lookup method, so that the keys are not validated and folded again.
+     */
+    if (bulk_count > 0) {
+	saved_flags = (dict->flags & DICT_FLAG_FOLD_ANY);
+	dict->flags &= ~DICT_FLAG_FOLD_ANY;
+	backup = dict->utf8_backup;
+	saved_lookup = dict->lookup;
+	dict->lookup = backup->lookup;
+	status = backup->bulk_lookup(dict, bulk_count, bulk_keys, bulk_values);
+	dict->lookup = saved_lookup;
+	dict->flags |= saved_flags;
+    } else {
+	status = dict->error = DICT_ERR_NONE;
+    }
+
+    /*
+     * Validate the results, and if invalid fail the request.
+     */
+    for (n = 0; status == DICT_ERR_NONE && n < bulk_count; n++) {
+	if (bulk_values[n] != 0
+	    && dict_utf8_check(bulk_values[n], &utf8_err) == 0) {
+	    msg_warn("%s:%s: key \"%s\": non-UTF-8 value \"%s\": %s",
+		     dict->type, dict->name, keys[bulk_index[n]],
+		     bulk_values[n], utf8_err);
+	    status = dict->error = DICT_ERR_CONFIG;
+	} else {
+	    values[bulk_index[n]] = bulk_values[n];
+	}
+    }
+    vstring_free(fold_keys);
+    myfree((void *) bulk_keys);
+    myfree((void *) bulk_values);
+    myfree((void *) bulk_index);
+    return (status);
+}
+
 /* dict_utf8_update - UTF-8 update method wrapper */
 
 static int dict_utf8_update(DICT *dict, const char *key, const char *value)
@@ -280,16 +362,18 @@ DICT   *dict_utf8_activate(DICT *dict)
     backup = dict->utf8_backup = (DICT_UTF8_BACKUP *) mymalloc(sizeof(*backup));
 
     /*
-     * Interpose on the lookup/update/delete methods. It is a conscious
-     * decision not to tinker with the iterator or destructor.
+     * Interpose on the lookup/update/delete/bulk lookup methods. It is a
+     * conscious decision not to tinker with the iterator or destructor.
      */
     backup->lookup = dict->lookup;
     backup->update = dict->update;
     backup->delete = dict->delete;
+    backup->bulk_lookup = dict->bulk_lookup;
 
     dict->lookup = dict_utf8_lookup;
     dict->update = dict_utf8_update;
     dict->delete = dict_utf8_delete;
+    dict->bulk_lookup = dict_utf8_bulk_lookup;
 
     /*
      * Leave our mark. See sanity check above.
@@ -156,7 +156,6 @@
 #include "mymalloc.h"
 #include "msg.h"
 #include "iostuff.h"
-#include "ring.h"
 #include "events.h"
 
 #if !defined(EVENTS_STYLE)
@@ -184,8 +183,9 @@ typedef fd_set EVENT_MASK;
 #else
 
  /*
-  * Kernel-based event filters (kqueue, /dev/poll, epoll). We use the
-  * following file descriptor mask structure which is expanded on the fly.
+  * Kernel-based event filters (kqueue, /dev/poll, epoll, io_uring). We use
+  * the following file descriptor mask structure which is expanded on the
+  * fly.
   */
 typedef struct {
     char   *data;			/* bit mask */
@@ -248,6 +248,18 @@ static EVENT_FDTABLE *event_fdtable;	/* one slot per file descriptor */
 static int event_fdslots;		/* number of file descriptor slots */
 static int event_max_fd = -1;		/* highest fd number seen */
 
+ /*
+  * The test program reports the number of system calls that were made to
+  * manage a kernel-based filter.
+  */
+#ifdef TEST
+static long event_syscalls;
+
+#define EVENT_COUNT_SYSCALL()	(event_syscalls++)
+#else
+#define EVENT_COUNT_SYSCALL()	((void) 0)
+#endif
+
  /*
   * FreeBSD kqueue supports no system call to find out what descriptors are
   * registered in the kernel-based filter. To implement our own sanity checks
@@ -464,6 +476,7 @@ static int event_epollfd;		/* epoll handle */
 	struct epoll_event dummy; \
 	dummy.events = (ev); \
 	dummy.data.fd = (fh); \
+	EVENT_COUNT_SYSCALL(); \
 	(er) = epoll_ctl(event_epollfd, (op), (fh), &dummy); \
     } while (0)
 
@@ -483,6 +496,7 @@ static int event_epollfd;		/* epoll handle */
 typedef struct epoll_event EVENT_BUFFER;
 
 #define EVENT_BUFFER_READ(event_count, event_buf, buflen, delay) do { \
+	EVENT_COUNT_SYSCALL(); \
 	(event_count) = epoll_wait(event_epollfd, (event_buf), (buflen), \
 				  (delay) < 0 ? -1 : (delay) * 1000); \
     } while (0)
@@ -499,8 +513,465 @@ typedef struct epoll_event EVENT_BUFFER;
 #endif
 
  /*
-  * Timer events. Timer requests are kept sorted, in a circular list. We use
-  * the RING abstraction, so we get to use a couple ugly macros.
+  * Linux io_uring. We use one-shot poll requests, and arm a poll request
+  * again after its completion was delivered, so that we keep the level
+  * triggered semantics of the other filters. New and renewed poll requests
+  * are not submitted one at a time; they are queued, and submitted in one
+  * batch with the io_uring_enter() call that waits for completions. That
+  * saves the system call per event_enable_read/write() request that the
+  * other kernel-based filters need when an application alternates between
+  * reading and writing.
+  * 
+  * A poll request holds a reference to the file, so that closing the file
+  * would not take effect while a poll request is pending. Therefore, we
+  * submit a request to remove a pending poll request immediately.
+  * 
+  * Each poll request is labeled with the file descriptor and a per-descriptor
+  * generation number, so that we can ignore completions for requests that
+  * were removed or replaced.
+  * 
+  * A kernel may lack io_uring support, or a security policy may forbid its
+  * use. In that case we log a warning once, and use epoll instead.
+  */
+#if (EVENTS_STYLE == EVENTS_STYLE_IO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+
+typedef struct EVENT_URING {
+    int     fd;				/* io_uring handle */
+    unsigned sq_entries;		/* submission queue size */
+    unsigned *sq_head;			/* kernel consumer index */
+    unsigned *sq_tail;			/* our producer index */
+    unsigned *sq_mask;
+    unsigned *sq_array;			/* indices into sqes */
+    struct io_uring_sqe *sqes;		/* submission queue entries */
+    unsigned *cq_head;			/* our consumer index */
+    unsigned *cq_tail;			/* kernel producer index */
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;		/* completion queue entries */
+    void   *sq_ptr;			/* mappings */
+    size_t  sq_len;
+    void   *cq_ptr;
+    size_t  cq_len;
+    size_t  sqes_len;
+} EVENT_URING;
+
+static EVENT_URING event_uring;		/* io_uring handle */
+static unsigned char *event_uring_state;	/* per-descriptor poll state */
+static unsigned *event_uring_gen;	/* per-descriptor generation */
+static int *event_uring_queue;		/* descriptors to (re)arm */
+static int event_uring_queued;		/* queue length */
+static int event_uring_slots;		/* per-descriptor table size */
+static int event_uring_epollfd = -1;	/* epoll fallback handle */
+
+#ifdef TEST
+static int event_uring_disable;		/* force epoll fallback */
+
+#endif
+
+#define EVENT_URING_IDLE	0	/* no poll request wanted */
+#define EVENT_URING_WANT	1	/* poll request not yet submitted */
+#define EVENT_URING_ARMED	2	/* poll request submitted */
+#define EVENT_URING_MASK	3
+#define EVENT_URING_QUEUED	4	/* on event_uring_queue */
+
+#define EVENT_URING_ENTRIES	256
+#define EVENT_URING_REMOVE_TAG	(~(__u64) 0)
+
+#define EVENT_URING_DATA(fd) \
+	(((__u64) event_uring_gen[fd] << 32) | (unsigned) (fd))
+
+#define event_uring_setup(entries, params) \
+	syscall(__NR_io_uring_setup, (entries), (params))
+#define event_uring_enter(fd, submit, wait, flags, arg, argsz) \
+	syscall(__NR_io_uring_enter, (fd), (submit), (wait), (flags), \
+		(arg), (argsz))
+
+/* event_uring_resize - resize per-descriptor information */
+
+static void event_uring_resize(int new_slots)
+{
+    int     old_slots = event_uring_slots;
+
+    if (old_slots == 0) {
+	event_uring_state = (unsigned char *) mymalloc(new_slots);
+	event_uring_gen = (unsigned *) mymalloc(sizeof(unsigned) * new_slots);
+	event_uring_queue = (int *) mymalloc(sizeof(int) * new_slots);
+    } else {
+	event_uring_state = (unsigned char *)
+	    myrealloc((void *) event_uring_state, new_slots);
+	event_uring_gen = (unsigned *)
+	    myrealloc((void *) event_uring_gen, sizeof(unsigned) * new_slots);
+	event_uring_queue = (int *)
+	    myrealloc((void *) event_uring_queue, sizeof(int) * new_slots);
+    }
+    memset(event_uring_state + old_slots, 0, new_slots - old_slots);
+    memset(event_uring_gen + old_slots, 0,
+	   sizeof(unsigned) * (new_slots - old_slots));
+    event_uring_slots = new_slots;
+}
+
+/* event_uring_fallback - use epoll instead of io_uring */
+
+static int event_uring_fallback(int slots, const char *what)
+{
+    static int warned;
+
+    if (warned++ == 0)
+	msg_warn("%s: %m; using epoll instead", what);
+    if ((event_uring_epollfd = epoll_create(slots)) >= 0)
+	close_on_exec(event_uring_epollfd, CLOSE_ON_EXEC);
+    return (event_uring_epollfd);
+}
+
+/* event_uring_open - create io_uring instance and map its queues */
+
+static int event_uring_open(int slots)
+{
+    EVENT_URING *up = &event_uring;
+    struct io_uring_params params;
+
+    memset((void *) &params, 0, sizeof(params));
+#ifdef TEST
+    if (event_uring_disable) {
+	errno = ENOSYS;
+	return (event_uring_fallback(slots, "io_uring_setup"));
+    }
+#endif
+    if ((up->fd = event_uring_setup(EVENT_URING_ENTRIES, &params)) < 0)
+	return (event_uring_fallback(slots, "io_uring_setup"));
+    close_on_exec(up->fd, CLOSE_ON_EXEC);
+
+    /*
+     * We need io_uring_enter() with a time limit (Linux 5.11).
+     */
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+	(void) close(up->fd);
+	errno = ENOSYS;
+	return (event_uring_fallback(slots, "io_uring_enter time limit"));
+    }
+    up->sq_entries = params.sq_entries;
+    up->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    up->cq_len = params.cq_off.cqes
+	+ params.cq_entries * sizeof(struct io_uring_cqe);
+    up->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    if ((up->sq_ptr = mmap((void *) 0, up->sq_len, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, up->fd,
+			   IORING_OFF_SQ_RING)) == MAP_FAILED)
+	msg_fatal("mmap io_uring submission queue: %m");
+    if ((up->cq_ptr = mmap((void *) 0, up->cq_len, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, up->fd,
+			   IORING_OFF_CQ_RING)) == MAP_FAILED)
+	msg_fatal("mmap io_uring completion queue: %m");
+    if ((up->sqes = (struct io_uring_sqe *)
+	 mmap((void *) 0, up->sqes_len, PROT_READ | PROT_WRITE,
+	      MAP_SHARED | MAP_POPULATE, up->fd,
+	      IORING_OFF_SQES)) == MAP_FAILED)
+	msg_fatal("mmap io_uring submission entries: %m");
+    up->sq_head = (unsigned *) ((char *) up->sq_ptr + params.sq_off.head);
+    up->sq_tail = (unsigned *) ((char *) up->sq_ptr + params.sq_off.tail);
+    up->sq_mask = (unsigned *) ((char *) up->sq_ptr + params.sq_off.ring_mask);
+    up->sq_array = (unsigned *) ((char *) up->sq_ptr + params.sq_off.array);
+    up->cq_head = (unsigned *) ((char *) up->cq_ptr + params.cq_off.head);
+    up->cq_tail = (unsigned *) ((char *) up->cq_ptr + params.cq_off.tail);
+    up->cq_mask = (unsigned *) ((char *) up->cq_ptr + params.cq_off.ring_mask);
+    up->cqes = (struct io_uring_cqe *) ((char *) up->cq_ptr + params.cq_off.cqes);
+
+    /*
+     * Initialize the per-descriptor information.
+     */
+    event_uring_queued = 0;
+    if (event_uring_slots == 0)
+	event_uring_resize(slots);
+    else
+	memset(event_uring_state, 0, event_uring_slots);
+    return (up->fd);
+}
+
+/* event_uring_close - destroy io_uring instance */
+
+static void event_uring_close(void)
+{
+    EVENT_URING *up = &event_uring;
+
+    if (event_uring_epollfd >= 0) {
+	(void) close(event_uring_epollfd);
+	event_uring_epollfd = -1;
+	return;
+    }
+    (void) munmap((void *) up->sqes, up->sqes_len);
+    (void) munmap(up->cq_ptr, up->cq_len);
+    (void) munmap(up->sq_ptr, up->sq_len);
+    (void) close(up->fd);
+}
+
+/* event_uring_submit - submit queued entries, optionally wait */
+
+static int event_uring_submit(int delay)
+{
+    EVENT_URING *up = &event_uring;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned to_submit;
+    unsigned flags = 0;
+    unsigned wait = 0;
+    int     ret;
+
+    to_submit = *up->sq_tail - __atomic_load_n(up->sq_head, __ATOMIC_ACQUIRE);
+    memset((void *) &arg, 0, sizeof(arg));
+    if (delay != 0) {
+	flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	wait = 1;
+	if (delay > 0) {
+	    ts.tv_sec = delay;
+	    ts.tv_nsec = 0;
+	    arg.ts = (__u64) (unsigned long) &ts;
+	}
+    } else if (to_submit == 0) {
+	return (0);
+    }
+    EVENT_COUNT_SYSCALL();
+    ret = event_uring_enter(up->fd, to_submit, wait, flags,
+			    flags ? (void *) &arg : (void *) 0,
+			    flags ? sizeof(arg) : 0);
+    if (ret < 0 && (errno == ETIME || errno == EBUSY))
+	ret = 0;
+    return (ret);
+}
+
+/* event_uring_get_sqe - allocate submission queue entry */
+
+static struct io_uring_sqe *event_uring_get_sqe(void)
+{
+    EVENT_URING *up = &event_uring;
+    struct io_uring_sqe *sqe;
+    unsigned tail = *up->sq_tail;
+    unsigned index;
+
+    /*
+     * The queue is full. Submit what we have without waiting.
+     */
+    while (tail - __atomic_load_n(up->sq_head, __ATOMIC_ACQUIRE)
+	   >= up->sq_entries)
+	if (event_uring_submit(0) < 0 && errno != EINTR)
+	    msg_fatal("io_uring_enter: %m");
+    index = tail & *up->sq_mask;
+    sqe = up->sqes + index;
+    memset((void *) sqe, 0, sizeof(*sqe));
+    up->sq_array[index] = index;
+    __atomic_store_n(up->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return (sqe);
+}
+
+/* event_uring_want - queue poll request for descriptor */
+
+static int event_uring_want(int fd)
+{
+    if ((event_uring_state[fd] & EVENT_URING_MASK) == EVENT_URING_IDLE) {
+	event_uring_state[fd] = (event_uring_state[fd] & EVENT_URING_QUEUED)
+	    | EVENT_URING_WANT;
+	if ((event_uring_state[fd] & EVENT_URING_QUEUED) == 0) {
+	    event_uring_state[fd] |= EVENT_URING_QUEUED;
+	    event_uring_queue[event_uring_queued++] = fd;
+	}
+    }
+    return (0);
+}
+
+/* event_uring_epoll_ctl - update epoll fallback filter */
+
+static int event_uring_epoll_ctl(int op, int fd, unsigned events)
+{
+    struct epoll_event dummy;
+
+    dummy.events = events;
+    dummy.data.fd = fd;
+    EVENT_COUNT_SYSCALL();
+    return (epoll_ctl(event_uring_epollfd, op, fd, &dummy));
+}
+
+/* event_uring_cancel - cancel poll request for descriptor */
+
+static int event_uring_cancel(int fd)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((event_uring_state[fd] & EVENT_URING_MASK) == EVENT_URING_ARMED) {
+	sqe = event_uring_get_sqe();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = EVENT_URING_DATA(fd);
+	sqe->user_data = EVENT_URING_REMOVE_TAG;
+	event_uring_gen[fd] += 1;
+	event_uring_state[fd] &= ~EVENT_URING_MASK;
+	return (event_uring_submit(0) < 0 ? -1 : 0);
+    }
+    event_uring_state[fd] &= ~EVENT_URING_MASK;
+    return (0);
+}
+
+/* event_uring_arm - submit queued poll requests */
+
+static void event_uring_arm(void)
+{
+    struct io_uring_sqe *sqe;
+    unsigned poll_mask;
+    int     fd;
+    int     n;
+
+    for (n = 0; n < event_uring_queued; n++) {
+	fd = event_uring_queue[n];
+	event_uring_state[fd] &= ~EVENT_URING_QUEUED;
+	if (event_uring_state[fd] != EVENT_URING_WANT)
+	    continue;
+	poll_mask = EVENT_MASK_ISSET(fd, &event_wmask) ? POLLOUT : POLLIN;
+#if defined(__BYTE_ORDER) && (__BYTE_ORDER == __BIG_ENDIAN)
+	poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+#endif
+	sqe = event_uring_get_sqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = poll_mask;
+	sqe->user_data = EVENT_URING_DATA(fd);
+	event_uring_state[fd] = EVENT_URING_ARMED;
+    }
+    event_uring_queued = 0;
+}
+
+/* event_uring_wait - submit requests, wait for and collect completions */
+
+typedef struct {
+    int     fd;				/* file descriptor */
+    unsigned events;			/* poll(2) events */
+} EVENT_BUFFER;
+
+static int event_uring_wait(EVENT_BUFFER *event_buf, int buflen, int delay)
+{
+    EVENT_URING *up = &event_uring;
+    struct io_uring_cqe *cqe;
+    unsigned head;
+    unsigned gen;
+    int     count = 0;
+    int     fd;
+
+    /*
+     * With the epoll fallback, convert epoll events into poll(2) events.
+     * Linux uses the same bit values for both.
+     */
+    if (event_uring_epollfd >= 0) {
+	struct epoll_event epoll_buf[100];
+
+	if (buflen > 100)
+	    buflen = 100;
+	EVENT_COUNT_SYSCALL();
+	count = epoll_wait(event_uring_epollfd, epoll_buf, buflen,
+			   delay < 0 ? -1 : delay * 1000);
+	for (fd = 0; fd < count; fd++) {
+	    event_buf[fd].fd = epoll_buf[fd].data.fd;
+	    event_buf[fd].events = epoll_buf[fd].events;
+	}
+	return (count);
+    }
+
+    /*
+     * Submit the poll requests that were queued since the previous call,
+     * and wait for completions unless some are already available.
+     */
+    event_uring_arm();
+    head = *up->cq_head;
+    if (head != __atomic_load_n(up->cq_tail, __ATOMIC_ACQUIRE))
+	delay = 0;
+    if (event_uring_submit(delay) < 0)
+	return (-1);
+
+    /*
+     * Collect completions. Ignore completions for requests that were
+     * removed or replaced, and for requests to remove a poll request. A
+     * completed request is queued to be armed again with the next call,
+     * unless the application disables the descriptor in the meantime.
+     */
+    while (count < buflen
+	   && head != __atomic_load_n(up->cq_tail, __ATOMIC_ACQUIRE)) {
+	cqe = up->cqes + (head & *up->cq_mask);
+	head++;
+	if (cqe->user_data == EVENT_URING_REMOVE_TAG)
+	    continue;
+	fd = (int) (cqe->user_data & 0xffffffff);
+	gen = (unsigned) (cqe->user_data >> 32);
+	if (fd >= event_uring_slots || gen != event_uring_gen[fd]
+	    || (event_uring_state[fd] & EVENT_URING_MASK) != EVENT_URING_ARMED)
+	    continue;
+	event_uring_state[fd] &= ~EVENT_URING_MASK;
+	(void) event_uring_want(fd);
+	event_buf[count].fd = fd;
+	event_buf[count].events = (cqe->res < 0 ? POLLERR : cqe->res);
+	count++;
+    }
+    __atomic_store_n(up->cq_head, head, __ATOMIC_RELEASE);
+    return (count);
+}
+
+ /*
+  * Macros to initialize the kernel-based filter; see event_init().
+  */
+#define EVENT_REG_INIT_HANDLE(er, n) do { \
+	er = event_uring_open(n); \
+    } while (0)
+#define EVENT_REG_INIT_TEXT	"io_uring_setup"
+
+#define EVENT_REG_FORK_HANDLE(er, n) do { \
+	event_uring_close(); \
+	EVENT_REG_INIT_HANDLE(er, (n)); \
+    } while (0)
+
+#define EVENT_REG_UPD_HANDLE(er, n) do { \
+	event_uring_resize(n); \
+	(er) = 0; \
+    } while (0)
+#define EVENT_REG_UPD_TEXT	"io_uring resize"
+
+ /*
+  * Macros to update the kernel-based filter; see event_enable_read(),
+  * event_enable_write() and event_disable_readwrite().
+  */
+#define EVENT_REG_ADD_OP(e, f, ev) ((e) = event_uring_epollfd >= 0 ? \
+	event_uring_epoll_ctl(EPOLL_CTL_ADD, (f), (ev)) : event_uring_want(f))
+#define EVENT_REG_ADD_READ(e, f)   EVENT_REG_ADD_OP((e), (f), EPOLLIN)
+#define EVENT_REG_ADD_WRITE(e, f)  EVENT_REG_ADD_OP((e), (f), EPOLLOUT)
+#define EVENT_REG_ADD_TEXT         "io_uring poll add"
+
+#define EVENT_REG_DEL_BOTH(e, f)   ((e) = event_uring_epollfd >= 0 ? \
+	event_uring_epoll_ctl(EPOLL_CTL_DEL, (f), 0) : event_uring_cancel(f))
+#define EVENT_REG_DEL_TEXT         "io_uring_enter"
+
+ /*
+  * Macros to retrieve event buffers from the kernel; see event_loop().
+  */
+#define EVENT_BUFFER_READ(event_count, event_buf, buflen, delay) do { \
+	(event_count) = event_uring_wait((event_buf), (buflen), (delay)); \
+    } while (0)
+#define EVENT_BUFFER_READ_TEXT	"io_uring_enter"
+
+ /*
+  * Macros to process event buffers from the kernel; see event_loop().
+  */
+#define EVENT_GET_FD(bp)	((bp)->fd)
+#define EVENT_GET_TYPE(bp)	((bp)->events)
+#define EVENT_TEST_READ(bp)	(EVENT_GET_TYPE(bp) & POLLIN)
+#define EVENT_TEST_WRITE(bp)	(EVENT_GET_TYPE(bp) & POLLOUT)
+
+#endif
+
+ /*
+  * Timer events. Timer requests are kept in a binary heap, ordered by their
+  * expiration time, and by the order in which they were (re)scheduled. A
+  * hash table finds the request for a given call-back and context. The
+  * queue and the table grow together, and are never shrunk. Thus,
+  * adding, resetting or canceling a request costs O(log n) instead of a
+  * linear search, which matters with one timer per client connection.
   * 
   * When a call-back function adds a timer request, we label the request with
   * the event_loop() call instance that invoked the call-back. We use this to
@@ -514,20 +985,172 @@ struct EVENT_TIMER {
     EVENT_NOTIFY_TIME_FN callback;	/* callback function */
     char   *context;			/* callback context */
     long    loop_instance;		/* event_loop() call instance */
-    RING    ring;			/* linkage */
+    unsigned long seqno;		/* FIFO order within time slot */
+    ssize_t heap_pos;			/* position in event_timer_heap */
+    EVENT_TIMER *hash_next;		/* event_timer_table chain */
 };
 
-static RING event_timer_head;		/* timer queue head */
+static EVENT_TIMER **event_timer_heap;	/* timer queue */
+static EVENT_TIMER **event_timer_table;	/* (callback, context) -> timer */
+static ssize_t event_timer_count;	/* queue length */
+static ssize_t event_timer_size;	/* queue and table size, power of 2 */
+static unsigned long event_timer_seqno;	/* timer request counter */
 static long event_loop_instance;	/* event_loop() call instance */
 
-#define RING_TO_TIMER(r) \
-	((EVENT_TIMER *) ((void *) (r) - offsetof(EVENT_TIMER, ring)))
+#define EVENT_TIMER_INIT_SIZE	16
+
+#define EVENT_TIMER_BEFORE(t1, t2) \
+	((t1)->when < (t2)->when \
+	 || ((t1)->when == (t2)->when && (t1)->seqno < (t2)->seqno))
+
+#define FIRST_TIMER() \
+	(event_timer_count > 0 ? event_timer_heap[0] : 0)
+
+#define EVENT_TIMER_LINK(timer) do { \
+	EVENT_TIMER **_h = event_timer_table \
+	    + event_timer_hash((timer)->callback, (timer)->context); \
+	(timer)->hash_next = *_h; \
+	*_h = (timer); \
+    } while (0)
+
+/* event_timer_hash - hash (callback, context) pair */
+
+static ssize_t event_timer_hash(EVENT_NOTIFY_TIME_FN callback, char *context)
+{
+    unsigned long h;
+
+    /*
+     * Mix the pointer bits, so that aligned or sequential context pointers
+     * don't all end up in a few buckets.
+     */
+    h = ((unsigned long) callback >> 4) ^ (unsigned long) context;
+    h = (h ^ (h >> 16)) * 0x45d9f3bUL;
+    h = (h ^ (h >> 16)) * 0x45d9f3bUL;
+    h = h ^ (h >> 16);
+    return (h & (event_timer_size - 1));
+}
+
+/* event_timer_alloc - (re)size timer queue and table */
 
-#define FOREACH_QUEUE_ENTRY(entry, head) \
-	for (entry = ring_succ(head); entry != (head); entry = ring_succ(entry))
+static void event_timer_alloc(ssize_t new_size)
+{
+    ssize_t n;
+
+    event_timer_size = new_size;
+    if (event_timer_heap == 0) {
+	event_timer_heap = (EVENT_TIMER **)
+	    mymalloc(sizeof(*event_timer_heap) * new_size);
+	event_timer_table = (EVENT_TIMER **)
+	    mymalloc(sizeof(*event_timer_table) * new_size);
+    } else {
+	event_timer_heap = (EVENT_TIMER **)
+	    myrealloc((void *) event_timer_heap,
+		      sizeof(*event_timer_heap) * new_size);
+	event_timer_table = (EVENT_TIMER **)
+	    myrealloc((void *) event_timer_table,
+		      sizeof(*event_timer_table) * new_size);
+    }
+    for (n = 0; n < new_size; n++)
+	event_timer_table[n] = 0;
+    for (n = 0; n < event_timer_count; n++)
+	EVENT_TIMER_LINK(event_timer_heap[n]);
+}
+
+/* event_timer_heap_put - store timer at heap position */
+
+static void event_timer_heap_put(EVENT_TIMER *timer, ssize_t pos)
+{
+    event_timer_heap[pos] = timer;
+    timer->heap_pos = pos;
+}
+
+/* event_timer_heap_up - move timer towards the heap root */
+
+static void event_timer_heap_up(EVENT_TIMER *timer)
+{
+    ssize_t pos = timer->heap_pos;
+    ssize_t parent;
+
+    while (pos > 0) {
+	parent = (pos - 1) / 2;
+	if (!EVENT_TIMER_BEFORE(timer, event_timer_heap[parent]))
+	    break;
+	event_timer_heap_put(event_timer_heap[parent], pos);
+	pos = parent;
+    }
+    event_timer_heap_put(timer, pos);
+}
+
+/* event_timer_heap_down - move timer towards the heap leaves */
+
+static void event_timer_heap_down(EVENT_TIMER *timer)
+{
+    ssize_t pos = timer->heap_pos;
+    ssize_t child;
+
+    while ((child = 2 * pos + 1) < event_timer_count) {
+	if (child + 1 < event_timer_count
+	    && EVENT_TIMER_BEFORE(event_timer_heap[child + 1],
+				  event_timer_heap[child]))
+	    child += 1;
+	if (!EVENT_TIMER_BEFORE(event_timer_heap[child], timer))
+	    break;
+	event_timer_heap_put(event_timer_heap[child], pos);
+	pos = child;
+    }
+    event_timer_heap_put(timer, pos);
+}
+
+/* event_timer_insert - add timer to the queue */
+
+static void event_timer_insert(EVENT_TIMER *timer)
+{
+    if (event_timer_count >= event_timer_size)
+	event_timer_alloc(2 * event_timer_size);
+    timer->seqno = event_timer_seqno++;
+    timer->heap_pos = event_timer_count++;
+    event_timer_heap_up(timer);
+    EVENT_TIMER_LINK(timer);
+}
+
+/* event_timer_find - look up timer request */
+
+static EVENT_TIMER *event_timer_find(EVENT_NOTIFY_TIME_FN callback,
+				             char *context)
+{
+    EVENT_TIMER *timer;
+
+    for (timer = event_timer_table[event_timer_hash(callback, context)];
+	 timer != 0; timer = timer->hash_next)
+	if (timer->callback == callback && timer->context == context)
+	    break;
+    return (timer);
+}
 
-#define FIRST_TIMER(head) \
-	(ring_succ(head) != (head) ? RING_TO_TIMER(ring_succ(head)) : 0)
+/* event_timer_detach - remove timer from the queue and from the table */
+
+static void event_timer_detach(EVENT_TIMER *timer)
+{
+    EVENT_TIMER **hp;
+    EVENT_TIMER *last;
+
+    last = event_timer_heap[--event_timer_count];
+    if (last != timer) {
+	event_timer_heap_put(last, timer->heap_pos);
+	if (last->heap_pos > 0
+	    && EVENT_TIMER_BEFORE(last,
+			       event_timer_heap[(last->heap_pos - 1) / 2]))
+	    event_timer_heap_up(last);
+	else
+	    event_timer_heap_down(last);
+    }
+    timer->heap_pos = -1;
+    for (hp = event_timer_table + event_timer_hash(timer->callback,
+						    timer->context);
+	 *hp != timer; hp = &(*hp)->hash_next)
+	 /* void */ ;
+    *hp = timer->hash_next;
+}
 
  /*
   * Other private data structures.
@@ -591,7 +1214,8 @@ static void event_init(void)
     /*
      * Initialize timer stuff.
      */
-    ring_init(&event_timer_head);
+    event_timer_count = 0;
+    event_timer_alloc(EVENT_TIMER_INIT_SIZE);
     (void) time(&event_present);
 
     /*
@@ -670,7 +1294,7 @@ void    event_drain(int time_limit)
     (void) time(&event_present);
     max_time = event_present + time_limit;
     while (event_present < max_time
-	   && (event_timer_head.pred != &event_timer_head
+	   && (event_timer_count > 0
 	       || EVENT_MASK_CMP(&zero_mask, &event_xmask) != 0)) {
 	event_loop(1);
 #if (EVENTS_STYLE != EVENTS_STYLE_SELECT)
@@ -894,7 +1518,6 @@ void    event_disable_readwrite(int fd)
 time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int delay)
 {
     const char *myname = "event_request_timer";
-    RING   *ring;
     EVENT_TIMER *timer;
 
     if (EVENT_INIT_NEEDED())
@@ -916,23 +1539,19 @@ time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int de
      * request away from the timer queue so that it can be inserted at the
      * right place.
      */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	timer = RING_TO_TIMER(ring);
-	if (timer->callback == callback && timer->context == context) {
-	    timer->when = event_present + delay;
-	    timer->loop_instance = event_loop_instance;
-	    ring_detach(ring);
-	    if (msg_verbose > 2)
-		msg_info("%s: reset 0x%lx 0x%lx %d", myname,
-			 (long) callback, (long) context, delay);
-	    break;
-	}
+    if ((timer = event_timer_find(callback, context)) != 0) {
+	timer->when = event_present + delay;
+	timer->loop_instance = event_loop_instance;
+	event_timer_detach(timer);
+	if (msg_verbose > 2)
+	    msg_info("%s: reset 0x%lx 0x%lx %d", myname,
+		     (long) callback, (long) context, delay);
     }
 
     /*
      * If not found, schedule a new timer request.
      */
-    if (ring == &event_timer_head) {
+    else {
 	timer = (EVENT_TIMER *) mymalloc(sizeof(EVENT_TIMER));
 	timer->when = event_present + delay;
 	timer->callback = callback;
@@ -944,18 +1563,12 @@ time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int de
     }
 
     /*
-     * Timer requests are kept sorted to reduce lookup overhead in the event
-     * loop.
-     * 
-     * XXX Append the new request after existing requests for the same time
-     * slot. The event_loop() routine depends on this to avoid starving I/O
-     * events when a call-back function schedules a zero-delay timer request.
+     * XXX Give the request a sequence number that is larger than that of
+     * existing requests for the same time slot. The event_loop() routine
+     * depends on this to avoid starving I/O events when a call-back function
+     * schedules a zero-delay timer request.
      */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	if (timer->when < RING_TO_TIMER(ring)->when)
-	    break;
-    }
-    ring_prepend(ring, &timer->ring);
+    event_timer_insert(timer);
 
     return (timer->when);
 }
@@ -965,7 +1578,6 @@ time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int de
 int     event_cancel_timer(EVENT_NOTIFY_TIME_FN callback, void *context)
 {
     const char *myname = "event_cancel_timer";
-    RING   *ring;
     EVENT_TIMER *timer;
     int     time_left = -1;
 
@@ -977,15 +1589,11 @@ int     event_cancel_timer(EVENT_NOTIFY_TIME_FN callback, void *context)
      * when the request is not found. It might have been canceled from some
      * other thread.
      */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	timer = RING_TO_TIMER(ring);
-	if (timer->callback == callback && timer->context == context) {
-	    if ((time_left = timer->when - event_present) < 0)
-		time_left = 0;
-	    ring_detach(ring);
-	    myfree((void *) timer);
-	    break;
-	}
+    if ((timer = event_timer_find(callback, context)) != 0) {
+	if ((time_left = timer->when - event_present) < 0)
+	    time_left = 0;
+	event_timer_detach(timer);
+	myfree((void *) timer);
     }
     if (msg_verbose > 2)
 	msg_info("%s: 0x%lx 0x%lx %d", myname,
@@ -1026,10 +1634,10 @@ void    event_loop(int delay)
      * XXX Also print the select() masks?
      */
     if (msg_verbose > 2) {
-	RING   *ring;
+	ssize_t n;
 
-	FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	    timer = RING_TO_TIMER(ring);
+	for (n = 0; n < event_timer_count; n++) {
+	    timer = event_timer_heap[n];
 	    msg_info("%s: time left %3d for 0x%lx 0x%lx", myname,
 		     (int) (timer->when - event_present),
 		     (long) timer->callback, (long) timer->context);
@@ -1037,10 +1645,10 @@ void    event_loop(int delay)
     }
 
     /*
-     * Find out when the next timer would go off. Timer requests are sorted.
+     * Find out when the next timer would go off. Timer requests are ordered.
      * If any timer is scheduled, adjust the delay appropriately.
      */
-    if ((timer = FIRST_TIMER(&event_timer_head)) != 0) {
+    if ((timer = FIRST_TIMER()) != 0) {
 	event_present = time((time_t *) 0);
 	if ((select_delay = timer->when - event_present) < 0) {
 	    select_delay = 0;
@@ -1102,9 +1710,9 @@ void    event_loop(int delay)
 
     /*
      * Deliver timer events. Allow the application to add/delete timer queue
-     * requests while it is being called back. Requests are sorted: we keep
-     * running over the timer request queue from the start, and stop when we
-     * reach the future or the list end. We also stop when we reach a timer
+     * requests while it is being called back. Requests are ordered: we keep
+     * taking the first request from the timer queue, and stop when we reach
+     * the future or the queue end. We also stop when we reach a timer
      * request that was added by a call-back that was invoked from this
      * event_loop() call instance, for reasons that are explained below.
      * 
@@ -1119,18 +1727,18 @@ void    event_loop(int delay)
      * instance that invoked the timer event call-back. We use this instance
      * label here to prevent zero-delay timer requests from running in a
      * tight loop and starving I/O events. To make this solution work,
-     * event_request_timer() appends a new request after existing requests
+     * event_request_timer() orders a new request after existing requests
      * for the same time slot.
      */
     event_present = time((time_t *) 0);
     event_loop_instance += 1;
 
-    while ((timer = FIRST_TIMER(&event_timer_head)) != 0) {
+    while ((timer = FIRST_TIMER()) != 0) {
 	if (timer->when > event_present)
 	    break;
 	if (timer->loop_instance == event_loop_instance)
 	    break;
-	ring_detach(&timer->ring);		/* first this */
+	event_timer_detach(timer);		/* first this */
 	if (msg_verbose > 2)
 	    msg_info("%s: timer 0x%lx 0x%lx", myname,
 		     (long) timer->callback, (long) timer->context);
@@ -1207,11 +1815,17 @@ void    event_loop(int delay)
  /*
   * Proof-of-concept test program for the event manager. Schedule a series of
   * events at one-second intervals and let them happen, while echoing any
-  * lines read from stdin.
+  * lines read from stdin. With "-b connections rounds", send requests and
+  * replies over many connections, and report the number of system calls
+  * made to manage the kernel-based filter. With "-t count", arm, reset and
+  * cancel many timer requests, and verify the order of timer events. With
+  * "-f" before other options, an io_uring build uses its epoll fallback.
   */
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <msg_vstream.h>
 
 /* timer_event - display event */
 
@@ -1248,8 +1862,203 @@ static void request(int unused_event, void *unused_context)
     event_request_timer(timer_event, "0 second", 0);
 }
 
+/* bench_read - server side: receive request, then send reply */
+
+static void bench_write(int, void *);
+
+static void bench_read(int event, void *context)
+{
+    int     fd = (int) (long) context;
+    char    ch;
+
+    if (event != EVENT_READ || read(fd, &ch, 1) != 1)
+	msg_fatal("bench_read: fd %d: event %d: %m", fd, event);
+    event_disable_readwrite(fd);
+    event_enable_write(fd, bench_write, context);
+}
+
+/* bench_write - server side: send reply, then wait for request */
+
+static int bench_pending;
+
+static void bench_write(int event, void *context)
+{
+    int     fd = (int) (long) context;
+
+    if (event != EVENT_WRITE || write(fd, "r", 1) != 1)
+	msg_fatal("bench_write: fd %d: event %d: %m", fd, event);
+    event_disable_readwrite(fd);
+    event_enable_read(fd, bench_read, context);
+    bench_pending -= 1;
+}
+
+/* bench - request/reply over many connections */
+
+static void bench(int conns, int rounds)
+{
+    int    *client;
+    int     pair[2];
+    int     n;
+    int     r;
+    char    ch;
+    struct timeval start;
+    struct timeval finish;
+
+    client = (int *) mymalloc(sizeof(*client) * conns);
+    for (n = 0; n < conns; n++) {
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+	    msg_fatal("socketpair: %m");
+	client[n] = pair[0];
+	event_enable_read(pair[1], bench_read, (void *) (long) pair[1]);
+    }
+    GETTIMEOFDAY(&start);
+    event_syscalls = 0;
+    for (r = 0; r < rounds; r++) {
+	for (n = 0; n < conns; n++)
+	    if (write(client[n], "q", 1) != 1)
+		msg_fatal("write: %m");
+	for (bench_pending = conns; bench_pending > 0; /* void */ )
+	    event_loop(-1);
+	for (n = 0; n < conns; n++)
+	    if (read(client[n], &ch, 1) != 1)
+		msg_fatal("read: %m");
+    }
+    GETTIMEOFDAY(&finish);
+    printf("%d connections, %d rounds: %ld event system calls, %.3f s\n",
+	   conns, rounds, event_syscalls,
+	   (finish.tv_sec - start.tv_sec)
+	   + (finish.tv_usec - start.tv_usec) / 1000000.0);
+    myfree((void *) client);
+}
+
+/* stress_event - timer call-back for the stress test */
+
+static long *stress_order;
+static long stress_count;
+static long stress_again;
+
+static void stress_event(int event, void *context)
+{
+    if (event != EVENT_TIME)
+	msg_fatal("stress_event: unexpected event %d", event);
+    stress_order[stress_count++] = (long) context;
+    if ((long) context == stress_again) {
+	stress_again = 0;
+	event_request_timer(stress_event, context, 0);
+    }
+}
+
+/* stress_check - verify the timer queue and table */
+
+static void stress_check(const char *what, ssize_t want)
+{
+    EVENT_TIMER *timer;
+    ssize_t n;
+    ssize_t used;
+
+    if (event_timer_count != want)
+	msg_fatal("%s: queue has %ld requests, expected %ld",
+		  what, (long) event_timer_count, (long) want);
+    for (used = n = 0; n < event_timer_size; n++)
+	for (timer = event_timer_table[n]; timer; timer = timer->hash_next)
+	    used++;
+    if (used != want)
+	msg_fatal("%s: table has %ld requests, expected %ld",
+		  what, (long) used, (long) want);
+    for (n = 0; n < event_timer_count; n++) {
+	if (event_timer_heap[n]->heap_pos != n)
+	    msg_fatal("%s: bad heap position at %ld", what, (long) n);
+	if (n > 0 && EVENT_TIMER_BEFORE(event_timer_heap[n],
+					event_timer_heap[(n - 1) / 2]))
+	    msg_fatal("%s: bad heap order at %ld", what, (long) n);
+    }
+    printf("%s: %ld requests ok\n", what, (long) want);
+}
+
+/* stress - arm, reset and cancel many timers */
+
+static void stress(long count)
+{
+    unsigned long seed = 1;
+    long    n;
+    long    want;
+    long    live;
+
+#define STRESS_RAND() (seed = seed * 1103515245 + 12345, (seed >> 16) & 0x7fff)
+
+    /*
+     * Arm many timers in the future, reset some of them, cancel some.
+     */
+    for (n = 1; n <= count; n++)
+	event_request_timer(stress_event, (void *) n, 1 + STRESS_RAND());
+    stress_check("request", count);
+    for (n = 1; n <= count; n += 3)
+	event_request_timer(stress_event, (void *) n, 1 + STRESS_RAND());
+    stress_check("reset", count);
+    for (live = count, n = 1; n <= count; n += 5, live--)
+	if (event_cancel_timer(stress_event, (void *) n) < 0)
+	    msg_fatal("cancel: request %ld not found", n);
+    stress_check("cancel", live);
+    for (n = 1; n <= count; n++)
+	(void) event_cancel_timer(stress_event, (void *) n);
+    stress_check("cancel all", 0);
+
+    /*
+     * Zero-delay timers must go off in the order they were (re)scheduled. A
+     * request that is added by a call-back must wait for the next
+     * event_loop() call.
+     */
+    for (n = 1; n <= count; n++)
+	event_request_timer(stress_event, (void *) n, 0);
+    for (live = count, n = 7; n <= count; n += 7, live--)
+	(void) event_cancel_timer(stress_event, (void *) n);
+    for (n = 11; n <= count; n += 11)
+	if (n % 7 != 0)
+	    event_request_timer(stress_event, (void *) n, 0);
+    stress_check("zero delay", live);
+    stress_order = (long *) mymalloc(sizeof(*stress_order) * (live + 1));
+    stress_count = 0;
+    stress_again = 2;
+    event_loop(0);
+    if (stress_count != live)
+	msg_fatal("event_loop: %ld call-backs, expected %ld",
+		  stress_count, live);
+    stress_check("event_loop", 1);
+    event_loop(0);
+    stress_check("event_loop", 0);
+    want = 0;
+    for (n = 1; n <= count; n++)
+	if (n % 7 != 0 && n % 11 != 0 && stress_order[want++] != n)
+	    msg_fatal("order: got %ld, expected %ld",
+		      stress_order[want - 1], n);
+    for (n = 11; n <= count; n += 11)
+	if (n % 7 != 0 && stress_order[want++] != n)
+	    msg_fatal("order: got %ld, expected %ld",
+		      stress_order[want - 1], n);
+    if (stress_order[want] != 2)
+	msg_fatal("order: got %ld, expected 2", stress_order[want]);
+    printf("order: %ld call-backs ok\n", stress_count);
+    myfree((void *) stress_order);
+}
+
 int     main(int argc, void **argv)
 {
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc > 1 && strcmp(argv[1], "-f") == 0) {
+#if (EVENTS_STYLE == EVENTS_STYLE_IO_URING)
+	event_uring_disable = 1;
+#endif
+	argc--;
+	argv++;
+    }
+    if (argc == 4 && strcmp(argv[1], "-b") == 0) {
+	bench(atoi(argv[2]), atoi(argv[3]));
+	exit(0);
+    }
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+	stress(atol(argv[2]));
+	exit(0);
+    }
     if (argv[1])
 	msg_verbose = atoi(argv[1]);
     event_request_timer(request, (void *) 0, 0);
@@ -0,0 +1,374 @@
+/*++
+/* NAME
+/*	extsort 3
+/* SUMMARY
+/*	sort key-value pairs with bounded memory
+/* SYNOPSIS
+/*	#include <extsort.h>
+/*
+/*	EXTSORT	*extsort_create(tmp_prefix, limit)
+/*	const char *tmp_prefix;
+/*	ssize_t	limit;
+/*
+/*	void	extsort_add(sort, key, value)
+/*	EXTSORT	*sort;
+/*	const char *key;
+/*	const char *value;
+/*
+/*	int	extsort_sequence(sort, how, key, value)
+/*	EXTSORT	*sort;
+/*	int	how;
+/*	const char **key;
+/*	const char **value;
+/*
+/*	void	extsort_free(sort)
+/*	EXTSORT	*sort;
+/* DESCRIPTION
+/*	This module sorts a sequence of key-value pairs by key, in
+/*	the byte order of strcmp(3). Pairs with equal keys are
+/*	returned in the order in which they were added. When the
+/*	pairs do not fit in the memory limit, sorted runs are saved
+/*	to temporary files and merged while the result is read.
+/*
+/*	extsort_create() creates an empty sorter.
+/*
+/*	extsort_add() adds a copy of a key-value pair. This is not
+/*	allowed after the first extsort_sequence() call.
+/*
+/*	extsort_sequence() returns the pairs in sorted order. The
+/*	result is 1 when a pair is returned, 0 when there are no
+/*	more pairs. The key and value remain valid until the next
+/*	extsort_sequence() or extsort_free() call. The sequence can
+/*	be started over any number of times.
+/*
+/*	extsort_free() destroys a sorter, and removes its temporary
+/*	files.
+/*
+/*	Arguments:
+/* .IP tmp_prefix
+/*	The pathname prefix for temporary files. A temporary file
+/*	is removed immediately after it is created, and is released
+/*	when it is closed or when the process terminates.
+/* .IP limit
+/*	The approximate amount of memory for keys and values, before
+/*	the pairs are saved to a temporary file. Specify a value > 0.
+/* .IP how
+/*	EXTSORT_SEQ_FIRST to return the first pair, EXTSORT_SEQ_NEXT
+/*	to return the next pair.
+/* DIAGNOSTICS
+/*	Fatal errors: cannot create or access a temporary file, out
+/*	of memory. Panic: interface violation.
+/* SEE ALSO
+/*	qsort(3) in-memory sorting
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <iostuff.h>
+#include <vstring.h>
+#include <vstream.h>
+#include <vstring_vstream.h>
+#include <extsort.h>
+
+/* Application-specific. */
+
+typedef struct {
+    VSTREAM *fp;			/* temporary file */
+    VSTRING *key;			/* current key */
+    VSTRING *value;			/* current value */
+    int     more;			/* key and value are valid */
+} EXTSORT_RUN;
+
+struct extsort {
+    char   *tmp_prefix;			/* temporary pathname prefix */
+    ssize_t limit;			/* memory limit */
+    VSTRING *data;			/* key\0value\0 records */
+    size_t *offs;			/* record offsets */
+    ssize_t count;			/* number of records */
+    ssize_t size;			/* offset array size */
+    EXTSORT_RUN *runs;			/* sorted runs */
+    int     run_count;			/* number of runs */
+    int     sorting;			/* sequence started */
+    ssize_t pos;			/* in-memory position */
+    int     last_run;			/* run of last result */
+};
+
+ /*
+  * qsort() has no context argument.
+  */
+static const char *extsort_base;
+
+/* extsort_compare - order records by key, then by input order */
+
+static int extsort_compare(const void *a, const void *b)
+{
+    size_t  off_a = *(const size_t *) a;
+    size_t  off_b = *(const size_t *) b;
+    int     diff;
+
+    if ((diff = strcmp(extsort_base + off_a, extsort_base + off_b)) != 0)
+	return (diff);
+    return (off_a < off_b ? -1 : off_a > off_b);
+}
+
+/* extsort_sort - sort the in-memory records */
+
+static void extsort_sort(EXTSORT *sp)
+{
+    extsort_base = vstring_str(sp->data);
+    qsort((void *) sp->offs, sp->count, sizeof(*sp->offs), extsort_compare);
+}
+
+/* extsort_spill - save the in-memory records as a sorted run */
+
+static void extsort_spill(EXTSORT *sp)
+{
+    VSTRING *path = vstring_alloc(100);
+    EXTSORT_RUN *run;
+    const char *cp;
+    ssize_t n;
+    int     fd;
+
+    if (sp->run_count == 0)
+	sp->runs = (EXTSORT_RUN *) mymalloc(sizeof(*sp->runs));
+    else
+	sp->runs = (EXTSORT_RUN *)
+	    myrealloc((void *) sp->runs, sizeof(*sp->runs) * (sp->run_count + 1));
+    run = sp->runs + sp->run_count;
+    vstring_sprintf(path, "%s.%ld.%d", sp->tmp_prefix,
+		    (long) getpid(), sp->run_count);
+    if ((fd = open(vstring_str(path), O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+	msg_fatal("create %s: %m", vstring_str(path));
+    if (unlink(vstring_str(path)) < 0)
+	msg_fatal("remove %s: %m", vstring_str(path));
+    close_on_exec(fd, CLOSE_ON_EXEC);
+    run->fp = vstream_fdopen(fd, O_RDWR);
+    vstream_control(run->fp, CA_VSTREAM_CTL_PATH(vstring_str(path)),
+		    CA_VSTREAM_CTL_END);
+    run->key = vstring_alloc(100);
+    run->value = vstring_alloc(100);
+    run->more = 0;
+    sp->run_count += 1;
+
+    extsort_sort(sp);
+    for (n = 0; n < sp->count; n++) {
+	cp = vstring_str(sp->data) + sp->offs[n];
+	vstream_fwrite(run->fp, cp, strlen(cp) + 1);
+	cp += strlen(cp) + 1;
+	vstream_fwrite(run->fp, cp, strlen(cp) + 1);
+    }
+    if (vstream_fflush(run->fp) != 0)
+	msg_fatal("write %s: %m", vstring_str(path));
+    if (msg_verbose)
+	msg_info("extsort: %s: %ld records", vstring_str(path), (long) n);
+    VSTRING_RESET(sp->data);
+    sp->count = 0;
+    vstring_free(path);
+}
+
+/* extsort_create - create empty sorter */
+
+EXTSORT *extsort_create(const char *tmp_prefix, ssize_t limit)
+{
+    EXTSORT *sp;
+
+    if (limit <= 0)
+	msg_panic("extsort_create: bad limit: %ld", (long) limit);
+    sp = (EXTSORT *) mymalloc(sizeof(*sp));
+    sp->tmp_prefix = mystrdup(tmp_prefix);
+    sp->limit = limit;
+    sp->data = vstring_alloc(limit < 4096 ? limit : 4096);
+    sp->size = 100;
+    sp->offs = (size_t *) mymalloc(sizeof(*sp->offs) * sp->size);
+    sp->count = 0;
+    sp->runs = 0;
+    sp->run_count = 0;
+    sp->sorting = 0;
+    sp->pos = 0;
+    sp->last_run = -1;
+    return (sp);
+}
+
+/* extsort_add - add one key-value pair */
+
+void    extsort_add(EXTSORT *sp, const char *key, const char *value)
+{
+    if (sp->sorting)
+	msg_panic("extsort_add: sequence already started");
+    if (sp->count > 0
+	&& (ssize_t) (VSTRING_LEN(sp->data) + sp->count * sizeof(*sp->offs))
+	>= sp->limit)
+	extsort_spill(sp);
+    if (sp->count >= sp->size) {
+	sp->size *= 2;
+	sp->offs = (size_t *)
+	    myrealloc((void *) sp->offs, sizeof(*sp->offs) * sp->size);
+    }
+    sp->offs[sp->count++] = VSTRING_LEN(sp->data);
+    vstring_memcat(sp->data, key, strlen(key) + 1);
+    vstring_memcat(sp->data, value, strlen(value) + 1);
+}
+
+/* extsort_read - read the next pair from a run */
+
+static void extsort_read(EXTSORT_RUN *run)
+{
+    run->more = (vstring_get_null(run->key, run->fp) != VSTREAM_EOF
+		 && vstring_get_null(run->value, run->fp) != VSTREAM_EOF);
+    if (run->more == 0 && vstream_ferror(run->fp))
+	msg_fatal("read %s: %m", VSTREAM_PATH(run->fp));
+}
+
+/* extsort_sequence - return pairs in sorted order */
+
+int     extsort_sequence(EXTSORT *sp, int how, const char **key,
+			         const char **value)
+{
+    EXTSORT_RUN *run;
+    int     best;
+    int     n;
+
+    /*
+     * The first call saves the last records when other records were saved
+     * already, so that all results come from a merge.
+     */
+    if (sp->sorting == 0) {
+	if (how != EXTSORT_SEQ_FIRST)
+	    msg_panic("extsort_sequence: sequence not started");
+	if (sp->run_count > 0 && sp->count > 0)
+	    extsort_spill(sp);
+	else if (sp->run_count == 0)
+	    extsort_sort(sp);
+	sp->sorting = 1;
+    }
+
+    /*
+     * All records fit in memory.
+     */
+    if (sp->run_count == 0) {
+	if (how == EXTSORT_SEQ_FIRST)
+	    sp->pos = 0;
+	if (sp->pos >= sp->count)
+	    return (0);
+	*key = vstring_str(sp->data) + sp->offs[sp->pos++];
+	*value = *key + strlen(*key) + 1;
+	return (1);
+    }
+
+    /*
+     * Merge the runs. With equal keys, the earlier run wins.
+     */
+    if (how == EXTSORT_SEQ_FIRST) {
+	for (run = sp->runs; run < sp->runs + sp->run_count; run++) {
+	    if (vstream_fseek(run->fp, (off_t) 0, SEEK_SET) < 0)
+		msg_fatal("seek %s: %m", VSTREAM_PATH(run->fp));
+	    extsort_read(run);
+	}
+    } else if (sp->last_run >= 0) {
+	extsort_read(sp->runs + sp->last_run);
+    }
+    for (best = -1, n = 0; n < sp->run_count; n++)
+	if (sp->runs[n].more
+	    && (best < 0 || strcmp(vstring_str(sp->runs[n].key),
+				   vstring_str(sp->runs[best].key)) < 0))
+	    best = n;
+    if ((sp->last_run = best) < 0)
+	return (0);
+    *key = vstring_str(sp->runs[best].key);
+    *value = vstring_str(sp->runs[best].value);
+    return (1);
+}
+
+/* extsort_free - destroy sorter */
+
+void    extsort_free(EXTSORT *sp)
+{
+    EXTSORT_RUN *run;
+
+    for (run = sp->runs; run < sp->runs + sp->run_count; run++) {
+	(void) vstream_fclose(run->fp);
+	vstring_free(run->key);
+	vstring_free(run->value);
+    }
+    if (sp->runs)
+	myfree((void *) sp->runs);
+    myfree(sp->tmp_prefix);
+    vstring_free(sp->data);
+    myfree((void *) sp->offs);
+    myfree((void *) sp);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Usage:
+  *
+  * extsort [-v] limit tmp_prefix <input
+  *
+  * Each input line has a key, whitespace, and a value. The program prints
+  * the pairs in sorted order, twice, to exercise a restart.
+  */
+#include <ctype.h>
+#include <stringops.h>
+#include <msg_vstream.h>
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    EXTSORT *sp;
+    const char *key;
+    const char *value;
+    char   *cp;
+    char   *k;
+    int     how;
+    int     pass;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+	msg_verbose++;
+	argc--;
+	argv++;
+    }
+    if (argc != 3 || atoi(argv[1]) <= 0)
+	msg_fatal("usage: %s [-v] limit tmp_prefix", argv[0]);
+    sp = extsort_create(argv[2], atoi(argv[1]));
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	cp = vstring_str(buf);
+	if ((k = mystrtok(&cp, CHARS_SPACE)) == 0)
+	    continue;
+	while (*cp && ISSPACE(*cp))
+	    cp++;
+	extsort_add(sp, k, cp);
+    }
+    for (pass = 1; pass <= 2; pass++) {
+	vstream_printf("pass %d\n", pass);
+	for (how = EXTSORT_SEQ_FIRST; extsort_sequence(sp, how, &key, &value);
+	     how = EXTSORT_SEQ_NEXT)
+	    vstream_printf("%s\t%s\n", key, value);
+    }
+    vstream_fflush(VSTREAM_OUT);
+    extsort_free(sp);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _EXTSORT_H_INCLUDED_
+#define _EXTSORT_H_INCLUDED_
+
+/*++
+/* NAME
+/*	extsort 3h
+/* SUMMARY
+/*	sort key-value pairs with bounded memory
+/* SYNOPSIS
+/*	#include <extsort.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * The structure of a sorter is not visible to the caller.
+  */
+#define EXTSORT struct extsort
+
+extern EXTSORT *extsort_create(const char *, ssize_t);
+extern void extsort_add(EXTSORT *, const char *, const char *);
+extern int extsort_sequence(EXTSORT *, int, const char **, const char **);
+extern void extsort_free(EXTSORT *);
+
+#define EXTSORT_SEQ_FIRST	1
+#define EXTSORT_SEQ_NEXT	2
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
@@ -0,0 +1,117 @@
+/*++
+/* NAME
+/*	hash_fnv 3
+/* SUMMARY
+/*	Fowler/Noll/Vo hash function
+/* SYNOPSIS
+/*	#include <hash_fnv.h>
+/*
+/*	unsigned hash_fnvz(data)
+/*	const char *data;
+/*
+/*	unsigned hash_fnvz_seed(data, seed)
+/*	const char *data;
+/*	unsigned seed;
+/*
+/*	unsigned hash_fnv_fmix(hash)
+/*	unsigned hash;
+/* DESCRIPTION
+/*	This module implements the 32-bit FNV-1a hash function, and
+/*	the final mixing step of the 32-bit MurmurHash3 function.
+/*	These are fast, but a client can easily choose keys that
+/*	have the same hash value. Use hash_sip(3) for hash tables
+/*	that store client-controlled keys, unless each match is
+/*	verified with a string comparison and the number of keys
+/*	is bounded.
+/*
+/*	hash_fnvz() hashes a null-terminated string.
+/*
+/*	hash_fnvz_seed() hashes a null-terminated string, starting
+/*	from the FNV offset basis XOR the specified seed. The result
+/*	is the same as with hash_fnvz() when the seed is zero.
+/*
+/*	hash_fnv_fmix() mixes the bits of a hash value, so that
+/*	every input bit affects every result bit. Use this when a
+/*	hash value is divided into ranges, instead of used modulo
+/*	a table size.
+/* SEE ALSO
+/*	hash_sip(3) keyed hash function
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <hash_fnv.h>
+
+ /*
+  * The algorithms need 32-bit arithmetic. We mask the results of
+  * multiplications, in case an unsigned int has more than 32 bits.
+  */
+#define HASH_FNV_MASK	0xffffffffU
+#define HASH_FNV_BASIS	2166136261U
+#define HASH_FNV_PRIME	16777619U
+
+/* hash_fnvz_seed - hash null-terminated string */
+
+unsigned hash_fnvz_seed(const char *data, unsigned seed)
+{
+    const unsigned char *cp = (const unsigned char *) data;
+    unsigned hash = (HASH_FNV_BASIS ^ seed) & HASH_FNV_MASK;
+
+    while (*cp)
+	hash = ((hash ^ *cp++) * HASH_FNV_PRIME) & HASH_FNV_MASK;
+    return (hash);
+}
+
+/* hash_fnv_fmix - final avalanche */
+
+unsigned hash_fnv_fmix(unsigned hash)
+{
+    hash ^= hash >> 16;
+    hash = (hash * 0x85ebca6bU) & HASH_FNV_MASK;
+    hash ^= hash >> 13;
+    hash = (hash * 0xc2b2ae35U) & HASH_FNV_MASK;
+    hash ^= hash >> 16;
+    return (hash);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Hash each input line, and show the result with and without
+  * the final mixing step, so that the results can be compared against a
+  * known output.
+  */
+#include <stdlib.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+
+int     main(int unused_argc, char **unused_argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    unsigned hash;
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	hash = hash_fnvz(vstring_str(buf));
+	vstream_printf("%08x %08x %s\n", hash, hash_fnv_fmix(hash),
+		       vstring_str(buf));
+    }
+    vstream_fflush(VSTREAM_OUT);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _HASH_FNV_H_INCLUDED_
+#define _HASH_FNV_H_INCLUDED_
+
+/*++
+/* NAME
+/*	hash_fnv 3h
+/* SUMMARY
+/*	Fowler/Noll/Vo hash function
+/* SYNOPSIS
+/*	#include <hash_fnv.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface.
+  */
+extern unsigned hash_fnvz_seed(const char *, unsigned);
+extern unsigned hash_fnv_fmix(unsigned);
+
+#define hash_fnvz(s)	hash_fnvz_seed((s), 0)
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
@@ -0,0 +1,216 @@
+/*++
+/* NAME
+/*	hash_sip 3
+/* SUMMARY
+/*	keyed hash function
+/* SYNOPSIS
+/*	#include <hash_sip.h>
+/*
+/*	unsigned hash_sip(data, len)
+/*	const void *data;
+/*	ssize_t	len;
+/*
+/*	unsigned hash_sipz(data)
+/*	const char *data;
+/* DESCRIPTION
+/*	This module implements HalfSipHash-1-3, a keyed hash function
+/*	that operates on 32-bit words. The key is chosen at random
+/*	when the first hash value is computed, and is shared with
+/*	child processes. Without knowledge of the key, a client
+/*	cannot easily choose lookup keys that all end up in the same
+/*	hash table bucket.
+/*
+/*	hash_sip() hashes the specified data.
+/*
+/*	hash_sipz() hashes a null-terminated string. The result is
+/*	the same as with hash_sip() and the string length.
+/* SEE ALSO
+/*	htable(3) string-keyed hash table
+/*	binhash(3) binary-keyed hash table
+/* BUGS
+/*	The key is chosen from /dev/urandom where available, and
+/*	otherwise from the process ID and the time of day. Chrooted
+/*	processes choose the latter when they compute the first
+/*	hash value after entering the chroot jail.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Utility library. */
+
+#include <hash_sip.h>
+
+ /*
+  * The algorithm needs 32-bit arithmetic. We mask the results of additions
+  * and shifts, in case an unsigned int has more than 32 bits.
+  */
+#define HASH_SIP_M32	0xffffffffU
+
+#define HASH_SIP_ROTL(x, b) \
+	((((x) << (b)) | ((x) >> (32 - (b)))) & HASH_SIP_M32)
+
+#define HASH_SIP_ROUND(v0, v1, v2, v3) do { \
+	v0 = (v0 + v1) & HASH_SIP_M32; v1 = HASH_SIP_ROTL(v1, 5); \
+	v1 ^= v0; v0 = HASH_SIP_ROTL(v0, 16); \
+	v2 = (v2 + v3) & HASH_SIP_M32; v3 = HASH_SIP_ROTL(v3, 8); \
+	v3 ^= v2; \
+	v0 = (v0 + v3) & HASH_SIP_M32; v3 = HASH_SIP_ROTL(v3, 7); \
+	v3 ^= v0; \
+	v2 = (v2 + v1) & HASH_SIP_M32; v1 = HASH_SIP_ROTL(v1, 13); \
+	v1 ^= v2; v2 = HASH_SIP_ROTL(v2, 16); \
+    } while (0)
+
+ /*
+  * Per-process hash key.
+  */
+static unsigned hash_sip_key[2];
+static int hash_sip_initdone;
+
+#define HASH_SIP_INIT(v0, v1, v2, v3) do { \
+	if (hash_sip_initdone == 0) \
+	    hash_sip_init(); \
+	v0 = hash_sip_key[0]; \
+	v1 = hash_sip_key[1]; \
+	v2 = 0x6c796765U ^ hash_sip_key[0]; \
+	v3 = 0x74656462U ^ hash_sip_key[1]; \
+    } while (0)
+
+#define HASH_SIP_WORD(v0, v1, v2, v3, m) do { \
+	v3 ^= (m); \
+	HASH_SIP_ROUND(v0, v1, v2, v3); \
+	v0 ^= (m); \
+    } while (0)
+
+#define HASH_SIP_FINAL(v0, v1, v2, v3, m) do { \
+	HASH_SIP_WORD(v0, v1, v2, v3, (m)); \
+	v2 ^= 0xff; \
+	HASH_SIP_ROUND(v0, v1, v2, v3); \
+	HASH_SIP_ROUND(v0, v1, v2, v3); \
+	HASH_SIP_ROUND(v0, v1, v2, v3); \
+    } while (0)
+
+/* hash_sip_init - choose hash key */
+
+static void hash_sip_init(void)
+{
+    struct timeval tv;
+    unsigned char buf[sizeof(hash_sip_key)];
+    int     fd;
+    int     got = 0;
+    int     n;
+
+#ifdef HAS_DEV_URANDOM
+    if ((fd = open("/dev/urandom", O_RDONLY, 0)) >= 0) {
+	got = (read(fd, buf, sizeof(buf)) == sizeof(buf));
+	(void) close(fd);
+    }
+#endif
+    if (got) {
+	for (n = 0; n < 2; n++)
+	    hash_sip_key[n] = (buf[4 * n] | buf[4 * n + 1] << 8
+			       | buf[4 * n + 2] << 16
+			       | (unsigned) buf[4 * n + 3] << 24);
+    } else {
+	GETTIMEOFDAY(&tv);
+	hash_sip_key[0] = (getpid() ^ tv.tv_sec) & HASH_SIP_M32;
+	hash_sip_key[1] = (tv.tv_usec ^ (unsigned long) &tv) & HASH_SIP_M32;
+    }
+    hash_sip_initdone = 1;
+}
+
+/* hash_sip - hash data */
+
+unsigned hash_sip(const void *data, ssize_t len)
+{
+    const unsigned char *cp = (const unsigned char *) data;
+    const unsigned char *end = cp + (len & ~3);
+    unsigned v0, v1, v2, v3;
+    unsigned m;
+
+    HASH_SIP_INIT(v0, v1, v2, v3);
+    for ( /* void */ ; cp < end; cp += 4) {
+	m = cp[0] | cp[1] << 8 | cp[2] << 16 | (unsigned) cp[3] << 24;
+	HASH_SIP_WORD(v0, v1, v2, v3, m);
+    }
+    m = ((unsigned) len & 0xff) << 24;
+    switch (len & 3) {
+    case 3:
+	m |= cp[2] << 16;
+	/* FALLTHROUGH */
+    case 2:
+	m |= cp[1] << 8;
+	/* FALLTHROUGH */
+    case 1:
+	m |= cp[0];
+    }
+    HASH_SIP_FINAL(v0, v1, v2, v3, m);
+    return ((v1 ^ v3) & HASH_SIP_M32);
+}
+
+/* hash_sipz - hash null-terminated string */
+
+unsigned hash_sipz(const char *data)
+{
+    return (hash_sip(data, strlen(data)));
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. With a fixed key, hash the byte sequences 00, 00 01, and so
+  * on, so that the results can be compared against a known output. Then,
+  * hash each input line with both functions, and verify that the results
+  * are the same.
+  */
+#include <stdlib.h>
+#include <msg.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+
+int     main(int unused_argc, char **unused_argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    unsigned char data[64];
+    int     n;
+
+    /*
+     * Key 00 01 02 03 04 05 06 07, as in the reference implementation.
+     */
+    hash_sip_key[0] = 0x03020100U;
+    hash_sip_key[1] = 0x07060504U;
+    hash_sip_initdone = 1;
+    for (n = 0; n < (int) sizeof(data); n++)
+	data[n] = n;
+    for (n = 0; n <= 8; n++)
+	vstream_printf("%d %08x\n", n, hash_sip(data, n));
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	if (hash_sip(vstring_str(buf), VSTRING_LEN(buf))
+	    != hash_sipz(vstring_str(buf)))
+	    msg_fatal("hash_sip and hash_sipz differ for \"%s\"",
+		      vstring_str(buf));
+	vstream_printf("%08x %s\n", hash_sipz(vstring_str(buf)),
+		       vstring_str(buf));
+    }
+    vstream_fflush(VSTREAM_OUT);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
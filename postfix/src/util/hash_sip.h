@@ -0,0 +1,31 @@
+#ifndef _HASH_SIP_H_INCLUDED_
+#define _HASH_SIP_H_INCLUDED_
+
+/*++
+/* NAME
+/*	hash_sip 3h
+/* SUMMARY
+/*	keyed hash function
+/* SYNOPSIS
+/*	#include <hash_sip.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface.
+  */
+extern unsigned hash_sip(const void *, ssize_t);
+extern unsigned hash_sipz(const char *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+#endif
@@ -76,6 +76,11 @@
 #include <sys_defs.h>
 #include <ctype.h>
 #include <string.h>
+#include <limits.h>
+
+#ifndef UCHAR_MAX
+#define UCHAR_MAX 0xff
+#endif
 
 /* Utility library. */
 
@@ -90,6 +95,35 @@ static const unsigned char hex_chars[] = "0123456789ABCDEF";
 
 #define UCHAR_PTR(x) ((const unsigned char *)(x))
 
+ /*
+  * The result buffer is extended once per chunk instead of once per output
+  * byte.
+  */
+#define HEX_CODE_CHUNK	1024		/* input bytes per extension */
+
+ /*
+  * Decoding table, initialized on the fly.
+  */
+#define CHARS_PER_BYTE	(UCHAR_MAX + 1)
+#define INVALID		0xff
+
+static unsigned char un_hex[CHARS_PER_BYTE];
+static int un_hex_initdone;
+
+/* hex_decode_init - initialize decoding table */
+
+static void hex_decode_init(void)
+{
+    int     ch;
+
+    memset(un_hex, INVALID, sizeof(un_hex));
+    for (ch = 0; ch < 16; ch++) {
+	un_hex[hex_chars[ch]] = ch;
+	un_hex[TOLOWER(hex_chars[ch])] = ch;
+    }
+    un_hex_initdone = 1;
+}
+
 /* hex_encode - ABI compatibility */
 
 #undef hex_encode
@@ -104,17 +138,33 @@ VSTRING *hex_encode(VSTRING *result, const char *in, ssize_t len)
 VSTRING *hex_encode_opt(VSTRING *result, const char *in, ssize_t len, int flags)
 {
     const unsigned char *cp;
+    const unsigned char *end;
+    unsigned char *out;
     int     ch;
     ssize_t count;
+    ssize_t chunk;
 
+    /*
+     * With HEX_ENCODE_FLAG_USE_COLON, append ":" after each byte, and
+     * remove the last one when done.
+     */
     VSTRING_RESET(result);
-    for (cp = UCHAR_PTR(in), count = len; count > 0; count--, cp++) {
-	ch = *cp;
-	VSTRING_ADDCH(result, hex_chars[(ch >> 4) & 0xf]);
-	VSTRING_ADDCH(result, hex_chars[ch & 0xf]);
-	if ((flags & HEX_ENCODE_FLAG_USE_COLON) && count > 1)
-	    VSTRING_ADDCH(result, ':');
+    for (cp = UCHAR_PTR(in), count = len; count > 0; count -= chunk) {
+	chunk = (count > HEX_CODE_CHUNK ? HEX_CODE_CHUNK : count);
+	VSTRING_SPACE(result, chunk * 3);
+	out = (unsigned char *) vstring_end(result);
+	for (end = cp + chunk; cp < end; cp++) {
+	    ch = *cp;
+	    *out++ = hex_chars[(ch >> 4) & 0xf];
+	    *out++ = hex_chars[ch & 0xf];
+	    if (flags & HEX_ENCODE_FLAG_USE_COLON)
+		*out++ = ':';
+	}
+	vstring_set_payload_size(result,
+				 out - (unsigned char *) vstring_str(result));
     }
+    if ((flags & HEX_ENCODE_FLAG_USE_COLON) && len > 0)
+	vstring_truncate(result, VSTRING_LEN(result) - 1);
     VSTRING_TERMINATE(result);
     return (result);
 }
@@ -133,33 +183,26 @@ VSTRING *hex_decode(VSTRING *result, const char *in, ssize_t len)
 VSTRING *hex_decode_opt(VSTRING *result, const char *in, ssize_t len, int flags)
 {
     const unsigned char *cp;
+    unsigned char *out;
     ssize_t count;
-    unsigned int hex;
-    unsigned int bin;
+    unsigned int hi;
+    unsigned int lo;
 
+    /*
+     * The output is never longer than half the input.
+     */
+    if (un_hex_initdone == 0)
+	hex_decode_init();
     VSTRING_RESET(result);
+    if (len > 0)
+	VSTRING_SPACE(result, len / 2);
+    out = (unsigned char *) vstring_str(result);
     for (cp = UCHAR_PTR(in), count = len; count > 0; cp += 2, count -= 2) {
 	if (count < 2)
 	    return (0);
-	hex = cp[0];
-	if (hex >= '0' && hex <= '9')
-	    bin = (hex - '0') << 4;
-	else if (hex >= 'A' && hex <= 'F')
-	    bin = (hex - 'A' + 10) << 4;
-	else if (hex >= 'a' && hex <= 'f')
-	    bin = (hex - 'a' + 10) << 4;
-	else
+	if ((hi = un_hex[cp[0]]) == INVALID || (lo = un_hex[cp[1]]) == INVALID)
 	    return (0);
-	hex = cp[1];
-	if (hex >= '0' && hex <= '9')
-	    bin |= (hex - '0');
-	else if (hex >= 'A' && hex <= 'F')
-	    bin |= (hex - 'A' + 10);
-	else if (hex >= 'a' && hex <= 'f')
-	    bin |= (hex - 'a' + 10);
-	else
-	    return (0);
-	VSTRING_ADDCH(result, bin);
+	*out++ = hi << 4 | lo;
 
 	/*
 	 * Support *colon-separated* input (no leading or trailing colons).
@@ -172,6 +215,8 @@ VSTRING *hex_decode_opt(VSTRING *result, const char *in, ssize_t len, int flags)
 	    --count;
 	}
     }
+    vstring_set_payload_size(result,
+			     out - (unsigned char *) vstring_str(result));
     VSTRING_TERMINATE(result);
     return (result);
 }
@@ -235,6 +280,17 @@ int     main(int unused_argc, char **unused_argv)
     VERIFY(STR(b2), test);
     argv_free(argv);
 
+    hex_encode_opt(b1, "\001\253\377", 3, HEX_ENCODE_FLAG_USE_COLON);
+    VERIFY(STR(b1), "01:AB:FF");
+    hex_encode_opt(b1, "", 0, HEX_ENCODE_FLAG_USE_COLON);
+    VERIFY(STR(b1), "");
+    DECODE(b2, "4a4B6c", 6);
+    VERIFY(STR(b2), "JKl");
+    if (hex_decode(b2, "4G", 2) != 0)
+	msg_panic("undetected bad hex: 4G");
+    if (hex_decode(b2, "414", 3) != 0)
+	msg_panic("undetected bad length: 414");
+
     vstring_free(b1);
     vstring_free(b2);
     return (0);
@@ -24,6 +24,9 @@
 /*	understands lowercase, uppercase, and mixed case %XX sequences. The
 /*	result value is the raw argument in case of success, a null pointer
 /*	otherwise.
+/*
+/*	Both functions copy runs of characters that need no conversion
+/*	with one operation.
 /* BUGS
 /*	hex_quote() cannot process null characters in data.
 /* LICENSE
@@ -46,6 +49,7 @@
 
 #include "sys_defs.h"
 #include <ctype.h>
+#include <string.h>
 
 /* Utility library. */
 
@@ -58,19 +62,30 @@
 #define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
+static const char hex_chars[] = "0123456789ABCDEF";
+
+#define NEEDS_QUOTE(ch) ((ch) == '%' || ISSPACE(ch) || !ISPRINT(ch))
+
 /* hex_quote - raw data to quoted */
 
 VSTRING *hex_quote(VSTRING *hex, const char *raw)
 {
     const char *cp;
+    const char *start;
     int     ch;
 
     VSTRING_RESET(hex);
-    for (cp = raw; (ch = *(unsigned const char *) cp) != 0; cp++) {
-	if (ch != '%' && !ISSPACE(ch) && ISPRINT(ch)) {
-	    VSTRING_ADDCH(hex, ch);
+    for (cp = raw; (ch = *(unsigned const char *) cp) != 0; /* void */ ) {
+	if (NEEDS_QUOTE(ch)) {
+	    VSTRING_ADDCH(hex, '%');
+	    VSTRING_ADDCH(hex, hex_chars[ch >> 4]);
+	    VSTRING_ADDCH(hex, hex_chars[ch & 0xf]);
+	    cp++;
 	} else {
-	    vstring_sprintf_append(hex, "%%%02X", ch);
+	    for (start = cp++; (ch = *(unsigned const char *) cp) != 0
+		 && !NEEDS_QUOTE(ch); cp++)
+		 /* void */ ;
+	    vstring_memcat(hex, start, cp - start);
 	}
     }
     VSTRING_TERMINATE(hex);
@@ -82,29 +97,33 @@ VSTRING *hex_quote(VSTRING *hex, const char *raw)
 VSTRING *hex_unquote(VSTRING *raw, const char *hex)
 {
     const char *cp;
+    const char *next;
     int     ch;
 
     VSTRING_RESET(raw);
-    for (cp = hex; (ch = *cp) != 0; cp++) {
-	if (ch == '%') {
-	    if (ISDIGIT(cp[1]))
-		ch = (cp[1] - '0') << 4;
-	    else if (cp[1] >= 'a' && cp[1] <= 'f')
-		ch = (cp[1] - 'a' + 10) << 4;
-	    else if (cp[1] >= 'A' && cp[1] <= 'F')
-		ch = (cp[1] - 'A' + 10) << 4;
-	    else
-		return (0);
-	    if (ISDIGIT(cp[2]))
-		ch |= (cp[2] - '0');
-	    else if (cp[2] >= 'a' && cp[2] <= 'f')
-		ch |= (cp[2] - 'a' + 10);
-	    else if (cp[2] >= 'A' && cp[2] <= 'F')
-		ch |= (cp[2] - 'A' + 10);
-	    else
-		return (0);
-	    cp += 2;
+    for (cp = hex; *cp != 0; cp += 3) {
+	if ((next = strchr(cp, '%')) == 0) {
+	    vstring_strcat(raw, cp);
+	    break;
 	}
+	vstring_memcat(raw, cp, next - cp);
+	cp = next;
+	if (ISDIGIT(cp[1]))
+	    ch = (cp[1] - '0') << 4;
+	else if (cp[1] >= 'a' && cp[1] <= 'f')
+	    ch = (cp[1] - 'a' + 10) << 4;
+	else if (cp[1] >= 'A' && cp[1] <= 'F')
+	    ch = (cp[1] - 'A' + 10) << 4;
+	else
+	    return (0);
+	if (ISDIGIT(cp[2]))
+	    ch |= (cp[2] - '0');
+	else if (cp[2] >= 'a' && cp[2] <= 'f')
+	    ch |= (cp[2] - 'a' + 10);
+	else if (cp[2] >= 'A' && cp[2] <= 'F')
+	    ch |= (cp[2] - 'A' + 10);
+	else
+	    return (0);
 	VSTRING_ADDCH(raw, ch);
     }
     VSTRING_TERMINATE(raw);
@@ -53,13 +53,16 @@
 /* DESCRIPTION
 /*	This module maintains one or more hash tables. Each table entry
 /*	consists of a unique string-valued lookup key and a generic
-/*	character-pointer value.
+/*	character-pointer value. Lookup keys are hashed with a keyed
+/*	hash function, so that clients cannot easily choose keys that
+/*	collide.
 /*	The tables are automatically resized when they fill up. When the
 /*	values to be remembered are not character pointers, proper casts
 /*	should be used or the code will not be portable.
 /*
 /*	htable_create() creates a table of the specified size and returns a
-/*	pointer to the result. The lookup keys are saved with mystrdup().
+/*	pointer to the result. The lookup keys are copied into the table
+/*	entries.
 /*	htable_enter() stores a (key, value) pair into the specified table
 /*	and returns a pointer to the resulting entry. The code does not
 /*	check if an entry with that key already exists: use htable_locate()
@@ -84,11 +87,12 @@
 /*
 /*	htable_walk() invokes the action function for each table entry, with
 /*	a pointer to the entry as its argument. The ptr argument is passed
-/*	on to the action function.
+/*	on to the action function. Entries are visited in the order that
+/*	they were added to the table.
 /*
 /*	htable_list() returns a null-terminated list of pointers to
-/*	all elements in the named table. The list should be passed to
-/*	myfree().
+/*	all elements in the named table, in the order that they were
+/*	added to the table. The list should be passed to myfree().
 /*
 /*	htable_sequence() returns the first or next element depending
 /*	on the value of the "how" argument.  Specify HTABLE_SEQ_FIRST
@@ -103,6 +107,7 @@
 /*	terminate immediately: memory allocation failure; an attempt
 /*	to delete a non-existent entry.
 /* SEE ALSO
+/*	hash_sip(3) keyed hash function
 /*	mymalloc(3) memory management wrapper
 /* LICENSE
 /* .ad
@@ -124,54 +129,117 @@
 
 #include "mymalloc.h"
 #include "msg.h"
+#include "hash_sip.h"
 #include "htable.h"
 
-/* htable_hash - hash a string */
-
-static size_t htable_hash(const char *s, size_t size)
+ /*
+  * The table uses open addressing. Entries are stored in groups. Each group
+  * has a control byte per entry with its state: empty, deleted, or the high
+  * 7 bits of the hash value of an entry that is in use, followed by the
+  * pointers to the entries. A lookup examines all control bytes of a group
+  * at once with word-at-a-time arithmetic, and compares lookup keys only
+  * when a control byte matches. The control bytes and most of the entry
+  * pointers of a group share one cache line.
+  * 
+  * The entries themselves are not moved when the table is resized, because
+  * callers may hold on to HTABLE_INFO pointers. Each entry is allocated
+  * together with its lookup key, to save a memory allocation and a cache
+  * miss. A doubly-linked list keeps the entries in insertion order, so that
+  * htable_walk(), htable_list() and htable_sequence() return results in a
+  * predictable order.
+  */
+typedef unsigned long HTABLE_WORD;
+
+#define HTABLE_GROUP_SIZE	((ssize_t) sizeof(HTABLE_WORD))
+
+struct HTABLE_GROUP {
+    unsigned char ctrl[sizeof(HTABLE_WORD)];	/* per-entry state */
+    HTABLE_INFO *info[sizeof(HTABLE_WORD)];	/* entries */
+};
+
+#define HTABLE_CTRL_EMPTY	0x80
+#define HTABLE_CTRL_DELETED	0xfe
+#define HTABLE_CTRL_TAG(h)	(((h) >> 25) & 0x7f)
+
+#define HTABLE_WORD_LSB		(~(HTABLE_WORD) 0 / 0xff)
+#define HTABLE_WORD_MSB		(HTABLE_WORD_LSB << 7)
+
+ /*
+  * Non-zero if a control byte may match the tag. This may produce false
+  * positives, but never false negatives.
+  */
+#define HTABLE_WORD_MATCH(w, tag) \
+	((((w) ^ (HTABLE_WORD_LSB * (tag))) - HTABLE_WORD_LSB) \
+	 & ~((w) ^ (HTABLE_WORD_LSB * (tag))) & HTABLE_WORD_MSB)
+
+ /*
+  * Non-zero if a control byte is empty, or is empty or deleted.
+  */
+#define HTABLE_WORD_EMPTY(w)	((w) & ~((w) << 6) & HTABLE_WORD_MSB)
+#define HTABLE_WORD_FREE(w)	((w) & HTABLE_WORD_MSB)
+
+#define HTABLE_MIN_SIZE		(2 * HTABLE_GROUP_SIZE)
+#define HTABLE_MAX_FILL(size)	((size) - (size) / 8)
+
+ /*
+  * Probe groups in triangular order. This visits every group when the
+  * number of groups is a power of 2.
+  */
+#define HTABLE_PROBE_START(table, hash, g, stride) \
+	((stride) = 0, \
+	 (g) = (hash) & ((table)->size / HTABLE_GROUP_SIZE - 1))
+
+#define HTABLE_PROBE_NEXT(table, g, stride) \
+	((stride) += 1, \
+	 (g) = ((g) + (stride)) & ((table)->size / HTABLE_GROUP_SIZE - 1))
+
+/* htable_word - load control bytes of group */
+
+static HTABLE_WORD htable_word(struct HTABLE_GROUP *group)
 {
-    size_t  h = 0;
-    size_t  g;
-
-    /*
-     * From the "Dragon" book by Aho, Sethi and Ullman.
-     */
+    HTABLE_WORD word;
 
-    while (*s) {
-	h = (h << 4U) + *(unsigned const char *) s++;
-	if ((g = (h & 0xf0000000)) != 0) {
-	    h ^= (g >> 24U);
-	    h ^= g;
-	}
-    }
-    return (h % size);
+    memcpy((void *) &word, group->ctrl, sizeof(word));
+    return (word);
 }
 
 /* htable_link - insert element into table */
 
-#define htable_link(table, element) { \
-     HTABLE_INFO **_h = table->data + htable_hash(element->key, table->size);\
-    element->prev = 0; \
-    if ((element->next = *_h) != 0) \
-	(*_h)->prev = element; \
-    *_h = element; \
-    table->used++; \
+static void htable_link(HTABLE *table, HTABLE_INFO *element)
+{
+    struct HTABLE_GROUP *group;
+    ssize_t g;
+    ssize_t stride;
+    ssize_t i;
+
+    for (HTABLE_PROBE_START(table, element->hash, g, stride); /* void */ ;
+	 HTABLE_PROBE_NEXT(table, g, stride)) {
+	group = table->data + g;
+	if (HTABLE_WORD_FREE(htable_word(group)))
+	    break;
+    }
+    for (i = 0; (group->ctrl[i] & HTABLE_CTRL_EMPTY) == 0; i++)
+	 /* void */ ;
+    if (group->ctrl[i] == HTABLE_CTRL_EMPTY)
+	table->fill++;
+    group->ctrl[i] = HTABLE_CTRL_TAG(element->hash);
+    group->info[i] = element;
+    table->used++;
 }
 
 /* htable_size - allocate and initialize hash table */
 
 static void htable_size(HTABLE *table, size_t size)
 {
-    HTABLE_INFO **h;
-
-    size |= 1;
+    ssize_t g;
 
-    table->data = h = (HTABLE_INFO **) mymalloc(size * sizeof(HTABLE_INFO *));
+    table->data = (struct HTABLE_GROUP *)
+	mymalloc(size / HTABLE_GROUP_SIZE * sizeof(struct HTABLE_GROUP));
+    for (g = 0; g < size / HTABLE_GROUP_SIZE; g++)
+	memset(table->data[g].ctrl, HTABLE_CTRL_EMPTY, HTABLE_GROUP_SIZE);
     table->size = size;
     table->used = 0;
-
-    while (size-- > 0)
-	*h++ = 0;
+    table->fill = 0;
 }
 
 /* htable_create - create initial hash table */
@@ -179,32 +247,29 @@ static void htable_size(HTABLE *table, size_t size)
 HTABLE *htable_create(ssize_t size)
 {
     HTABLE *table;
+    ssize_t new_size;
 
+    for (new_size = HTABLE_MIN_SIZE; HTABLE_MAX_FILL(new_size) <= size;
+	 new_size *= 2)
+	 /* void */ ;
     table = (HTABLE *) mymalloc(sizeof(HTABLE));
-    htable_size(table, size < 13 ? 13 : size);
+    htable_size(table, new_size);
+    table->head = table->tail = 0;
     table->seq_bucket = table->seq_element = 0;
     return (table);
 }
 
-/* htable_grow - extend existing table */
+/* htable_grow - extend existing table, or purge deleted entries */
 
 static void htable_grow(HTABLE *table)
 {
     HTABLE_INFO *ht;
-    HTABLE_INFO *next;
-    size_t  old_size = table->size;
-    HTABLE_INFO **h = table->data;
-    HTABLE_INFO **old_entries = h;
-
-    htable_size(table, 2 * old_size);
+    ssize_t old_size = table->size;
 
-    while (old_size-- > 0) {
-	for (ht = *h++; ht; ht = next) {
-	    next = ht->next;
-	    htable_link(table, ht);
-	}
-    }
-    myfree((void *) old_entries);
+    myfree((void *) table->data);
+    htable_size(table, table->used >= old_size / 2 ? 2 * old_size : old_size);
+    for (ht = table->head; ht; ht = ht->next)
+	htable_link(table, ht);
 }
 
 /* htable_enter - enter (key, value) pair */
@@ -212,28 +277,68 @@ static void htable_grow(HTABLE *table)
 HTABLE_INFO *htable_enter(HTABLE *table, const char *key, void *value)
 {
     HTABLE_INFO *ht;
+    size_t  len = strlen(key);
 
-    if (table->used >= table->size)
+    if (table->fill >= HTABLE_MAX_FILL(table->size))
 	htable_grow(table);
-    ht = (HTABLE_INFO *) mymalloc(sizeof(HTABLE_INFO));
-    ht->key = mystrdup(key);
+    ht = (HTABLE_INFO *) mymalloc(sizeof(HTABLE_INFO) + len + 1);
+    ht->key = memcpy((void *) (ht + 1), key, len + 1);
     ht->value = value;
+    ht->hash = hash_sip(key, len);
     htable_link(table, ht);
+    ht->next = 0;
+    if ((ht->prev = table->tail) != 0)
+	table->tail->next = ht;
+    else
+	table->head = ht;
+    table->tail = ht;
     return (ht);
 }
 
-/* htable_find - lookup value */
+/* htable_index - find table position of entry */
 
-void   *htable_find(HTABLE *table, const char *key)
+static ssize_t htable_index(HTABLE *table, const char *key)
 {
+    unsigned hash = hash_sipz(key);
+    int     tag = HTABLE_CTRL_TAG(hash);
+    struct HTABLE_GROUP *group;
+    HTABLE_WORD word;
     HTABLE_INFO *ht;
+    ssize_t g;
+    ssize_t stride;
+    ssize_t i;
 
 #define	STREQ(x,y) (x == y || (x[0] == y[0] && strcmp(x,y) == 0))
 
-    if (table)
-	for (ht = table->data[htable_hash(key, table->size)]; ht; ht = ht->next)
-	    if (STREQ(key, ht->key))
-		return (ht->value);
+    for (HTABLE_PROBE_START(table, hash, g, stride); /* void */ ;
+	 HTABLE_PROBE_NEXT(table, g, stride)) {
+	group = table->data + g;
+	word = htable_word(group);
+	if (HTABLE_WORD_MATCH(word, tag)) {
+	    for (i = 0; i < HTABLE_GROUP_SIZE; i++) {
+		if (group->ctrl[i] == tag) {
+		    ht = group->info[i];
+		    if (ht->hash == hash && STREQ(key, ht->key))
+			return (g * HTABLE_GROUP_SIZE + i);
+		}
+	    }
+	}
+	if (HTABLE_WORD_EMPTY(word))
+	    return (-1);
+    }
+}
+
+#define HTABLE_INFO_AT(table, pos) \
+	((table)->data[(pos) / HTABLE_GROUP_SIZE].info[(pos) % HTABLE_GROUP_SIZE])
+
+/* htable_find - lookup value */
+
+void   *htable_find(HTABLE *table, const char *key)
+{
+    ssize_t pos;
+
+    if (table && (pos = htable_index(table, key)) >= 0)
+	return (HTABLE_INFO_AT(table, pos)->value);
     return (0);
 }
 
@@ -241,14 +346,10 @@ void   *htable_find(HTABLE *table, const char *key)
 
 HTABLE_INFO *htable_locate(HTABLE *table, const char *key)
 {
-    HTABLE_INFO *ht;
-
-#define	STREQ(x,y) (x == y || (x[0] == y[0] && strcmp(x,y) == 0))
+    ssize_t pos;
 
-    if (table)
-	for (ht = table->data[htable_hash(key, table->size)]; ht; ht = ht->next)
-	    if (STREQ(key, ht->key))
-		return (ht);
+    if (table && (pos = htable_index(table, key)) >= 0)
+	return (HTABLE_INFO_AT(table, pos));
     return (0);
 }
 
@@ -257,28 +358,40 @@ HTABLE_INFO *htable_locate(HTABLE *table, const char *key)
 void    htable_delete(HTABLE *table, const char *key, void (*free_fn) (void *))
 {
     if (table) {
+	struct HTABLE_GROUP *group;
 	HTABLE_INFO *ht;
-	HTABLE_INFO **h = table->data + htable_hash(key, table->size);
-
-#define	STREQ(x,y) (x == y || (x[0] == y[0] && strcmp(x,y) == 0))
-
-	for (ht = *h; ht; ht = ht->next) {
-	    if (STREQ(key, ht->key)) {
-		if (ht->next)
-		    ht->next->prev = ht->prev;
-		if (ht->prev)
-		    ht->prev->next = ht->next;
-		else
-		    *h = ht->next;
-		table->used--;
-		myfree(ht->key);
-		if (free_fn && ht->value)
-		    (*free_fn) (ht->value);
-		myfree((void *) ht);
-		return;
-	    }
+	ssize_t pos;
+	ssize_t i;
+
+	if ((pos = htable_index(table, key)) < 0)
+	    msg_panic("htable_delete: unknown_key: \"%s\"", key);
+	group = table->data + pos / HTABLE_GROUP_SIZE;
+	i = pos % HTABLE_GROUP_SIZE;
+	ht = group->info[i];
+
+	/*
+	 * If this group has an empty entry, then no lookup will continue
+	 * past this group, and the entry can be made empty. Otherwise, it
+	 * must be marked as deleted.
+	 */
+	if (HTABLE_WORD_EMPTY(htable_word(group))) {
+	    group->ctrl[i] = HTABLE_CTRL_EMPTY;
+	    table->fill--;
+	} else {
+	    group->ctrl[i] = HTABLE_CTRL_DELETED;
 	}
-	msg_panic("htable_delete: unknown_key: \"%s\"", key);
+	if (ht->next)
+	    ht->next->prev = ht->prev;
+	else
+	    table->tail = ht->prev;
+	if (ht->prev)
+	    ht->prev->next = ht->next;
+	else
+	    table->head = ht->next;
+	table->used--;
+	if (free_fn && ht->value)
+	    (*free_fn) (ht->value);
+	myfree((void *) ht);
     }
 }
 
@@ -287,19 +400,14 @@ void    htable_delete(HTABLE *table, const char *key, void (*free_fn) (void *))
 void    htable_free(HTABLE *table, void (*free_fn) (void *))
 {
     if (table) {
-	ssize_t i = table->size;
 	HTABLE_INFO *ht;
 	HTABLE_INFO *next;
-	HTABLE_INFO **h = table->data;
 
-	while (i-- > 0) {
-	    for (ht = *h++; ht; ht = next) {
-		next = ht->next;
-		myfree(ht->key);
-		if (free_fn && ht->value)
-		    (*free_fn) (ht->value);
-		myfree((void *) ht);
-	    }
+	for (ht = table->head; ht; ht = next) {
+	    next = ht->next;
+	    if (free_fn && ht->value)
+		(*free_fn) (ht->value);
+	    myfree((void *) ht);
 	}
 	myfree((void *) table->data);
 	table->data = 0;
@@ -315,13 +423,10 @@ void    htable_free(HTABLE *table, void (*free_fn) (void *))
 void    htable_walk(HTABLE *table, void (*action) (HTABLE_INFO *, void *),
 		            void *ptr) {
     if (table) {
-	ssize_t i = table->size;
-	HTABLE_INFO **h = table->data;
 	HTABLE_INFO *ht;
 
-	while (i-- > 0)
-	    for (ht = *h++; ht; ht = ht->next)
-		(*action) (ht, ptr);
+	for (ht = table->head; ht; ht = ht->next)
+	    (*action) (ht, ptr);
     }
 }
 
@@ -332,13 +437,11 @@ HTABLE_INFO **htable_list(HTABLE *table)
     HTABLE_INFO **list;
     HTABLE_INFO *member;
     ssize_t count = 0;
-    ssize_t i;
 
     if (table != 0) {
 	list = (HTABLE_INFO **) mymalloc(sizeof(*list) * (table->used + 1));
-	for (i = 0; i < table->size; i++)
-	    for (member = table->data[i]; member != 0; member = member->next)
-		list[count++] = member;
+	for (member = table->head; member != 0; member = member->next)
+	    list[count++] = member;
     } else {
 	list = (HTABLE_INFO **) mymalloc(sizeof(*list));
     }
@@ -374,10 +477,227 @@ HTABLE_INFO *htable_sequence(HTABLE *table, int how)
 }
 
 #ifdef TEST
+#include <stdlib.h>
+#include <sys/time.h>
 #include <vstring_vstream.h>
 #include <myrand.h>
 
-int     main(int unused_argc, char **unused_argv)
+ /*
+  * For comparison, the chained hash table with the "Dragon" book hash
+  * function that this module used to implement. Only the operations that
+  * the benchmark needs.
+  */
+typedef struct OLD_INFO {
+    char   *key;
+    void   *value;
+    struct OLD_INFO *next;
+} OLD_INFO;
+
+typedef struct OLD_TABLE {
+    ssize_t size;
+    ssize_t used;
+    OLD_INFO **data;
+} OLD_TABLE;
+
+static size_t old_hash(const char *s, size_t size)
+{
+    size_t  h = 0;
+    size_t  g;
+
+    while (*s) {
+	h = (h << 4U) + *(unsigned const char *) s++;
+	if ((g = (h & 0xf0000000)) != 0) {
+	    h ^= (g >> 24U);
+	    h ^= g;
+	}
+    }
+    return (h % size);
+}
+
+static void old_size(OLD_TABLE *table, ssize_t size)
+{
+    size |= 1;
+    table->data = (OLD_INFO **) mymalloc(size * sizeof(OLD_INFO *));
+    memset((void *) table->data, 0, size * sizeof(OLD_INFO *));
+    table->size = size;
+}
+
+static void old_enter(OLD_TABLE *table, const char *key, void *value)
+{
+    OLD_INFO *ht;
+    OLD_INFO *next;
+    OLD_INFO **old_data;
+    ssize_t old_count;
+    ssize_t i;
+
+    if (table->used >= table->size) {
+	old_data = table->data;
+	old_count = table->size;
+	old_size(table, 2 * old_count);
+	for (i = 0; i < old_count; i++) {
+	    for (ht = old_data[i]; ht; ht = next) {
+		next = ht->next;
+		ht->next = table->data[old_hash(ht->key, table->size)];
+		table->data[old_hash(ht->key, table->size)] = ht;
+	    }
+	}
+	myfree((void *) old_data);
+    }
+    ht = (OLD_INFO *) mymalloc(sizeof(*ht));
+    ht->key = mystrdup(key);
+    ht->value = value;
+    ht->next = table->data[old_hash(key, table->size)];
+    table->data[old_hash(key, table->size)] = ht;
+    table->used++;
+}
+
+static void *old_find(OLD_TABLE *table, const char *key)
+{
+    OLD_INFO *ht;
+
+    for (ht = table->data[old_hash(key, table->size)]; ht; ht = ht->next)
+	if (STREQ(key, ht->key))
+	    return (ht->value);
+    return (0);
+}
+
+static void old_delete(OLD_TABLE *table, const char *key)
+{
+    OLD_INFO **h;
+    OLD_INFO *ht;
+
+    for (h = table->data + old_hash(key, table->size); (ht = *h) != 0;
+	 h = &ht->next) {
+	if (STREQ(key, ht->key)) {
+	    *h = ht->next;
+	    myfree(ht->key);
+	    myfree((void *) ht);
+	    table->used--;
+	    return;
+	}
+    }
+    msg_panic("old_delete: unknown key: \"%s\"", key);
+}
+
+/* elapsed - report time since start */
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/* bench - compare old and new implementation */
+
+static void bench(ssize_t count)
+{
+    char  **keys;
+    char  **miss;
+    ssize_t *order;
+    OLD_TABLE old_table;
+    HTABLE *table;
+    struct timeval start;
+    VSTRING *buf = vstring_alloc(100);
+    ssize_t i;
+    ssize_t j;
+    ssize_t r;
+    int     round;
+
+#define BENCH_ROUNDS	5
+
+    /*
+     * Look up keys in a random order, so that neither implementation
+     * benefits from keys that hash to nearby buckets.
+     */
+    keys = (char **) mymalloc(sizeof(*keys) * count);
+    miss = (char **) mymalloc(sizeof(*miss) * count);
+    order = (ssize_t *) mymalloc(sizeof(*order) * count);
+    for (i = 0; i < count; i++) {
+	keys[i] = mystrdup(vstring_str(vstring_sprintf(buf,
+						  "%ld.example.com", (long) i)));
+	miss[i] = mystrdup(vstring_str(vstring_sprintf(buf,
+						"%ld.example.org", (long) i)));
+	order[i] = i;
+    }
+    for (i = 0; i < count; i++) {
+	r = myrand() % count;
+	j = order[i];
+	order[i] = order[r];
+	order[r] = j;
+    }
+
+    /*
+     * The old implementation.
+     */
+    GETTIMEOFDAY(&start);
+    old_table.used = 0;
+    old_size(&old_table, 13);
+    for (i = 0; i < count; i++)
+	old_enter(&old_table, keys[i], (void *) keys[i]);
+    vstream_printf("old: enter %ld keys: %.3f s\n", (long) count,
+		   elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+	for (j = 0; j < count; j++) {
+	    i = order[j];
+	    if (old_find(&old_table, keys[i]) != keys[i])
+		msg_panic("old: key %s not found", keys[i]);
+	    if (old_find(&old_table, miss[i]) != 0)
+		msg_panic("old: key %s found", miss[i]);
+	}
+    }
+    vstream_printf("old: %d x %ld hits and misses: %.3f s\n", BENCH_ROUNDS,
+		   (long) count, elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (j = 0; j < count; j++)
+	old_delete(&old_table, keys[order[j]]);
+    myfree((void *) old_table.data);
+    vstream_printf("old: delete %ld keys: %.3f s\n", (long) count,
+		   elapsed(&start));
+
+    /*
+     * The new implementation.
+     */
+    GETTIMEOFDAY(&start);
+    table = htable_create(13);
+    for (i = 0; i < count; i++)
+	htable_enter(table, keys[i], (void *) keys[i]);
+    vstream_printf("new: enter %ld keys: %.3f s\n", (long) count,
+		   elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+	for (j = 0; j < count; j++) {
+	    i = order[j];
+	    if (htable_find(table, keys[i]) != keys[i])
+		msg_panic("new: key %s not found", keys[i]);
+	    if (htable_find(table, miss[i]) != 0)
+		msg_panic("new: key %s found", miss[i]);
+	}
+    }
+    vstream_printf("new: %d x %ld hits and misses: %.3f s\n", BENCH_ROUNDS,
+		   (long) count, elapsed(&start));
+    GETTIMEOFDAY(&start);
+    for (j = 0; j < count; j++)
+	htable_delete(table, keys[order[j]], (void (*) (void *)) 0);
+    htable_free(table, (void (*) (void *)) 0);
+    vstream_printf("new: delete %ld keys: %.3f s\n", (long) count,
+		   elapsed(&start));
+    vstream_fflush(VSTREAM_OUT);
+
+    for (i = 0; i < count; i++) {
+	myfree(keys[i]);
+	myfree(miss[i]);
+    }
+    myfree((void *) keys);
+    myfree((void *) miss);
+    myfree((void *) order);
+    vstring_free(buf);
+}
+
+int     main(int argc, char **argv)
 {
     VSTRING *buf = vstring_alloc(10);
     ssize_t count = 0;
@@ -389,15 +709,25 @@ int     main(int unused_argc, char **unused_argv)
     ssize_t r;
     int     op;
 
+    if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+	bench(atol(argv[2]));
+	return (0);
+    }
+
     /*
      * Load a large number of strings and delete them in a random order.
+     * The sequence must return the strings in the order that they were
+     * added. After each deletion, the deleted string must be gone, and the
+     * other strings must still be there.
      */
     hash = htable_create(10);
     while (vstring_get(buf, VSTREAM_IN) != VSTREAM_EOF)
 	htable_enter(hash, vstring_str(buf), CAST_INT_TO_VOID_PTR(count++));
-    for (i = 0, op = HTABLE_SEQ_FIRST; htable_sequence(hash, op) != 0;
+    for (i = 0, op = HTABLE_SEQ_FIRST; (info = htable_sequence(hash, op)) != 0;
 	 i++, op = HTABLE_SEQ_NEXT)
-	 /* void */ ;
+	if (CAST_ANY_PTR_TO_INT(info->value) != i)
+	    msg_panic("entry %ld has value %d", (long) i,
+		      CAST_ANY_PTR_TO_INT(info->value));
     if (i != hash->used)
 	msg_panic("%ld entries found, but %lu entries exist",
 		  (long) i, (unsigned long) hash->used);
@@ -408,8 +738,14 @@ int     main(int unused_argc, char **unused_argv)
 	ht_info[i] = ht_info[r];
 	ht_info[r] = info;
     }
-    for (ht = ht_info; *ht; ht++)
+    for (ht = ht_info; *ht; ht++) {
+	vstring_strcpy(buf, ht[0]->key);
 	htable_delete(hash, ht[0]->key, (void (*) (void *)) 0);
+	if (htable_locate(hash, vstring_str(buf)) != 0)
+	    msg_panic("deleted entry \"%s\" still exists", vstring_str(buf));
+	if (ht[1] != 0 && htable_locate(hash, ht[1]->key) != ht[1])
+	    msg_panic("entry \"%s\" not found", ht[1]->key);
+    }
     if (hash->used > 0)
 	msg_panic("%ld entries not deleted", (long) hash->used);
     myfree((void *) ht_info);
@@ -16,8 +16,9 @@
 typedef struct HTABLE_INFO {
     char   *key;			/* lookup key */
     void   *value;			/* associated value */
-    struct HTABLE_INFO *next;		/* colliding entry */
-    struct HTABLE_INFO *prev;		/* colliding entry */
+    struct HTABLE_INFO *next;		/* next entry, in insertion order */
+    struct HTABLE_INFO *prev;		/* previous entry */
+    unsigned hash;			/* keyed hash of lookup key */
 } HTABLE_INFO;
 
  /* Structure of one hash table. */
@@ -25,7 +26,10 @@ typedef struct HTABLE_INFO {
 typedef struct HTABLE {
     ssize_t size;			/* length of entries array */
     ssize_t used;			/* number of entries in table */
-    HTABLE_INFO **data;			/* entries array, auto-resized */
+    ssize_t fill;			/* used + deleted entries */
+    struct HTABLE_GROUP *data;		/* entries array, auto-resized */
+    HTABLE_INFO *head;			/* first entry, in insertion order */
+    HTABLE_INFO *tail;			/* last entry, in insertion order */
     HTABLE_INFO **seq_bucket;		/* current sequence hash bucket */
     HTABLE_INFO **seq_element;		/* current sequence element */
 } HTABLE;
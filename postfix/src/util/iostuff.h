@@ -13,6 +13,8 @@
  /*
   * External interface.
   */
+struct iovec;
+
 extern int non_blocking(int, int);
 extern int close_on_exec(int, int);
 extern int open_limit(int);
@@ -23,6 +25,7 @@ extern ssize_t peekfd(int);
 extern ssize_t write_buf(int, const char *, ssize_t, int);
 extern ssize_t timed_read(int, void *, size_t, int, void *);
 extern ssize_t timed_write(int, const void *, size_t, int, void *);
+extern ssize_t timed_writev(int, const struct iovec *, int, int, void *);
 extern void doze(unsigned);
 extern void rand_sleep(unsigned, unsigned);
 extern int duplex_pipe(int *);
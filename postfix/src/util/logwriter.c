@@ -14,6 +14,11 @@
 /*	const char *buffer.
 /*	ssize_t	buflen)
 /*
+/*	int	logwriter_append(
+/*	VSTREAM	*file,
+/*	const char *buffer.
+/*	ssize_t	buflen)
+/*
 /*	int	logwriter_close(
 /*	VSTREAM	*file)
 /*
@@ -31,6 +36,12 @@
 /*	open logfile. The result is zero if successful, VSTREAM_EOF
 /*	if the operation failed.
 /*
+/*	logwriter_append() is like logwriter_write(), but leaves
+/*	the data in the stream buffer until the buffer fills up,
+/*	or until the application calls vstream_fflush() or
+/*	logwriter_write(). A buffer that fits in the stream buffer
+/*	is written with one write operation.
+/*
 /*	logwriter_close() closes the logfile and destroys the VSTREAM
 /*	instance. The result is zero if there were no errors writing
 /*	the file, VSTREAM_EOF otherwise.
@@ -103,6 +114,20 @@ int     logwriter_write(VSTREAM *fp, const char *buf, ssize_t len)
     return (vstream_fflush(fp));
 }
 
+/* logwriter_append - append to logfile, buffered */
+
+int     logwriter_append(VSTREAM *fp, const char *buf, ssize_t len)
+{
+    if (len < 0)
+	msg_panic("logwriter_append: negative length %ld", (long) len);
+    if (vstream_bufstat(fp, VSTREAM_BST_OUT_PEND) + len + 1
+	> vstream_req_bufsize(fp) && vstream_fflush(fp) != 0)
+	return (VSTREAM_EOF);
+    if (vstream_fwrite(fp, buf, len) != len)
+	return (VSTREAM_EOF);
+    return (VSTREAM_PUTC('\n', fp) == VSTREAM_EOF ? VSTREAM_EOF : 0);
+}
+
 /* logwriter_close - close logfile */
 
 int     logwriter_close(VSTREAM *fp)
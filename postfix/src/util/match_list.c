@@ -44,6 +44,18 @@
 /*
 /*	match_list_free() releases storage allocated by match_list_init().
 /*
+/*	When all match functions are match_string(), match_hostname()
+/*	or match_hostaddr(), match_list_init() also compiles the
+/*	pattern list. Runs of consecutive string, name and address
+/*	patterns are stored in hash tables (exact and parent-domain
+/*	matches) and in a radix tree (net/mask matches); type:table
+/*	patterns, and address patterns that don't parse, are still
+/*	tried one at a time. match_list_match() searches the runs
+/*	in list order, and returns the result for the first matching
+/*	pattern, as if the patterns were tried one at a time. In
+/*	verbose mode, match_list_match() does try the patterns one
+/*	at a time, so that each comparison is logged.
+/*
 /*	Arguments:
 /* .IP pname
 /*	Parameter name or other identifying information that is
@@ -105,6 +117,9 @@
 #include <stringops.h>
 #include <argv.h>
 #include <dict.h>
+#include <htable.h>
+#include <cidr_match.h>
+#include <cidr_trie.h>
 #include <match_list.h>
 
 /* Application-specific */
@@ -112,6 +127,44 @@
 #define MATCH_DICTIONARY(pattern) \
     ((pattern)[0] != '[' && strchr((pattern), ':') != 0)
 
+ /*
+  * The address syntax tests must be consistent with match_hostaddr().
+  */
+#define V4_ADDR_STRING_CHARS	"01234567890."
+#define V6_ADDR_STRING_CHARS	V4_ADDR_STRING_CHARS "abcdefABCDEF:"
+
+#define MATCH_NET_PATTERN(pattern) \
+    ((pattern)[strcspn((pattern), ":/")] != 0 \
+     && (pattern)[strspn((pattern), V4_ADDR_STRING_CHARS)] != 0 \
+     && (pattern)[strspn((pattern), V6_ADDR_STRING_CHARS "[]/")] == 0)
+
+ /*
+  * A compiled pattern list is a sequence of segments. An indexed segment
+  * holds consecutive patterns that can be looked up, instead of being tried
+  * one at a time; a linear segment holds patterns that must be tried one at
+  * a time. Table values are pattern list indices plus one.
+  */
+typedef struct {
+    CIDR_MATCH info;			/* must be first */
+    int     index;			/* pattern list index */
+} MATCH_NET;
+
+typedef struct MATCH_LIST_SEG {
+    int     first;			/* first pattern list index */
+    int     stop;			/* first index after segment */
+    int     indexed;			/* lookup tables below */
+    HTABLE *names;			/* exact and parent-domain match */
+    HTABLE *domains;			/* .domain match */
+    HTABLE *addrs;			/* exact address match */
+    MATCH_NET *nets;			/* net/mask patterns */
+    CIDR_TRIE *net_trie;		/* net/mask match */
+    struct MATCH_LIST_SEG *next;	/* next segment */
+} MATCH_LIST_SEG;
+
+#define MATCH_HAS_STRING	(1<<0)
+#define MATCH_HAS_HOSTNAME	(1<<1)
+#define MATCH_HAS_HOSTADDR	(1<<2)
+
 /* match_list_parse - parse buffer, destroy buffer */
 
 static ARGV *match_list_parse(MATCH_LIST *match_list, ARGV *pat_list,
@@ -192,6 +245,182 @@ static ARGV *match_list_parse(MATCH_LIST *match_list, ARGV *pat_list,
     return (pat_list);
 }
 
+/* match_list_pattern - skip and evaluate negation operators */
+
+static char *match_list_pattern(char *pat, int *match)
+{
+    for (*match = 1; *pat == '!'; pat++)
+	*match = !*match;
+    return (pat);
+}
+
+/* match_list_indexable - can this pattern be looked up */
+
+static int match_list_indexable(const char *pat, int funcs)
+{
+    CIDR_MATCH info;
+    VSTRING *err;
+    char   *saved_pat;
+
+    if (MATCH_DICTIONARY(pat))
+	return (0);
+
+    /*
+     * match_hostaddr() reports a net/mask syntax error when the pattern is
+     * used, so it must be tried in its place in the pattern list.
+     */
+    if ((funcs & MATCH_HAS_HOSTADDR) && MATCH_NET_PATTERN(pat)) {
+	saved_pat = mystrdup(pat);
+	err = cidr_match_parse(&info, saved_pat, CIDR_MATCH_TRUE,
+			       (VSTRING *) 0);
+	myfree(saved_pat);
+	if (err != 0) {
+	    vstring_free(err);
+	    return (0);
+	}
+    }
+    return (1);
+}
+
+/* match_list_enter - add pattern to lookup table, first one wins */
+
+static void match_list_enter(HTABLE **table, const char *key, int index)
+{
+    if (*table == 0)
+	*table = htable_create(13);
+    if (htable_locate(*table, key) == 0)
+	(void) htable_enter(*table, key, CAST_INT_TO_VOID_PTR(index + 1));
+}
+
+/* match_list_find - look up pattern, remember the first one */
+
+static void match_list_find(HTABLE *table, const char *key, int *best)
+{
+    void   *value;
+
+    if (table != 0 && (value = htable_find(table, key)) != 0
+	&& CAST_ANY_PTR_TO_INT(value) - 1 < *best)
+	*best = CAST_ANY_PTR_TO_INT(value) - 1;
+}
+
+/* match_list_index - build lookup tables for one segment */
+
+static void match_list_index(MATCH_LIST *list, MATCH_LIST_SEG *seg,
+			             int funcs)
+{
+    char  **argv = list->patterns->argv;
+    MATCH_NET *net;
+    char   *pat;
+    char   *saved_pat;
+    char   *cp;
+    int     match;
+    int     n;
+
+    if (funcs & MATCH_HAS_HOSTADDR)
+	seg->nets = (MATCH_NET *)
+	    mymalloc(sizeof(*seg->nets) * (seg->stop - seg->first));
+    for (net = seg->nets, n = seg->first; n < seg->stop; n++) {
+	pat = match_list_pattern(argv[n], &match);
+	if (funcs & (MATCH_HAS_STRING | MATCH_HAS_HOSTNAME))
+	    match_list_enter(&seg->names, pat, n);
+	if ((funcs & MATCH_HAS_HOSTNAME) && !(list->flags & MATCH_FLAG_PARENT)
+	    && pat[0] == '.')
+	    match_list_enter(&seg->domains, pat, n);
+	if (funcs & MATCH_HAS_HOSTADDR) {
+	    if (pat[0] != '[') {
+		match_list_enter(&seg->addrs, pat, n);
+	    } else if (*(cp = pat + strlen(pat) - 1) == ']' && cp > pat) {
+		*cp = 0;
+		match_list_enter(&seg->addrs, pat + 1, n);
+		*cp = ']';
+	    }
+	    if (MATCH_NET_PATTERN(pat)) {
+		saved_pat = mystrdup(pat);
+		if (cidr_match_parse(&net->info, saved_pat, CIDR_MATCH_TRUE,
+				     (VSTRING *) 0) != 0)
+		    msg_panic("match_list_index: bad pattern: %s", pat);
+		myfree(saved_pat);
+		net->index = n;
+		if (seg->net_trie == 0)
+		    seg->net_trie = cidr_trie_create();
+		cidr_trie_add(seg->net_trie, &net->info);
+		net++;
+	    }
+	}
+    }
+}
+
+/* match_list_compile - group patterns into segments */
+
+static MATCH_LIST_SEG *match_list_compile(MATCH_LIST *list)
+{
+    MATCH_LIST_SEG *segments = 0;
+    MATCH_LIST_SEG **link = &segments;
+    MATCH_LIST_SEG *seg = 0;
+    char   *pat;
+    int     funcs = 0;
+    int     indexable;
+    int     match;
+    int     i;
+    int     n;
+
+    /*
+     * Don't second-guess match functions that we don't know.
+     */
+    for (i = 0; i < list->match_count; i++) {
+	if (list->match_func[i] == match_string)
+	    funcs |= MATCH_HAS_STRING;
+	else if (list->match_func[i] == match_hostname)
+	    funcs |= MATCH_HAS_HOSTNAME;
+	else if (list->match_func[i] == match_hostaddr)
+	    funcs |= MATCH_HAS_HOSTADDR;
+	else
+	    return (0);
+    }
+    for (n = 0; n < list->patterns->argc; n++) {
+	pat = match_list_pattern(list->patterns->argv[n], &match);
+	indexable = match_list_indexable(pat, funcs);
+	if (seg == 0 || seg->indexed != indexable) {
+	    seg = (MATCH_LIST_SEG *) mymalloc(sizeof(*seg));
+	    seg->first = n;
+	    seg->indexed = indexable;
+	    seg->names = seg->domains = seg->addrs = 0;
+	    seg->nets = 0;
+	    seg->net_trie = 0;
+	    seg->next = 0;
+	    *link = seg;
+	    link = &seg->next;
+	}
+	seg->stop = n + 1;
+    }
+    for (seg = segments; seg != 0; seg = seg->next)
+	if (seg->indexed)
+	    match_list_index(list, seg, funcs);
+    return (segments);
+}
+
+/* match_list_free_segments - destroy compiled pattern list */
+
+static void match_list_free_segments(MATCH_LIST_SEG *segments)
+{
+    MATCH_LIST_SEG *seg;
+
+    while ((seg = segments) != 0) {
+	segments = seg->next;
+	if (seg->names)
+	    htable_free(seg->names, (void (*) (void *)) 0);
+	if (seg->domains)
+	    htable_free(seg->domains, (void (*) (void *)) 0);
+	if (seg->addrs)
+	    htable_free(seg->addrs, (void (*) (void *)) 0);
+	if (seg->net_trie)
+	    cidr_trie_free(seg->net_trie);
+	if (seg->nets)
+	    myfree((void *) seg->nets);
+	myfree((void *) seg);
+    }
+}
+
 /* match_list_init - initialize pattern list */
 
 MATCH_LIST *match_list_init(const char *pname, int flags,
@@ -227,16 +456,85 @@ MATCH_LIST *match_list_init(const char *pname, int flags,
 				      DO_MATCH);
     argv_terminate(list->patterns);
     myfree(saved_patterns);
+    list->segments = match_list_compile(list);
     return (list);
 }
 
+/* match_list_linear - match strings against patterns, one at a time */
+
+static int match_list_linear(MATCH_LIST *list, char **cpp, char **stop,
+			             int *result)
+{
+    char   *pat;
+    int     match;
+    int     i;
+
+    for (/* void */ ; cpp < stop; cpp++) {
+	pat = match_list_pattern(*cpp, &match);
+	for (i = 0; i < list->match_count; i++) {
+	    casefold(list->fold_buf, list->match_args[i]);
+	    if (list->match_func[i] (list, STR(list->fold_buf), pat)) {
+		*result = match;
+		return (1);
+	    } else if (list->error != 0) {
+		*result = 0;
+		return (1);
+	    }
+	}
+    }
+    return (0);
+}
+
+/* match_list_indexed - match strings against indexed segment */
+
+static int match_list_indexed(MATCH_LIST *list, MATCH_LIST_SEG *seg)
+{
+    unsigned char addr_bytes[CIDR_MATCH_ABYTES];
+    int     addr_family;
+    CIDR_MATCH *info;
+    const char *str;
+    const char *cp;
+    int     best = seg->stop;
+    int     i;
+
+    /*
+     * Find the first pattern in the segment that any match function would
+     * accept. See match_ops.c for the definition of a match.
+     */
+    for (i = 0; i < list->match_count; i++) {
+	str = casefold(list->fold_buf, list->match_args[i]);
+	if (list->match_func[i] == match_string) {
+	    match_list_find(seg->names, str, &best);
+	} else if (list->match_func[i] == match_hostname) {
+	    match_list_find(seg->names, str, &best);
+	    for (cp = str; (cp = strchr(cp, '.')) != 0; cp++) {
+		if (list->flags & MATCH_FLAG_PARENT)
+		    match_list_find(seg->names, cp + 1, &best);
+		else if (cp > str)
+		    match_list_find(seg->domains, cp, &best);
+	    }
+	} else if (list->match_func[i] == match_hostaddr) {
+	    if (str[strspn(str, V6_ADDR_STRING_CHARS)] != 0)
+		continue;
+	    match_list_find(seg->addrs, str, &best);
+	    if (seg->net_trie != 0
+		&& (addr_family = cidr_match_addr(str, addr_bytes)) != 0
+		&& (info = cidr_trie_find(seg->net_trie, addr_family,
+					  addr_bytes)) != 0
+		&& ((MATCH_NET *) info)->index < best)
+		best = ((MATCH_NET *) info)->index;
+	}
+    }
+    return (best < seg->stop ? best : -1);
+}
+
 /* match_list_match - match strings against pattern list */
 
 int     match_list_match(MATCH_LIST *list,...)
 {
     const char *myname = "match_list_match";
-    char  **cpp;
-    char   *pat;
+    char  **argv = list->patterns->argv;
+    MATCH_LIST_SEG *seg;
     int     match;
     int     i;
     va_list ap;
@@ -250,15 +548,20 @@ int     match_list_match(MATCH_LIST *list,...)
     va_end(ap);
 
     list->error = 0;
-    for (cpp = list->patterns->argv; (pat = *cpp) != 0; cpp++) {
-	for (match = 1; *pat == '!'; pat++)
-	    match = !match;
-	for (i = 0; i < list->match_count; i++) {
-	    casefold(list->fold_buf, list->match_args[i]);
-	    if (list->match_func[i] (list, STR(list->fold_buf), pat))
+    if (list->segments == 0 || msg_verbose) {
+	if (match_list_linear(list, argv, argv + list->patterns->argc, &match))
+	    return (match);
+    } else {
+	for (seg = list->segments; seg != 0; seg = seg->next) {
+	    if (seg->indexed) {
+		if ((i = match_list_indexed(list, seg)) >= 0) {
+		    (void) match_list_pattern(argv[i], &match);
+		    return (match);
+		}
+	    } else if (match_list_linear(list, argv + seg->first,
+					 argv + seg->stop, &match)) {
 		return (match);
-	    else if (list->error != 0)
-		return (0);
+	    }
 	}
     }
     if (msg_verbose)
@@ -273,9 +576,97 @@ void    match_list_free(MATCH_LIST *list)
 {
     /* XXX Should decrement map refcounts. */
     myfree(list->pname);
+    if (list->segments)
+	match_list_free_segments(list->segments);
     argv_free(list->patterns);
     myfree((void *) list->match_func);
     myfree((void *) list->match_args);
     vstring_free(list->fold_buf);
     myfree((void *) list);
 }
+
+#ifdef TEST
+
+ /*
+  * Test program. Each input line is one of:
+  * 
+  * parent on|off
+  * 
+  * list patterns...
+  * 
+  * match hostname address
+  * 
+  * The program reports the result for the most recent host name and address
+  * pattern list, and complains when trying the patterns one at a time gives
+  * a different result.
+  */
+#include <stdlib.h>
+#include <msg_vstream.h>
+
+static const char *test_match(MATCH_LIST *list, const char *name,
+			              const char *addr)
+{
+    return (match_list_match(list, name, addr) ? "YES" :
+	    list->error == 0 ? "NO" : "ERROR");
+}
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    MATCH_LIST *list = 0;
+    MATCH_LIST_SEG *segments;
+    int     flags = MATCH_FLAG_RETURN;
+    const char *compiled;
+    const char *linear;
+    char   *cp;
+    char   *cmd;
+    char   *name;
+    char   *addr;
+    int     errors = 0;
+
+    msg_vstream_init(argv[0], VSTREAM_OUT);
+    dict_allow_surrogate = 1;
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	if (*STR(buf) == 0 || *STR(buf) == '#')
+	    continue;
+	vstream_printf("> %s\n", STR(buf));
+	cp = STR(buf);
+	if ((cmd = mystrtok(&cp, CHARS_SPACE)) == 0)
+	    continue;
+	if (strcmp(cmd, "parent") == 0 && (cmd = mystrtok(&cp, CHARS_SPACE))) {
+	    if (strcmp(cmd, "on") == 0)
+		flags |= MATCH_FLAG_PARENT;
+	    else
+		flags &= ~MATCH_FLAG_PARENT;
+	} else if (strcmp(cmd, "list") == 0) {
+	    if (list)
+		match_list_free(list);
+	    list = match_list_init("test", flags, cp, 2,
+				   match_hostname, match_hostaddr);
+	} else if (strcmp(cmd, "match") == 0 && list != 0
+		   && (name = mystrtok(&cp, CHARS_SPACE)) != 0
+		   && (addr = mystrtok(&cp, CHARS_SPACE)) != 0) {
+	    compiled = test_match(list, name, addr);
+	    segments = list->segments;
+	    list->segments = 0;
+	    linear = test_match(list, name, addr);
+	    list->segments = segments;
+	    vstream_printf("%s/%s: %s\n", name, addr, compiled);
+	    if (strcmp(compiled, linear) != 0) {
+		vstream_printf("%s/%s: one at a time: %s\n", name, addr, linear);
+		errors++;
+	    }
+	} else {
+	    vstream_printf("usage: parent on|off | list patterns... "
+			   "| match hostname address\n");
+	}
+	vstream_fflush(VSTREAM_OUT);
+    }
+    if (list)
+	match_list_free(list);
+    vstring_free(buf);
+    exit(errors != 0);
+}
+
+#endif
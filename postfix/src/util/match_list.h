@@ -33,6 +33,7 @@ struct MATCH_LIST {
     const char **match_args;		/* match arguments */
     VSTRING *fold_buf;			/* case-folded pattern string */
     int     error;			/* last operation */
+    struct MATCH_LIST_SEG *segments;	/* compiled patterns */
 };
 
 #define MATCH_FLAG_NONE		0
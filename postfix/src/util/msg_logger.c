@@ -14,6 +14,8 @@
 /*
 /*	void	msg_logger_control(
 /*	int	key,...)
+/*
+/*	void	msg_logger_flush(void)
 /* DESCRIPTION
 /*	This module implements support to report msg(3) diagnostics
 /*	through a logger daemon, with an optional fallback mechanism.
@@ -66,11 +68,35 @@
 /*	Close the logging socket if it was already open, and open
 /*	the logging socket now, if permitted by current settings.
 /*	Otherwise, the open is delayed until a logging request.
+/* .IP CA_MSG_LOGGER_CTL_BATCH_SIZE(ssize_t)
+/*	Send records to the logging socket in batches of up to the
+/*	specified number of bytes (limited to MSG_LOGGER_BATCH_LIMIT),
+/*	one newline-separated batch per datagram. Specify zero to
+/*	send each record immediately (the default). The batch is
+/*	sent when it is full, when a record with severity "warning"
+/*	or worse is logged, when a record is logged more than a
+/*	second after the first record in the batch, when
+/*	msg_logger_flush() is called, and when the process terminates
+/*	with exit(3). This setting is ignored in a child process
+/*	that is created with fork(2), so that records are not sent
+/*	twice, and so that records are not lost when the child
+/*	executes a program or terminates with _exit(2).
+/* .PP
+/*	msg_logger_flush() sends any records that are batched. An
+/*	application should call this function before it waits for
+/*	an unbounded amount of time.
+/*
+/*	When records cannot be sent to the logging socket, they are
+/*	counted, and the number is reported with the next record
+/*	that can be sent.
 /* SEE ALSO
 /*	msg(3)  diagnostics module
 /* BUGS
 /*	Output records are truncated to ~2000 characters, because
 /*	unlimited logging is a liability.
+/*
+/*	Batched records are lost when a process is terminated by
+/*	a signal.
 /* LICENSE
 /* .ad
 /* .fi
@@ -87,6 +113,7 @@
   */
 #include <sys_defs.h>
 #include <sys/socket.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -124,6 +151,19 @@ static int msg_logger_enable = 0;
 
 static VSTRING *msg_logger_buf;
 static int msg_logger_sock = MSG_LOGGER_SOCK_NONE;
+static unsigned long msg_logger_lost;	/* records not sent */
+
+ /*
+  * Batching state. The batch belongs to the process that enabled batching;
+  * a child process discards its copy and sends records immediately.
+  */
+static VSTRING *msg_logger_batch;
+static ssize_t msg_logger_batch_size;	/* 0 means don't batch */
+static int msg_logger_batch_count;	/* records in batch */
+static time_t msg_logger_batch_start;	/* time of first record */
+static pid_t msg_logger_batch_pid;	/* batch owner */
+
+#define MSG_LOGGER_BATCH_DELAY	1	/* seconds */
 
  /*
   * Safety limit.
@@ -157,11 +197,11 @@ static void msg_logger_disconnect(void)
     }
 }
 
-/* msg_logger_print - log info to service or file */
+/* msg_logger_format - format log record */
 
-static void msg_logger_print(int level, const char *text)
+static void msg_logger_format(VSTRING *buf, time_t now, pid_t pid,
+			              int level, const char *text)
 {
-    time_t  now;
     struct tm *lt;
     ssize_t len;
 
@@ -175,13 +215,6 @@ static void msg_logger_print(int level, const char *text)
 	"info", "warning", "error", "fatal", "panic",
     };
 
-    /*
-     * This test is simple enough that we don't bother with unregistering the
-     * msg_logger_print() function.
-     */
-    if (msg_logger_enable == 0)
-	return;
-
     /*
      * Note: there is code in postlogd(8) that attempts to strip off
      * information that is prepended here. If the formatting below is
@@ -191,20 +224,17 @@ static void msg_logger_print(int level, const char *text)
     /*
      * Format the time stamp.
      */
-    if (time(&now) < 0)
-	msg_fatal("no time: %m");
     lt = localtime(&now);
-    VSTRING_RESET(msg_logger_buf);
-    if ((len = strftime(vstring_str(msg_logger_buf),
-			vstring_avail(msg_logger_buf),
+    VSTRING_RESET(buf);
+    if ((len = strftime(vstring_str(buf), vstring_avail(buf),
 			"%b %d %H:%M:%S ", lt)) == 0)
 	msg_fatal("strftime: %m");
-    vstring_set_payload_size(msg_logger_buf, len);
+    vstring_set_payload_size(buf, len);
 
     /*
      * Format the host name (first name label only).
      */
-    vstring_sprintf_append(msg_logger_buf, "%.*s ",
+    vstring_sprintf_append(buf, "%.*s ",
 			   (int) strcspn(msg_logger_hostname, "."),
 			   msg_logger_hostname);
 
@@ -215,14 +245,24 @@ static void msg_logger_print(int level, const char *text)
 	msg_panic("msg_logger_print: invalid severity level: %d", level);
 
     if (level == MSG_INFO) {
-	vstring_sprintf_append(msg_logger_buf, "%s[%ld]: %.*s",
-			       msg_logger_progname, (long) getpid(),
+	vstring_sprintf_append(buf, "%s[%ld]: %.*s",
+			       msg_logger_progname, (long) pid,
 			       (int) MSG_LOGGER_RECLEN, text);
     } else {
-	vstring_sprintf_append(msg_logger_buf, "%s[%ld]: %s: %.*s",
-			       msg_logger_progname, (long) getpid(),
+	vstring_sprintf_append(buf, "%s[%ld]: %s: %.*s",
+			       msg_logger_progname, (long) pid,
 		       severity_name[level], (int) MSG_LOGGER_RECLEN, text);
     }
+}
+
+/* msg_logger_send - send one record or one batch */
+
+static void msg_logger_send(const char *buf, ssize_t len, int count)
+{
+    static VSTRING *lost_text;
+    static VSTRING *lost_buf;
+    const char *cp;
+    const char *next;
 
     /*
      * Connect to logging service, or fall back to direct log. Many systems
@@ -232,9 +272,121 @@ static void msg_logger_print(int level, const char *text)
     if (MSG_LOGGER_NEED_SOCKET())
 	msg_logger_connect();
     if (msg_logger_sock != MSG_LOGGER_SOCK_NONE) {
-	send(msg_logger_sock, STR(msg_logger_buf), LEN(msg_logger_buf), 0);
+
+	/*
+	 * Report records that could not be sent earlier. The socket is
+	 * blocking, so that a slow logger service slows us down, instead of
+	 * making us lose records; records are lost only when the service is
+	 * unavailable.
+	 */
+	if (msg_logger_lost > 0) {
+	    if (lost_buf == 0) {
+		lost_text = vstring_alloc(100);
+		lost_buf = vstring_alloc(100);
+	    }
+	    vstring_sprintf(lost_text, "%lu log record%s could not be sent "
+			    "to %s", msg_logger_lost,
+			    msg_logger_lost > 1 ? "s" : "",
+			    msg_logger_unix_path);
+	    msg_logger_format(lost_buf, time((time_t *) 0), getpid(),
+			      MSG_WARN, STR(lost_text));
+	    if (send(msg_logger_sock, STR(lost_buf), LEN(lost_buf), 0) >= 0)
+		msg_logger_lost = 0;
+	}
+	if (send(msg_logger_sock, buf, len, 0) >= 0)
+	    return;
+
+	/*
+	 * The batch is too large for this system. Send its records one at a
+	 * time, and stop batching.
+	 */
+	if (errno == EMSGSIZE && count > 1) {
+	    msg_logger_batch_size = 0;
+	    for (cp = buf; count > 0; cp = next + 1, count--) {
+		if ((next = memchr(cp, '\n', buf + len - cp)) == 0)
+		    next = buf + len;
+		if (send(msg_logger_sock, cp, next - cp, 0) < 0)
+		    msg_logger_lost += 1;
+	    }
+	    return;
+	}
+	msg_logger_lost += count;
     } else if (msg_logger_fallback_fn) {
-	msg_logger_fallback_fn(STR(msg_logger_buf));
+	msg_logger_fallback_fn(buf);
+    }
+}
+
+/* msg_logger_flush - send batched records */
+
+void    msg_logger_flush(void)
+{
+    static int flushing;
+
+    /*
+     * Guard against recursive calls, for example when the fallback function
+     * waits until it can write.
+     */
+    if (msg_logger_batch_count > 0 && flushing == 0) {
+	flushing = 1;
+	if (msg_logger_batch_pid == getpid())
+	    msg_logger_send(STR(msg_logger_batch), LEN(msg_logger_batch),
+			    msg_logger_batch_count);
+	VSTRING_RESET(msg_logger_batch);
+	VSTRING_TERMINATE(msg_logger_batch);
+	msg_logger_batch_count = 0;
+	flushing = 0;
+    }
+}
+
+/* msg_logger_print - log info to service or file */
+
+static void msg_logger_print(int level, const char *text)
+{
+    time_t  now;
+    pid_t   pid;
+
+    /*
+     * This test is simple enough that we don't bother with unregistering the
+     * msg_logger_print() function.
+     */
+    if (msg_logger_enable == 0)
+	return;
+
+    if (time(&now) < 0)
+	msg_fatal("no time: %m");
+    pid = getpid();
+    msg_logger_format(msg_logger_buf, now, pid, level, text);
+    if (MSG_LOGGER_NEED_SOCKET())
+	msg_logger_connect();
+
+    /*
+     * Batch records when requested, and when we are not a child process
+     * that inherited its parent's batch.
+     */
+    if (msg_logger_batch_size > 0 && msg_logger_batch_pid != pid) {
+	msg_logger_flush();
+	msg_logger_batch_size = 0;
+    }
+    if (msg_logger_batch_size > 0 && msg_logger_sock != MSG_LOGGER_SOCK_NONE) {
+	if (msg_logger_batch_count > 0
+	    && LEN(msg_logger_batch) + 1 + LEN(msg_logger_buf)
+	    > msg_logger_batch_size)
+	    msg_logger_flush();
+	if (msg_logger_batch_count++ > 0) {
+	    VSTRING_ADDCH(msg_logger_batch, '\n');
+	} else {
+	    msg_logger_batch_start = now;
+	}
+	vstring_memcat(msg_logger_batch, STR(msg_logger_buf),
+		       LEN(msg_logger_buf));
+	VSTRING_TERMINATE(msg_logger_batch);
+	if (level != MSG_INFO
+	    || now - msg_logger_batch_start >= MSG_LOGGER_BATCH_DELAY
+	    || LEN(msg_logger_batch) >= msg_logger_batch_size)
+	    msg_logger_flush();
+    } else {
+	msg_logger_flush();
+	msg_logger_send(STR(msg_logger_buf), LEN(msg_logger_buf), 1);
     }
 }
 
@@ -299,6 +451,7 @@ void    msg_logger_control(int name,...)
 {
     const char *myname = "msg_logger_control";
     va_list ap;
+    ssize_t batch_size;
 
     /*
      * Overrides remain in effect until the next msg_logger_init() or
@@ -307,6 +460,7 @@ void    msg_logger_control(int name,...)
     for (va_start(ap, name); name != MSG_LOGGER_CTL_END; name = va_arg(ap, int)) {
 	switch (name) {
 	case MSG_LOGGER_CTL_FALLBACK_ONLY:
+	    msg_logger_flush();
 	    msg_logger_fallback_only_override = 1;
 	    msg_logger_disconnect();
 	    break;
@@ -314,13 +468,29 @@ void    msg_logger_control(int name,...)
 	    msg_logger_fallback_fn = va_arg(ap, MSG_LOGGER_FALLBACK_FN);
 	    break;
 	case MSG_LOGGER_CTL_DISABLE:
+	    msg_logger_flush();
 	    msg_logger_enable = 0;
 	    break;
 	case MSG_LOGGER_CTL_CONNECT_NOW:
+	    msg_logger_flush();
 	    msg_logger_disconnect();
 	    if (MSG_LOGGER_NEED_SOCKET())
 		msg_logger_connect();
 	    break;
+	case MSG_LOGGER_CTL_BATCH_SIZE:
+	    batch_size = va_arg(ap, ssize_t);
+	    if (batch_size < 0)
+		msg_panic("%s: bad batch size %ld", myname, (long) batch_size);
+	    if (batch_size > MSG_LOGGER_BATCH_LIMIT)
+		batch_size = MSG_LOGGER_BATCH_LIMIT;
+	    msg_logger_flush();
+	    msg_logger_batch_size = batch_size;
+	    msg_logger_batch_pid = getpid();
+	    if (batch_size > 0 && msg_logger_batch == 0) {
+		msg_logger_batch = vstring_alloc(batch_size);
+		atexit(msg_logger_flush);
+	    }
+	    break;
 	default:
 	    msg_panic("%s: bad name %d", myname, name);
 	}
@@ -333,13 +503,13 @@ void    msg_logger_control(int name,...)
  /*
   * Proof-of-concept program to test the msg_logger module.
   * 
-  * Usage: msg_logger hostname unix_path fallback_path text...
+  * Usage: msg_logger [-b batch_size] hostname unix_path fallback_path text...
   */
 static char *fallback_path;
 
 static void fallback(const char *msg)
 {
-    if (logwriter_one_shot(fallback_path, msg) != 0)
+    if (logwriter_one_shot(fallback_path, msg, strlen(msg)) != 0)
 	msg_fatal("unable to fall back to directly write %s: %m",
 		  fallback_path);
 }
@@ -347,10 +517,28 @@ static void fallback(const char *msg)
 int     main(int argc, char **argv)
 {
     VSTRING *vp = vstring_alloc(256);
-
+    char   *progname = argv[0];
+    ssize_t batch_size = 0;
+    int     ch;
+
+    while ((ch = GETOPT(argc, argv, "b:")) > 0) {
+	switch (ch) {
+	case 'b':
+	    batch_size = atoi(optarg);
+	    break;
+	default:
+	    msg_fatal("usage: %s [-b batch_size] host path fallback_path "
+		      "text to log", argv[0]);
+	}
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
     if (argc < 4)
-	msg_fatal("usage: %s host port path text to log", argv[0]);
-    msg_logger_init(argv[0], argv[1], argv[2], fallback);
+	msg_fatal("usage: %s [-b batch_size] host path fallback_path "
+		  "text to log", argv[0]);
+    msg_logger_init(progname, argv[1], argv[2], fallback);
+    msg_logger_control(CA_MSG_LOGGER_CTL_BATCH_SIZE(batch_size),
+		       CA_MSG_LOGGER_CTL_END);
     fallback_path = argv[3];
     argc -= 3;
     argv += 3;
@@ -359,6 +547,8 @@ int     main(int argc, char **argv)
 	if (argv[1])
 	    vstring_strcat(vp, " ");
     }
+    msg_info("static text");
+    msg_info("dynamic text: >%s<", vstring_str(vp));
     msg_warn("static text");
     msg_warn("dynamic text: >%s<", vstring_str(vp));
     msg_warn("dynamic numeric: >%d<", 42);
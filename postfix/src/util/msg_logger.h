@@ -29,6 +29,9 @@ typedef void (*MSG_LOGGER_FALLBACK_FN) (const char *);
 extern void msg_logger_init(const char *, const char *, const char *,
 			            MSG_LOGGER_FALLBACK_FN);
 extern void msg_logger_control(int,...);
+extern void msg_logger_flush(void);
+
+#define MSG_LOGGER_BATCH_LIMIT	4096	/* pre-3.6 postlogd datagram size */
 
 /* Internal-only API: type-unchecked arguments. */
 #define MSG_LOGGER_CTL_END		0
@@ -36,6 +39,7 @@ extern void msg_logger_control(int,...);
 #define MSG_LOGGER_CTL_FALLBACK_FN	2
 #define MSG_LOGGER_CTL_DISABLE		3
 #define MSG_LOGGER_CTL_CONNECT_NOW	4
+#define MSG_LOGGER_CTL_BATCH_SIZE	5
 
 /* Safer API: type-checked arguments, external use. */
 #define CA_MSG_LOGGER_CTL_END		MSG_LOGGER_CTL_END
@@ -45,8 +49,11 @@ extern void msg_logger_control(int,...);
 		MSG_LOGGER_FALLBACK_FN, (v))
 #define CA_MSG_LOGGER_CTL_DISABLE	MSG_LOGGER_CTL_DISABLE
 #define CA_MSG_LOGGER_CTL_CONNECT_NOW	MSG_LOGGER_CTL_CONNECT_NOW
+#define CA_MSG_LOGGER_CTL_BATCH_SIZE(v) \
+	MSG_LOGGER_CTL_BATCH_SIZE, CHECK_VAL(MSG_LOGGER_CTL, ssize_t, (v))
 
 CHECK_VAL_HELPER_DCL(MSG_LOGGER_CTL, MSG_LOGGER_FALLBACK_FN);
+CHECK_VAL_HELPER_DCL(MSG_LOGGER_CTL, ssize_t);
 
 /* LICENSE
 /* .ad
@@ -26,6 +26,8 @@
 /*	void	*mymemdup(ptr, len)
 /*	const void *ptr;
 /*	ssize_t	len;
+/*
+/*	void	mymalloc_stats()
 /* DESCRIPTION
 /*	This module performs low-level memory management with error
 /*	handling. A call of these functions either succeeds or it does
@@ -57,6 +59,29 @@
 /*	mymemdup() makes a copy of the memory pointed to by \fIptr\fR
 /*	with length \fIlen\fR. The result is NOT null-terminated.
 /*	This routine uses mymalloc().
+/*
+/*	The following features are selected at compile time:
+/* .IP MYMALLOC_POOL
+/*	Allocate small memory blocks from per-size-class free lists,
+/*	which are filled from large slabs. Blocks are recycled but
+/*	never given back to the system. This avoids most malloc()
+/*	and free() calls for the many small, short-lived objects
+/*	that Postfix programs create.
+/* .IP MYMALLOC_STATS
+/*	Keep per-call-site statistics. mymalloc_stats() logs the
+/*	statistics with msg_info(); this also happens when the
+/*	program terminates and the MYMALLOC_STATS environment
+/*	variable is set. When the MYMALLOC_TRACE environment
+/*	variable is set, each process records every allocation,
+/*	reallocation and release in the file
+/*	\fB$MYMALLOC_TRACE.\fIpid\fR, unless the process runs
+/*	with set-uid or set-gid privileges. The "mymalloc" test
+/*	program replays such traces. Daemon processes receive these
+/*	environment variables only when they are listed in the
+/*	import_environment parameter.
+/* .PP
+/*	Both features must be selected for all of the code, for
+/*	example with "make makefiles CCARGS=-DMYMALLOC_POOL".
 /* SEE ALSO
 /*	msg(3) diagnostics interface
 /* DIAGNOSTICS
@@ -86,11 +111,58 @@
 #include <stddef.h>
 #include <string.h>
 
+#ifdef MYMALLOC_STATS
+#include <stdio.h>			/* snprintf() */
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 /* Application-specific. */
 
 #include "msg.h"
+#include "safe.h"
 #include "mymalloc.h"
 
+#undef mymalloc
+#undef myrealloc
+#undef mystrdup
+#undef mystrndup
+#undef mymemdup
+
+ /*
+  * Per-call-site statistics. The site table has a fixed size, and uses no
+  * dynamic memory. Sites that don't fit are counted together.
+  */
+#ifdef MYMALLOC_STATS
+
+typedef struct MYMALLOC_SITE {
+    const char *file;			/* source file */
+    int     line;			/* source line */
+    long    calls;			/* allocation requests */
+    long    bytes;			/* bytes requested */
+    long    live;			/* allocated blocks */
+    long    live_bytes;			/* bytes in allocated blocks */
+    long    peak_bytes;			/* live_bytes high-water mark */
+} MYMALLOC_SITE;
+
+#define MYMALLOC_SITES	4096
+
+static MYMALLOC_SITE mymalloc_sites[MYMALLOC_SITES];
+static MYMALLOC_SITE mymalloc_overflow_site = {"(other)", 0,};
+static int mymalloc_stats_init;
+
+#define SITE_DCL	, const char *file, int line
+#define SITE_ARG	, file, line
+#define SITE_UNKNOWN	, "(unknown)", 0
+
+#else
+
+#define SITE_DCL
+#define SITE_ARG
+#define SITE_UNKNOWN
+
+#endif
+
  /*
   * Structure of an annotated memory block. In order to detect spurious
   * free() calls we prepend a signature to memory given to the application.
@@ -101,6 +173,9 @@
 typedef struct MBLOCK {
     int     signature;			/* set when block is active */
     ssize_t length;			/* user requested length */
+#ifdef MYMALLOC_STATS
+    MYMALLOC_SITE *site;		/* allocation call site */
+#endif
     union {
 	ALIGN_TYPE align;
 	char    payload[1];		/* actually a bunch of bytes */
@@ -129,6 +204,103 @@ typedef struct MBLOCK {
 
 #define SPACE_FOR(len)	(offsetof(MBLOCK, u.payload[0]) + len)
 
+ /*
+  * Optional size-class pool. Blocks up to POOL_MAX bytes (including the
+  * MBLOCK header) are rounded up to a multiple of POOL_GRAIN, and are
+  * carved from POOL_SLAB-byte slabs. A released block goes on the free list
+  * for its size class, and is handed out again by the next request for that
+  * size class. Larger blocks are passed on to malloc() and free().
+  */
+#ifdef MYMALLOC_POOL
+
+typedef struct POOL_FREE {
+    struct POOL_FREE *next;		/* next free block in size class */
+} POOL_FREE;
+
+#define POOL_GRAIN	16
+#define POOL_MAX	1024
+#define POOL_SLAB	(64 * 1024)
+#define POOL_CLASSES	(POOL_MAX / POOL_GRAIN)
+#define POOL_CLASS(space) (((space) - 1) / POOL_GRAIN)
+
+static POOL_FREE *pool_free_list[POOL_CLASSES];
+static char *pool_slab;			/* unused part of current slab */
+static size_t pool_slab_left;		/* bytes left in current slab */
+
+/* pool_alloc - allocate from pool or from system */
+
+static void *pool_alloc(size_t space)
+{
+    POOL_FREE *block;
+    size_t  class_size;
+    int     class;
+
+    if (space > POOL_MAX)
+	return (malloc(space));
+    class = POOL_CLASS(space);
+    if ((block = pool_free_list[class]) != 0) {
+	pool_free_list[class] = block->next;
+	return ((void *) block);
+    }
+    class_size = (class + 1) * POOL_GRAIN;
+    if (pool_slab_left < class_size) {
+	if ((pool_slab = (char *) malloc(POOL_SLAB)) == 0)
+	    return (0);
+	pool_slab_left = POOL_SLAB;
+    }
+    block = (POOL_FREE *) pool_slab;
+    pool_slab += class_size;
+    pool_slab_left -= class_size;
+    return ((void *) block);
+}
+
+/* pool_release - give block back to pool or to system */
+
+static void pool_release(void *ptr, size_t space)
+{
+    POOL_FREE *block;
+    int     class;
+
+    if (space > POOL_MAX) {
+	free(ptr);
+    } else {
+	class = POOL_CLASS(space);
+	block = (POOL_FREE *) ptr;
+	block->next = pool_free_list[class];
+	pool_free_list[class] = block;
+    }
+}
+
+/* pool_realloc - resize block */
+
+static void *pool_realloc(void *ptr, size_t old_space, size_t new_space)
+{
+    void   *new_ptr;
+
+    if (old_space > POOL_MAX && new_space > POOL_MAX)
+	return (realloc(ptr, new_space));
+    if (old_space <= POOL_MAX && new_space <= POOL_MAX
+	&& POOL_CLASS(old_space) == POOL_CLASS(new_space))
+	return (ptr);
+    if ((new_ptr = pool_alloc(new_space)) == 0)
+	return (0);
+    memcpy(new_ptr, ptr, old_space < new_space ? old_space : new_space);
+    pool_release(ptr, old_space);
+    return (new_ptr);
+}
+
+#define SYS_ALLOC(space)		pool_alloc(space)
+#define SYS_REALLOC(ptr, old, space)	pool_realloc((ptr), (old), (space))
+#define SYS_FREE(ptr, space)		pool_release((ptr), (space))
+
+#else
+
+#define SYS_ALLOC(space)		malloc(space)
+#define SYS_REALLOC(ptr, old, space)	realloc((ptr), (space))
+#define SYS_FREE(ptr, space)		free(ptr)
+
+#endif
+
  /*
   * Optimization for short strings. We share one copy with multiple callers.
   * This differs from normal heap memory in two ways, because the memory is
@@ -145,9 +317,173 @@ static const char empty_string[] = "";
 
 #endif
 
-/* mymalloc - allocate memory or bust */
+#ifdef MYMALLOC_STATS
 
-void   *mymalloc(ssize_t len)
+ /*
+  * Allocation trace. We format records into a static buffer, and write the
+  * buffer with write(2), so that tracing does not allocate memory. After
+  * fork(), the child discards the parent's buffer and opens its own file.
+  */
+static int mymalloc_trace_fd = -1;
+static pid_t mymalloc_trace_pid;
+static char mymalloc_trace_buf[8192];
+static size_t mymalloc_trace_len;
+
+/* mymalloc_trace_flush - write trace buffer */
+
+static void mymalloc_trace_flush(void)
+{
+    if (mymalloc_trace_fd >= 0 && mymalloc_trace_len > 0
+	&& mymalloc_trace_pid == getpid())
+	(void) write(mymalloc_trace_fd, mymalloc_trace_buf,
+		     mymalloc_trace_len);
+    mymalloc_trace_len = 0;
+}
+
+/* mymalloc_trace - append trace record */
+
+static void mymalloc_trace(int op, void *old_ptr, void *ptr, ssize_t len)
+{
+    static const char *trace_name;
+    char    buf[100];
+    int     n;
+
+    if (trace_name == 0 && (trace_name = safe_getenv("MYMALLOC_TRACE")) == 0)
+	trace_name = "";
+    if (*trace_name == 0)
+	return;
+    if (mymalloc_trace_pid != getpid()) {
+	if (mymalloc_trace_fd >= 0)
+	    (void) close(mymalloc_trace_fd);
+	mymalloc_trace_len = 0;
+	mymalloc_trace_pid = getpid();
+	(void) snprintf(buf, sizeof(buf), "%s.%ld", trace_name,
+			(long) mymalloc_trace_pid);
+	mymalloc_trace_fd = open(buf, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (mymalloc_trace_fd < 0)
+	    return;
+	n = snprintf(buf, sizeof(buf), "p %ld\n", (long) mymalloc_trace_pid);
+	memcpy(mymalloc_trace_buf, buf, n);
+	mymalloc_trace_len = n;
+    }
+    if (mymalloc_trace_fd < 0)
+	return;
+    switch (op) {
+    case 'm':
+	n = snprintf(buf, sizeof(buf), "m %lx %ld\n",
+		     (unsigned long) ptr, (long) len);
+	break;
+    case 'r':
+	n = snprintf(buf, sizeof(buf), "r %lx %lx %ld\n",
+		     (unsigned long) old_ptr, (unsigned long) ptr, (long) len);
+	break;
+    default:
+	n = snprintf(buf, sizeof(buf), "f %lx\n", (unsigned long) ptr);
+	break;
+    }
+    if (mymalloc_trace_len + n > sizeof(mymalloc_trace_buf))
+	mymalloc_trace_flush();
+    memcpy(mymalloc_trace_buf + mymalloc_trace_len, buf, n);
+    mymalloc_trace_len += n;
+}
+
+/* mymalloc_site - find or create call-site statistics */
+
+static MYMALLOC_SITE *mymalloc_site(const char *file, int line)
+{
+    MYMALLOC_SITE *site;
+    unsigned long h;
+    int     n;
+
+    if (mymalloc_stats_init == 0) {
+	mymalloc_stats_init = 1;
+	if (getenv("MYMALLOC_STATS") != 0)
+	    atexit(mymalloc_stats);
+	atexit(mymalloc_trace_flush);
+    }
+    h = ((unsigned long) file >> 3) ^ ((unsigned long) line * 2654435761UL);
+    for (n = 0; n < MYMALLOC_SITES; n++) {
+	site = mymalloc_sites + (h + n) % MYMALLOC_SITES;
+	if (site->file == file && site->line == line)
+	    return (site);
+	if (site->file == 0) {
+	    site->file = file;
+	    site->line = line;
+	    return (site);
+	}
+    }
+    return (&mymalloc_overflow_site);
+}
+
+/* mymalloc_site_add - update call-site statistics */
+
+static void mymalloc_site_add(MYMALLOC_SITE *site, ssize_t len)
+{
+    site->calls += 1;
+    site->bytes += len;
+    site->live += 1;
+    if ((site->live_bytes += len) > site->peak_bytes)
+	site->peak_bytes = site->live_bytes;
+}
+
+/* mymalloc_site_sub - update call-site statistics */
+
+static void mymalloc_site_sub(MYMALLOC_SITE *site, ssize_t len)
+{
+    site->live -= 1;
+    site->live_bytes -= len;
+}
+
+/* mymalloc_site_resize - update call-site statistics */
+
+static void mymalloc_site_resize(MYMALLOC_SITE *site, ssize_t old_len,
+				         ssize_t len)
+{
+    if (len > old_len)
+	site->bytes += len - old_len;
+    if ((site->live_bytes += len - old_len) > site->peak_bytes)
+	site->peak_bytes = site->live_bytes;
+}
+
+/* mymalloc_stats_cmp - sort sites by number of calls */
+
+static int mymalloc_stats_cmp(const void *a, const void *b)
+{
+    long    calls_a = (*(MYMALLOC_SITE **) a)->calls;
+    long    calls_b = (*(MYMALLOC_SITE **) b)->calls;
+
+    return (calls_a < calls_b ? 1 : calls_a > calls_b ? -1 : 0);
+}
+
+/* mymalloc_stats - log call-site statistics */
+
+void    mymalloc_stats(void)
+{
+    MYMALLOC_SITE *list[MYMALLOC_SITES + 1];
+    MYMALLOC_SITE *site;
+    int     count = 0;
+    int     n;
+
+    for (n = 0; n < MYMALLOC_SITES; n++)
+	if (mymalloc_sites[n].calls > 0)
+	    list[count++] = mymalloc_sites + n;
+    if (mymalloc_overflow_site.calls > 0)
+	list[count++] = &mymalloc_overflow_site;
+    qsort((void *) list, count, sizeof(list[0]), mymalloc_stats_cmp);
+    for (n = 0; n < count; n++) {
+	site = list[n];
+	msg_info("mymalloc: %s:%d calls=%ld bytes=%ld live=%ld "
+		 "live_bytes=%ld peak_bytes=%ld", site->file, site->line,
+		 site->calls, site->bytes, site->live, site->live_bytes,
+		 site->peak_bytes);
+    }
+}
+
+#endif
+
+/* mymalloc_impl - allocate memory or bust */
+
+static void *mymalloc_impl(ssize_t len SITE_DCL)
 {
     void   *ptr;
     MBLOCK *real_ptr;
@@ -162,24 +498,36 @@ void   *mymalloc(ssize_t len)
 #ifdef MYMALLOC_FUZZ
     len += MYMALLOC_FUZZ;
 #endif
-    if ((real_ptr = (MBLOCK *) malloc(SPACE_FOR(len))) == 0)
+    if ((real_ptr = (MBLOCK *) SYS_ALLOC(SPACE_FOR(len))) == 0)
 	msg_fatal("mymalloc: insufficient memory for %ld bytes: %m",
 		  (long) len);
     CHECK_OUT_PTR(ptr, real_ptr, len);
     memset(ptr, FILLER, len);
+#ifdef MYMALLOC_STATS
+    real_ptr->site = mymalloc_site(file, line);
+    mymalloc_site_add(real_ptr->site, len);
+    mymalloc_trace('m', (void *) 0, ptr, len);
+#endif
     return (ptr);
 }
 
-/* myrealloc - reallocate memory or bust */
+/* mymalloc - allocate memory or bust */
 
-void   *myrealloc(void *ptr, ssize_t len)
+void   *mymalloc(ssize_t len)
+{
+    return (mymalloc_impl(len SITE_UNKNOWN));
+}
+
+/* myrealloc_impl - reallocate memory or bust */
+
+static void *myrealloc_impl(void *ptr, ssize_t len SITE_DCL)
 {
     MBLOCK *real_ptr;
     ssize_t old_len;
 
 #ifndef NO_SHARED_EMPTY_STRINGS
     if (ptr == empty_string)
-	return (mymalloc(len));
+	return (mymalloc_impl(len SITE_ARG));
 #endif
 
     /*
@@ -193,15 +541,29 @@ void   *myrealloc(void *ptr, ssize_t len)
     len += MYMALLOC_FUZZ;
 #endif
     CHECK_IN_PTR(ptr, real_ptr, old_len, "myrealloc");
-    if ((real_ptr = (MBLOCK *) realloc((void *) real_ptr, SPACE_FOR(len))) == 0)
+#ifdef MYMALLOC_STATS
+    mymalloc_site_resize(real_ptr->site, old_len, len);
+#endif
+    if ((real_ptr = (MBLOCK *) SYS_REALLOC((void *) real_ptr,
+				    SPACE_FOR(old_len), SPACE_FOR(len))) == 0)
 	msg_fatal("myrealloc: insufficient memory for %ld bytes: %m",
 		  (long) len);
+#ifdef MYMALLOC_STATS
+    mymalloc_trace('r', ptr, real_ptr->u.payload, len);
+#endif
     CHECK_OUT_PTR(ptr, real_ptr, len);
     if (len > old_len)
 	memset(ptr + old_len, FILLER, len - old_len);
     return (ptr);
 }
 
+/* myrealloc - reallocate memory or bust */
+
+void   *myrealloc(void *ptr, ssize_t len)
+{
+    return (myrealloc_impl(ptr, len SITE_UNKNOWN));
+}
+
 /* myfree - release memory */
 
 void    myfree(void *ptr)
@@ -213,16 +575,20 @@ void    myfree(void *ptr)
     if (ptr != empty_string) {
 #endif
 	CHECK_IN_PTR(ptr, real_ptr, len, "myfree");
+#ifdef MYMALLOC_STATS
+	mymalloc_site_sub(real_ptr->site, len);
+	mymalloc_trace('f', (void *) 0, ptr, 0);
+#endif
 	memset((void *) real_ptr, FILLER, SPACE_FOR(len));
-	free((void *) real_ptr);
+	SYS_FREE((void *) real_ptr, SPACE_FOR(len));
 #ifndef NO_SHARED_EMPTY_STRINGS
     }
 #endif
 }
 
-/* mystrdup - save string to heap */
+/* mystrdup_impl - save string to heap */
 
-char   *mystrdup(const char *str)
+static char *mystrdup_impl(const char *str SITE_DCL)
 {
     size_t  len;
 
@@ -234,12 +600,19 @@ char   *mystrdup(const char *str)
 #endif
     if ((len = strlen(str) + 1) > SSIZE_T_MAX)
 	msg_panic("mystrdup: string length >= SSIZE_T_MAX");
-    return (memcpy(mymalloc(len), str, len));
+    return (memcpy(mymalloc_impl(len SITE_ARG), str, len));
 }
 
-/* mystrndup - save substring to heap */
+/* mystrdup - save string to heap */
 
-char   *mystrndup(const char *str, ssize_t len)
+char   *mystrdup(const char *str)
+{
+    return (mystrdup_impl(str SITE_UNKNOWN));
+}
+
+/* mystrndup_impl - save substring to heap */
+
+static char *mystrndup_impl(const char *str, ssize_t len SITE_DCL)
 {
     char   *result;
     char   *cp;
@@ -254,16 +627,393 @@ char   *mystrndup(const char *str, ssize_t len)
 #endif
     if ((cp = memchr(str, 0, len)) != 0)
 	len = cp - str;
-    result = memcpy(mymalloc(len + 1), str, len);
+    result = memcpy(mymalloc_impl(len + 1 SITE_ARG), str, len);
     result[len] = 0;
     return (result);
 }
 
-/* mymemdup - copy memory */
+/* mystrndup - save substring to heap */
 
-void   *mymemdup(const void *ptr, ssize_t len)
+char   *mystrndup(const char *str, ssize_t len)
+{
+    return (mystrndup_impl(str, len SITE_UNKNOWN));
+}
+
+/* mymemdup_impl - copy memory */
+
+static void *mymemdup_impl(const void *ptr, ssize_t len SITE_DCL)
 {
     if (ptr == 0)
 	msg_panic("mymemdup: null pointer argument");
-    return (memcpy(mymalloc(len), ptr, len));
+    return (memcpy(mymalloc_impl(len SITE_ARG), ptr, len));
+}
+
+/* mymemdup - copy memory */
+
+void   *mymemdup(const void *ptr, ssize_t len)
+{
+    return (mymemdup_impl(ptr, len SITE_UNKNOWN));
 }
+
+#ifdef MYMALLOC_STATS
+
+ /*
+  * Call-site versions, invoked through the macros in mymalloc.h.
+  */
+void   *mymalloc_at(ssize_t len, const char *file, int line)
+{
+    return (mymalloc_impl(len, file, line));
+}
+
+void   *myrealloc_at(void *ptr, ssize_t len, const char *file, int line)
+{
+    return (myrealloc_impl(ptr, len, file, line));
+}
+
+char   *mystrdup_at(const char *str, const char *file, int line)
+{
+    return (mystrdup_impl(str, file, line));
+}
+
+char   *mystrndup_at(const char *str, ssize_t len, const char *file, int line)
+{
+    return (mystrndup_impl(str, len, file, line));
+}
+
+void   *mymemdup_at(const void *ptr, ssize_t len, const char *file, int line)
+{
+    return (mymemdup_impl(ptr, len, file, line));
+}
+
+#endif
+
+#ifdef TEST
+
+ /*
+  * Test program. Replay allocation traces that were recorded with a
+  * MYMALLOC_STATS build, and report how long that takes. The trace is first
+  * converted into an array of operations on numbered slots, so that the
+  * timed loop does no parsing or pointer lookups. A trace may contain the
+  * records of multiple processes, each starting with a "p pid" line. With
+  * "-s count", replay a synthetic sequence of count operations instead.
+  * With "-v", replay once without timing, and verify that every live block
+  * keeps its content across other allocations, reallocations and releases.
+  */
+#include <stdio.h>
+#include <sys/time.h>
+#include <binhash.h>
+#include <msg_vstream.h>
+
+typedef struct REPLAY_OP {
+    int     op;				/* 'm', 'r' or 'f' */
+    int     slot;			/* block slot number */
+    ssize_t len;			/* requested length */
+} REPLAY_OP;
+
+typedef struct REPLAY {
+    REPLAY_OP *ops;			/* operations */
+    int     count;			/* number of operations */
+    int     size;			/* allocated size */
+    int     slots;			/* number of slots */
+} REPLAY;
+
+/* replay_add - append one operation */
+
+static void replay_add(REPLAY *rp, int op, int slot, ssize_t len)
+{
+    if (rp->count >= rp->size) {
+	rp->size = rp->size ? 2 * rp->size : 1024;
+	rp->ops = (REPLAY_OP *) realloc((void *) rp->ops,
+					rp->size * sizeof(*rp->ops));
+	if (rp->ops == 0)
+	    msg_fatal("out of memory");
+    }
+    rp->ops[rp->count].op = op;
+    rp->ops[rp->count].slot = slot;
+    rp->ops[rp->count].len = len;
+    rp->count += 1;
+}
+
+/* replay_slot - map trace pointer to slot number */
+
+static int replay_slot(REPLAY *rp, BINHASH *live, unsigned long addr,
+		               int create)
+{
+    BINHASH_INFO *ht;
+    int     slot;
+
+    if ((ht = binhash_locate(live, (void *) &addr, sizeof(addr))) != 0) {
+	slot = (int) (long) ht->value;
+	if (create == 0)
+	    binhash_delete(live, (void *) &addr, sizeof(addr),
+			   (void (*) (void *)) 0);
+	return (slot);
+    }
+    if (create == 0)
+	return (-1);
+    slot = rp->slots++;
+    binhash_enter(live, (void *) &addr, sizeof(addr), (void *) (long) slot);
+    return (slot);
+}
+
+/* replay_load - convert trace file into slot operations */
+
+static void replay_load(REPLAY *rp, const char *path)
+{
+    FILE   *fp;
+    BINHASH *live;
+    char    line[200];
+    unsigned long addr;
+    unsigned long new_addr;
+    long    len;
+    int     slot;
+
+    if ((fp = fopen(path, "r")) == 0)
+	msg_fatal("open %s: %m", path);
+    live = binhash_create(1024);
+    while (fgets(line, sizeof(line), fp) != 0) {
+	if (line[0] == 'p') {
+	    binhash_free(live, (void (*) (void *)) 0);
+	    live = binhash_create(1024);
+	} else if (sscanf(line, "m %lx %ld", &addr, &len) == 2) {
+	    replay_add(rp, 'm', replay_slot(rp, live, addr, 1), len);
+	} else if (sscanf(line, "r %lx %lx %ld", &addr, &new_addr, &len) == 3) {
+	    if ((slot = replay_slot(rp, live, addr, 0)) < 0)
+		continue;
+	    replay_add(rp, 'r', slot, len);
+	    binhash_enter(live, (void *) &new_addr, sizeof(new_addr),
+			  (void *) (long) slot);
+	} else if (sscanf(line, "f %lx", &addr) == 1) {
+	    if ((slot = replay_slot(rp, live, addr, 0)) >= 0)
+		replay_add(rp, 'f', slot, 0);
+	} else {
+	    msg_warn("%s: ignoring malformed line: %s", path, line);
+	}
+    }
+    (void) fclose(fp);
+    binhash_free(live, (void (*) (void *)) 0);
+}
+
+/* replay_synth - generate synthetic slot operations */
+
+static void replay_synth(REPLAY *rp, int count)
+{
+    unsigned long seed = 1;
+    ssize_t *live_len;
+    int    *live;
+    int     nlive = 0;
+    int     n;
+    int     pick;
+    int     slot;
+    ssize_t len;
+
+#define SYNTH_MAX_LIVE	1000
+#define SYNTH_RAND()	((seed = seed * 1103515245 + 12345) >> 16)
+
+    /*
+     * Mimic a Postfix process: mostly small strings and structures that are
+     * released soon, some medium-size buffers, a few large buffers, and
+     * strings that grow by doubling. A fixed seed makes the sequence the
+     * same for every run and every allocator.
+     */
+    live = (int *) malloc(SYNTH_MAX_LIVE * sizeof(*live));
+    live_len = (ssize_t *) malloc(SYNTH_MAX_LIVE * sizeof(*live_len));
+    if (live == 0 || live_len == 0)
+	msg_fatal("out of memory");
+    for (n = 0; n < count; n++) {
+	pick = SYNTH_RAND() % 100;
+	if (nlive > 0 && (nlive >= SYNTH_MAX_LIVE || pick < 45)) {
+	    pick = SYNTH_RAND() % nlive;
+	    replay_add(rp, 'f', live[pick], 0);
+	    live[pick] = live[--nlive];
+	    live_len[pick] = live_len[nlive];
+	} else if (nlive > 0 && pick < 55) {
+	    pick = SYNTH_RAND() % nlive;
+	    if (live_len[pick] < 16384)
+		live_len[pick] *= 2;
+	    replay_add(rp, 'r', live[pick], live_len[pick]);
+	} else {
+	    pick = SYNTH_RAND() % 100;
+	    if (pick < 80)
+		len = 1 + SYNTH_RAND() % 64;
+	    else if (pick < 97)
+		len = 65 + SYNTH_RAND() % 960;
+	    else
+		len = 1025 + SYNTH_RAND() % 8192;
+	    slot = rp->slots++;
+	    replay_add(rp, 'm', slot, len);
+	    live[nlive] = slot;
+	    live_len[nlive++] = len;
+	}
+    }
+    free((void *) live);
+    free((void *) live_len);
+}
+
+/* replay_run - replay operations, return elapsed time */
+
+static double replay_run(REPLAY *rp, void **blocks)
+{
+    struct timeval start;
+    struct timeval stop;
+    REPLAY_OP *op;
+    int     n;
+
+    GETTIMEOFDAY(&start);
+    for (op = rp->ops; op < rp->ops + rp->count; op++) {
+	switch (op->op) {
+	case 'm':
+	    blocks[op->slot] = mymalloc(op->len);
+	    break;
+	case 'r':
+	    blocks[op->slot] = myrealloc(blocks[op->slot], op->len);
+	    break;
+	case 'f':
+	    myfree(blocks[op->slot]);
+	    blocks[op->slot] = 0;
+	    break;
+	}
+    }
+    for (n = 0; n < rp->slots; n++) {
+	if (blocks[n] != 0) {
+	    myfree(blocks[n]);
+	    blocks[n] = 0;
+	}
+    }
+    GETTIMEOFDAY(&stop);
+    return (stop.tv_sec - start.tv_sec
+	    + (stop.tv_usec - start.tv_usec) / 1000000.0);
+}
+
+/* replay_fill - fill block with slot-specific pattern */
+
+static void replay_fill(unsigned char *cp, ssize_t from, ssize_t to, int slot)
+{
+    ssize_t i;
+
+    for (i = from; i < to; i++)
+	cp[i] = (unsigned char) (slot + i);
+}
+
+/* replay_check - verify slot-specific pattern */
+
+static int replay_check(unsigned char *cp, ssize_t len, int slot)
+{
+    ssize_t i;
+
+    for (i = 0; i < len; i++)
+	if (cp[i] != (unsigned char) (slot + i))
+	    return (1);
+    return (0);
+}
+
+/* replay_verify - replay operations, verify block content */
+
+static int replay_verify(REPLAY *rp, void **blocks)
+{
+    ssize_t *lens;
+    REPLAY_OP *op;
+    int     errors = 0;
+    int     n;
+
+    if ((lens = (ssize_t *) calloc(rp->slots + 1, sizeof(*lens))) == 0)
+	msg_fatal("out of memory");
+    for (op = rp->ops; op < rp->ops + rp->count; op++) {
+	switch (op->op) {
+	case 'm':
+	    blocks[op->slot] = mymalloc(op->len);
+	    replay_fill(blocks[op->slot], 0, op->len, op->slot);
+	    lens[op->slot] = op->len;
+	    break;
+	case 'r':
+	    errors += replay_check(blocks[op->slot], lens[op->slot], op->slot);
+	    blocks[op->slot] = myrealloc(blocks[op->slot], op->len);
+	    if (op->len < lens[op->slot])
+		lens[op->slot] = op->len;
+	    errors += replay_check(blocks[op->slot], lens[op->slot], op->slot);
+	    replay_fill(blocks[op->slot], lens[op->slot], op->len, op->slot);
+	    lens[op->slot] = op->len;
+	    break;
+	case 'f':
+	    errors += replay_check(blocks[op->slot], lens[op->slot], op->slot);
+	    myfree(blocks[op->slot]);
+	    blocks[op->slot] = 0;
+	    break;
+	}
+    }
+    for (n = 0; n < rp->slots; n++) {
+	if (blocks[n] != 0) {
+	    errors += replay_check(blocks[n], lens[n], n);
+	    myfree(blocks[n]);
+	    blocks[n] = 0;
+	}
+    }
+    free((void *) lens);
+    return (errors);
+}
+
+static NORETURN usage(const char *myname)
+{
+    msg_fatal("usage: %s [-v] [-n rounds] [-s count | tracefile...]", myname);
+}
+
+int     main(int argc, char **argv)
+{
+    REPLAY  replay;
+    void  **blocks;
+    double  elapsed = 0;
+    int     rounds = 10;
+    int     synth = 0;
+    int     verify = 0;
+    int     ch;
+    int     n;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while ((ch = GETOPT(argc, argv, "n:s:v")) > 0) {
+	switch (ch) {
+	case 'n':
+	    if ((rounds = atoi(optarg)) < 1)
+		usage(argv[0]);
+	    break;
+	case 's':
+	    if ((synth = atoi(optarg)) < 1)
+		usage(argv[0]);
+	    break;
+	case 'v':
+	    verify = 1;
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if ((optind >= argc) == (synth == 0))
+	usage(argv[0]);
+    memset((void *) &replay, 0, sizeof(replay));
+    if (synth > 0)
+	replay_synth(&replay, synth);
+    for (n = optind; n < argc; n++)
+	replay_load(&replay, argv[n]);
+    if ((blocks = (void **) calloc(replay.slots + 1, sizeof(*blocks))) == 0)
+	msg_fatal("out of memory");
+    if (verify) {
+	msg_info("%d operations, %d errors",
+		 replay.count, replay_verify(&replay, blocks));
+	free((void *) blocks);
+	free((void *) replay.ops);
+	exit(0);
+    }
+    for (n = 0; n < rounds; n++)
+	elapsed += replay_run(&replay, blocks);
+    msg_info("%s: %d operations x %d rounds: %.3f s",
+#ifdef MYMALLOC_POOL
+	     "pool",
+#else
+	     "malloc",
+#endif
+	     replay.count, rounds, elapsed);
+    free((void *) blocks);
+    free((void *) replay.ops);
+    exit(0);
+}
+
+#endif
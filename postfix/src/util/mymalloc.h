@@ -21,6 +21,21 @@ extern char *mystrdup(const char *);
 extern char *mystrndup(const char *, ssize_t);
 extern void *mymemdup(const void *, ssize_t);
 
+#ifdef MYMALLOC_STATS
+extern void *mymalloc_at(ssize_t, const char *, int);
+extern void *myrealloc_at(void *, ssize_t, const char *, int);
+extern char *mystrdup_at(const char *, const char *, int);
+extern char *mystrndup_at(const char *, ssize_t, const char *, int);
+extern void *mymemdup_at(const void *, ssize_t, const char *, int);
+extern void mymalloc_stats(void);
+
+#define mymalloc(len)		mymalloc_at((len), __FILE__, __LINE__)
+#define myrealloc(ptr, len)	myrealloc_at((ptr), (len), __FILE__, __LINE__)
+#define mystrdup(str)		mystrdup_at((str), __FILE__, __LINE__)
+#define mystrndup(str, len)	mystrndup_at((str), (len), __FILE__, __LINE__)
+#define mymemdup(ptr, len)	mymemdup_at((ptr), (len), __FILE__, __LINE__)
+#endif
+
 /* LICENSE
 /* .ad
 /* .fi
@@ -44,6 +44,7 @@
 /*
 /*	poll_fd() waits until the specified file descriptor becomes
 /*	readable or writable, or until the time limit is reached.
+/*	Before it waits, it sends any batched msg_logger(3) records.
 /*
 /*	Arguments:
 /* .IP fd
@@ -139,6 +140,7 @@ int     poll_fd_bsd(int, int, int, int, int);
 /* Utility library. */
 
 #include <msg.h>
+#include <msg_logger.h>
 #include <iostuff.h>
 
 #ifdef USE_BSD_SELECT
@@ -165,6 +167,12 @@ int     poll_fd_bsd(int fd, int request, int time_limit,
 	fd = temp_fd;
     }
 
+    /*
+     * Don't sit on batched log records while we wait.
+     */
+    if (time_limit != 0)
+	msg_logger_flush();
+
     /*
      * Use select() so we do not depend on alarm() and on signal() handlers.
      * Restart select() when interrupted by some signal. Some select()
@@ -231,6 +239,12 @@ int     poll_fd_sysv(int fd, int request, int time_limit,
 {
     struct pollfd pollfd;
 
+    /*
+     * Don't sit on batched log records while we wait.
+     */
+    if (time_limit != 0)
+	msg_logger_flush();
+
     /*
      * System-V poll() is optimal for polling a few descriptors.
      */
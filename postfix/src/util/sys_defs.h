@@ -814,7 +814,9 @@ extern int initgroups(const char *, int);
 #define CANT_WRITE_BEFORE_SENDING_FD
 #endif
 #define PREFERRED_RAND_SOURCE	"dev:/dev/urandom"	/* introduced in 1.1 */
-#ifndef NO_EPOLL
+#if defined(USE_IO_URING)
+#define EVENTS_STYLE	EVENTS_STYLE_IO_URING	/* introduced in 3.6 */
+#elif !defined(NO_EPOLL)
 #define EVENTS_STYLE	EVENTS_STYLE_EPOLL	/* introduced in 2.5 */
 #endif
 #define USE_SYSV_POLL
@@ -1377,7 +1379,7 @@ extern int inet_pton(int, const char *, void *);
 #endif
 
  /*
-  * Defaults for systems without kqueue, /dev/poll or epoll support.
+  * Defaults for systems without kqueue, /dev/poll, epoll or io_uring support.
   * master/multi-server.c and *qmgr/qmgr_transport.c depend on this.
   */
 #if !defined(EVENTS_STYLE)
@@ -1388,6 +1390,7 @@ extern int inet_pton(int, const char *, void *);
 #define EVENTS_STYLE_KQUEUE	2	/* FreeBSD kqueue */
 #define EVENTS_STYLE_DEVPOLL	3	/* Solaris /dev/poll */
 #define EVENTS_STYLE_EPOLL	4	/* Linux epoll */
+#define EVENTS_STYLE_IO_URING	5	/* Linux io_uring */
 
  /*
   * We use poll() for read/write time limit enforcement on modern systems. We
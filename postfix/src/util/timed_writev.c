@@ -0,0 +1,87 @@
+/*++
+/* NAME
+/*	timed_writev 3
+/* SUMMARY
+/*	gather write operation with pre-write timeout
+/* SYNOPSIS
+/*	#include <iostuff.h>
+/*
+/*	ssize_t	timed_writev(fd, iov, iovcnt, timeout, context)
+/*	int	fd;
+/*	const struct iovec *iov;
+/*	int	iovcnt;
+/*	int	timeout;
+/*	void	*context;
+/* DESCRIPTION
+/*	timed_writev() performs a writev() operation when the specified
+/*	descriptor becomes writable within a user-specified deadline.
+/*
+/*	Arguments:
+/* .IP fd
+/*	File descriptor in the range 0..FD_SETSIZE.
+/* .IP iov
+/*	Array of write buffer pointers and sizes.
+/* .IP iovcnt
+/*	The number of array elements.
+/* .IP timeout
+/*	The deadline in seconds. If this is <= 0, the deadline feature
+/*	is disabled.
+/* .IP context
+/*	Application context. This parameter is unused. It exists only
+/*	for the sake of VSTREAM compatibility.
+/* DIAGNOSTICS
+/*	When the operation does not complete within the deadline, the
+/*	result value is -1, and errno is set to ETIMEDOUT.
+/*	All other returns are identical to those of a writev(2) operation.
+/* SEE ALSO
+/*	timed_write(3) write operation with pre-write timeout
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <iostuff.h>
+
+/* timed_writev - gather write with deadline */
+
+ssize_t timed_writev(int fd, const struct iovec *iov, int iovcnt,
+		             int timeout, void *unused_context)
+{
+    ssize_t ret;
+
+    /*
+     * Wait for a limited amount of time for something to happen. If nothing
+     * happens, report an ETIMEDOUT error. See timed_write() for the EAGAIN
+     * workaround.
+     */
+    for (;;) {
+	if (timeout > 0 && write_wait(fd, timeout) < 0)
+	    return (-1);
+	if ((ret = writev(fd, iov, iovcnt)) < 0 && timeout > 0 && errno == EAGAIN) {
+	    msg_warn("writev() returns EAGAIN on a writable file descriptor!");
+	    msg_warn("pausing to avoid going into a tight select/write loop!");
+	    sleep(1);
+	    continue;
+	} else if (ret < 0 && errno == EINTR) {
+	    continue;
+	} else {
+	    return (ret);
+	}
+    }
+}
@@ -81,6 +81,11 @@
 /*	void *buf;
 /*	ssize_t	len;
 /*
+/*	ssize_t	vstream_fwritev(stream, iov, iovcnt)
+/*	VSTREAM	*stream;
+/*	const struct iovec *iov;
+/*	int	iovcnt;
+/*
 /*	ssize_t	vstream_fread_app(stream, buf, len)
 /*	VSTREAM	*stream;
 /*	VSTRING	*buf;
@@ -138,6 +143,10 @@
 /*	const char *vstream_peek_data(stream)
 /*	VSTREAM	*stream;
 /*
+/*	ssize_t	vstream_peek_skip(stream, len)
+/*	VSTREAM	*stream;
+/*	ssize_t	len;
+/*
 /*	int	vstream_setjmp(stream)
 /*	VSTREAM	*stream;
 /*
@@ -297,6 +306,15 @@
 /*	transferred. A short count is returned in case of end-of-file
 /*	or error conditions.
 /*
+/*	vstream_fwritev() writes the content of up to VSTREAM_IOV_MAX
+/*	caller-owned buffers, as if with one vstream_fwrite() call
+/*	per buffer. When the data does not fit in the stream buffer,
+/*	it is not copied: vstream_fwritev() sends any buffered output
+/*	and the caller's buffers with one gather write operation.
+/*	The caller's buffers are not accessed after vstream_fwritev()
+/*	returns. The result value is the total number of bytes
+/*	written, or VSTREAM_EOF in case of error.
+/*
 /*	vstream_fread_buf() resets the buffer write position,
 /*	allocates space for the specified number of bytes in the
 /*	buffer, reads the bytes from the specified VSTREAM, and
@@ -332,6 +350,16 @@
 /*	This function should return the positive number of bytes transferred,
 /*	and -1 upon error with errno set appropriately. Instead of -1 it may
 /*	also return 0, e.g., upon remote party-initiated protocol shutdown.
+/*	This request also disables the gather write function (see below).
+/* .IP "CA_VSTREAM_CTL_WRITEV_FN(ssize_t (*)(int, const struct iovec *, int, int, void *))"
+/*	The argument specifies an alternative for the timed_writev(3)
+/*	function that is used by vstream_fwritev(), or a null pointer
+/*	to copy all vstream_fwritev() data into the stream buffer.
+/*	This function receives as arguments a file descriptor, an
+/*	iovec array pointer, the number of array elements, timeout
+/*	value, and the VSTREAM's context value. The result value
+/*	is as with the CA_VSTREAM_CTL_WRITE_FN function. Specify
+/*	this after CA_VSTREAM_CTL_WRITE_FN.
 /* .IP "CA_VSTREAM_CTL_CONTEXT(void *)"
 /*	The argument specifies application context that is passed on to
 /*	the application-specified read/write routines. No copy is made.
@@ -449,6 +477,12 @@
 /*	that exist according to vstream_peek(), or null if no unread
 /*	bytes are available.
 /*
+/*	vstream_peek_skip() consumes up to \fIlen\fR of the unread
+/*	bytes that exist according to vstream_peek(), as if they
+/*	were read, and returns the number of bytes consumed. Together
+/*	with vstream_peek_data(), this allows an application to
+/*	process buffered input without copying it.
+/*
 /*	vstream_setjmp() saves processing context and makes that context
 /*	available for use with vstream_longjmp().  Normally, vstream_setjmp()
 /*	returns zero.  A non-zero result means that vstream_setjmp() returned
@@ -550,19 +584,19 @@ VSTREAM vstream_fstd[] = {
 	    0, 0, 0, 0,			/* buffer */
 	    vstream_buf_get_ready, vstream_buf_put_ready, vstream_buf_space,
     }, STDIN_FILENO, (VSTREAM_RW_FN) timed_read, (VSTREAM_RW_FN) timed_write,
-    0,},
+    timed_writev, 0,},
     {{
 	    0,				/* flags */
 	    0, 0, 0, 0,			/* buffer */
 	    vstream_buf_get_ready, vstream_buf_put_ready, vstream_buf_space,
     }, STDOUT_FILENO, (VSTREAM_RW_FN) timed_read, (VSTREAM_RW_FN) timed_write,
-    0,},
+    timed_writev, 0,},
     {{
 	    VBUF_FLAG_FIXED | VSTREAM_FLAG_WRITE,
 	    vstream_fstd_buf, VSTREAM_BUFSIZE, VSTREAM_BUFSIZE, vstream_fstd_buf,
 	    vstream_buf_get_ready, vstream_buf_put_ready, vstream_buf_space,
     }, STDERR_FILENO, (VSTREAM_RW_FN) timed_read, (VSTREAM_RW_FN) timed_write,
-    VSTREAM_BUFSIZE,},
+    timed_writev, VSTREAM_BUFSIZE,},
 };
 
 #define VSTREAM_STATIC(v) ((v) >= VSTREAM_IN && (v) <= VSTREAM_ERR)
@@ -708,58 +742,24 @@ static void vstream_buf_wipe(VBUF *bp)
     VSTREAM_BUF_ACTIONS(bp, 0, 0, 0);
 }
 
-/* vstream_fflush_some - flush some buffered data */
+/* vstream_fflush_iov - write data, allow for partial writes */
 
-static int vstream_fflush_some(VSTREAM *stream, ssize_t to_flush)
+static int vstream_fflush_iov(VSTREAM *stream, struct iovec *iov, int iovcnt,
+			              ssize_t to_flush)
 {
-    const char *myname = "vstream_fflush_some";
+    const char *myname = "vstream_fflush_iov";
     VBUF   *bp = &stream->buf;
-    ssize_t used;
-    ssize_t left_over;
-    void   *data;
     ssize_t len;
     ssize_t n;
+    ssize_t skip;
     int     timeout;
     struct timeval before;
     struct timeval elapsed;
 
-    /*
-     * Sanity checks. It is illegal to flush a read-only stream. Otherwise,
-     * if there is buffered input, discard the input. If there is buffered
-     * output, require that the amount to flush is larger than the amount to
-     * keep, so that we can memcpy() the residue.
-     */
-    if (bp->put_ready == 0)
-	msg_panic("%s: read-only stream", myname);
-    switch (bp->flags & (VSTREAM_FLAG_WRITE | VSTREAM_FLAG_READ)) {
-    case VSTREAM_FLAG_READ:			/* discard input */
-	VSTREAM_BUF_AT_END(bp);
-	/* FALLTHROUGH */
-    case 0:					/* flush after seek? */
-	return ((bp->flags & VSTREAM_FLAG_ERR) ? VSTREAM_EOF : 0);
-    case VSTREAM_FLAG_WRITE:			/* output buffered */
-	break;
-    case VSTREAM_FLAG_WRITE | VSTREAM_FLAG_READ:
-	msg_panic("%s: read/write stream", myname);
-    }
-    used = bp->len - bp->cnt;
-    left_over = used - to_flush;
-
-    if (msg_verbose > 2 && stream != VSTREAM_ERR)
-	msg_info("%s: fd %d flush %ld", myname, stream->fd, (long) to_flush);
-    if (to_flush < 0 || left_over < 0)
-	msg_panic("%s: bad to_flush %ld", myname, (long) to_flush);
-    if (to_flush < left_over)
-	msg_panic("%s: to_flush < left_over", myname);
-    if (to_flush == 0)
-	return ((bp->flags & VSTREAM_FLAG_ERR) ? VSTREAM_EOF : 0);
-    if (bp->flags & VSTREAM_FLAG_ERR)
-	return (VSTREAM_EOF);
-
     /*
      * When flushing a buffer, allow for partial writes. These can happen
-     * while talking to a network. Update the cached file seek position, if
-     * any.
+     * while talking to a network. After a partial write, skip the data that
+     * was written, and update the caller's iovec array in place.
      * 
      * When deadlines are enabled, we count the elapsed time for each write
      * operation instead of simply comparing the time-of-day clock with a
@@ -768,7 +768,7 @@ static int vstream_fflush_some(VSTREAM *stream, ssize_t to_flush)
      * mind that a receiver may not be able to keep up when a sender suddenly
      * floods it with a lot of data as it tries to catch up with a deadline.
      */
-    for (data = (void *) bp->data, len = to_flush; len > 0; len -= n, data += n) {
+    for (len = to_flush; len > 0; len -= n) {
 	if (bp->flags & VSTREAM_FLAG_DEADLINE) {
 	    timeout = stream->time_limit.tv_sec + (stream->time_limit.tv_usec > 0);
 	    if (timeout <= 0) {
@@ -782,7 +782,11 @@ static int vstream_fflush_some(VSTREAM *stream, ssize_t to_flush)
 		before = stream->iotime;
 	} else
 	    timeout = stream->timeout;
-	if ((n = stream->write_fn(stream->fd, data, len, timeout, stream->context)) <= 0) {
+	if ((n = (iovcnt == 1 ?
+		  stream->write_fn(stream->fd, iov->iov_base, iov->iov_len,
+				   timeout, stream->context) :
+		  stream->writev_fn(stream->fd, iov, iovcnt,
+				    timeout, stream->context))) <= 0) {
 	    bp->flags |= VSTREAM_FLAG_WR_ERR;
 	    if (errno == ETIMEDOUT) {
 		bp->flags |= VSTREAM_FLAG_WR_TIMEOUT;
@@ -800,7 +804,69 @@ static int vstream_fflush_some(VSTREAM *stream, ssize_t to_flush)
 	if (msg_verbose > 2 && stream != VSTREAM_ERR && n != to_flush)
 	    msg_info("%s: %d flushed %ld/%ld", myname, stream->fd,
 		     (long) n, (long) to_flush);
+	if (n < len) {
+	    for (skip = n; (size_t) skip >= iov->iov_len; skip -= iov->iov_len) {
+		iov++;
+		iovcnt--;
+	    }
+	    iov->iov_base = (char *) iov->iov_base + skip;
+	    iov->iov_len -= skip;
+	}
+    }
+    return (0);
+}
+
+/* vstream_fflush_some - flush some buffered data */
+
+static int vstream_fflush_some(VSTREAM *stream, ssize_t to_flush)
+{
+    const char *myname = "vstream_fflush_some";
+    VBUF   *bp = &stream->buf;
+    ssize_t used;
+    ssize_t left_over;
+    struct iovec iov;
+
+    /*
+     * Sanity checks. It is illegal to flush a read-only stream. Otherwise,
+     * if there is buffered input, discard the input. If there is buffered
+     * output, require that the amount to flush is larger than the amount to
+     * keep, so that we can memcpy() the residue.
+     */
+    if (bp->put_ready == 0)
+	msg_panic("%s: read-only stream", myname);
+    switch (bp->flags & (VSTREAM_FLAG_WRITE | VSTREAM_FLAG_READ)) {
+    case VSTREAM_FLAG_READ:			/* discard input */
+	VSTREAM_BUF_AT_END(bp);
+	/* FALLTHROUGH */
+    case 0:					/* flush after seek? */
+	return ((bp->flags & VSTREAM_FLAG_ERR) ? VSTREAM_EOF : 0);
+    case VSTREAM_FLAG_WRITE:			/* output buffered */
+	break;
+    case VSTREAM_FLAG_WRITE | VSTREAM_FLAG_READ:
+	msg_panic("%s: read/write stream", myname);
     }
+    used = bp->len - bp->cnt;
+    left_over = used - to_flush;
+
+    if (msg_verbose > 2 && stream != VSTREAM_ERR)
+	msg_info("%s: fd %d flush %ld", myname, stream->fd, (long) to_flush);
+    if (to_flush < 0 || left_over < 0)
+	msg_panic("%s: bad to_flush %ld", myname, (long) to_flush);
+    if (to_flush < left_over)
+	msg_panic("%s: to_flush < left_over", myname);
+    if (to_flush == 0)
+	return ((bp->flags & VSTREAM_FLAG_ERR) ? VSTREAM_EOF : 0);
+    if (bp->flags & VSTREAM_FLAG_ERR)
+	return (VSTREAM_EOF);
+
+    /*
+     * When flushing a buffer, allow for partial writes. Update the cached
+     * file seek position, if any.
+     */
+    iov.iov_base = (void *) bp->data;
+    iov.iov_len = to_flush;
+    if (vstream_fflush_iov(stream, &iov, 1, to_flush) != 0)
+	return (VSTREAM_EOF);
     if (bp->flags & VSTREAM_FLAG_SEEK)
 	stream->offset += to_flush;
 
@@ -1326,6 +1392,7 @@ VSTREAM *vstream_fdopen(int fd, int flags)
     stream->fd = fd;
     stream->read_fn = VSTREAM_CAN_READ(flags) ? (VSTREAM_RW_FN) timed_read : 0;
     stream->write_fn = VSTREAM_CAN_WRITE(flags) ? (VSTREAM_RW_FN) timed_write : 0;
+    stream->writev_fn = VSTREAM_CAN_WRITE(flags) ? timed_writev : 0;
     vstream_buf_init(&stream->buf, flags);
     return (stream);
 }
@@ -1378,6 +1445,72 @@ int     vstream_fflush(VSTREAM *stream)
     return (VSTREAM_FFLUSH_SOME(stream));
 }
 
+/* vstream_fwritev - write data from multiple buffers */
+
+ssize_t vstream_fwritev(VSTREAM *stream, const struct iovec *iov, int iovcnt)
+{
+    const char *myname = "vstream_fwritev";
+    VBUF   *bp = &stream->buf;
+    struct iovec vec[VSTREAM_IOV_MAX + 1];
+    ssize_t total;
+    ssize_t used;
+    int     n;
+
+    if (iovcnt < 0 || iovcnt > VSTREAM_IOV_MAX)
+	msg_panic("%s: bad iovec count %d", myname, iovcnt);
+    for (total = 0, n = 0; n < iovcnt; n++)
+	total += iov[n].iov_len;
+
+    /*
+     * Enter write mode, so that we know how much space is left in the write
+     * buffer. The first write operation also allocates the buffer.
+     */
+    if (stream->writev_fn != 0 && (bp->flags & VSTREAM_FLAG_WRITE) == 0
+	&& total > 0 && bp->put_ready(bp) != 0)
+	return (VSTREAM_EOF);
+
+    /*
+     * Copy data that fits into the stream buffer, as vstream_fwrite() does.
+     * Send larger amounts of data with one gather write operation, after any
+     * output that is already buffered. This avoids copying the data, and
+     * avoids multiple write operations for data that would not fit into the
+     * buffer anyway.
+     */
+    if ((bp->flags & VSTREAM_FLAG_WRITE) != 0 && total <= bp->cnt) {
+	for (n = 0; n < iovcnt; n++) {
+	    memcpy(bp->ptr, iov[n].iov_base, iov[n].iov_len);
+	    bp->ptr += iov[n].iov_len;
+	}
+	bp->cnt -= total;
+	return (total);
+    }
+    if (stream->writev_fn == 0 || (bp->flags & VSTREAM_FLAG_WRITE) == 0) {
+	for (n = 0; n < iovcnt; n++)
+	    if (vbuf_write(bp, iov[n].iov_base, iov[n].iov_len)
+		!= (ssize_t) iov[n].iov_len)
+		return (VSTREAM_EOF);
+	return (total);
+    }
+    if (bp->flags & VSTREAM_FLAG_ERR)
+	return (VSTREAM_EOF);
+    if (msg_verbose > 2 && stream != VSTREAM_ERR)
+	msg_info("%s: fd %d write %ld", myname, stream->fd, (long) total);
+    n = 0;
+    if ((used = bp->len - bp->cnt) > 0) {
+	vec[n].iov_base = (void *) bp->data;
+	vec[n].iov_len = used;
+	n++;
+    }
+    memcpy((void *) (vec + n), (void *) iov, iovcnt * sizeof(*iov));
+    if (vstream_fflush_iov(stream, vec, n + iovcnt, used + total) != 0)
+	return (VSTREAM_EOF);
+    if (bp->flags & VSTREAM_FLAG_SEEK)
+	stream->offset += used + total;
+    bp->cnt += used;
+    bp->ptr -= used;
+    return (total);
+}
+
 /* vstream_fclose - close buffered stream */
 
 int     vstream_fclose(VSTREAM *stream)
@@ -1543,6 +1676,10 @@ void    vstream_control(VSTREAM *stream, int name,...)
 	    break;
 	case VSTREAM_CTL_WRITE_FN:
 	    stream->write_fn = va_arg(ap, VSTREAM_RW_FN);
+	    stream->writev_fn = 0;
+	    break;
+	case VSTREAM_CTL_WRITEV_FN:
+	    stream->writev_fn = va_arg(ap, VSTREAM_WRITEV_FN);
 	    break;
 	case VSTREAM_CTL_CONTEXT:
 	    stream->context = va_arg(ap, void *);
@@ -1757,6 +1894,28 @@ const char *vstream_peek_data(VSTREAM *vp)
     }
 }
 
+/* vstream_peek_skip - consume unread data */
+
+ssize_t vstream_peek_skip(VSTREAM *vp, ssize_t len)
+{
+    VBUF   *bp;
+
+    if (vp->buf.flags & VSTREAM_FLAG_READ) {
+	bp = &vp->buf;
+    } else if (vp->buf.flags & VSTREAM_FLAG_DOUBLE) {
+	bp = &vp->read_buf;
+    } else {
+	return (0);
+    }
+    if (len > -bp->cnt)
+	len = -bp->cnt;
+    if (len > 0) {
+	bp->ptr += len;
+	bp->cnt += len;
+    }
+    return (len);
+}
+
 /* vstream_memopen - open a VSTRING */
 
 VSTREAM *vstream_memreopen(VSTREAM *stream, VSTRING *string, int flags)
@@ -1768,6 +1927,7 @@ VSTREAM *vstream_memreopen(VSTREAM *stream, VSTRING *string, int flags)
     stream->fd = -1;
     stream->read_fn = 0;
     stream->write_fn = 0;
+    stream->writev_fn = 0;
     stream->vstring = string;
     memcpy(&stream->buf, &stream->vstring->vbuf, sizeof(stream->buf));
     stream->buf.flags |= VSTREAM_FLAG_MEMORY;
@@ -1956,6 +2116,77 @@ static void do_memory_stream(void)
     vstring_free(buf);
 }
 
+static void do_writev(void)
+{
+    VSTRING *buf = vstring_alloc(1);
+    VSTREAM *fp;
+    struct iovec iov[3];
+    char    big[2 * VSTREAM_BUFSIZE];
+    char   *got;
+    ssize_t len;
+    ssize_t count;
+    ssize_t n;
+    int     fds[2];
+
+    /*
+     * Test: gather write to a memory stream. The data is copied into the
+     * VSTRING.
+     */
+    vstream_printf("gather write test: write three pieces to memory stream\n");
+    iov[0].iov_base = "hello";
+    iov[0].iov_len = 5;
+    iov[1].iov_base = ", ";
+    iov[1].iov_len = 2;
+    iov[2].iov_base = "world";
+    iov[2].iov_len = 5;
+    fp = vstream_memopen(buf, O_WRONLY);
+    vstream_printf("vstream_fwritev result: %ld\n",
+		   (long) vstream_fwritev(fp, iov, 3));
+    vstream_fclose(fp);
+    vstream_printf("VSTRING content length: %ld, content: %s\n",
+		   (long) VSTRING_LEN(buf), vstring_str(buf));
+    VSTREAM_PUTCHAR('\n');
+    vstream_fflush(VSTREAM_OUT);
+
+    /*
+     * Test: gather write to a pipe. Small data is buffered; large data is
+     * written together with the buffered data, bypassing the buffer.
+     */
+    vstream_printf("gather write test: write small and large pieces to pipe\n");
+    if (pipe(fds) < 0)
+	msg_fatal("pipe: %m");
+    fp = vstream_fdopen(fds[1], O_WRONLY);
+    vstream_printf("vstream_fwritev result: %ld\n",
+		   (long) vstream_fwritev(fp, iov, 3));
+    vstream_printf("buffered output: %ld\n",
+		   (long) vstream_bufstat(fp, VSTREAM_BST_OUT_PEND));
+    memset(big, 'x', sizeof(big));
+    iov[0].iov_base = big;
+    iov[0].iov_len = sizeof(big);
+    iov[1].iov_base = "!";
+    iov[1].iov_len = 1;
+    vstream_printf("vstream_fwritev result: %ld\n",
+		   (long) vstream_fwritev(fp, iov, 2));
+    vstream_printf("buffered output: %ld\n",
+		   (long) vstream_bufstat(fp, VSTREAM_BST_OUT_PEND));
+    if (vstream_fclose(fp) != 0)
+	msg_fatal("vstream_fclose: %m");
+    len = 12 + sizeof(big) + 1;
+    got = mymalloc(len + 1);
+    for (n = 0; n < len + 1; n += count)
+	if ((count = read(fds[0], got + n, len + 1 - n)) <= 0)
+	    break;
+    (void) close(fds[0]);
+    vstream_printf("pipe content check: %s\n",
+		   n == len && memcmp(got, "hello, world", 12) == 0
+		   && memcmp(got + 12, big, sizeof(big)) == 0
+		   && got[len - 1] == '!' ? "PASS" : "FAIL");
+    VSTREAM_PUTCHAR('\n');
+    vstream_fflush(VSTREAM_OUT);
+    myfree(got);
+    vstring_free(buf);
+}
+
  /*
   * Exercise some of the features.
   */
@@ -1975,6 +2206,7 @@ int     main(int argc, char **argv)
     copy_line(1);				/* two-byte read/write */
     printf_number();				/* multi-byte write */
     do_memory_stream();
+    do_writev();
 
     exit(0);
 }
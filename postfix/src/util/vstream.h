@@ -15,6 +15,7 @@
   * System library.
   */
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <fcntl.h>
 #include <stdarg.h>
@@ -32,6 +33,7 @@
   * official interface and can change without prior notice.
   */
 typedef ssize_t (*VSTREAM_RW_FN) (int, void *, size_t, int, void *);
+typedef ssize_t (*VSTREAM_WRITEV_FN) (int, const struct iovec *, int, int, void *);
 typedef pid_t(*VSTREAM_WAITPID_FN) (pid_t, WAIT_STATUS_T *, int);
 
 #ifdef NO_SIGSETJMP
@@ -45,6 +47,7 @@ typedef struct VSTREAM {
     int     fd;				/* file handle, no 256 limit */
     VSTREAM_RW_FN read_fn;		/* buffer fill action */
     VSTREAM_RW_FN write_fn;		/* buffer flush action */
+    VSTREAM_WRITEV_FN writev_fn;	/* gather flush action */
     ssize_t req_bufsize;		/* requested read/write buffer size */
     void   *context;			/* application context */
     off_t   offset;			/* cached seek info */
@@ -107,6 +110,10 @@ extern int vstream_fdclose(VSTREAM *);
 #define vstream_fread(v, b, n)	vbuf_read(&(v)->buf, (b), (n))
 #define vstream_fwrite(v, b, n)	vbuf_write(&(v)->buf, (b), (n))
 
+#define VSTREAM_IOV_MAX		16	/* vstream_fwritev() limit */
+
+extern ssize_t vstream_fwritev(VSTREAM *, const struct iovec *, int);
+
 #define VSTREAM_PUTC(ch, vp)	VBUF_PUT(&(vp)->buf, (ch))
 #define VSTREAM_GETC(vp)	VBUF_GET(&(vp)->buf)
 #define vstream_ungetc(vp, ch)	vbuf_unget(&(vp)->buf, (ch))
@@ -155,6 +162,7 @@ extern void vstream_control(VSTREAM *, int,...);
 #define VSTREAM_CTL_SWAP_FD	13
 #define VSTREAM_CTL_START_DEADLINE 14
 #define VSTREAM_CTL_STOP_DEADLINE 15
+#define VSTREAM_CTL_WRITEV_FN	16
 
 /* Safer API: type-checked arguments, external use. */
 #define CA_VSTREAM_CTL_END		VSTREAM_CTL_END
@@ -175,11 +183,13 @@ extern void vstream_control(VSTREAM *, int,...);
 #define CA_VSTREAM_CTL_SWAP_FD(v)	VSTREAM_CTL_SWAP_FD, CHECK_PTR(VSTREAM_CTL, VSTREAM, (v))
 #define CA_VSTREAM_CTL_START_DEADLINE	VSTREAM_CTL_START_DEADLINE
 #define CA_VSTREAM_CTL_STOP_DEADLINE	VSTREAM_CTL_STOP_DEADLINE
+#define CA_VSTREAM_CTL_WRITEV_FN(v)	VSTREAM_CTL_WRITEV_FN, CHECK_VAL(VSTREAM_CTL, VSTREAM_WRITEV_FN, (v))
 
 CHECK_VAL_HELPER_DCL(VSTREAM_CTL, ssize_t);
 CHECK_VAL_HELPER_DCL(VSTREAM_CTL, int);
 CHECK_VAL_HELPER_DCL(VSTREAM_CTL, VSTREAM_WAITPID_FN);
 CHECK_VAL_HELPER_DCL(VSTREAM_CTL, VSTREAM_RW_FN);
+CHECK_VAL_HELPER_DCL(VSTREAM_CTL, VSTREAM_WRITEV_FN);
 CHECK_PTR_HELPER_DCL(VSTREAM_CTL, void);
 CHECK_PTR_HELPER_DCL(VSTREAM_CTL, VSTREAM);
 CHECK_CPTR_HELPER_DCL(VSTREAM_CTL, char);
@@ -237,6 +247,7 @@ extern ssize_t vstream_bufstat(VSTREAM *, int);
 #define vstream_peek(vp) vstream_bufstat((vp), VSTREAM_BST_IN_PEND)
 
 extern const char *vstream_peek_data(VSTREAM *);
+extern ssize_t vstream_peek_skip(VSTREAM *, ssize_t);
 
  /*
   * Exception handling. We use pointer to jmp_buf to avoid a lot of unused
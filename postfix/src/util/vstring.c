@@ -123,6 +123,8 @@
 /*
 /*	VSTRING	*vstring_import(str)
 /*	char	*str;
+/*
+/*	void	vstring_pool_reset(void)
 /* DESCRIPTION
 /*	The functions and macros in this module implement arbitrary-length
 /*	strings and common operations on those strings. The strings do not
@@ -160,6 +162,13 @@
 /*	vstring_free() reclaims storage for a variable-length string.
 /*	It conveniently returns a null pointer.
 /*
+/*	To avoid two malloc()/free() pairs for each short-lived
+/*	string, vstring_free() keeps a bounded number of strings
+/*	with small buffers in a pool, and vstring_alloc() reuses
+/*	those before it allocates new memory. A pooled string may
+/*	have a larger buffer than requested. vstring_free() detects
+/*	an attempt to free a pooled string.
+/*
 /*	vstring_str() is a macro that returns the string value
 /*	of a variable-length string. It is a safe macro that
 /*	evaluates its argument only once.
@@ -265,6 +274,11 @@
 /*	vstring_import() takes a `bare' string and converts it to
 /*	a VSTRING. The string argument must be obtained from mymalloc().
 /*	The string argument is not copied.
+/*
+/*	vstring_pool_reset() releases the memory of all pooled
+/*	strings. A long-running program may call this at the end
+/*	of a transaction, so that strings that were released during
+/*	the transaction do not keep memory in use while idle.
 /* DIAGNOSTICS
 /*	Fatal errors: memory allocation failure.
 /* BUGS
@@ -303,6 +317,16 @@
 #include "vbuf_print.h"
 #include "vstring.h"
 
+ /*
+  * Pool with released strings. Strings with large buffers are not saved, so
+  * that one unusual input does not pin a lot of memory.
+  */
+#define VSTRING_POOL_LIMIT	64	/* max number of saved strings */
+#define VSTRING_POOL_MAXSIZE	1024	/* max buffer size of saved string */
+
+static VSTRING *vstring_pool[VSTRING_POOL_LIMIT];
+static int vstring_pool_count;
+
 /* vstring_extend - variable-length string buffer extension policy */
 
 static void vstring_extend(VBUF *bp, ssize_t incr)
@@ -375,6 +399,24 @@ VSTRING *vstring_alloc(ssize_t len)
      */
     if (len < 1 || len > SSIZE_T_MAX - 1)
 	msg_panic("vstring_alloc: bad length %ld", (long) len);
+
+    /*
+     * Reuse a released string. Most strings are allocated with a small
+     * initial size, so that a pooled buffer is usually large enough.
+     */
+    if (vstring_pool_count > 0 && len <= VSTRING_POOL_MAXSIZE) {
+	vp = vstring_pool[--vstring_pool_count];
+	vp->vbuf.flags = 0;
+	if (vp->vbuf.len < len) {
+	    vp->vbuf.data = (unsigned char *)
+		myrealloc((void *) vp->vbuf.data, len + 1);
+	    vp->vbuf.data[len] = 0;
+	    vp->vbuf.len = len;
+	}
+	VSTRING_RESET(vp);
+	vp->vbuf.data[0] = 0;
+	return (vp);
+    }
     vp = (VSTRING *) mymalloc(sizeof(*vp));
     vp->vbuf.flags = 0;
     vp->vbuf.len = 0;
@@ -393,12 +435,33 @@ VSTRING *vstring_alloc(ssize_t len)
 
 VSTRING *vstring_free(VSTRING *vp)
 {
+    if (vp->vbuf.flags & VSTRING_FLAG_POOLED)
+	msg_panic("vstring_free: string is already free");
+    if (vstring_pool_count < VSTRING_POOL_LIMIT && vp->vbuf.data != 0
+	&& vp->vbuf.len <= VSTRING_POOL_MAXSIZE) {
+	vp->vbuf.flags = VSTRING_FLAG_POOLED;
+	vstring_pool[vstring_pool_count++] = vp;
+	return (0);
+    }
     if (vp->vbuf.data)
 	myfree((void *) vp->vbuf.data);
     myfree((void *) vp);
     return (0);
 }
 
+/* vstring_pool_reset - release pooled strings */
+
+void    vstring_pool_reset(void)
+{
+    VSTRING *vp;
+
+    while (vstring_pool_count > 0) {
+	vp = vstring_pool[--vstring_pool_count];
+	myfree((void *) vp->vbuf.data);
+	myfree((void *) vp);
+    }
+}
+
 /* vstring_ctl - modify memory management policy */
 
 void    vstring_ctl(VSTRING *vp,...)
@@ -689,14 +752,86 @@ VSTRING *vstring_sprintf_prepend(VSTRING *vp, const char *format,...)
 
  /*
   * Test program - concatenate all command-line arguments into one string.
+  * With "-b transactions recipients", compare the cost of short-lived
+  * strings with and without reuse of released strings.
   */
 #include <stdio.h>
+#include <sys/time.h>
+
+/* elapsed - report time since start */
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+/* bench_transaction - per-recipient string usage pattern */
+
+static void bench_transaction(int rcpt_count, int reset_each)
+{
+    VSTRING *addr;
+    VSTRING *canon;
+    VSTRING *reply;
+    int     n;
+
+    /*
+     * Roughly what a recipient address check does: a few short-lived
+     * strings for the external and internal address form, and a reply.
+     */
+    for (n = 0; n < rcpt_count; n++) {
+	addr = vstring_alloc(100);
+	canon = vstring_alloc(100);
+	reply = vstring_alloc(10);
+	vstring_sprintf(addr, "<user%d@example.com>", n);
+	vstring_strncpy(canon, vstring_str(addr) + 1, VSTRING_LEN(addr) - 2);
+	vstring_sprintf(reply, "250 2.1.5 Ok %s", vstring_str(canon));
+	vstring_free(reply);
+	vstring_free(canon);
+	vstring_free(addr);
+	if (reset_each)
+	    vstring_pool_reset();
+    }
+    vstring_pool_reset();
+}
+
+/* bench - compare allocation with and without string reuse */
+
+static void bench(int txn_count, int rcpt_count)
+{
+    struct timeval start;
+    double  t_old;
+    double  t_new;
+    int     n;
+
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < txn_count; n++)
+	bench_transaction(rcpt_count, 1);
+    t_old = elapsed(&start);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < txn_count; n++)
+	bench_transaction(rcpt_count, 0);
+    t_new = elapsed(&start);
+    printf("no reuse: %d x %d recipients: %.3f s, %.3f us/transaction\n",
+	   txn_count, rcpt_count, t_old, t_old * 1e6 / txn_count);
+    printf("reuse:    %d x %d recipients: %.3f s, %.3f us/transaction\n",
+	   txn_count, rcpt_count, t_new, t_new * 1e6 / txn_count);
+}
 
 int     main(int argc, char **argv)
 {
-    VSTRING *vp = vstring_alloc(1);
+    VSTRING *vp;
     int     n;
 
+    if (argc == 4 && strcmp(argv[1], "-b") == 0) {
+	bench(atoi(argv[2]), atoi(argv[3]));
+	return (0);
+    }
+    vp = vstring_alloc(1);
+
     /*
      * Report the location of the gratuitous null terminator.
      */
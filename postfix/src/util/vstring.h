@@ -49,6 +49,7 @@ extern VSTRING *PRINTFLIKE(2, 3) vstring_sprintf_append(VSTRING *, const char *,
 extern VSTRING *PRINTFLIKE(2, 3) vstring_sprintf_prepend(VSTRING *, const char *,...);
 extern char *vstring_export(VSTRING *);
 extern VSTRING *vstring_import(char *);
+extern void vstring_pool_reset(void);
 
 /* Legacy API: constant plus type-unchecked argument. */
 #define VSTRING_CTL_EXACT	2
@@ -62,6 +63,7 @@ CHECK_VAL_HELPER_DCL(VSTRING_CTL, ssize_t);
 
 /* Flags 24..31 are reserved for VSTRING. */
 #define VSTRING_FLAG_EXACT	(1<<24)	/* exact allocation for tests */
+#define VSTRING_FLAG_POOLED	(1<<25)	/* released, kept for reuse */
 #define VSTRING_FLAG_MASK	(255 << 24)
 
  /*
@@ -578,6 +578,33 @@ static int verify_cache_validator(const char *addr, const char *raw_data,
 		|| !POS_OR_NEG_ENTRY_EXPIRED(addr_status, updated)));
 }
 
+/* verify_cache_expiry - earliest time that verify_cache_validator() drops entry */
+
+static time_t verify_cache_expiry(const char *addr, const char *raw_data,
+				          void *context)
+{
+    VSTRING *get_buf = (VSTRING *) context;
+    int     addr_status;
+    long    probed;
+    long    updated;
+    char   *text;
+    long    expires;
+
+    /*
+     * The validator removes an entry when no probe is in progress, and the
+     * positive or negative result has expired.
+     */
+    vstring_strcpy(get_buf, raw_data);
+    if (verify_parse_entry(STR(get_buf), &addr_status,
+			   &probed, &updated, &text) != 0)
+	return (0);
+    expires = updated + 1 + (addr_status == DEL_RCPT_STAT_OK ?
+			     var_verify_pos_exp : var_verify_neg_exp);
+    if (expires < probed + PROBE_TTL)
+	expires = probed + PROBE_TTL;
+    return ((time_t) expires);
+}
+
 /* verify_service - perform service for client */
 
 static void verify_service(VSTREAM *client_stream, char *unused_service,
@@ -658,6 +685,7 @@ static void post_jail_init(char *unused_name, char **unused_argv)
 			   CA_DICT_CACHE_CTL_FLAGS(cache_flags),
 			   CA_DICT_CACHE_CTL_INTERVAL(var_verify_scan_cache),
 			CA_DICT_CACHE_CTL_VALIDATOR(verify_cache_validator),
+			   CA_DICT_CACHE_CTL_EXPIRY(verify_cache_expiry),
 		     CA_DICT_CACHE_CTL_CONTEXT((void *) vstring_alloc(100)),
 			   CA_DICT_CACHE_CTL_END);
     }